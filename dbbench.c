@@ -0,0 +1,1116 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2026-10-19     RT-Thread    first version
+ */
+
+#include <rtthread.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <dfs_posix.h>
+#include "sqlite3.h"
+#include "rtthread_vfs.h"
+#include "dbhelper.h"
+#include "dbbulk.h"
+#ifdef PKG_SQLITE_BLOCKDEV
+#include "dbblock.h"
+#endif
+#ifdef PKG_SQLITE_LOGFS
+#include "dblog.h"
+#endif
+
+#define DBG_ENABLE
+#define DBG_SECTION_NAME "app.dbbench"
+#define DBG_LEVEL DBG_INFO
+#define DBG_COLOR
+#include <rtdbg.h>
+
+/* everything here is driven from the sqlbench shell command */
+#ifdef RT_USING_FINSH
+
+#ifndef BENCH_DB_NAME
+#define BENCH_DB_NAME "/bench.db"
+#endif
+#define BENCH_VFS_NAME "bench-count"
+
+/*
+ * A pass-through VFS over the default one that counts the bytes written and
+ * the syncs issued to the database and to its journal, so that benchmarks
+ * can report the write volume of a workload.
+ */
+struct bench_io_count
+{
+    rt_uint32_t db_reads;
+    rt_uint32_t db_locks;           /* xLock and xUnlock calls */
+    rt_uint32_t db_writes;
+    rt_uint32_t db_syncs;
+    sqlite3_int64 db_bytes;
+    rt_uint32_t jrnl_writes;
+    rt_uint32_t jrnl_syncs;
+    sqlite3_int64 jrnl_bytes;
+};
+
+struct bench_file
+{
+    sqlite3_file base;
+    sqlite3_file *real;
+    int kind;                       /* SQLITE_OPEN_MAIN_DB, SQLITE_OPEN_MAIN_JOURNAL or 0 */
+};
+
+static struct bench_io_count bench_count;
+#ifdef PKG_SQLITE_LOGFS
+static struct db_log_stats bench_log;   /* logfs counters when the commits started */
+#endif
+static sqlite3_vfs bench_vfs;
+static sqlite3_io_methods bench_io_methods;
+
+static int bench_io_close(sqlite3_file *f)
+{
+    struct bench_file *p = (struct bench_file *)f;
+    int rc = p->real->pMethods->xClose(p->real);
+    sqlite3_free(p->real);
+    return rc;
+}
+
+static int bench_io_read(sqlite3_file *f, void *buf, int amt, sqlite3_int64 ofst)
+{
+    struct bench_file *p = (struct bench_file *)f;
+    if (p->kind == SQLITE_OPEN_MAIN_DB)
+    {
+        bench_count.db_reads++;
+    }
+    return p->real->pMethods->xRead(p->real, buf, amt, ofst);
+}
+
+static int bench_io_write(sqlite3_file *f, const void *buf, int amt, sqlite3_int64 ofst)
+{
+    struct bench_file *p = (struct bench_file *)f;
+    if (p->kind == SQLITE_OPEN_MAIN_DB)
+    {
+        bench_count.db_writes++;
+        bench_count.db_bytes += amt;
+    }
+    else if (p->kind == SQLITE_OPEN_MAIN_JOURNAL)
+    {
+        bench_count.jrnl_writes++;
+        bench_count.jrnl_bytes += amt;
+    }
+    return p->real->pMethods->xWrite(p->real, buf, amt, ofst);
+}
+
+static int bench_io_truncate(sqlite3_file *f, sqlite3_int64 size)
+{
+    struct bench_file *p = (struct bench_file *)f;
+    return p->real->pMethods->xTruncate(p->real, size);
+}
+
+static int bench_io_sync(sqlite3_file *f, int flags)
+{
+    struct bench_file *p = (struct bench_file *)f;
+    if (p->kind == SQLITE_OPEN_MAIN_DB)
+    {
+        bench_count.db_syncs++;
+    }
+    else if (p->kind == SQLITE_OPEN_MAIN_JOURNAL)
+    {
+        bench_count.jrnl_syncs++;
+    }
+    return p->real->pMethods->xSync(p->real, flags);
+}
+
+static int bench_io_file_size(sqlite3_file *f, sqlite3_int64 *size)
+{
+    struct bench_file *p = (struct bench_file *)f;
+    return p->real->pMethods->xFileSize(p->real, size);
+}
+
+static int bench_io_lock(sqlite3_file *f, int lock)
+{
+    struct bench_file *p = (struct bench_file *)f;
+    if (p->kind == SQLITE_OPEN_MAIN_DB)
+    {
+        bench_count.db_locks++;
+    }
+    return p->real->pMethods->xLock(p->real, lock);
+}
+
+static int bench_io_unlock(sqlite3_file *f, int lock)
+{
+    struct bench_file *p = (struct bench_file *)f;
+    if (p->kind == SQLITE_OPEN_MAIN_DB)
+    {
+        bench_count.db_locks++;
+    }
+    return p->real->pMethods->xUnlock(p->real, lock);
+}
+
+static int bench_io_check_reserved(sqlite3_file *f, int *out)
+{
+    struct bench_file *p = (struct bench_file *)f;
+    return p->real->pMethods->xCheckReservedLock(p->real, out);
+}
+
+static int bench_io_file_control(sqlite3_file *f, int op, void *arg)
+{
+    struct bench_file *p = (struct bench_file *)f;
+    return p->real->pMethods->xFileControl(p->real, op, arg);
+}
+
+static int bench_io_sector_size(sqlite3_file *f)
+{
+    struct bench_file *p = (struct bench_file *)f;
+    return p->real->pMethods->xSectorSize(p->real);
+}
+
+static int bench_io_device_characteristics(sqlite3_file *f)
+{
+    struct bench_file *p = (struct bench_file *)f;
+    return p->real->pMethods->xDeviceCharacteristics(p->real);
+}
+
+static int bench_vfs_open(sqlite3_vfs *vfs, const char *name, sqlite3_file *f, int flags, int *out_flags)
+{
+    sqlite3_vfs *root = (sqlite3_vfs *)vfs->pAppData;
+    struct bench_file *p = (struct bench_file *)f;
+    int rc;
+
+    memset(p, 0, sizeof(struct bench_file));
+    p->real = sqlite3_malloc(root->szOsFile);
+    if (p->real == RT_NULL)
+    {
+        return SQLITE_NOMEM;
+    }
+    memset(p->real, 0, root->szOsFile);
+
+    rc = root->xOpen(root, name, p->real, flags, out_flags);
+    if (rc != SQLITE_OK || p->real->pMethods == RT_NULL)
+    {
+        sqlite3_free(p->real);
+        p->real = RT_NULL;
+        return rc;
+    }
+    p->kind = flags & (SQLITE_OPEN_MAIN_DB | SQLITE_OPEN_MAIN_JOURNAL);
+    p->base.pMethods = &bench_io_methods;
+    return SQLITE_OK;
+}
+
+static int bench_vfs_delete(sqlite3_vfs *vfs, const char *name, int sync_dir)
+{
+    sqlite3_vfs *root = (sqlite3_vfs *)vfs->pAppData;
+    return root->xDelete(root, name, sync_dir);
+}
+
+static int bench_vfs_access(sqlite3_vfs *vfs, const char *name, int flags, int *out)
+{
+    sqlite3_vfs *root = (sqlite3_vfs *)vfs->pAppData;
+    return root->xAccess(root, name, flags, out);
+}
+
+static int bench_vfs_fullpathname(sqlite3_vfs *vfs, const char *name, int n, char *out)
+{
+    sqlite3_vfs *root = (sqlite3_vfs *)vfs->pAppData;
+    return root->xFullPathname(root, name, n, out);
+}
+
+static int bench_vfs_randomness(sqlite3_vfs *vfs, int n, char *out)
+{
+    sqlite3_vfs *root = (sqlite3_vfs *)vfs->pAppData;
+    return root->xRandomness(root, n, out);
+}
+
+static int bench_vfs_sleep(sqlite3_vfs *vfs, int us)
+{
+    sqlite3_vfs *root = (sqlite3_vfs *)vfs->pAppData;
+    return root->xSleep(root, us);
+}
+
+static int bench_vfs_current_time(sqlite3_vfs *vfs, double *now)
+{
+    sqlite3_vfs *root = (sqlite3_vfs *)vfs->pAppData;
+    return root->xCurrentTime(root, now);
+}
+
+static int bench_vfs_register(void)
+{
+    sqlite3_vfs *root;
+
+    if (sqlite3_vfs_find(BENCH_VFS_NAME))
+    {
+        return SQLITE_OK;
+    }
+
+    root = sqlite3_vfs_find(RT_NULL);
+    if (root == RT_NULL)
+    {
+        return SQLITE_ERROR;
+    }
+
+    bench_io_methods.iVersion = 1;
+    bench_io_methods.xClose = bench_io_close;
+    bench_io_methods.xRead = bench_io_read;
+    bench_io_methods.xWrite = bench_io_write;
+    bench_io_methods.xTruncate = bench_io_truncate;
+    bench_io_methods.xSync = bench_io_sync;
+    bench_io_methods.xFileSize = bench_io_file_size;
+    bench_io_methods.xLock = bench_io_lock;
+    bench_io_methods.xUnlock = bench_io_unlock;
+    bench_io_methods.xCheckReservedLock = bench_io_check_reserved;
+    bench_io_methods.xFileControl = bench_io_file_control;
+    bench_io_methods.xSectorSize = bench_io_sector_size;
+    bench_io_methods.xDeviceCharacteristics = bench_io_device_characteristics;
+
+    bench_vfs.iVersion = 1;
+    bench_vfs.szOsFile = sizeof(struct bench_file);
+    bench_vfs.mxPathname = root->mxPathname;
+    bench_vfs.zName = BENCH_VFS_NAME;
+    bench_vfs.pAppData = root;
+    bench_vfs.xOpen = bench_vfs_open;
+    bench_vfs.xDelete = bench_vfs_delete;
+    bench_vfs.xAccess = bench_vfs_access;
+    bench_vfs.xFullPathname = bench_vfs_fullpathname;
+    bench_vfs.xRandomness = bench_vfs_randomness;
+    bench_vfs.xSleep = bench_vfs_sleep;
+    bench_vfs.xCurrentTime = bench_vfs_current_time;
+
+    return sqlite3_vfs_register(&bench_vfs, 0);
+}
+
+static rt_uint32_t bench_ms(rt_tick_t ticks)
+{
+    return (rt_uint32_t)((rt_uint64_t)ticks * 1000 / RT_TICK_PER_SECOND);
+}
+
+static int bench_exec(sqlite3 *db, const char *sql)
+{
+    char *err = RT_NULL;
+    int rc = sqlite3_exec(db, sql, 0, 0, &err);
+
+    if (rc != SQLITE_OK)
+    {
+        LOG_E("%s: %s", sql, err ? err : sqlite3_errstr(rc));
+        sqlite3_free(err);
+    }
+    return rc;
+}
+
+/*
+ * Create a fresh benchmark database with a table of "rows" records through
+ * the counting VFS, running "pragmas" before the table is created.
+ */
+static int bench_open_with(sqlite3 **db, const char *pragmas, int rows)
+{
+    int rc, i;
+    sqlite3_stmt *stmt;
+
+    bench_vfs_delete(&bench_vfs, BENCH_DB_NAME, 0);
+    rc = sqlite3_open_v2(BENCH_DB_NAME, db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, BENCH_VFS_NAME);
+    if (rc != SQLITE_OK)
+    {
+        LOG_E("open %s failed,rc=%d", BENCH_DB_NAME, rc);
+        sqlite3_close(*db);
+        return rc;
+    }
+    if (pragmas != RT_NULL && bench_exec(*db, pragmas) != SQLITE_OK)
+    {
+        return SQLITE_ERROR;
+    }
+    rc = bench_exec(*db, "CREATE TABLE kv(id INTEGER PRIMARY KEY, val INT, txt TEXT);");
+    if (rc != SQLITE_OK)
+    {
+        return rc;
+    }
+    bench_exec(*db, "BEGIN;");
+    sqlite3_prepare_v2(*db, "INSERT INTO kv(val,txt) VALUES(?,'sensor reading sample text');", -1, &stmt, RT_NULL);
+    for (i = 0; i < rows; i++)
+    {
+        sqlite3_bind_int(stmt, 1, i);
+        sqlite3_step(stmt);
+        sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+    return bench_exec(*db, "COMMIT;");
+}
+
+static int bench_open_fresh(sqlite3 **db, int rows)
+{
+    return bench_open_with(db, RT_NULL, rows);
+}
+
+/*
+ * Run "commits" single-row update transactions and report the bytes written
+ * per commit to the database and the journal.
+ */
+static int bench_commit_run(int commits, rt_tick_t *ticks)
+{
+    sqlite3 *db = RT_NULL;
+    sqlite3_stmt *stmt;
+    int rc, i;
+
+    rc = bench_open_fresh(&db, 1000);
+    if (rc != SQLITE_OK)
+    {
+        return rc;
+    }
+    memset(&bench_count, 0, sizeof(bench_count));
+#ifdef PKG_SQLITE_LOGFS
+    db_log_stats(&bench_log, 0);
+#endif
+    sqlite3_prepare_v2(db, "UPDATE kv SET val=val+1 WHERE id=?;", -1, &stmt, RT_NULL);
+    *ticks = rt_tick_get();
+    for (i = 0; i < commits; i++)
+    {
+        sqlite3_bind_int(stmt, 1, (i * 7919) % 1000 + 1);
+        rc = sqlite3_step(stmt);
+        sqlite3_reset(stmt);
+        if (rc != SQLITE_DONE)
+        {
+            LOG_E("update failed,rc=%d", rc);
+            break;
+        }
+    }
+    *ticks = rt_tick_get() - *ticks;
+    sqlite3_finalize(stmt);
+    sqlite3_close(db);
+    return rc == SQLITE_DONE ? SQLITE_OK : rc;
+}
+
+static void bench_count_print(const char *title, int commits, rt_tick_t ticks)
+{
+    rt_kprintf("%-10s db:%6d B/commit %3d.%02d syncs  journal:%6d B/commit %3d.%02d syncs  %4dms/commit\n", title,
+               (int)(bench_count.db_bytes / commits),
+               bench_count.db_syncs / commits, bench_count.db_syncs * 100 / commits % 100,
+               (int)(bench_count.jrnl_bytes / commits),
+               bench_count.jrnl_syncs / commits, bench_count.jrnl_syncs * 100 / commits % 100,
+               bench_ms(ticks) / commits);
+}
+
+/*
+ * bytes written per commit with the legacy geometry (default sector size,
+ * no IOCAP flags) against the geometry detected from the media.
+ */
+static int bench_geometry(int argc, char **argv)
+{
+    int commits = argc > 0 ? atoi(argv[0]) : 100;
+    rt_tick_t ticks;
+
+    if (commits <= 0)
+    {
+        commits = 100;
+    }
+    rt_kprintf("%d single-row commits on %s\n", commits, BENCH_DB_NAME);
+
+    rtthread_vfs_set_geometry("/", 4096, 0);
+    if (bench_commit_run(commits, &ticks) == SQLITE_OK)
+    {
+        bench_count_print("legacy", commits, ticks);
+    }
+
+    rtthread_vfs_set_geometry("/", 0, 0);
+    if (bench_commit_run(commits, &ticks) == SQLITE_OK)
+    {
+        bench_count_print("detected", commits, ticks);
+    }
+
+    unlink(BENCH_DB_NAME);
+    return 0;
+}
+
+/*
+ * commit latency with the journal created and deleted by every transaction
+ * against the journal kept open and invalidated in place.
+ */
+static int bench_journal(int argc, char **argv)
+{
+    int commits = argc > 0 ? atoi(argv[0]) : 100;
+    int reuse = rtthread_vfs_journal_reuse(-1);
+    rt_tick_t ticks;
+
+    if (commits <= 0)
+    {
+        commits = 100;
+    }
+    rt_kprintf("%d single-row commits on %s\n", commits, BENCH_DB_NAME);
+
+    rtthread_vfs_journal_reuse(0);
+    if (bench_commit_run(commits, &ticks) == SQLITE_OK)
+    {
+        bench_count_print("delete", commits, ticks);
+    }
+
+    rtthread_vfs_journal_reuse(1);
+    if (bench_commit_run(commits, &ticks) == SQLITE_OK)
+    {
+        bench_count_print("reuse", commits, ticks);
+    }
+
+    rtthread_vfs_journal_reuse(reuse);
+    unlink(BENCH_DB_NAME);
+    return 0;
+}
+
+/*
+ * latency of autocommit transactions, a point query then a single-row
+ * update, on a connection that locks the database and validates its cache
+ * in every transaction against one with the PRAGMAs of PKG_SQLITE_EXCLUSIVE,
+ * which keeps the database locked and the cache valid.
+ */
+static int bench_exclusive(int argc, char **argv)
+{
+    static const struct
+    {
+        const char *pragmas;
+        const char *name;
+    } kinds[] =
+    {
+        {"", "normal"},
+        {PKG_SQLITE_EXCLUSIVE_PRAGMAS, "exclusive"},
+    };
+    int rounds = argc > 0 ? atoi(argv[0]) : 100;
+    sqlite3_stmt *query, *update;
+    sqlite3 *db = RT_NULL;
+    rt_tick_t ticks;
+    int i, k, n, rc;
+
+    if (rounds <= 0)
+    {
+        rounds = 100;
+    }
+    n = rounds * 2;
+    rt_kprintf("%d transactions on %s\n", n, BENCH_DB_NAME);
+    for (k = 0; k < sizeof(kinds) / sizeof(kinds[0]); k++)
+    {
+        rc = bench_open_fresh(&db, 1000);
+        if (rc == SQLITE_OK)
+        {
+            rc = bench_exec(db, kinds[k].pragmas);
+        }
+        if (rc != SQLITE_OK)
+        {
+            sqlite3_close(db);
+            break;
+        }
+        sqlite3_prepare_v2(db, "SELECT val FROM kv WHERE id=?;", -1, &query, RT_NULL);
+        sqlite3_prepare_v2(db, "UPDATE kv SET val=val+1 WHERE id=?;", -1, &update, RT_NULL);
+        memset(&bench_count, 0, sizeof(bench_count));
+        ticks = rt_tick_get();
+        for (i = 0; i < rounds; i++)
+        {
+            sqlite3_bind_int(query, 1, (i * 7919) % 1000 + 1);
+            sqlite3_step(query);
+            sqlite3_reset(query);
+            sqlite3_bind_int(update, 1, (i * 7919) % 1000 + 1);
+            sqlite3_step(update);
+            sqlite3_reset(update);
+        }
+        ticks = rt_tick_get() - ticks;
+        sqlite3_finalize(query);
+        sqlite3_finalize(update);
+        sqlite3_close(db);
+        rt_kprintf("%-10s %6d us/txn  locks %3d.%02d  db reads %3d.%02d  syncs %3d.%02d per txn\n", kinds[k].name,
+                   (int)((rt_uint64_t)ticks * 1000000 / RT_TICK_PER_SECOND / n),
+                   bench_count.db_locks / n, bench_count.db_locks * 100 / n % 100,
+                   bench_count.db_reads / n, bench_count.db_reads * 100 / n % 100,
+                   (bench_count.db_syncs + bench_count.jrnl_syncs) / n,
+                   (bench_count.db_syncs + bench_count.jrnl_syncs) * 100 / n % 100);
+    }
+    unlink(BENCH_DB_NAME);
+    return 0;
+}
+
+/*
+ * the same workload under the SQLite defaults and each dbhelper profile: a
+ * bulk load of "rows" records in one transaction, "commits" single-row
+ * inserts each in its own transaction, then "rows" point queries.
+ */
+static int bench_profile(int argc, char **argv)
+{
+    static const char *const profiles[] = {"default", "durable", "fast-log", "read-mostly", "bulk-load"};
+    int rows = argc > 0 ? atoi(argv[0]) : 5000;
+    int commits = argc > 1 ? atoi(argv[1]) : 100;
+    sqlite3_stmt *insert, *query;
+    sqlite3 *db = RT_NULL;
+    rt_tick_t load, log, read;
+    rt_uint32_t syncs;
+    int i, k, rc;
+
+    if (rows <= 0)
+    {
+        rows = 5000;
+    }
+    if (commits <= 0)
+    {
+        commits = 100;
+    }
+    rt_kprintf("load %d rows, %d single-row commits and %d lookups on %s\n", rows, commits, rows, BENCH_DB_NAME);
+    rt_kprintf("profile       load ms  us/commit  syncs/commit  us/lookup\n");
+    for (k = 0; k < sizeof(profiles) / sizeof(profiles[0]); k++)
+    {
+        load = rt_tick_get();
+        rc = bench_open_with(&db, db_profile_pragmas(profiles[k]), rows);
+        load = rt_tick_get() - load;
+        if (rc != SQLITE_OK)
+        {
+            sqlite3_close(db);
+            break;
+        }
+        sqlite3_prepare_v2(db, "INSERT INTO kv(val,txt) VALUES(?,'event log sample text');", -1, &insert, RT_NULL);
+        sqlite3_prepare_v2(db, "SELECT val,txt FROM kv WHERE id=?;", -1, &query, RT_NULL);
+        memset(&bench_count, 0, sizeof(bench_count));
+        log = rt_tick_get();
+        for (i = 0; i < commits; i++)
+        {
+            sqlite3_bind_int(insert, 1, i);
+            sqlite3_step(insert);
+            sqlite3_reset(insert);
+        }
+        log = rt_tick_get() - log;
+        syncs = bench_count.db_syncs + bench_count.jrnl_syncs;
+        read = rt_tick_get();
+        for (i = 0; i < rows; i++)
+        {
+            sqlite3_bind_int(query, 1, (i * 7919) % rows + 1);
+            sqlite3_step(query);
+            sqlite3_reset(query);
+        }
+        read = rt_tick_get() - read;
+        sqlite3_finalize(insert);
+        sqlite3_finalize(query);
+        sqlite3_close(db);
+        rt_kprintf("%-12s %8d %10d %9d.%02d %10d\n", profiles[k], bench_ms(load),
+                   (int)((rt_uint64_t)log * 1000000 / RT_TICK_PER_SECOND / commits),
+                   syncs / commits, syncs * 100 / commits % 100,
+                   (int)((rt_uint64_t)read * 1000000 / RT_TICK_PER_SECOND / rows));
+    }
+    unlink(BENCH_DB_NAME);
+    return 0;
+}
+
+/*
+ * loading "rows" rows in random key order into a table with two secondary
+ * indexes: in one transaction with the SQLite defaults, then in a bulk
+ * load, and in a bulk load that sorts the rows in its buffer.
+ */
+static int bench_bulk(int argc, char **argv)
+{
+    static const char *const kinds[] = {"plain", "bulk", "bulk+sort"};
+    int rows = argc > 0 ? atoi(argv[0]) : 20000;
+    struct db_bulk bulk;
+    sqlite3_stmt *stmt;
+    sqlite3 *db = RT_NULL;
+    rt_tick_t ticks, plain = 0;
+    char code[16];
+    int i, k, id, rc;
+
+    if (rows <= 0)
+    {
+        rows = 20000;
+    }
+    if (rows % 7919 == 0)
+    {
+        rows++;
+    }
+    rt_kprintf("load %d rows in random key order on %s\n", rows, BENCH_DB_NAME);
+    for (k = 0; k < sizeof(kinds) / sizeof(kinds[0]); k++)
+    {
+        rc = bench_open_fresh(&db, 0);
+        if (rc == SQLITE_OK)
+        {
+            rc = bench_exec(db, "CREATE TABLE item(id INTEGER PRIMARY KEY, code TEXT, score INT);"
+                            "CREATE INDEX item_code ON item(code); CREATE INDEX item_score ON item(score);");
+        }
+        if (rc != SQLITE_OK)
+        {
+            sqlite3_close(db);
+            break;
+        }
+        memset(&bench_count, 0, sizeof(bench_count));
+        ticks = rt_tick_get();
+        if (k == 0)
+        {
+            bench_exec(db, "BEGIN;");
+            sqlite3_prepare_v2(db, "INSERT INTO item VALUES(?,?,?);", -1, &stmt, RT_NULL);
+        }
+        else
+        {
+            rc = db_bulk_begin(&bulk, db, "item", "INSERT INTO item VALUES(?,?,?);", k == 2);
+        }
+        for (i = 0; i < rows && rc == SQLITE_OK; i++)
+        {
+            id = (int)((rt_uint64_t)i * 7919 % rows) + 1;
+            rt_snprintf(code, sizeof(code), "C%08x", (unsigned int)id * 2654435761u);
+            if (k == 0)
+            {
+                sqlite3_bind_int(stmt, 1, id);
+                sqlite3_bind_text(stmt, 2, code, -1, SQLITE_STATIC);
+                sqlite3_bind_int(stmt, 3, id % 1000);
+                rc = sqlite3_step(stmt) == SQLITE_DONE ? SQLITE_OK : SQLITE_ERROR;
+                sqlite3_reset(stmt);
+            }
+            else
+            {
+                rc = db_bulk_insert(&bulk, "%d%s%d", id, code, id % 1000);
+            }
+        }
+        if (k == 0)
+        {
+            sqlite3_finalize(stmt);
+            rc = rc == SQLITE_OK ? bench_exec(db, "COMMIT;") : rc;
+        }
+        else if (bulk.db != RT_NULL)
+        {
+            rc = db_bulk_end(&bulk, rc == SQLITE_OK);
+        }
+        ticks = rt_tick_get() - ticks;
+        sqlite3_close(db);
+        if (rc != SQLITE_OK)
+        {
+            LOG_E("%s load failed,rc=%d", kinds[k], rc);
+            break;
+        }
+        if (k == 0)
+        {
+            plain = ticks ? ticks : 1;
+        }
+        rt_kprintf("%-10s %6dms  db:%8d KB %4d syncs  journal:%8d KB  speedup %d.%02d\n", kinds[k], bench_ms(ticks),
+                   (int)(bench_count.db_bytes >> 10), bench_count.db_syncs, (int)(bench_count.jrnl_bytes >> 10),
+                   plain / (ticks ? ticks : 1), plain * 100 / (ticks ? ticks : 1) % 100);
+    }
+    unlink(BENCH_DB_NAME);
+    return 0;
+}
+
+/*
+ * cost of an uncontended enter/leave pair of a FAST mutex, which takes the
+ * atomic fast path, against a RECURSIVE one, which is always an rt_mutex.
+ */
+static int bench_mutex(int argc, char **argv)
+{
+    static const struct
+    {
+        int id;
+        const char *name;
+    } kinds[] =
+    {
+        {SQLITE_MUTEX_FAST, "fast"},
+        {SQLITE_MUTEX_RECURSIVE, "recursive"},
+    };
+    int pairs = argc > 0 ? atoi(argv[0]) : 100000;
+    sqlite3_mutex *mutex;
+    rt_tick_t ticks;
+    int i, k;
+
+    if (pairs <= 0)
+    {
+        pairs = 100000;
+    }
+    rt_kprintf("%d enter/leave pairs\n", pairs);
+    for (k = 0; k < sizeof(kinds) / sizeof(kinds[0]); k++)
+    {
+        mutex = sqlite3_mutex_alloc(kinds[k].id);
+        if (mutex == RT_NULL)
+        {
+            LOG_E("alloc a %s mutex failed", kinds[k].name);
+            return -1;
+        }
+        ticks = rt_tick_get();
+        for (i = 0; i < pairs; i++)
+        {
+            sqlite3_mutex_enter(mutex);
+            sqlite3_mutex_leave(mutex);
+        }
+        ticks = rt_tick_get() - ticks;
+        sqlite3_mutex_free(mutex);
+        rt_kprintf("%-10s %6dms  %6d ns/pair\n", kinds[k].name, bench_ms(ticks),
+                   (int)((rt_uint64_t)ticks * 1000000000 / RT_TICK_PER_SECOND / pairs));
+    }
+    return 0;
+}
+
+/*
+ * cost of a primary key lookup (bind, step, column, reset) on a connection
+ * with its mutex (serialized) against one without (multi-thread, as dbhelper
+ * opens them), which is what every API call saves once a connection is
+ * owned by one thread.
+ */
+static int bench_conn(int argc, char **argv)
+{
+    static const struct
+    {
+        int flags;
+        const char *name;
+    } kinds[] =
+    {
+        {SQLITE_OPEN_FULLMUTEX, "serialized"},
+        {SQLITE_OPEN_NOMUTEX, "multi-thread"},
+    };
+    int calls = argc > 0 ? atoi(argv[0]) : 20000;
+    sqlite3_stmt *stmt;
+    sqlite3 *db;
+    rt_tick_t ticks;
+    int i, k, rc;
+
+    if (calls <= 0)
+    {
+        calls = 20000;
+    }
+    rc = bench_open_fresh(&db, 1000);
+    sqlite3_close(db);
+    if (rc != SQLITE_OK)
+    {
+        return -1;
+    }
+    rt_kprintf("%d lookups, SQLITE_THREADSAFE=%d\n", calls, sqlite3_threadsafe());
+    for (k = 0; k < sizeof(kinds) / sizeof(kinds[0]); k++)
+    {
+        rc = sqlite3_open_v2(BENCH_DB_NAME, &db, SQLITE_OPEN_READWRITE | kinds[k].flags, RT_NULL);
+        if (rc == SQLITE_OK)
+        {
+            rc = sqlite3_prepare_v2(db, "SELECT val FROM kv WHERE id=?;", -1, &stmt, RT_NULL);
+        }
+        if (rc != SQLITE_OK)
+        {
+            LOG_E("open %s failed,rc=%d", BENCH_DB_NAME, rc);
+            sqlite3_close(db);
+            break;
+        }
+        ticks = rt_tick_get();
+        for (i = 0; i < calls; i++)
+        {
+            sqlite3_bind_int(stmt, 1, i % 1000 + 1);
+            sqlite3_step(stmt);
+            sqlite3_column_int(stmt, 0);
+            sqlite3_reset(stmt);
+        }
+        ticks = rt_tick_get() - ticks;
+        sqlite3_finalize(stmt);
+        sqlite3_close(db);
+        rt_kprintf("%-12s %6dms  %6d ns/lookup\n", kinds[k].name, bench_ms(ticks),
+                   (int)((rt_uint64_t)ticks * 1000000000 / RT_TICK_PER_SECOND / calls));
+    }
+    unlink(BENCH_DB_NAME);
+    return 0;
+}
+
+/*
+ * time of a CREATE INDEX over "rows" random keys with 0 up to "threads"
+ * worker threads of the sorter (PRAGMA threads). The cache is kept small so
+ * that the sorter cuts the keys into several runs for the workers to sort.
+ */
+static int bench_sort(int argc, char **argv)
+{
+    int rows = argc > 0 ? atoi(argv[0]) : 20000;
+    int threads = argc > 1 ? atoi(argv[1]) : 4;
+    sqlite3 *db;
+    rt_tick_t ticks;
+    int i, rc;
+
+    if (rows <= 0)
+    {
+        rows = 20000;
+    }
+    rc = bench_open_fresh(&db, rows);
+    if (rc == SQLITE_OK)
+    {
+        rc = bench_exec(db, "UPDATE kv SET val=random(); PRAGMA cache_size=-256;");
+    }
+    if (rc != SQLITE_OK)
+    {
+        sqlite3_close(db);
+        return -1;
+    }
+    /* the build may allow fewer workers than asked for */
+    sqlite3_limit(db, SQLITE_LIMIT_WORKER_THREADS, threads);
+    threads = sqlite3_limit(db, SQLITE_LIMIT_WORKER_THREADS, -1);
+    rt_kprintf("CREATE INDEX over %d rows\n", rows);
+    for (i = 0; i <= threads; i++)
+    {
+        sqlite3_limit(db, SQLITE_LIMIT_WORKER_THREADS, i);
+        bench_exec(db, "DROP INDEX IF EXISTS kv_val;");
+        ticks = rt_tick_get();
+        rc = bench_exec(db, "CREATE INDEX kv_val ON kv(val, txt);");
+        ticks = rt_tick_get() - ticks;
+        if (rc != SQLITE_OK)
+        {
+            break;
+        }
+        rt_kprintf("%d threads %6dms\n", i, bench_ms(ticks));
+    }
+    sqlite3_close(db);
+    unlink(BENCH_DB_NAME);
+    return 0;
+}
+
+struct bench_reader
+{
+    sqlite3 *db;
+    int rows;
+    int lookups;
+    struct rt_semaphore *done;
+};
+
+static void bench_reader_entry(void *parameter)
+{
+    struct bench_reader *r = (struct bench_reader *)parameter;
+    sqlite3_stmt *stmt;
+    int i;
+
+    if (sqlite3_prepare_v2(r->db, "SELECT txt FROM kv WHERE id=?;", -1, &stmt, RT_NULL) == SQLITE_OK)
+    {
+        for (i = 0; i < r->lookups; i++)
+        {
+            sqlite3_bind_int(stmt, 1, (int)((rt_uint32_t)i * 7919 % r->rows) + 1);
+            sqlite3_step(stmt);
+            sqlite3_reset(stmt);
+        }
+        sqlite3_finalize(stmt);
+    }
+    rt_sem_release(r->done);
+}
+
+/*
+ * page cache memory and lookup throughput of 2, 4 and 8 connections, each
+ * read by its own thread, with a private cache each against one shared
+ * cache. The cache memory is the sum of SQLITE_DBSTATUS_CACHE_USED_SHARED,
+ * which splits a shared cache among its connections.
+ */
+static int bench_shared(int argc, char **argv)
+{
+    static const struct
+    {
+        int flags;
+        const char *name;
+    } kinds[] =
+    {
+        {SQLITE_OPEN_PRIVATECACHE, "private"},
+        {SQLITE_OPEN_SHAREDCACHE, "shared"},
+    };
+    static const int conns[] = {2, 4, 8};
+    struct bench_reader readers[8];
+    struct rt_semaphore done;
+    int rows = argc > 0 ? atoi(argv[0]) : 2000;
+    int lookups = argc > 1 ? atoi(argv[1]) : 2000;
+    rt_thread_t tid;
+    rt_tick_t ticks;
+    sqlite3 *db;
+    int cache, cur, hw, i, k, n, rc;
+
+    if (rows <= 0)
+    {
+        rows = 2000;
+    }
+    if (lookups <= 0)
+    {
+        lookups = 2000;
+    }
+    rc = bench_open_fresh(&db, rows);
+    sqlite3_close(db);
+    if (rc != SQLITE_OK)
+    {
+        return -1;
+    }
+    rt_sem_init(&done, "bench", 0, RT_IPC_FLAG_FIFO);
+    rt_kprintf("%d rows, %d lookups per connection\n", rows, lookups);
+    rt_kprintf("cache    conns  cache KB  lookups/s\n");
+    for (k = 0; k < sizeof(kinds) / sizeof(kinds[0]); k++)
+    {
+        for (n = 0; n < sizeof(conns) / sizeof(conns[0]); n++)
+        {
+            for (i = 0; i < conns[n]; i++)
+            {
+                readers[i].rows = rows;
+                readers[i].lookups = lookups;
+                readers[i].done = &done;
+                rc = sqlite3_open_v2(BENCH_DB_NAME, &readers[i].db,
+                                     SQLITE_OPEN_READWRITE | SQLITE_OPEN_NOMUTEX | kinds[k].flags, RT_NULL);
+                if (rc != SQLITE_OK)
+                {
+                    LOG_E("open %s failed,rc=%d", BENCH_DB_NAME, rc);
+                }
+            }
+            ticks = rt_tick_get();
+            for (i = 0; i < conns[n]; i++)
+            {
+                tid = rt_thread_create("bench", bench_reader_entry, &readers[i], 8192,
+                                       rt_thread_self()->current_priority, 10);
+                if (tid != RT_NULL)
+                {
+                    rt_thread_startup(tid);
+                }
+                else
+                {
+                    bench_reader_entry(&readers[i]);
+                }
+            }
+            for (i = 0; i < conns[n]; i++)
+            {
+                rt_sem_take(&done, RT_WAITING_FOREVER);
+            }
+            ticks = rt_tick_get() - ticks;
+            cache = 0;
+            for (i = 0; i < conns[n]; i++)
+            {
+                if (sqlite3_db_status(readers[i].db, SQLITE_DBSTATUS_CACHE_USED_SHARED, &cur, &hw, 0) == SQLITE_OK)
+                {
+                    cache += cur;
+                }
+                sqlite3_close(readers[i].db);
+            }
+            rt_kprintf("%-8s %5d %9d %10d\n", kinds[k].name, conns[n], cache / 1024,
+                       (int)((rt_uint64_t)conns[n] * lookups * RT_TICK_PER_SECOND / (ticks ? ticks : 1)));
+        }
+    }
+    rt_sem_detach(&done);
+    unlink(BENCH_DB_NAME);
+    return 0;
+}
+
+#ifdef PKG_SQLITE_BLOCKDEV
+/*
+ * commit latency and write volume of the database on the file system
+ * against the same database kept on a partition by the blockdev VFS.
+ */
+static int bench_blockdev(int argc, char **argv)
+{
+    static const char *kinds[] = {"rt-thread", DB_BLOCK_VFS_NAME};
+    sqlite3_vfs *root = (sqlite3_vfs *)bench_vfs.pAppData;
+    int commits = argc > 1 ? atoi(argv[1]) : 100;
+    rt_tick_t ticks;
+    int k;
+
+    if (argc < 1)
+    {
+        rt_kprintf("usage: sqlbench blockdev DEVICE [commits]\n");
+        return -1;
+    }
+    if (commits <= 0)
+    {
+        commits = 100;
+    }
+    if (db_block_register(argv[0], 0) != SQLITE_OK)
+    {
+        LOG_E("mount %s failed, format it with sqlblk first", argv[0]);
+        return -1;
+    }
+    rt_kprintf("%d single-row commits on %s\n", commits, BENCH_DB_NAME);
+
+    for (k = 0; k < sizeof(kinds) / sizeof(kinds[0]); k++)
+    {
+        /* count the calls to this VFS instead of the default one */
+        bench_vfs.pAppData = sqlite3_vfs_find(kinds[k]);
+        if (bench_commit_run(commits, &ticks) == SQLITE_OK)
+        {
+            bench_count_print(kinds[k], commits, ticks);
+        }
+        bench_vfs_delete(&bench_vfs, BENCH_DB_NAME, 0);
+    }
+
+    bench_vfs.pAppData = root;
+    return 0;
+}
+#endif
+
+#ifdef PKG_SQLITE_LOGFS
+/*
+ * bytes and syncs reaching the file system per commit with a rollback
+ * journal against the log of the logfs VFS, whose journal stays in RAM.
+ */
+static int bench_logfs(int argc, char **argv)
+{
+    sqlite3_vfs *root = (sqlite3_vfs *)bench_vfs.pAppData;
+    int commits = argc > 0 ? atoi(argv[0]) : 100;
+    struct db_log_stats st;
+    rt_tick_t ticks;
+
+    if (commits <= 0)
+    {
+        commits = 100;
+    }
+    if (db_log_register(0) != SQLITE_OK)
+    {
+        return -1;
+    }
+    rt_kprintf("%d single-row commits on %s\n", commits, BENCH_DB_NAME);
+
+    bench_vfs.pAppData = sqlite3_vfs_find("rt-thread");
+    if (bench_commit_run(commits, &ticks) == SQLITE_OK)
+    {
+        rt_kprintf("%-10s %6d B/commit %3d.%02d syncs %4dms/commit\n", "journal",
+                   (int)((bench_count.db_bytes + bench_count.jrnl_bytes) / commits),
+                   (bench_count.db_syncs + bench_count.jrnl_syncs) / commits,
+                   (bench_count.db_syncs + bench_count.jrnl_syncs) * 100 / commits % 100,
+                   bench_ms(ticks) / commits);
+    }
+    bench_vfs_delete(&bench_vfs, BENCH_DB_NAME, 0);
+
+    /* the counting VFS sees pages going into logfs, the log itself is counted there */
+    bench_vfs.pAppData = sqlite3_vfs_find(DB_LOG_VFS_NAME);
+    if (bench_commit_run(commits, &ticks) == SQLITE_OK)
+    {
+        db_log_stats(&st, 0);
+        rt_kprintf("%-10s %6d B/commit %3d.%02d syncs %4dms/commit  cleaner %d pages\n", "logfs",
+                   (int)((st.log_bytes - bench_log.log_bytes) / commits),
+                   bench_count.db_syncs / commits, bench_count.db_syncs * 100 / commits % 100,
+                   bench_ms(ticks) / commits, st.gc_pages - bench_log.gc_pages);
+    }
+    bench_vfs_delete(&bench_vfs, BENCH_DB_NAME, 0);
+
+    bench_vfs.pAppData = root;
+    return 0;
+}
+#endif
+
+static const struct bench_case
+{
+    const char *name;
+    int (*run)(int argc, char **argv);
+    const char *desc;
+} bench_cases[] =
+{
+    {"geometry", bench_geometry, "[commits] bytes written per commit, legacy vs detected geometry"},
+    {"journal", bench_journal, "[commits] commit latency, journal deleted vs reused"},
+    {"exclusive", bench_exclusive, "[rounds] transaction latency, normal vs exclusive locking"},
+    {"profile", bench_profile, "[rows] [commits] load, commit and lookup cost under each profile"},
+    {"bulk", bench_bulk, "[rows] indexed table load time, plain vs bulk load"},
+    {"mutex", bench_mutex, "[pairs] uncontended enter/leave cost, fast vs recursive mutex"},
+    {"conn", bench_conn, "[calls] lookup cost, serialized vs multi-thread connection"},
+    {"sort", bench_sort, "[rows] [threads] index build time against sorter worker threads"},
+    {"shared", bench_shared, "[rows] [lookups] cache memory and throughput, private vs shared cache"},
+#ifdef PKG_SQLITE_BLOCKDEV
+    {"blockdev", bench_blockdev, "DEVICE [commits] commit latency, file system vs block device"},
+#endif
+#ifdef PKG_SQLITE_LOGFS
+    {"logfs", bench_logfs, "[commits] bytes written per commit, rollback journal vs logfs"},
+#endif
+};
+
+static void sqlbench(int argc, char **argv)
+{
+    int i;
+
+    if (bench_vfs_register() != SQLITE_OK)
+    {
+        LOG_E("register the counting VFS failed");
+        return;
+    }
+    for (i = 0; argc >= 2 && i < sizeof(bench_cases) / sizeof(bench_cases[0]); i++)
+    {
+        if (rt_strcmp(argv[1], bench_cases[i].name) == 0)
+        {
+            bench_cases[i].run(argc - 2, argv + 2);
+            return;
+        }
+    }
+    rt_kprintf("usage: sqlbench CASE [ARGS]\n");
+    for (i = 0; i < sizeof(bench_cases) / sizeof(bench_cases[0]); i++)
+    {
+        rt_kprintf("    %-10s %s\n", bench_cases[i].name, bench_cases[i].desc);
+    }
+}
+MSH_CMD_EXPORT(sqlbench, sqlite benchmarks);
+
+#endif /* RT_USING_FINSH */
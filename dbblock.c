@@ -0,0 +1,1215 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2026-10-19     RT-Thread    first version
+ */
+
+#include <rtthread.h>
+#include <string.h>
+#include <dfs_posix.h>
+#include "sqlite3.h"
+#include "dbblock.h"
+
+#define DBG_ENABLE
+#define DBG_SECTION_NAME "app.dbblock"
+#define DBG_LEVEL DBG_INFO
+#define DBG_COLOR
+#include <rtdbg.h>
+
+/* sectors a file grows by at least, when it outgrows its extents */
+#ifndef PKG_SQLITE_BLOCKDEV_EXTENT
+#define PKG_SQLITE_BLOCKDEV_EXTENT 128
+#endif
+
+/*
+ * A VFS keeping database files and their journals directly on a partition,
+ * without a file system:
+ *
+ *     sector 0, 1     two copies of the superblock, the valid one with the
+ *                     highest generation wins
+ *     sector 2...     extents of the files
+ *
+ * The superblock holds a table of BLK_FILES files, each made of up to
+ * BLK_EXTENTS runs of sectors; a file that needs more is moved into a
+ * single run. It is only written back when a file gets a new extent, when
+ * the size of a database changes, or when a database is deleted; an ordinary commit writes the changed pages and syncs. Journals
+ * keep their extents when deleted: deleting one zeroes its first sector,
+ * which is all SQLite looks at to tell a hot journal.
+ *
+ * All device I/O is in whole sectors. Writes that do not cover a sector go
+ * through one cached sector per file, written back on sync or when another
+ * sector is needed, so appends to a journal become full sector writes.
+ */
+#define BLK_MAGIC               0x314b4c42      /* "BLK1" */
+#define BLK_FILES               6
+#define BLK_EXTENTS             5
+#define BLK_NAME_LEN            28
+#define BLK_DATA_START          2
+
+#define BLK_KIND_DB             1
+#define BLK_KIND_JOURNAL        2
+
+struct blk_extent
+{
+    rt_uint32_t start;
+    rt_uint32_t count;
+};
+
+struct blk_slot
+{
+    char name[BLK_NAME_LEN];        /* empty for a free slot */
+    rt_uint32_t kind;
+    rt_uint64_t size;               /* bytes, kept for databases only */
+    struct blk_extent ext[BLK_EXTENTS];
+};
+
+struct blk_super
+{
+    rt_uint32_t magic;
+    rt_uint32_t gen;
+    rt_uint32_t sectors;
+    rt_uint32_t sum;
+    struct blk_slot slot[BLK_FILES];
+};
+
+/* run-time state of a file, shared by all of its handles */
+struct blk_state
+{
+    int refs;
+    sqlite3_int64 size;
+    int live;                       /* journal: first sector not zero */
+    int lock;                       /* strongest lock held, SQLITE_LOCK_xxx */
+    int shared;                     /* handles holding SHARED or more */
+    rt_uint8_t *cache;              /* one sector */
+    rt_uint32_t cache_no;           /* file sector in cache plus one, 0 for none */
+    int cache_dirty;
+};
+
+struct blk_file
+{
+    sqlite3_file base;
+    int slot;
+    int lock;
+};
+
+static struct
+{
+    char device[RT_NAME_MAX > 64 ? RT_NAME_MAX : 64];
+    rt_device_t dev;
+    int fd;                         /* image file standing in for dev, or -1 */
+    rt_uint32_t sector_size;
+    rt_uint32_t sectors;
+    rt_uint8_t *sbuf;               /* one sector for the superblock */
+    struct blk_super super;
+    int super_dirty;
+    struct blk_state state[BLK_FILES];
+} blk = { "", RT_NULL, -1 };
+
+static sqlite3_vfs blk_vfs;
+static sqlite3_io_methods blk_io_methods;
+
+static sqlite3_mutex *blk_mutex(void)
+{
+    return sqlite3_mutex_alloc(SQLITE_MUTEX_STATIC_APP3);
+}
+
+static rt_uint32_t blk_sum(const void *buf, int len)
+{
+    const rt_uint8_t *p = buf;
+    rt_uint32_t h = 2166136261U;
+
+    while (len-- > 0)
+    {
+        h = (h ^ *p++) * 16777619U;
+    }
+    return h;
+}
+
+static int blk_io(int is_write, rt_uint32_t sector, void *buf, rt_uint32_t count)
+{
+    if (blk.fd >= 0)
+    {
+        int len = (int)(count * blk.sector_size);
+
+        if (lseek(blk.fd, (off_t)sector * blk.sector_size, SEEK_SET) < 0)
+        {
+            return -1;
+        }
+        return (is_write ? write(blk.fd, buf, len) : read(blk.fd, buf, len)) == len ? 0 : -1;
+    }
+    if (is_write)
+    {
+        return rt_device_write(blk.dev, sector, buf, count) == count ? 0 : -1;
+    }
+    return rt_device_read(blk.dev, sector, buf, count) == count ? 0 : -1;
+}
+
+static int blk_sync(void)
+{
+    if (blk.fd >= 0)
+    {
+        return fsync(blk.fd);
+    }
+    return rt_device_control(blk.dev, RT_DEVICE_CTRL_BLK_SYNC, RT_NULL) == RT_EOK ? 0 : -1;
+}
+
+static int blk_open_device(const char *device)
+{
+    if (device[0] == '/')
+    {
+        blk.fd = open(device, O_RDWR, 0);
+        if (blk.fd < 0)
+        {
+            LOG_E("open %s failed", device);
+            return -1;
+        }
+        blk.sector_size = 512;
+        blk.sectors = (rt_uint32_t)(lseek(blk.fd, 0, SEEK_END) / 512);
+    }
+    else
+    {
+        struct rt_device_blk_geometry geometry;
+
+        blk.dev = rt_device_find(device);
+        if (blk.dev == RT_NULL || rt_device_open(blk.dev, RT_DEVICE_OFLAG_RDWR) != RT_EOK)
+        {
+            LOG_E("open device %s failed", device);
+            blk.dev = RT_NULL;
+            return -1;
+        }
+        memset(&geometry, 0, sizeof(geometry));
+        rt_device_control(blk.dev, RT_DEVICE_CTRL_BLK_GETGEOME, &geometry);
+        blk.sector_size = geometry.bytes_per_sector;
+        blk.sectors = geometry.sector_count;
+    }
+
+    if (blk.sector_size < sizeof(struct blk_super) || (blk.sector_size & (blk.sector_size - 1))
+        || blk.sectors <= BLK_DATA_START)
+    {
+        LOG_E("%s: unsupported geometry, %d sectors of %d bytes", device, blk.sectors, blk.sector_size);
+        return -1;
+    }
+    blk.sbuf = rt_malloc(blk.sector_size);
+    return blk.sbuf ? 0 : -1;
+}
+
+static void blk_close_device(void)
+{
+    if (blk.fd >= 0)
+    {
+        close(blk.fd);
+        blk.fd = -1;
+    }
+    if (blk.dev)
+    {
+        rt_device_close(blk.dev);
+        blk.dev = RT_NULL;
+    }
+    rt_free(blk.sbuf);
+    blk.sbuf = RT_NULL;
+}
+
+static int blk_write_super(void)
+{
+    blk.super.gen++;
+    blk.super.sum = 0;
+    blk.super.sum = blk_sum(&blk.super, sizeof(blk.super));
+    memset(blk.sbuf, 0, blk.sector_size);
+    memcpy(blk.sbuf, &blk.super, sizeof(blk.super));
+    if (blk_io(1, blk.super.gen & 1, blk.sbuf, 1) < 0)
+    {
+        return SQLITE_IOERR_WRITE;
+    }
+    blk.super_dirty = 0;
+    return SQLITE_OK;
+}
+
+static int blk_read_super(void)
+{
+    struct blk_super super;
+    rt_uint32_t sum;
+    int i, found = 0;
+
+    for (i = 0; i < 2; i++)
+    {
+        if (blk_io(0, i, blk.sbuf, 1) < 0)
+        {
+            return SQLITE_IOERR_READ;
+        }
+        memcpy(&super, blk.sbuf, sizeof(super));
+        sum = super.sum;
+        super.sum = 0;
+        if (super.magic == BLK_MAGIC && sum == blk_sum(&super, sizeof(super)) && super.sectors <= blk.sectors
+            && (!found || super.gen > blk.super.gen))
+        {
+            super.sum = sum;
+            blk.super = super;
+            found = 1;
+        }
+    }
+    return found ? SQLITE_OK : SQLITE_NOTADB;
+}
+
+/*
+ * Extents: files are allocated first fit in the space not covered by the
+ * extents of any file.
+ */
+static rt_uint32_t blk_capacity(const struct blk_slot *s)
+{
+    rt_uint32_t n = 0;
+    int i;
+
+    for (i = 0; i < BLK_EXTENTS; i++)
+    {
+        n += s->ext[i].count;
+    }
+    return n;
+}
+
+/* device sector of file sector fsec, and the sectors contiguous with it */
+static rt_uint32_t blk_map(const struct blk_slot *s, rt_uint32_t fsec, rt_uint32_t *run)
+{
+    int i;
+
+    for (i = 0; i < BLK_EXTENTS; i++)
+    {
+        if (fsec < s->ext[i].count)
+        {
+            *run = s->ext[i].count - fsec;
+            return s->ext[i].start + fsec;
+        }
+        fsec -= s->ext[i].count;
+    }
+    *run = 0;
+    return 0;
+}
+
+static rt_uint32_t blk_find_free(rt_uint32_t n)
+{
+    rt_uint32_t start = BLK_DATA_START;
+    int i, j, moved = 1;
+
+    while (moved)
+    {
+        moved = 0;
+        for (i = 0; i < BLK_FILES; i++)
+        {
+            for (j = 0; j < BLK_EXTENTS; j++)
+            {
+                const struct blk_extent *e = &blk.super.slot[i].ext[j];
+                if (e->count && start < e->start + e->count && start + n > e->start)
+                {
+                    start = e->start + e->count;
+                    moved = 1;
+                }
+            }
+        }
+    }
+    return start + n <= blk.sectors ? start : 0;
+}
+
+/* free sectors from start on, at most max */
+static rt_uint32_t blk_free_run(rt_uint32_t start, rt_uint32_t max)
+{
+    rt_uint32_t n = start < blk.sectors ? blk.sectors - start : 0;
+    int i, j;
+
+    n = n < max ? n : max;
+    for (i = 0; i < BLK_FILES; i++)
+    {
+        for (j = 0; j < BLK_EXTENTS; j++)
+        {
+            const struct blk_extent *e = &blk.super.slot[i].ext[j];
+            if (e->count && e->start <= start && start < e->start + e->count)
+            {
+                return 0;
+            }
+            if (e->count && e->start > start && e->start - start < n)
+            {
+                n = e->start - start;
+            }
+        }
+    }
+    return n;
+}
+
+/* the largest free run, 0 if the device is full */
+static rt_uint32_t blk_largest_free(rt_uint32_t *run)
+{
+    rt_uint32_t best = 0, n;
+    int i, j;
+
+    *run = blk_free_run(BLK_DATA_START, blk.sectors);
+    if (*run)
+    {
+        best = BLK_DATA_START;
+    }
+    for (i = 0; i < BLK_FILES; i++)
+    {
+        for (j = 0; j < BLK_EXTENTS; j++)
+        {
+            const struct blk_extent *e = &blk.super.slot[i].ext[j];
+            n = e->count ? blk_free_run(e->start + e->count, blk.sectors) : 0;
+            if (n > *run)
+            {
+                *run = n;
+                best = e->start + e->count;
+            }
+        }
+    }
+    return best;
+}
+
+/*
+ * Move a file that has used up its extents into one run of want sectors.
+ * The new superblock is made durable before anything else can be given the
+ * sectors the file leaves, which the old one still points to.
+ */
+static int blk_relocate(int slot, rt_uint32_t want)
+{
+    struct blk_slot *s = &blk.super.slot[slot];
+    struct blk_state *st = &blk.state[slot];
+    rt_uint32_t used = (rt_uint32_t)((st->size + blk.sector_size - 1) / blk.sector_size);
+    rt_uint32_t fsec, run, start;
+
+    start = blk_find_free(want);
+    if (start == 0)
+    {
+        return SQLITE_FULL;
+    }
+
+    /* the first sector of a journal tells whether it is hot */
+    used = used == 0 && s->kind == BLK_KIND_JOURNAL ? 1 : used;
+    for (fsec = 0; fsec < used; fsec++)
+    {
+        rt_uint32_t sector = blk_map(s, fsec, &run);
+        if (run == 0 || blk_io(0, sector, blk.sbuf, 1) < 0 || blk_io(1, start + fsec, blk.sbuf, 1) < 0)
+        {
+            return SQLITE_IOERR_WRITE;
+        }
+    }
+    if (blk_sync() < 0)
+    {
+        return SQLITE_IOERR_FSYNC;
+    }
+
+    memset(s->ext, 0, sizeof(s->ext));
+    s->ext[0].start = start;
+    s->ext[0].count = want;
+    LOG_D("%s moved to sectors %u+%u", s->name, start, want);
+    if (blk_write_super() != SQLITE_OK || blk_sync() < 0)
+    {
+        return SQLITE_IOERR_WRITE;
+    }
+    return SQLITE_OK;
+}
+
+/*
+ * Make file slot hold at least nsec sectors. The file grows by at least its
+ * current size so that extents stay few: in place when the sectors after
+ * its last extent are free, else in a new extent sized to the free space
+ * there is, else, with no extent left, by moving the whole file.
+ */
+static int blk_reserve(int slot, rt_uint32_t nsec)
+{
+    struct blk_slot *s = &blk.super.slot[slot];
+    rt_uint32_t cap = blk_capacity(s);
+    rt_uint32_t need, want, start, run;
+    int last;
+
+    if (nsec <= cap)
+    {
+        return SQLITE_OK;
+    }
+
+    need = nsec - cap;
+    want = need > cap ? need : cap;
+    want = want > PKG_SQLITE_BLOCKDEV_EXTENT ? want : PKG_SQLITE_BLOCKDEV_EXTENT;
+
+    for (last = 0; last < BLK_EXTENTS && s->ext[last].count; last++)
+    {
+    }
+    if (last > 0)
+    {
+        run = blk_free_run(s->ext[last - 1].start + s->ext[last - 1].count, want);
+        if (run >= need)
+        {
+            s->ext[last - 1].count += run;
+            blk.super_dirty = 1;
+            return SQLITE_OK;
+        }
+    }
+
+    if (last == BLK_EXTENTS)
+    {
+        int rc = blk_relocate(slot, cap + want);
+        return rc == SQLITE_FULL ? blk_relocate(slot, nsec) : rc;
+    }
+
+    start = blk_find_free(want);
+    if (start == 0)
+    {
+        start = blk_largest_free(&run);
+        want = run;
+    }
+    if (start == 0 || want < need)
+    {
+        return SQLITE_FULL;
+    }
+    s->ext[last].start = start;
+    s->ext[last].count = want;
+    blk.super_dirty = 1;
+    return SQLITE_OK;
+}
+
+static int blk_flush(int slot)
+{
+    struct blk_state *st = &blk.state[slot];
+    rt_uint32_t run;
+
+    if (st->cache_dirty)
+    {
+        rt_uint32_t sector = blk_map(&blk.super.slot[slot], st->cache_no - 1, &run);
+        if (run == 0 || blk_io(1, sector, st->cache, 1) < 0)
+        {
+            return SQLITE_IOERR_WRITE;
+        }
+        st->cache_dirty = 0;
+    }
+    return SQLITE_OK;
+}
+
+/* bring file sector fsec into the cache; bytes past the end of file read as zeros */
+static int blk_load(int slot, rt_uint32_t fsec)
+{
+    struct blk_state *st = &blk.state[slot];
+    sqlite3_int64 base = (sqlite3_int64)fsec * blk.sector_size;
+    rt_uint32_t run, sector;
+    int rc;
+
+    if (st->cache_no == fsec + 1)
+    {
+        return SQLITE_OK;
+    }
+    rc = blk_flush(slot);
+    if (rc != SQLITE_OK)
+    {
+        return rc;
+    }
+    if (st->cache == RT_NULL)
+    {
+        st->cache = rt_malloc(blk.sector_size);
+        if (st->cache == RT_NULL)
+        {
+            return SQLITE_NOMEM;
+        }
+    }
+
+    st->cache_no = 0;
+    memset(st->cache, 0, blk.sector_size);
+    if (base < st->size)
+    {
+        sector = blk_map(&blk.super.slot[slot], fsec, &run);
+        if (run == 0 || blk_io(0, sector, st->cache, 1) < 0)
+        {
+            return SQLITE_IOERR_READ;
+        }
+        if (st->size - base < blk.sector_size)
+        {
+            memset(st->cache + (st->size - base), 0, blk.sector_size - (rt_uint32_t)(st->size - base));
+        }
+    }
+    st->cache_no = fsec + 1;
+    return SQLITE_OK;
+}
+
+/* drop the cached sector if it lies in [fsec, fsec + n), written around it */
+static void blk_forget(int slot, rt_uint32_t fsec, rt_uint32_t n)
+{
+    struct blk_state *st = &blk.state[slot];
+
+    if (st->cache_no > fsec && st->cache_no <= fsec + n)
+    {
+        st->cache_no = 0;
+        st->cache_dirty = 0;
+    }
+}
+
+/* zero the first sector of a journal so that it is no longer hot */
+static int blk_kill_journal(int slot)
+{
+    struct blk_state *st = &blk.state[slot];
+    int rc = SQLITE_OK;
+
+    if (blk_capacity(&blk.super.slot[slot]) > 0)
+    {
+        rc = blk_load(slot, 0);
+        if (rc == SQLITE_OK)
+        {
+            memset(st->cache, 0, blk.sector_size);
+            st->cache_dirty = 1;
+            rc = blk_flush(slot);
+        }
+    }
+    st->size = 0;
+    st->live = 0;
+    return rc;
+}
+
+static int blk_io_read(sqlite3_file *f, void *buf, int amt, sqlite3_int64 ofst)
+{
+    struct blk_file *p = (struct blk_file *)f;
+    struct blk_state *st = &blk.state[p->slot];
+    struct blk_slot *s = &blk.super.slot[p->slot];
+    rt_uint8_t *out = buf;
+    int rc = SQLITE_OK;
+
+    sqlite3_mutex_enter(blk_mutex());
+    while (rc == SQLITE_OK && amt > 0 && ofst < st->size)
+    {
+        rt_uint32_t fsec = (rt_uint32_t)(ofst / blk.sector_size);
+        int off = (int)(ofst % blk.sector_size);
+        int n = amt;
+
+        if (n > st->size - ofst)
+        {
+            n = (int)(st->size - ofst);
+        }
+        if (off == 0 && n >= (int)blk.sector_size && st->cache_no != fsec + 1)
+        {
+            rt_uint32_t run, count = n / blk.sector_size;
+            rt_uint32_t sector = blk_map(s, fsec, &run);
+
+            count = count < run ? count : run;
+            if (st->cache_no > fsec && st->cache_no <= fsec + count)
+            {
+                count = st->cache_no - 1 - fsec;
+            }
+            if (run == 0 || blk_io(0, sector, out, count) < 0)
+            {
+                rc = SQLITE_IOERR_READ;
+                break;
+            }
+            n = (int)(count * blk.sector_size);
+        }
+        else
+        {
+            rc = blk_load(p->slot, fsec);
+            n = n < (int)blk.sector_size - off ? n : (int)blk.sector_size - off;
+            memcpy(out, st->cache + off, n);
+        }
+        out += n;
+        ofst += n;
+        amt -= n;
+    }
+    sqlite3_mutex_leave(blk_mutex());
+
+    if (rc == SQLITE_OK && amt > 0)
+    {
+        memset(out, 0, amt);
+        rc = SQLITE_IOERR_SHORT_READ;
+    }
+    return rc;
+}
+
+static int blk_io_write(sqlite3_file *f, const void *buf, int amt, sqlite3_int64 ofst)
+{
+    struct blk_file *p = (struct blk_file *)f;
+    struct blk_state *st = &blk.state[p->slot];
+    struct blk_slot *s = &blk.super.slot[p->slot];
+    const rt_uint8_t *in = buf;
+    sqlite3_int64 end = ofst + amt;
+    int rc;
+
+    sqlite3_mutex_enter(blk_mutex());
+    rc = blk_reserve(p->slot, (rt_uint32_t)((end + blk.sector_size - 1) / blk.sector_size));
+    if (rc == SQLITE_OK && ofst == 0 && s->kind == BLK_KIND_JOURNAL)
+    {
+        st->live = in[0] != 0;
+    }
+    while (rc == SQLITE_OK && amt > 0)
+    {
+        rt_uint32_t fsec = (rt_uint32_t)(ofst / blk.sector_size);
+        int off = (int)(ofst % blk.sector_size);
+        int n;
+
+        if (off == 0 && amt >= (int)blk.sector_size)
+        {
+            rt_uint32_t run, count = amt / blk.sector_size;
+            rt_uint32_t sector = blk_map(s, fsec, &run);
+
+            count = count < run ? count : run;
+            blk_forget(p->slot, fsec, count);
+            if (run == 0 || blk_io(1, sector, (void *)in, count) < 0)
+            {
+                rc = SQLITE_IOERR_WRITE;
+                break;
+            }
+            n = (int)(count * blk.sector_size);
+        }
+        else
+        {
+            rc = blk_load(p->slot, fsec);
+            n = amt < (int)blk.sector_size - off ? amt : (int)blk.sector_size - off;
+            if (rc == SQLITE_OK)
+            {
+                memcpy(st->cache + off, in, n);
+                st->cache_dirty = 1;
+            }
+        }
+        in += n;
+        ofst += n;
+        amt -= n;
+    }
+
+    if (rc == SQLITE_OK && end > st->size)
+    {
+        st->size = end;
+        if (s->kind == BLK_KIND_DB)
+        {
+            s->size = end;
+            blk.super_dirty = 1;
+        }
+    }
+    sqlite3_mutex_leave(blk_mutex());
+    return rc;
+}
+
+static int blk_io_truncate(sqlite3_file *f, sqlite3_int64 size)
+{
+    struct blk_file *p = (struct blk_file *)f;
+    struct blk_state *st = &blk.state[p->slot];
+    struct blk_slot *s = &blk.super.slot[p->slot];
+    int rc = SQLITE_OK;
+
+    sqlite3_mutex_enter(blk_mutex());
+    if (size < st->size)
+    {
+        if (s->kind == BLK_KIND_JOURNAL && size == 0)
+        {
+            rc = blk_kill_journal(p->slot);
+        }
+        st->size = size;
+        if (s->kind == BLK_KIND_DB)
+        {
+            s->size = size;
+            blk.super_dirty = 1;
+        }
+    }
+    sqlite3_mutex_leave(blk_mutex());
+    return rc;
+}
+
+static int blk_io_sync(sqlite3_file *f, int flags)
+{
+    struct blk_file *p = (struct blk_file *)f;
+    int rc;
+
+    sqlite3_mutex_enter(blk_mutex());
+    rc = blk_flush(p->slot);
+    if (rc == SQLITE_OK && blk.super_dirty)
+    {
+        rc = blk_write_super();
+    }
+    if (rc == SQLITE_OK && blk_sync() < 0)
+    {
+        rc = SQLITE_IOERR_FSYNC;
+    }
+    sqlite3_mutex_leave(blk_mutex());
+    return rc;
+}
+
+static int blk_io_file_size(sqlite3_file *f, sqlite3_int64 *size)
+{
+    struct blk_file *p = (struct blk_file *)f;
+
+    sqlite3_mutex_enter(blk_mutex());
+    *size = blk.state[p->slot].size;
+    sqlite3_mutex_leave(blk_mutex());
+    return SQLITE_OK;
+}
+
+/*
+ * Locks follow the rt-thread VFS: any number of SHARED holders, RESERVED
+ * and PENDING coexist with readers, EXCLUSIVE only for the last reader.
+ */
+static int blk_io_lock(sqlite3_file *f, int lock)
+{
+    struct blk_file *p = (struct blk_file *)f;
+    struct blk_state *st = &blk.state[p->slot];
+    int rc = SQLITE_OK;
+
+    if (p->lock >= lock)
+    {
+        return SQLITE_OK;
+    }
+
+    sqlite3_mutex_enter(blk_mutex());
+    if (p->lock != st->lock && (st->lock >= SQLITE_LOCK_PENDING || lock > SQLITE_LOCK_SHARED))
+    {
+        rc = SQLITE_BUSY;
+    }
+    else if (lock == SQLITE_LOCK_SHARED)
+    {
+        st->shared++;
+        if (st->lock < SQLITE_LOCK_SHARED)
+        {
+            st->lock = SQLITE_LOCK_SHARED;
+        }
+        p->lock = SQLITE_LOCK_SHARED;
+    }
+    else if (lock == SQLITE_LOCK_EXCLUSIVE && st->shared > 1)
+    {
+        p->lock = SQLITE_LOCK_PENDING;
+        st->lock = SQLITE_LOCK_PENDING;
+        rc = SQLITE_BUSY;
+    }
+    else
+    {
+        p->lock = lock;
+        st->lock = lock;
+    }
+    sqlite3_mutex_leave(blk_mutex());
+    return rc;
+}
+
+static int blk_io_unlock(sqlite3_file *f, int lock)
+{
+    struct blk_file *p = (struct blk_file *)f;
+    struct blk_state *st = &blk.state[p->slot];
+
+    if (p->lock <= lock)
+    {
+        return SQLITE_OK;
+    }
+
+    sqlite3_mutex_enter(blk_mutex());
+    if (p->lock > SQLITE_LOCK_SHARED)
+    {
+        st->lock = SQLITE_LOCK_SHARED;
+    }
+    if (lock == SQLITE_LOCK_NONE)
+    {
+        if (--st->shared == 0)
+        {
+            st->lock = SQLITE_LOCK_NONE;
+        }
+    }
+    p->lock = lock;
+    sqlite3_mutex_leave(blk_mutex());
+    return SQLITE_OK;
+}
+
+static int blk_io_check_reserved(sqlite3_file *f, int *out)
+{
+    struct blk_file *p = (struct blk_file *)f;
+
+    sqlite3_mutex_enter(blk_mutex());
+    *out = p->lock > SQLITE_LOCK_SHARED || blk.state[p->slot].lock > SQLITE_LOCK_SHARED;
+    sqlite3_mutex_leave(blk_mutex());
+    return SQLITE_OK;
+}
+
+static int blk_io_file_control(sqlite3_file *f, int op, void *arg)
+{
+    struct blk_file *p = (struct blk_file *)f;
+    int rc;
+
+    switch (op)
+    {
+    /* extents are the preallocation */
+    case SQLITE_FCNTL_SIZE_HINT:
+        sqlite3_mutex_enter(blk_mutex());
+        rc = blk_reserve(p->slot, (rt_uint32_t)((*(sqlite3_int64 *)arg + blk.sector_size - 1) / blk.sector_size));
+        sqlite3_mutex_leave(blk_mutex());
+        return rc;
+
+    case SQLITE_FCNTL_CHUNK_SIZE:
+        return SQLITE_OK;
+
+    case SQLITE_FCNTL_VFSNAME:
+        *(char **)arg = sqlite3_mprintf("%s", DB_BLOCK_VFS_NAME);
+        return SQLITE_OK;
+
+    default:
+        return SQLITE_NOTFOUND;
+    }
+}
+
+static int blk_io_sector_size(sqlite3_file *f)
+{
+    return (int)blk.sector_size;
+}
+
+static int blk_io_device_characteristics(sqlite3_file *f)
+{
+    return SQLITE_IOCAP_POWERSAFE_OVERWRITE;
+}
+
+static int blk_io_close(sqlite3_file *f)
+{
+    struct blk_file *p = (struct blk_file *)f;
+    struct blk_state *st = &blk.state[p->slot];
+    int rc;
+
+    blk_io_unlock(f, SQLITE_LOCK_NONE);
+
+    sqlite3_mutex_enter(blk_mutex());
+    rc = blk_flush(p->slot);
+    if (--st->refs == 0)
+    {
+        rt_free(st->cache);
+        st->cache = RT_NULL;
+        st->cache_no = 0;
+        st->cache_dirty = 0;
+    }
+    sqlite3_mutex_leave(blk_mutex());
+    return rc;
+}
+
+/* the slot of a file, or -1; names are stored without leading slashes */
+static int blk_find(const char *name)
+{
+    int i;
+
+    while (*name == '/')
+    {
+        name++;
+    }
+    for (i = 0; i < BLK_FILES; i++)
+    {
+        if (blk.super.slot[i].name[0] && strncmp(blk.super.slot[i].name, name, BLK_NAME_LEN) == 0)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int blk_vfs_open(sqlite3_vfs *vfs, const char *name, sqlite3_file *f, int flags, int *out_flags)
+{
+    sqlite3_vfs *root = (sqlite3_vfs *)vfs->pAppData;
+    struct blk_file *p = (struct blk_file *)f;
+    int kind, slot;
+
+    /* temporary files, sub-journals and master journals stay on the file system */
+    if (name == RT_NULL || !(flags & (SQLITE_OPEN_MAIN_DB | SQLITE_OPEN_MAIN_JOURNAL)))
+    {
+        return root->xOpen(root, name, f, flags, out_flags);
+    }
+    kind = (flags & SQLITE_OPEN_MAIN_DB) ? BLK_KIND_DB : BLK_KIND_JOURNAL;
+
+    sqlite3_mutex_enter(blk_mutex());
+    slot = blk_find(name);
+    if (slot < 0 && (flags & SQLITE_OPEN_CREATE))
+    {
+        while (*name == '/')
+        {
+            name++;
+        }
+        for (slot = 0; slot < BLK_FILES && blk.super.slot[slot].name[0]; slot++);
+        if (slot == BLK_FILES || strlen(name) >= BLK_NAME_LEN)
+        {
+            LOG_E("no room for %s on %s", name, blk.device);
+            slot = -1;
+        }
+        else
+        {
+            memset(&blk.super.slot[slot], 0, sizeof(blk.super.slot[slot]));
+            strcpy(blk.super.slot[slot].name, name);
+            blk.super.slot[slot].kind = kind;
+            memset(&blk.state[slot], 0, sizeof(blk.state[slot]));
+            blk.super_dirty = 1;
+        }
+    }
+    if (slot >= 0)
+    {
+        blk.state[slot].refs++;
+    }
+    sqlite3_mutex_leave(blk_mutex());
+
+    if (slot < 0)
+    {
+        return SQLITE_CANTOPEN;
+    }
+
+    memset(p, 0, sizeof(*p));
+    p->slot = slot;
+    p->base.pMethods = &blk_io_methods;
+    if (out_flags)
+    {
+        *out_flags = flags;
+    }
+    return SQLITE_OK;
+}
+
+static int blk_vfs_delete(sqlite3_vfs *vfs, const char *name, int sync_dir)
+{
+    sqlite3_vfs *root = (sqlite3_vfs *)vfs->pAppData;
+    int slot, rc;
+
+    sqlite3_mutex_enter(blk_mutex());
+    slot = blk_find(name);
+    if (slot < 0)
+    {
+        sqlite3_mutex_leave(blk_mutex());
+        return root->xDelete(root, name, sync_dir);
+    }
+
+    if (blk.super.slot[slot].kind == BLK_KIND_JOURNAL)
+    {
+        /*
+         * Deleting the journal is what commits the transaction. Unlike an
+         * unlink, a zeroed first sector still sitting in the device cache
+         * would let the old journal come back as hot after a power cut and
+         * roll a committed transaction back, so it is always synced.
+         */
+        rc = blk_kill_journal(slot);
+        sync_dir = 1;
+    }
+    else
+    {
+        char journal[BLK_NAME_LEN + 8];
+
+        /* the journal of a deleted database gives its extents back too */
+        memset(&blk.super.slot[slot], 0, sizeof(blk.super.slot[slot]));
+        blk.state[slot].size = 0;
+        rt_snprintf(journal, sizeof(journal), "%s-journal", name);
+        slot = blk_find(journal);
+        if (slot >= 0 && blk.state[slot].refs == 0)
+        {
+            memset(&blk.super.slot[slot], 0, sizeof(blk.super.slot[slot]));
+            blk.state[slot].size = 0;
+            blk.state[slot].live = 0;
+            sync_dir = 1;
+        }
+        rc = blk_write_super();
+    }
+    if (rc == SQLITE_OK && sync_dir && blk_sync() < 0)
+    {
+        rc = SQLITE_IOERR_DIR_FSYNC;
+    }
+    sqlite3_mutex_leave(blk_mutex());
+    return rc;
+}
+
+static int blk_vfs_access(sqlite3_vfs *vfs, const char *name, int flags, int *out)
+{
+    sqlite3_vfs *root = (sqlite3_vfs *)vfs->pAppData;
+    int slot;
+
+    sqlite3_mutex_enter(blk_mutex());
+    slot = blk_find(name);
+    if (slot >= 0)
+    {
+        *out = blk.super.slot[slot].kind == BLK_KIND_DB || blk.state[slot].live;
+    }
+    sqlite3_mutex_leave(blk_mutex());
+
+    return slot >= 0 ? SQLITE_OK : root->xAccess(root, name, flags, out);
+}
+
+static int blk_vfs_fullpathname(sqlite3_vfs *vfs, const char *name, int n, char *out)
+{
+    sqlite3_vfs *root = (sqlite3_vfs *)vfs->pAppData;
+    return root->xFullPathname(root, name, n, out);
+}
+
+static int blk_vfs_randomness(sqlite3_vfs *vfs, int n, char *out)
+{
+    sqlite3_vfs *root = (sqlite3_vfs *)vfs->pAppData;
+    return root->xRandomness(root, n, out);
+}
+
+static int blk_vfs_sleep(sqlite3_vfs *vfs, int us)
+{
+    sqlite3_vfs *root = (sqlite3_vfs *)vfs->pAppData;
+    return root->xSleep(root, us);
+}
+
+static int blk_vfs_current_time(sqlite3_vfs *vfs, double *now)
+{
+    sqlite3_vfs *root = (sqlite3_vfs *)vfs->pAppData;
+    return root->xCurrentTime(root, now);
+}
+
+/*
+ * Rebuild the run-time state of the files after mounting. A journal whose
+ * first sector is not zero may be hot and is given its whole capacity as
+ * size, which is never less than what was written to it; SQLite stops the
+ * playback at the first record whose checksum fails.
+ */
+static int blk_mount(void)
+{
+    int i, rc;
+
+    rc = blk_read_super();
+    if (rc != SQLITE_OK)
+    {
+        return rc;
+    }
+    memset(blk.state, 0, sizeof(blk.state));
+    for (i = 0; i < BLK_FILES; i++)
+    {
+        struct blk_slot *s = &blk.super.slot[i];
+        rt_uint32_t run;
+
+        if (s->name[0] == 0)
+        {
+            continue;
+        }
+        if (s->kind == BLK_KIND_DB)
+        {
+            blk.state[i].size = (sqlite3_int64)s->size;
+        }
+        else if (blk_capacity(s) > 0)
+        {
+            if (blk_io(0, blk_map(s, 0, &run), blk.sbuf, 1) < 0)
+            {
+                return SQLITE_IOERR_READ;
+            }
+            blk.state[i].live = blk.sbuf[0] != 0;
+            blk.state[i].size = blk.state[i].live ? (sqlite3_int64)blk_capacity(s) * blk.sector_size : 0;
+        }
+    }
+    return SQLITE_OK;
+}
+
+int db_block_format(const char *device)
+{
+    int rc = SQLITE_OK;
+
+    sqlite3_mutex_enter(blk_mutex());
+    if (blk.device[0])
+    {
+        LOG_E("%s is mounted", blk.device);
+        sqlite3_mutex_leave(blk_mutex());
+        return SQLITE_MISUSE;
+    }
+    if (blk_open_device(device) < 0)
+    {
+        rc = SQLITE_CANTOPEN;
+    }
+    else
+    {
+        memset(&blk.super, 0, sizeof(blk.super));
+        blk.super.magic = BLK_MAGIC;
+        blk.super.sectors = blk.sectors;
+        rc = blk_write_super();
+        if (rc == SQLITE_OK)
+        {
+            memset(blk.sbuf, 0, blk.sector_size);
+            rc = blk_io(1, blk.super.gen & 1 ? 0 : 1, blk.sbuf, 1) < 0 ? SQLITE_IOERR_WRITE : SQLITE_OK;
+        }
+        if (rc == SQLITE_OK && blk_sync() < 0)
+        {
+            rc = SQLITE_IOERR_FSYNC;
+        }
+    }
+    blk_close_device();
+    sqlite3_mutex_leave(blk_mutex());
+    return rc;
+}
+
+int db_block_register(const char *device, int make_default)
+{
+    sqlite3_vfs *root;
+    int rc;
+
+    sqlite3_mutex_enter(blk_mutex());
+    if (blk.device[0])
+    {
+        rc = strcmp(blk.device, device) == 0 ? SQLITE_OK : SQLITE_MISUSE;
+        sqlite3_mutex_leave(blk_mutex());
+        return rc == SQLITE_OK ? sqlite3_vfs_register(&blk_vfs, make_default) : rc;
+    }
+
+    root = sqlite3_vfs_find("rt-thread");
+    if (root == RT_NULL || blk_open_device(device) < 0)
+    {
+        blk_close_device();
+        sqlite3_mutex_leave(blk_mutex());
+        return SQLITE_CANTOPEN;
+    }
+    rc = blk_mount();
+    if (rc != SQLITE_OK)
+    {
+        LOG_E("mount %s failed (%d), not formatted?", device, rc);
+        blk_close_device();
+        sqlite3_mutex_leave(blk_mutex());
+        return rc;
+    }
+    strncpy(blk.device, device, sizeof(blk.device) - 1);
+    sqlite3_mutex_leave(blk_mutex());
+
+    blk_io_methods.iVersion = 1;
+    blk_io_methods.xClose = blk_io_close;
+    blk_io_methods.xRead = blk_io_read;
+    blk_io_methods.xWrite = blk_io_write;
+    blk_io_methods.xTruncate = blk_io_truncate;
+    blk_io_methods.xSync = blk_io_sync;
+    blk_io_methods.xFileSize = blk_io_file_size;
+    blk_io_methods.xLock = blk_io_lock;
+    blk_io_methods.xUnlock = blk_io_unlock;
+    blk_io_methods.xCheckReservedLock = blk_io_check_reserved;
+    blk_io_methods.xFileControl = blk_io_file_control;
+    blk_io_methods.xSectorSize = blk_io_sector_size;
+    blk_io_methods.xDeviceCharacteristics = blk_io_device_characteristics;
+
+    blk_vfs.iVersion = 1;
+    blk_vfs.szOsFile = root->szOsFile > (int)sizeof(struct blk_file) ? root->szOsFile : (int)sizeof(struct blk_file);
+    blk_vfs.mxPathname = root->mxPathname;
+    blk_vfs.zName = DB_BLOCK_VFS_NAME;
+    blk_vfs.pAppData = root;
+    blk_vfs.xOpen = blk_vfs_open;
+    blk_vfs.xDelete = blk_vfs_delete;
+    blk_vfs.xAccess = blk_vfs_access;
+    blk_vfs.xFullPathname = blk_vfs_fullpathname;
+    blk_vfs.xRandomness = blk_vfs_randomness;
+    blk_vfs.xSleep = blk_vfs_sleep;
+    blk_vfs.xCurrentTime = blk_vfs_current_time;
+
+    return sqlite3_vfs_register(&blk_vfs, make_default);
+}
+
+#ifdef RT_USING_FINSH
+static void sqlblk(int argc, char **argv)
+{
+    int i, j;
+
+    if (argc >= 3 && rt_strcmp(argv[1], "format") == 0)
+    {
+        rt_kprintf("format %s: %s\n", argv[2], db_block_format(argv[2]) == SQLITE_OK ? "ok" : "failed");
+    }
+    else if (argc >= 2 && rt_strcmp(argv[1], "ls") == 0 && blk.device[0])
+    {
+        sqlite3_mutex_enter(blk_mutex());
+        rt_kprintf("%s: %d sectors of %d bytes, superblock generation %d\n",
+                   blk.device, blk.sectors, blk.sector_size, blk.super.gen);
+        for (i = 0; i < BLK_FILES; i++)
+        {
+            struct blk_slot *s = &blk.super.slot[i];
+            if (s->name[0] == 0)
+            {
+                continue;
+            }
+            rt_kprintf("%-28s %8d bytes, extents", s->name, (int)blk.state[i].size);
+            for (j = 0; j < BLK_EXTENTS && s->ext[j].count; j++)
+            {
+                rt_kprintf(" %d+%d", s->ext[j].start, s->ext[j].count);
+            }
+            rt_kprintf("\n");
+        }
+        sqlite3_mutex_leave(blk_mutex());
+    }
+    else
+    {
+        rt_kprintf("usage: sqlblk format DEVICE | sqlblk ls\n");
+    }
+}
+MSH_CMD_EXPORT(sqlblk, sqlite block device partition: sqlblk format DEVICE | ls);
+#endif
@@ -0,0 +1,40 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2026-10-19     RT-Thread    first version
+ */
+
+#ifndef __DBBLOCK_H__
+#define __DBBLOCK_H__
+
+#include <sqlite3.h>
+
+#define DB_BLOCK_VFS_NAME "blockdev"
+
+/**
+ * This function will write an empty superblock to a partition, dropping
+ * every database stored on it.
+ *
+ * @param device the name of a block device, or the path of an image file
+ *        starting with '/' to stand in for one.
+ * @return SQLITE_OK on success.
+ */
+int db_block_format(const char *device);
+
+/**
+ * This function will mount a partition formatted by db_block_format() and
+ * register the "blockdev" VFS, which keeps the main database files and
+ * their rollback journals directly on that partition. Other files go to
+ * the rt-thread VFS.
+ *
+ * @param device the name of a block device, or the path of an image file.
+ * @param make_default non-zero to make it the default VFS.
+ * @return SQLITE_OK on success, SQLITE_NOTADB if the partition is not formatted.
+ */
+int db_block_register(const char *device, int make_default);
+
+#endif
@@ -0,0 +1,683 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2026-10-19     RT-Thread    first version
+ */
+
+#include <rtthread.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "sqlite3.h"
+#include "dbbulk.h"
+
+#define DBG_ENABLE
+#define DBG_SECTION_NAME "app.dbbulk"
+#define DBG_LEVEL DBG_INFO
+#define DBG_COLOR
+#include <rtdbg.h>
+
+/* bytes of the buffer the rows of a bulk load are collected and sorted in */
+#ifndef PKG_SQLITE_BULK_BUFFER
+#define PKG_SQLITE_BULK_BUFFER 16384
+#endif
+
+/*
+ * A bulk load runs in one transaction with neither a rollback journal nor
+ * syncs, so a failure or a power loss in the middle leaves the database
+ * damaged. Before it starts, the database is copied next to itself to the
+ * backup point, which is restored if the load fails or, after a power loss,
+ * by db_bulk_recover(). The load is done once the rows are committed, the
+ * database is synced and the backup point is removed.
+ *
+ * Inserting rows in random key order touches B-tree pages all over the
+ * table, and every row updates each index of the table as well. The
+ * secondary indexes are therefore dropped for the load and rebuilt at the
+ * end, which sorts each of them once, and the rows can be sorted by key in
+ * the buffer before they are inserted.
+ */
+#define DBB_BACKUP_SUFFIX       "-bulk"
+#define DBB_BUF_SIZE            RT_ALIGN_DOWN(PKG_SQLITE_BULK_BUFFER, sizeof(rt_uint8_t *))
+#define DBB_SLOTS(b)            ((rt_uint8_t **)((b)->buf + DBB_BUF_SIZE) - (b)->count)
+
+static unsigned int dbb_ms(rt_tick_t ticks)
+{
+    return (unsigned int)((rt_uint64_t)ticks * 1000 / RT_TICK_PER_SECOND);
+}
+
+/*
+ * A buffered row is its size followed by its values, each a format letter
+ * and the value: an int, a double, the length and the bytes of a string or
+ * a blob, or nothing for a NULL string or blob. The fields are not
+ * aligned, they are copied with memcpy(). With out RT_NULL only the size is
+ * computed.
+ */
+static int dbb_put(rt_uint8_t *out, rt_uint32_t pos, char type, const void *data, rt_int32_t len)
+{
+    if (out)
+    {
+        out[pos] = type;
+        memcpy(out + pos + 1, data, len);
+    }
+    return 1 + len;
+}
+
+static int dbb_encode(rt_uint8_t *out, const char *fmt, va_list args)
+{
+    rt_uint32_t size = sizeof(size);
+    const char *p;
+    rt_int32_t len;
+    double d;
+    int i;
+
+    for (; fmt && *fmt; ++fmt)
+    {
+        if (*fmt != '%')
+        {
+            continue;
+        }
+        ++fmt;
+        len = 0;
+        while (isdigit(*fmt))
+        {
+            len = len * 10 + (*fmt - '0');
+            ++fmt;
+        }
+        switch (*fmt)
+        {
+        case 'd':
+            i = va_arg(args, int);
+            size += dbb_put(out, size, 'd', &i, sizeof(i));
+            break;
+        case 'f':
+            d = va_arg(args, double);
+            size += dbb_put(out, size, 'f', &d, sizeof(d));
+            break;
+        case 's':
+        case 'x':
+            p = va_arg(args, const char *);
+            if (p == RT_NULL)
+            {
+                /* bound as NULL, like sqlite3_bind_text() does */
+                size += dbb_put(out, size, 'n', &len, 0);
+                break;
+            }
+            if (*fmt == 's')
+            {
+                len = strlen(p);
+            }
+            size += dbb_put(out, size, *fmt, &len, sizeof(len));
+            if (out)
+            {
+                memcpy(out + size, p, len);
+            }
+            size += len;
+            break;
+        default:
+            return -1;
+        }
+    }
+    if (out)
+    {
+        memcpy(out, &size, sizeof(size));
+    }
+    return size;
+}
+
+static int dbb_bind(sqlite3_stmt *stmt, const rt_uint8_t *row)
+{
+    rt_uint32_t size, pos = sizeof(size);
+    int i, n = 1, rc = SQLITE_OK;
+    rt_int32_t len;
+    double d;
+
+    memcpy(&size, row, sizeof(size));
+    for (; pos < size && rc == SQLITE_OK; n++)
+    {
+        switch (row[pos++])
+        {
+        case 'd':
+            memcpy(&i, row + pos, sizeof(i));
+            pos += sizeof(i);
+            rc = sqlite3_bind_int(stmt, n, i);
+            break;
+        case 'f':
+            memcpy(&d, row + pos, sizeof(d));
+            pos += sizeof(d);
+            rc = sqlite3_bind_double(stmt, n, d);
+            break;
+        case 'n':
+            rc = sqlite3_bind_null(stmt, n);
+            break;
+        case 's':
+            memcpy(&len, row + pos, sizeof(len));
+            pos += sizeof(len);
+            rc = sqlite3_bind_text(stmt, n, (const char *)row + pos, len, SQLITE_STATIC);
+            pos += len;
+            break;
+        default:
+            memcpy(&len, row + pos, sizeof(len));
+            pos += sizeof(len);
+            rc = sqlite3_bind_blob(stmt, n, row + pos, len, SQLITE_STATIC);
+            pos += len;
+            break;
+        }
+    }
+    return rc;
+}
+
+/* order two buffered rows by their first value */
+static int dbb_compare(const void *a, const void *b)
+{
+    const rt_uint8_t *x = *(rt_uint8_t *const *)a;
+    const rt_uint8_t *y = *(rt_uint8_t *const *)b;
+    rt_uint32_t xsize, ysize;
+    rt_int32_t xlen, ylen;
+    int i, j, rc;
+
+    memcpy(&xsize, x, sizeof(xsize));
+    memcpy(&ysize, y, sizeof(ysize));
+    x += sizeof(xsize);
+    y += sizeof(ysize);
+    if (xsize <= sizeof(xsize) || ysize <= sizeof(ysize) || x[0] != y[0] || x[0] == 'f' || x[0] == 'n')
+    {
+        return 0;
+    }
+    if (x[0] == 'd')
+    {
+        memcpy(&i, x + 1, sizeof(i));
+        memcpy(&j, y + 1, sizeof(j));
+        return i < j ? -1 : i > j;
+    }
+    memcpy(&xlen, x + 1, sizeof(xlen));
+    memcpy(&ylen, y + 1, sizeof(ylen));
+    rc = memcmp(x + 1 + sizeof(xlen), y + 1 + sizeof(ylen), xlen < ylen ? xlen : ylen);
+    return rc ? rc : xlen - ylen;
+}
+
+/* insert the buffered rows, in key order when sorting */
+static int dbb_flush(struct db_bulk *bulk)
+{
+    rt_uint8_t **rows = DBB_SLOTS(bulk);
+    int i, rc = SQLITE_OK;
+
+    if (bulk->sort && bulk->count > 1)
+    {
+        qsort(rows, bulk->count, sizeof(rows[0]), dbb_compare);
+    }
+    for (i = 0; i < bulk->count && rc == SQLITE_OK; i++)
+    {
+        rc = dbb_bind(bulk->stmt, rows[i]);
+        if (rc == SQLITE_OK)
+        {
+            rc = sqlite3_step(bulk->stmt);
+            rc = rc == SQLITE_DONE ? SQLITE_OK : rc;
+        }
+        sqlite3_reset(bulk->stmt);
+        if (rc == SQLITE_OK)
+        {
+            bulk->stats.rows++;
+        }
+        else
+        {
+            LOG_E("insert failed: %s", sqlite3_errmsg(bulk->db));
+        }
+    }
+    bulk->used = 0;
+    bulk->count = 0;
+    return rc;
+}
+
+/* read the first column of a one-row statement as text */
+static int dbb_query_text(sqlite3 *db, const char *sql, char *out, int size)
+{
+    sqlite3_stmt *stmt;
+    int rc = sqlite3_prepare_v2(db, sql, -1, &stmt, RT_NULL);
+
+    if (rc == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        rt_strncpy(out, (const char *)sqlite3_column_text(stmt, 0), size - 1);
+        out[size - 1] = '\0';
+    }
+    else if (rc == SQLITE_OK)
+    {
+        rc = SQLITE_ERROR;
+    }
+    sqlite3_finalize(stmt);
+    return rc;
+}
+
+/* copy the main database of one connection over that of another */
+static int dbb_copy(sqlite3 *to, sqlite3 *from)
+{
+    sqlite3_backup *backup = sqlite3_backup_init(to, "main", from, "main");
+    int rc;
+
+    if (backup == RT_NULL)
+    {
+        return sqlite3_errcode(to);
+    }
+    rc = sqlite3_backup_step(backup, -1);
+    if (rc == SQLITE_DONE)
+    {
+        return sqlite3_backup_finish(backup);
+    }
+    sqlite3_backup_finish(backup);
+    return rc;
+}
+
+/* open a file of the database VFS as a main database, freed by dbb_file_close() */
+static sqlite3_file *dbb_file_open(sqlite3_vfs *vfs, const char *name, int flags)
+{
+    sqlite3_file *file = sqlite3_malloc(vfs->szOsFile);
+    int out;
+
+    if (file == RT_NULL)
+    {
+        return RT_NULL;
+    }
+    memset(file, 0, vfs->szOsFile);
+    if (vfs->xOpen(vfs, name, file, flags | SQLITE_OPEN_MAIN_DB, &out) != SQLITE_OK)
+    {
+        if (file->pMethods)
+        {
+            file->pMethods->xClose(file);
+        }
+        sqlite3_free(file);
+        return RT_NULL;
+    }
+    return file;
+}
+
+static void dbb_file_close(sqlite3_file *file)
+{
+    if (file)
+    {
+        file->pMethods->xClose(file);
+        sqlite3_free(file);
+    }
+}
+
+/* take the write lock of a database file the way a pager does, waiting out its readers */
+static int dbb_file_lock(sqlite3_file *file)
+{
+    static const int locks[] = {SQLITE_LOCK_SHARED, SQLITE_LOCK_RESERVED, SQLITE_LOCK_EXCLUSIVE};
+    int i, tries, rc = SQLITE_OK;
+
+    for (i = 0; i < sizeof(locks) / sizeof(locks[0]) && rc == SQLITE_OK; i++)
+    {
+        for (tries = 0; (rc = file->pMethods->xLock(file, locks[i])) == SQLITE_BUSY && tries < 100; tries++)
+        {
+            sqlite3_sleep(10);
+        }
+    }
+    return rc;
+}
+
+/*
+ * Copy the backup point over the database byte by byte through the VFS. It
+ * does not read the database through SQLite, whose first page may be torn
+ * by the power loss that interrupted the load, and is simply done again if
+ * it is interrupted itself. The pages are copied whole, the compressing VFS
+ * learns the page size from the first write.
+ */
+static int dbb_restore(sqlite3_vfs *vfs, const char *path, const char *name)
+{
+    sqlite3_file *from = dbb_file_open(vfs, name, SQLITE_OPEN_READONLY);
+    sqlite3_file *to = dbb_file_open(vfs, path, SQLITE_OPEN_READWRITE);
+    sqlite3_int64 size = 0, old = 0, ofst;
+    rt_uint8_t head[100] = {0};
+    void *page = RT_NULL;
+    int page_size = 0, rc;
+
+    rc = from && to ? dbb_file_lock(to) : SQLITE_CANTOPEN;
+    if (rc == SQLITE_OK)
+    {
+        rc = from->pMethods->xFileSize(from, &size);
+    }
+    if (rc == SQLITE_OK && size > 0)
+    {
+        rc = size >= (sqlite3_int64)sizeof(head) ? from->pMethods->xRead(from, head, sizeof(head), 0) : SQLITE_CORRUPT;
+        page_size = head[16] == 0 && head[17] == 1 ? 65536 : (head[16] << 8) | head[17];
+        if (rc == SQLITE_OK && (page_size < 512 || (page_size & (page_size - 1)) != 0 || size % page_size != 0))
+        {
+            rc = SQLITE_CORRUPT;
+        }
+    }
+    if (rc == SQLITE_OK && size > 0)
+    {
+        page = sqlite3_malloc(page_size);
+        rc = page ? SQLITE_OK : SQLITE_NOMEM;
+    }
+    for (ofst = 0; rc == SQLITE_OK && ofst < size; ofst += page_size)
+    {
+        rc = from->pMethods->xRead(from, page, page_size, ofst);
+        if (rc == SQLITE_OK)
+        {
+            rc = to->pMethods->xWrite(to, page, page_size, ofst);
+        }
+    }
+    if (rc == SQLITE_OK)
+    {
+        rc = to->pMethods->xFileSize(to, &old);
+    }
+    if (rc == SQLITE_OK && old > size && to->pMethods->xTruncate(to, size) != SQLITE_OK)
+    {
+        /* the page count in the header keeps SQLite off the pages past the end */
+        LOG_W("truncate %s failed, %d bytes past the database are left", path, (int)(old - size));
+    }
+    if (rc == SQLITE_OK)
+    {
+        /* a log-structured VFS only keeps the writes of a transaction its pager synced */
+        to->pMethods->xFileControl(to, SQLITE_FCNTL_SYNC, RT_NULL);
+        rc = to->pMethods->xSync(to, SQLITE_SYNC_NORMAL);
+    }
+    if (to)
+    {
+        to->pMethods->xUnlock(to, SQLITE_LOCK_NONE);
+    }
+    sqlite3_free(page);
+    dbb_file_close(from);
+    dbb_file_close(to);
+    return rc;
+}
+
+enum dbb_backup_op
+{
+    DBB_BACKUP_CREATE,
+    DBB_BACKUP_RESTORE,             /* restore it if there is one, then remove it */
+    DBB_BACKUP_REMOVE,
+};
+
+/* the backup point is a copy of the database through the same VFS */
+static int dbb_backup(sqlite3 *db, enum dbb_backup_op op)
+{
+    const char *path = sqlite3_db_filename(db, "main");
+    sqlite3_vfs *vfs = RT_NULL;
+    sqlite3 *copy = RT_NULL;
+    char *name;
+    int rc, exists = 0;
+
+    if (path == RT_NULL || path[0] == '\0')
+    {
+        LOG_E("a bulk load needs a database file");
+        return SQLITE_MISUSE;
+    }
+    sqlite3_file_control(db, "main", SQLITE_FCNTL_VFS_POINTER, &vfs);
+    name = sqlite3_mprintf("%s" DBB_BACKUP_SUFFIX, path);
+    if (vfs == RT_NULL || name == RT_NULL)
+    {
+        sqlite3_free(name);
+        return SQLITE_NOMEM;
+    }
+    rc = vfs->xAccess(vfs, name, SQLITE_ACCESS_EXISTS, &exists);
+    if (rc == SQLITE_OK && op == DBB_BACKUP_CREATE)
+    {
+        rc = sqlite3_open_v2(name, &copy, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, vfs->zName);
+        if (rc == SQLITE_OK)
+        {
+            rc = dbb_copy(copy, db);
+        }
+        sqlite3_close(copy);
+        if (rc != SQLITE_OK)
+        {
+            LOG_E("create the backup point %s failed,rc=%d", name, rc);
+            vfs->xDelete(vfs, name, 0);
+        }
+    }
+    else if (rc == SQLITE_OK && exists)
+    {
+        if (op == DBB_BACKUP_RESTORE)
+        {
+            rc = dbb_restore(vfs, path, name);
+            if (rc == SQLITE_OK)
+            {
+                LOG_W("%s restored from the bulk load backup point", path);
+            }
+            else
+            {
+                LOG_E("restore %s from the backup point failed,rc=%d", path, rc);
+            }
+        }
+        if (rc == SQLITE_OK)
+        {
+            rc = vfs->xDelete(vfs, name, 1);
+        }
+    }
+    sqlite3_free(name);
+    return rc;
+}
+
+/* sync the database, the load committed with synchronous=OFF */
+static int dbb_sync(sqlite3 *db)
+{
+    sqlite3_file *file = RT_NULL;
+
+    sqlite3_file_control(db, "main", SQLITE_FCNTL_FILE_POINTER, &file);
+    if (file == RT_NULL || file->pMethods == RT_NULL)
+    {
+        return SQLITE_OK;
+    }
+    return file->pMethods->xSync(file, SQLITE_SYNC_NORMAL);
+}
+
+/* leave the load transaction and give the connection its journal_mode and synchronous back */
+static int dbb_restore_settings(struct db_bulk *bulk)
+{
+    char *sql;
+    int rc;
+
+    if (!sqlite3_get_autocommit(bulk->db))
+    {
+        sqlite3_exec(bulk->db, "ROLLBACK;", 0, 0, RT_NULL);
+    }
+    sql = sqlite3_mprintf("PRAGMA journal_mode=%s; PRAGMA synchronous=%d;", bulk->journal, bulk->synchronous);
+    rc = sql ? sqlite3_exec(bulk->db, sql, 0, 0, RT_NULL) : SQLITE_NOMEM;
+    sqlite3_free(sql);
+    return rc;
+}
+
+static void dbb_release(struct db_bulk *bulk)
+{
+    sqlite3_finalize(bulk->stmt);
+    sqlite3_free(bulk->indexes);
+    rt_free(bulk->buf);
+    bulk->stmt = RT_NULL;
+    bulk->indexes = RT_NULL;
+    bulk->buf = RT_NULL;
+    bulk->db = RT_NULL;
+}
+
+int db_bulk_begin(struct db_bulk *bulk, sqlite3 *db, const char *table, const char *sql, int sort)
+{
+    char value[16];
+    char *drops = RT_NULL;
+    sqlite3_stmt *stmt;
+    rt_tick_t tick;
+    int rc;
+
+    memset(bulk, 0, sizeof(*bulk));
+    bulk->start = rt_tick_get();
+    if (!sqlite3_get_autocommit(db))
+    {
+        LOG_E("a bulk load cannot start inside a transaction");
+        return SQLITE_MISUSE;
+    }
+    rc = db_bulk_recover(db);
+    if (rc == SQLITE_OK)
+    {
+        rc = dbb_query_text(db, "PRAGMA journal_mode;", bulk->journal, sizeof(bulk->journal));
+    }
+    if (rc == SQLITE_OK)
+    {
+        rc = dbb_query_text(db, "PRAGMA synchronous;", value, sizeof(value));
+        bulk->synchronous = atoi(value);
+    }
+    if (rc != SQLITE_OK)
+    {
+        return rc;
+    }
+    tick = rt_tick_get();
+    rc = dbb_backup(db, DBB_BACKUP_CREATE);
+    bulk->stats.backup_ms = dbb_ms(rt_tick_get() - tick);
+    if (rc != SQLITE_OK)
+    {
+        return rc;
+    }
+
+    /* nothing has changed before here, from here on a failure restores the backup point */
+    bulk->db = db;
+    bulk->sort = sort;
+    rc = sqlite3_prepare_v2(db, "SELECT name,sql FROM sqlite_master WHERE type='index' AND tbl_name=?1 "
+                            "AND sql IS NOT NULL;", -1, &stmt, RT_NULL);
+    if (rc == SQLITE_OK)
+    {
+        sqlite3_bind_text(stmt, 1, table, -1, SQLITE_STATIC);
+        while (rc == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW)
+        {
+            bulk->indexes = sqlite3_mprintf("%z%s;", bulk->indexes, sqlite3_column_text(stmt, 1));
+            drops = sqlite3_mprintf("%zDROP INDEX \"%w\";", drops, sqlite3_column_text(stmt, 0));
+            rc = bulk->indexes && drops ? SQLITE_OK : SQLITE_NOMEM;
+            if (rc == SQLITE_OK)
+            {
+                bulk->stats.indexes++;
+            }
+        }
+        sqlite3_finalize(stmt);
+    }
+    if (rc == SQLITE_OK)
+    {
+        rc = sqlite3_exec(db, "PRAGMA journal_mode=OFF; PRAGMA synchronous=OFF; BEGIN;", 0, 0, RT_NULL);
+    }
+    if (rc == SQLITE_OK && drops)
+    {
+        rc = sqlite3_exec(db, drops, 0, 0, RT_NULL);
+    }
+    sqlite3_free(drops);
+    if (rc == SQLITE_OK)
+    {
+        rc = sqlite3_prepare_v2(db, sql, -1, &bulk->stmt, RT_NULL);
+    }
+    if (rc == SQLITE_OK)
+    {
+        bulk->buf = rt_malloc(DBB_BUF_SIZE);
+        rc = bulk->buf ? SQLITE_OK : SQLITE_NOMEM;
+    }
+    if (rc != SQLITE_OK)
+    {
+        LOG_E("start the bulk load of %s failed: %s", table, sqlite3_errstr(rc));
+        dbb_restore_settings(bulk);
+        dbb_backup(db, DBB_BACKUP_RESTORE);
+        dbb_release(bulk);
+        return rc;
+    }
+    bulk->load = rt_tick_get();
+    return SQLITE_OK;
+}
+
+int db_bulk_insert(struct db_bulk *bulk, const char *fmt, ...)
+{
+    va_list args;
+    int size;
+
+    if (bulk->db == RT_NULL)
+    {
+        return SQLITE_MISUSE;
+    }
+    if (bulk->rc != SQLITE_OK)
+    {
+        return bulk->rc;
+    }
+    va_start(args, fmt);
+    size = dbb_encode(RT_NULL, fmt, args);
+    va_end(args);
+    if (size < 0 || size + sizeof(rt_uint8_t *) > DBB_BUF_SIZE)
+    {
+        LOG_E("the row of format %s is invalid or larger than the buffer", fmt ? fmt : "");
+        bulk->rc = size < 0 ? SQLITE_MISUSE : SQLITE_TOOBIG;
+        return bulk->rc;
+    }
+    if (bulk->used + size + (bulk->count + 1) * sizeof(rt_uint8_t *) > DBB_BUF_SIZE)
+    {
+        bulk->rc = dbb_flush(bulk);
+    }
+    if (bulk->rc == SQLITE_OK)
+    {
+        va_start(args, fmt);
+        dbb_encode(bulk->buf + bulk->used, fmt, args);
+        va_end(args);
+        bulk->count++;
+        DBB_SLOTS(bulk)[0] = bulk->buf + bulk->used;
+        bulk->used += size;
+        if (!bulk->sort)
+        {
+            bulk->rc = dbb_flush(bulk);
+        }
+    }
+    return bulk->rc;
+}
+
+int db_bulk_end(struct db_bulk *bulk, int commit)
+{
+    rt_tick_t tick;
+    int rc, rc2;
+
+    if (bulk->db == RT_NULL)
+    {
+        return SQLITE_MISUSE;
+    }
+    rc = commit ? bulk->rc : SQLITE_ABORT;
+    if (rc == SQLITE_OK)
+    {
+        rc = dbb_flush(bulk);
+    }
+    tick = rt_tick_get();
+    bulk->stats.load_ms = dbb_ms(tick - bulk->load);
+    if (rc == SQLITE_OK && bulk->indexes)
+    {
+        rc = sqlite3_exec(bulk->db, bulk->indexes, 0, 0, RT_NULL);
+    }
+    if (rc == SQLITE_OK)
+    {
+        rc = sqlite3_exec(bulk->db, "COMMIT;", 0, 0, RT_NULL);
+    }
+    bulk->stats.index_ms = dbb_ms(rt_tick_get() - tick);
+    rc2 = dbb_restore_settings(bulk);
+    if (rc == SQLITE_OK)
+    {
+        rc = rc2;
+    }
+    if (rc == SQLITE_OK)
+    {
+        rc = dbb_sync(bulk->db);
+    }
+    if (rc == SQLITE_OK)
+    {
+        /* the load is done once the backup point is gone */
+        rc = dbb_backup(bulk->db, DBB_BACKUP_REMOVE);
+    }
+    else
+    {
+        if (commit)
+        {
+            LOG_E("bulk load failed,rc=%d, restoring the backup point", rc);
+        }
+        dbb_backup(bulk->db, DBB_BACKUP_RESTORE);
+    }
+    bulk->stats.total_ms = dbb_ms(rt_tick_get() - bulk->start);
+    LOG_I("bulk load: %u rows in %u ms, backup %u ms, load %u ms, %u indexes rebuilt in %u ms",
+          bulk->stats.rows, bulk->stats.total_ms, bulk->stats.backup_ms, bulk->stats.load_ms,
+          bulk->stats.indexes, bulk->stats.index_ms);
+    dbb_release(bulk);
+    return rc;
+}
+
+int db_bulk_recover(sqlite3 *db)
+{
+    return dbb_backup(db, DBB_BACKUP_RESTORE);
+}
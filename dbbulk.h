@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2026-10-19     RT-Thread    first version
+ */
+
+#ifndef __DBBULK_H__
+#define __DBBULK_H__
+
+#include <sqlite3.h>
+#include <rtthread.h>
+
+/* counters of a bulk load, filled by db_bulk_end() */
+struct db_bulk_stats
+{
+    unsigned int rows;              /* rows inserted */
+    unsigned int indexes;           /* secondary indexes dropped and rebuilt */
+    unsigned int backup_ms;         /* copying the database to the backup point */
+    unsigned int load_ms;           /* inserting the rows */
+    unsigned int index_ms;          /* rebuilding the indexes and committing */
+    unsigned int total_ms;          /* from db_bulk_begin() to the end of db_bulk_end() */
+};
+
+/* a bulk load in progress, the fields are private to dbbulk.c */
+struct db_bulk
+{
+    sqlite3 *db;
+    sqlite3_stmt *stmt;             /* the INSERT statement */
+    char *indexes;                  /* CREATE INDEX statements of the dropped indexes */
+    char journal[16];               /* journal_mode to restore */
+    int synchronous;                /* synchronous to restore */
+    int sort;                       /* sort the buffered rows by their first value */
+    rt_uint8_t *buf;                /* rows at the start, pointers to them at the end */
+    rt_size_t used;                 /* row bytes in buf */
+    int count;                      /* rows in buf */
+    int rc;                         /* first error */
+    rt_tick_t start;
+    rt_tick_t load;
+    struct db_bulk_stats stats;
+};
+
+/**
+ * This function will start a bulk load into a table. It copies the
+ * database to a backup point, drops the secondary indexes of the table,
+ * switches the connection to journal_mode=OFF and synchronous=OFF and opens
+ * the transaction the rows are inserted in. A backup point left by a load
+ * that was interrupted is restored first.
+ *
+ * @param bulk the bulk load.
+ * @param db the connection, e.g. from db_connection_take(1), held until
+ *        db_bulk_end().
+ * @param table the table the rows are loaded into.
+ * @param sql the INSERT statement, with one parameter for each value.
+ * @param sort non-zero to sort the rows by their first value, the primary
+ *        key, in a buffer of PKG_SQLITE_BULK_BUFFER bytes before inserting.
+ * @return SQLITE_OK on success, the connection is left untouched on failure.
+ */
+int db_bulk_begin(struct db_bulk *bulk, sqlite3 *db, const char *table, const char *sql, int sort);
+
+/**
+ * This function will add a row to a bulk load. The values are formatted
+ * like those of db_nonquery_by_varpara(): %d int, %f double, %s string and
+ * %Nx blob of N bytes, a RT_NULL string or blob is bound as NULL.
+ *
+ * @param bulk the bulk load.
+ * @param fmt the args format.
+ * @param ... the values of the row.
+ * @return SQLITE_OK on success, the first error of the load on failure.
+ */
+int db_bulk_insert(struct db_bulk *bulk, const char *fmt, ...);
+
+/**
+ * This function will finish a bulk load. On commit it inserts the buffered
+ * rows, rebuilds the dropped indexes, commits, restores the journal_mode and
+ * synchronous of the connection, syncs the database and removes the backup
+ * point. Otherwise, or if any of that fails, the database is restored from
+ * the backup point.
+ *
+ * @param bulk the bulk load.
+ * @param commit non-zero to keep the rows.
+ * @return SQLITE_OK if the rows were committed.
+ */
+int db_bulk_end(struct db_bulk *bulk, int commit);
+
+/**
+ * This function will restore a database from the backup point left by a
+ * bulk load that was interrupted, e.g. by a power loss, by copying the backup
+ * point over the database file through the VFS. dbhelper calls it when it
+ * opens the first connection to a database, others should call it at startup
+ * before the database is used.
+ *
+ * @param db a connection to the database, not in a transaction and not
+ *        holding the database in locking_mode=EXCLUSIVE.
+ * @return SQLITE_OK if there was no backup point or it was restored.
+ */
+int db_bulk_recover(sqlite3 *db);
+
+#endif
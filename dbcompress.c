@@ -0,0 +1,1238 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2026-10-19     RT-Thread    first version
+ */
+
+#include <rtthread.h>
+#include <string.h>
+#include "sqlite3.h"
+#include "rtthread_vfs.h"
+#include "dbcompress.h"
+
+#define DBG_ENABLE
+#define DBG_SECTION_NAME "app.dbcompress"
+#define DBG_LEVEL DBG_INFO
+#define DBG_COLOR
+#include <rtdbg.h>
+
+/* pages a compressed database can hold, fixed when the file is created */
+#ifndef PKG_SQLITE_COMPRESS_MAX_PAGES
+#define PKG_SQLITE_COMPRESS_MAX_PAGES 2048
+#endif
+
+/*
+ * A VFS over the rt-thread one that stores each page of a main database file
+ * compressed, in a whole number of ZVFS_BLOCK blocks:
+ *
+ *     block 0                     superblock
+ *     copy 0: header + map_blocks page map, gen even or odd
+ *     copy 1: header + map_blocks page map
+ *     data_start...               compressed pages
+ *
+ * Pages are never overwritten in place: a page write goes to free blocks and
+ * only updates the page map in RAM. xSync() commits the map by writing its
+ * changed blocks to the copy not holding the last commit, syncing, then
+ * writing that copy's header with the next generation and syncing again.
+ * Opening picks the valid header with the highest generation, so a crash at
+ * any point leaves the previous commit, and SQLite's rollback journal sees
+ * the same all-or-nothing page writes as on a plain file. Blocks of replaced
+ * pages become free once the commit that dropped them is durable.
+ */
+#define ZVFS_BLOCK              512
+#define ZVFS_BLOCK_SHIFT        9
+#define ZVFS_MAGIC              0x315a5452      /* "RTZ1" */
+#define ZVFS_MAP_MAGIC          0x4d5a5452      /* "RTZM" */
+#define ZVFS_MAX_PAGE_SIZE      32768
+#define ZVFS_HASH_BITS          12
+
+/* where one page is stored; clen 0 means stored uncompressed */
+struct zvfs_entry
+{
+    rt_uint32_t block;              /* first block, 0 if the page was never written */
+    rt_uint16_t nblocks;
+    rt_uint16_t clen;               /* compressed length */
+};
+
+#define ZVFS_PER_BLOCK          (ZVFS_BLOCK / sizeof(struct zvfs_entry))
+
+struct zvfs_super
+{
+    rt_uint32_t magic;
+    rt_uint32_t page_size;
+    rt_uint32_t max_pages;
+    rt_uint32_t map_blocks;         /* page map blocks of each copy */
+    rt_uint32_t data_start;
+    rt_uint32_t sum;
+};
+
+struct zvfs_map_header
+{
+    rt_uint32_t magic;
+    rt_uint32_t gen;
+    rt_uint32_t npages;
+    rt_uint32_t sum;
+};
+
+struct zvfs_run
+{
+    rt_uint32_t block;
+    rt_uint32_t nblocks;
+};
+
+/* state of one database file, shared by all of its handles */
+struct zvfs_shared
+{
+    struct zvfs_shared *next;
+    int refs;
+    char *path;
+    sqlite3_mutex *mutex;
+
+    rt_uint32_t page_size;          /* 0 until the file is created */
+    rt_uint32_t max_pages;
+    rt_uint32_t map_blocks;
+    rt_uint32_t data_start;
+    rt_uint32_t npages;
+    struct zvfs_entry *map;
+    rt_uint32_t *fresh;             /* per page: stored since the last commit */
+    rt_uint32_t *dirty[2];          /* per map block: changed since written to copy 0/1 */
+    int active;                     /* copy holding the last commit, -1 if none */
+    rt_uint32_t gen;
+    int changed;                    /* uncommitted page map changes */
+
+    rt_uint32_t *used;              /* per data block: allocated */
+    rt_uint32_t used_words;         /* size of used[] */
+    rt_uint32_t nblocks;            /* data blocks in use or freed, from data_start */
+    struct zvfs_run *pending;       /* blocks to free at the next commit */
+    int npending;
+    int max_pending;
+
+    rt_uint8_t *page;               /* one uncompressed page, for partial I/O */
+    rt_uint32_t page_no;            /* page held in page[] plus one, 0 for none */
+    rt_uint8_t *zbuf;               /* one compressed page */
+    rt_uint16_t *hash;              /* compressor match table */
+};
+
+struct zvfs_file
+{
+    sqlite3_file base;
+    struct zvfs_shared *sh;
+    sqlite3_file *real;
+};
+
+#define ZVFS_FILE_SIZE  RT_ALIGN(sizeof(struct zvfs_file), 8)
+
+static sqlite3_vfs zvfs_vfs;
+static sqlite3_io_methods zvfs_io_methods;
+static struct zvfs_shared *zvfs_list;
+static struct db_compress_stats zvfs_stats;
+
+static sqlite3_mutex *zvfs_mutex(void)
+{
+    return sqlite3_mutex_alloc(SQLITE_MUTEX_STATIC_APP2);
+}
+
+#define ZVFS_BIT(a, i)          ((a)[(i) >> 5] & (1UL << ((i) & 31)))
+#define ZVFS_SET(a, i)          ((a)[(i) >> 5] |= (1UL << ((i) & 31)))
+#define ZVFS_CLR(a, i)          ((a)[(i) >> 5] &= ~(1UL << ((i) & 31)))
+#define ZVFS_WORDS(n)           (((n) + 31) >> 5)
+
+static rt_uint32_t zvfs_sum(const void *buf, int len)
+{
+    const rt_uint8_t *p = buf;
+    rt_uint32_t h = 2166136261U;
+
+    while (len-- > 0)
+    {
+        h = (h ^ *p++) * 16777619U;
+    }
+    return h;
+}
+
+/*
+ * Codec in the LZ4 block format: greedy parse with a single-entry hash
+ * table, fast enough to run on every page write.
+ */
+static rt_uint32_t zvfs_read32(const rt_uint8_t *p)
+{
+    rt_uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static int zvfs_lz_length(rt_uint8_t *dst, int op, int len)
+{
+    while (len >= 255)
+    {
+        dst[op++] = 255;
+        len -= 255;
+    }
+    dst[op++] = (rt_uint8_t)len;
+    return op;
+}
+
+/* append a sequence, or the last literals when mlen is 0; -1 if over cap */
+static int zvfs_lz_sequence(rt_uint8_t *dst, int op, int cap, const rt_uint8_t *lit, int nlit, int offset, int mlen)
+{
+    int token = op;
+
+    if (op + 1 + nlit + nlit / 255 + 1 + 2 + mlen / 255 + 1 > cap)
+    {
+        return -1;
+    }
+
+    dst[op++] = (rt_uint8_t)((nlit >= 15 ? 15 : nlit) << 4);
+    if (nlit >= 15)
+    {
+        op = zvfs_lz_length(dst, op, nlit - 15);
+    }
+    memcpy(dst + op, lit, nlit);
+    op += nlit;
+
+    if (mlen > 0)
+    {
+        dst[op++] = (rt_uint8_t)offset;
+        dst[op++] = (rt_uint8_t)(offset >> 8);
+        mlen -= 4;
+        dst[token] |= (rt_uint8_t)(mlen >= 15 ? 15 : mlen);
+        if (mlen >= 15)
+        {
+            op = zvfs_lz_length(dst, op, mlen - 15);
+        }
+    }
+    return op;
+}
+
+/* compress n bytes into at most cap bytes, 0 if they do not fit */
+static int zvfs_lz_compress(const rt_uint8_t *src, int n, rt_uint8_t *dst, int cap, rt_uint16_t *hash)
+{
+    int ip = 0, anchor = 0, op = 0;
+
+    memset(hash, 0, sizeof(rt_uint16_t) << ZVFS_HASH_BITS);
+
+    /* the format wants the last match to start 12 bytes and end 5 bytes before the end */
+    while (ip < n - 12)
+    {
+        rt_uint32_t seq = zvfs_read32(src + ip);
+        rt_uint32_t h = (seq * 2654435761U) >> (32 - ZVFS_HASH_BITS);
+        int ref = (int)hash[h] - 1;
+        int mlen;
+
+        hash[h] = (rt_uint16_t)(ip + 1);
+        if (ref < 0 || ip - ref > 65535 || zvfs_read32(src + ref) != seq)
+        {
+            ip++;
+            continue;
+        }
+
+        mlen = 4;
+        while (ip + mlen < n - 5 && src[ref + mlen] == src[ip + mlen])
+        {
+            mlen++;
+        }
+        op = zvfs_lz_sequence(dst, op, cap, src + anchor, ip - anchor, ip - ref, mlen);
+        if (op < 0)
+        {
+            return 0;
+        }
+        ip += mlen;
+        anchor = ip;
+    }
+
+    op = zvfs_lz_sequence(dst, op, cap, src + anchor, n - anchor, 0, 0);
+    return op < 0 ? 0 : op;
+}
+
+static int zvfs_lz_extra(const rt_uint8_t *src, int n, int *ip, int *len)
+{
+    int b;
+
+    do
+    {
+        if (*ip >= n)
+        {
+            return -1;
+        }
+        b = src[(*ip)++];
+        *len += b;
+    } while (b == 255);
+    return 0;
+}
+
+/* decompress n bytes into at most cap bytes, returns the size or -1 if corrupt */
+static int zvfs_lz_decompress(const rt_uint8_t *src, int n, rt_uint8_t *dst, int cap)
+{
+    int ip = 0, op = 0;
+
+    while (ip < n)
+    {
+        int token = src[ip++];
+        int len = token >> 4;
+        int offset;
+
+        if (len == 15 && zvfs_lz_extra(src, n, &ip, &len) < 0)
+        {
+            return -1;
+        }
+        if (len > n - ip || len > cap - op)
+        {
+            return -1;
+        }
+        memcpy(dst + op, src + ip, len);
+        ip += len;
+        op += len;
+        if (ip >= n)
+        {
+            break;
+        }
+
+        if (ip + 2 > n)
+        {
+            return -1;
+        }
+        offset = src[ip] | (src[ip + 1] << 8);
+        ip += 2;
+        len = (token & 15) + 4;
+        if ((token & 15) == 15 && zvfs_lz_extra(src, n, &ip, &len) < 0)
+        {
+            return -1;
+        }
+        if (offset == 0 || offset > op || len > cap - op)
+        {
+            return -1;
+        }
+        while (len-- > 0)
+        {
+            dst[op] = dst[op - offset];
+            op++;
+        }
+    }
+    return op;
+}
+
+static int zvfs_read(struct zvfs_file *p, void *buf, int amt, rt_uint32_t block)
+{
+    return p->real->pMethods->xRead(p->real, buf, amt, (sqlite3_int64)block << ZVFS_BLOCK_SHIFT);
+}
+
+static int zvfs_write(struct zvfs_file *p, const void *buf, int amt, rt_uint32_t block)
+{
+    return p->real->pMethods->xWrite(p->real, buf, amt, (sqlite3_int64)block << ZVFS_BLOCK_SHIFT);
+}
+
+static rt_uint32_t zvfs_copy_block(struct zvfs_shared *sh, int copy)
+{
+    return 1 + copy * (1 + sh->map_blocks);
+}
+
+/*
+ * Data block allocation, first fit over the used[] bitmap; the data area
+ * grows at the end of the file when no run of free blocks is long enough.
+ */
+static int zvfs_grow(struct zvfs_shared *sh, rt_uint32_t nblocks)
+{
+    if (ZVFS_WORDS(nblocks) > sh->used_words)
+    {
+        rt_uint32_t more = ZVFS_WORDS(nblocks) + 64;
+        rt_uint32_t *used = sqlite3_realloc(sh->used, more * sizeof(rt_uint32_t));
+        if (used == RT_NULL)
+        {
+            return SQLITE_NOMEM;
+        }
+        memset(used + sh->used_words, 0, (more - sh->used_words) * sizeof(rt_uint32_t));
+        sh->used = used;
+        sh->used_words = more;
+    }
+    sh->nblocks = nblocks;
+    return SQLITE_OK;
+}
+
+static void zvfs_mark(struct zvfs_shared *sh, rt_uint32_t block, rt_uint32_t n, int used)
+{
+    rt_uint32_t i = block - sh->data_start;
+
+    for (; n > 0; n--, i++)
+    {
+        if (used)
+        {
+            ZVFS_SET(sh->used, i);
+        }
+        else
+        {
+            ZVFS_CLR(sh->used, i);
+        }
+    }
+}
+
+static rt_uint32_t zvfs_alloc(struct zvfs_shared *sh, rt_uint32_t n)
+{
+    rt_uint32_t i, run = 0;
+
+    for (i = 0; i < sh->nblocks; i++)
+    {
+        run = ZVFS_BIT(sh->used, i) ? 0 : run + 1;
+        if (run == n)
+        {
+            zvfs_mark(sh, sh->data_start + i + 1 - n, n, 1);
+            return sh->data_start + i + 1 - n;
+        }
+    }
+
+    /* extend a free tail rather than leaving it behind */
+    i = sh->nblocks - run;
+    if (zvfs_grow(sh, i + n) != SQLITE_OK)
+    {
+        return 0;
+    }
+    zvfs_mark(sh, sh->data_start + i, n, 1);
+    return sh->data_start + i;
+}
+
+static void zvfs_dirty(struct zvfs_shared *sh, rt_uint32_t pgno)
+{
+    rt_uint32_t i = pgno / ZVFS_PER_BLOCK;
+
+    ZVFS_SET(sh->dirty[0], i);
+    ZVFS_SET(sh->dirty[1], i);
+    sh->changed = 1;
+}
+
+/*
+ * Drop the blocks of a page: blocks stored since the last commit are not
+ * referenced by any map on flash and are free at once, the others only
+ * once the next commit no longer references them.
+ */
+static int zvfs_release(struct zvfs_shared *sh, rt_uint32_t pgno)
+{
+    struct zvfs_entry *e = &sh->map[pgno];
+
+    if (e->block == 0)
+    {
+        return SQLITE_OK;
+    }
+    if (ZVFS_BIT(sh->fresh, pgno))
+    {
+        zvfs_mark(sh, e->block, e->nblocks, 0);
+    }
+    else
+    {
+        if (sh->npending == sh->max_pending)
+        {
+            int more = sh->max_pending ? sh->max_pending * 2 : 32;
+            struct zvfs_run *pending = sqlite3_realloc(sh->pending, more * sizeof(struct zvfs_run));
+            if (pending == RT_NULL)
+            {
+                return SQLITE_NOMEM;
+            }
+            sh->pending = pending;
+            sh->max_pending = more;
+        }
+        sh->pending[sh->npending].block = e->block;
+        sh->pending[sh->npending].nblocks = e->nblocks;
+        sh->npending++;
+    }
+    memset(e, 0, sizeof(*e));
+    zvfs_dirty(sh, pgno);
+    return SQLITE_OK;
+}
+
+static void zvfs_free_state(struct zvfs_shared *sh)
+{
+    sqlite3_free(sh->map);
+    sqlite3_free(sh->fresh);
+    sqlite3_free(sh->dirty[0]);
+    sqlite3_free(sh->page);
+    sqlite3_free(sh->zbuf);
+    sqlite3_free(sh->hash);
+    sh->map = RT_NULL;
+    sh->fresh = RT_NULL;
+    sh->dirty[0] = sh->dirty[1] = RT_NULL;
+    sh->page = RT_NULL;
+    sh->zbuf = RT_NULL;
+    sh->hash = RT_NULL;
+}
+
+static void zvfs_free_shared(struct zvfs_shared *sh)
+{
+    zvfs_free_state(sh);
+    sqlite3_free(sh->used);
+    sqlite3_free(sh->pending);
+    if (sh->mutex)
+    {
+        sqlite3_mutex_free(sh->mutex);
+    }
+    sqlite3_free(sh);
+}
+
+/* size the in-memory state once page_size, max_pages and map_blocks are known */
+static int zvfs_alloc_state(struct zvfs_shared *sh)
+{
+    rt_uint32_t words = ZVFS_WORDS(sh->map_blocks);
+    rt_uint32_t entries = sh->map_blocks * ZVFS_PER_BLOCK;
+
+    sh->map = sqlite3_malloc(entries * sizeof(struct zvfs_entry));
+    sh->fresh = sqlite3_malloc(ZVFS_WORDS(sh->max_pages) * sizeof(rt_uint32_t));
+    sh->dirty[0] = sqlite3_malloc(2 * words * sizeof(rt_uint32_t));
+    sh->page = sqlite3_malloc(sh->page_size);
+    sh->zbuf = sqlite3_malloc(sh->page_size);
+    sh->hash = sqlite3_malloc(sizeof(rt_uint16_t) << ZVFS_HASH_BITS);
+    if (!sh->map || !sh->fresh || !sh->dirty[0] || !sh->page || !sh->zbuf || !sh->hash)
+    {
+        zvfs_free_state(sh);
+        return SQLITE_NOMEM;
+    }
+    sh->dirty[1] = sh->dirty[0] + words;
+    memset(sh->map, 0, entries * sizeof(struct zvfs_entry));
+    memset(sh->fresh, 0, ZVFS_WORDS(sh->max_pages) * sizeof(rt_uint32_t));
+    memset(sh->dirty[0], 0, 2 * words * sizeof(rt_uint32_t));
+    return SQLITE_OK;
+}
+
+/*
+ * Lay out a new compressed file on its first write. SQLite writes page 1
+ * first, so the size of that write is the page size.
+ */
+static int zvfs_create(struct zvfs_file *p, int amt, sqlite3_int64 ofst)
+{
+    struct zvfs_shared *sh = p->sh;
+    struct zvfs_super super;
+    int rc;
+
+    sh->page_size = 4096;
+    if (ofst == 0 && amt >= ZVFS_BLOCK && amt <= ZVFS_MAX_PAGE_SIZE && (amt & (amt - 1)) == 0)
+    {
+        sh->page_size = amt;
+    }
+    sh->max_pages = PKG_SQLITE_COMPRESS_MAX_PAGES;
+    sh->map_blocks = (sh->max_pages + ZVFS_PER_BLOCK - 1) / ZVFS_PER_BLOCK;
+    sh->data_start = 1 + 2 * (1 + sh->map_blocks);
+    sh->active = -1;
+    sh->gen = 0;
+
+    rc = zvfs_alloc_state(sh);
+    if (rc != SQLITE_OK)
+    {
+        sh->page_size = 0;
+        return rc;
+    }
+
+    memset(&super, 0, sizeof(super));
+    super.magic = ZVFS_MAGIC;
+    super.page_size = sh->page_size;
+    super.max_pages = sh->max_pages;
+    super.map_blocks = sh->map_blocks;
+    super.data_start = sh->data_start;
+    super.sum = zvfs_sum(&super, sizeof(super) - sizeof(super.sum));
+    return zvfs_write(p, &super, sizeof(super), 0);
+}
+
+/*
+ * Load the superblock and the last committed page map of an existing file.
+ * Returns SQLITE_NOTADB for a file that is not in this format.
+ */
+static int zvfs_load(struct zvfs_file *p)
+{
+    static const char plain[] = "SQLite format 3";
+    struct zvfs_shared *sh = p->sh;
+    struct zvfs_map_header hdr[2];
+    struct zvfs_super super;
+    sqlite3_int64 size;
+    rt_uint32_t i, end;
+    int rc, copy;
+
+    rc = p->real->pMethods->xFileSize(p->real, &size);
+    if (rc != SQLITE_OK || size == 0)
+    {
+        return rc;
+    }
+
+    rc = zvfs_read(p, &super, sizeof(super), 0);
+    if (rc == SQLITE_OK && memcmp(&super, plain, sizeof(plain)) == 0)
+    {
+        return SQLITE_NOTADB;
+    }
+    if (rc != SQLITE_OK || super.magic != ZVFS_MAGIC
+        || super.sum != zvfs_sum(&super, sizeof(super) - sizeof(super.sum))
+        || super.page_size < ZVFS_BLOCK || super.page_size > ZVFS_MAX_PAGE_SIZE)
+    {
+        return rc == SQLITE_IOERR_SHORT_READ || rc == SQLITE_OK ? SQLITE_CORRUPT : rc;
+    }
+
+    sh->page_size = super.page_size;
+    sh->max_pages = super.max_pages;
+    sh->map_blocks = super.map_blocks;
+    sh->data_start = super.data_start;
+    rc = zvfs_alloc_state(sh);
+    if (rc != SQLITE_OK)
+    {
+        return rc;
+    }
+
+    sh->active = -1;
+    sh->gen = 0;
+    for (copy = 0; copy < 2; copy++)
+    {
+        rc = zvfs_read(p, &hdr[copy], sizeof(hdr[copy]), zvfs_copy_block(sh, copy));
+        if (rc != SQLITE_OK && rc != SQLITE_IOERR_SHORT_READ)
+        {
+            return rc;
+        }
+        if (rc == SQLITE_OK && hdr[copy].magic == ZVFS_MAP_MAGIC && hdr[copy].npages <= sh->max_pages
+            && hdr[copy].sum == zvfs_sum(&hdr[copy], sizeof(hdr[copy]) - sizeof(hdr[copy].sum))
+            && (sh->active < 0 || hdr[copy].gen > sh->gen))
+        {
+            sh->active = copy;
+            sh->gen = hdr[copy].gen;
+        }
+    }
+
+    sh->npages = 0;
+    if (sh->active >= 0 && hdr[sh->active].npages > 0)
+    {
+        sh->npages = hdr[sh->active].npages;
+        rc = zvfs_read(p, sh->map, sh->npages * sizeof(struct zvfs_entry), zvfs_copy_block(sh, sh->active) + 1);
+        if (rc != SQLITE_OK)
+        {
+            return rc == SQLITE_IOERR_SHORT_READ ? SQLITE_CORRUPT : rc;
+        }
+    }
+
+    end = 0;
+    for (i = 0; i < sh->npages; i++)
+    {
+        if (sh->map[i].block != 0 && sh->map[i].block + sh->map[i].nblocks - sh->data_start > end)
+        {
+            end = sh->map[i].block + sh->map[i].nblocks - sh->data_start;
+        }
+    }
+    rc = zvfs_grow(sh, end);
+    for (i = 0; rc == SQLITE_OK && i < sh->npages; i++)
+    {
+        if (sh->map[i].block != 0)
+        {
+            zvfs_mark(sh, sh->map[i].block, sh->map[i].nblocks, 1);
+        }
+    }
+
+    /* the other copy is older by an unknown number of commits */
+    for (i = 0; i * ZVFS_PER_BLOCK < sh->npages; i++)
+    {
+        ZVFS_SET(sh->dirty[sh->active == 0 ? 1 : 0], i);
+    }
+    return rc;
+}
+
+/*
+ * Make the page map durable, see the top of the file. With sync_flags 0 the
+ * map is written without syncing, as SQLite does with synchronous=OFF.
+ */
+static int zvfs_commit(struct zvfs_file *p, int sync_flags)
+{
+    struct zvfs_shared *sh = p->sh;
+    struct zvfs_map_header hdr;
+    int copy = sh->active == 0 ? 1 : 0;
+    rt_uint32_t base = zvfs_copy_block(sh, copy) + 1;
+    rt_uint32_t i, bytes = 0;
+    int rc = SQLITE_OK;
+
+    for (i = 0; rc == SQLITE_OK && i * ZVFS_PER_BLOCK < sh->npages; i++)
+    {
+        if (ZVFS_BIT(sh->dirty[copy], i))
+        {
+            rc = zvfs_write(p, &sh->map[i * ZVFS_PER_BLOCK], ZVFS_BLOCK, base + i);
+            bytes += ZVFS_BLOCK;
+        }
+    }
+    if (rc == SQLITE_OK && sync_flags)
+    {
+        rc = p->real->pMethods->xSync(p->real, sync_flags);
+    }
+    if (rc != SQLITE_OK)
+    {
+        return rc;
+    }
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = ZVFS_MAP_MAGIC;
+    hdr.gen = sh->gen + 1;
+    hdr.npages = sh->npages;
+    hdr.sum = zvfs_sum(&hdr, sizeof(hdr) - sizeof(hdr.sum));
+    rc = zvfs_write(p, &hdr, sizeof(hdr), base - 1);
+    if (rc == SQLITE_OK && sync_flags)
+    {
+        rc = p->real->pMethods->xSync(p->real, sync_flags);
+    }
+    if (rc != SQLITE_OK)
+    {
+        return rc;
+    }
+
+    sh->active = copy;
+    sh->gen++;
+    sh->changed = 0;
+    memset(sh->dirty[copy], 0, ZVFS_WORDS(sh->map_blocks) * sizeof(rt_uint32_t));
+    memset(sh->fresh, 0, ZVFS_WORDS(sh->max_pages) * sizeof(rt_uint32_t));
+    for (i = 0; i < (rt_uint32_t)sh->npending; i++)
+    {
+        zvfs_mark(sh, sh->pending[i].block, sh->pending[i].nblocks, 0);
+    }
+    sh->npending = 0;
+
+    sqlite3_mutex_enter(zvfs_mutex());
+    zvfs_stats.commits++;
+    zvfs_stats.map_bytes += bytes + sizeof(hdr);
+    sqlite3_mutex_leave(zvfs_mutex());
+    return SQLITE_OK;
+}
+
+/* load page pgno into buf, zeros for a page never written */
+static int zvfs_get_page(struct zvfs_file *p, rt_uint32_t pgno, rt_uint8_t *buf)
+{
+    struct zvfs_shared *sh = p->sh;
+    struct zvfs_entry *e = &sh->map[pgno];
+    rt_uint32_t t;
+    int rc, n;
+
+    if (sh->page_no == pgno + 1)
+    {
+        if (buf != sh->page)
+        {
+            memcpy(buf, sh->page, sh->page_size);
+        }
+        return SQLITE_OK;
+    }
+    if (pgno >= sh->npages || e->block == 0)
+    {
+        memset(buf, 0, sh->page_size);
+        return SQLITE_OK;
+    }
+
+    rc = zvfs_read(p, e->clen ? sh->zbuf : buf, e->clen ? e->clen : (int)sh->page_size, e->block);
+    if (rc != SQLITE_OK)
+    {
+        return rc == SQLITE_IOERR_SHORT_READ ? SQLITE_CORRUPT : rc;
+    }
+    t = PKG_SQLITE_IO_CLOCK();
+    n = e->clen ? zvfs_lz_decompress(sh->zbuf, e->clen, buf, sh->page_size) : (int)sh->page_size;
+    t = PKG_SQLITE_IO_CLOCK() - t;
+
+    sqlite3_mutex_enter(zvfs_mutex());
+    zvfs_stats.pages_read++;
+    zvfs_stats.decompress_time += t;
+    sqlite3_mutex_leave(zvfs_mutex());
+    return n == (int)sh->page_size ? SQLITE_OK : SQLITE_CORRUPT;
+}
+
+/* compress page pgno into free blocks */
+static int zvfs_put_page(struct zvfs_file *p, rt_uint32_t pgno, const rt_uint8_t *data)
+{
+    struct zvfs_shared *sh = p->sh;
+    struct zvfs_entry *e = &sh->map[pgno];
+    const rt_uint8_t *src = sh->zbuf;
+    rt_uint32_t t, block, nblocks;
+    int clen, len, rc;
+
+    /* only worth it when at least one block is saved */
+    t = PKG_SQLITE_IO_CLOCK();
+    clen = zvfs_lz_compress(data, sh->page_size, sh->zbuf, sh->page_size - ZVFS_BLOCK, sh->hash);
+    t = PKG_SQLITE_IO_CLOCK() - t;
+    len = clen;
+    if (clen == 0)
+    {
+        src = data;
+        len = sh->page_size;
+    }
+    nblocks = (len + ZVFS_BLOCK - 1) >> ZVFS_BLOCK_SHIFT;
+
+    rc = zvfs_release(sh, pgno);
+    if (rc != SQLITE_OK)
+    {
+        return rc;
+    }
+    block = zvfs_alloc(sh, nblocks);
+    if (block == 0)
+    {
+        return SQLITE_NOMEM;
+    }
+    rc = zvfs_write(p, src, len, block);
+    if (rc != SQLITE_OK)
+    {
+        zvfs_mark(sh, block, nblocks, 0);
+        return rc;
+    }
+
+    e->block = block;
+    e->nblocks = (rt_uint16_t)nblocks;
+    e->clen = (rt_uint16_t)clen;
+    ZVFS_SET(sh->fresh, pgno);
+    zvfs_dirty(sh, pgno);
+    for (; sh->npages <= pgno; sh->npages++)
+    {
+        zvfs_dirty(sh, sh->npages);
+    }
+    if (sh->page_no == pgno + 1 && data != sh->page)
+    {
+        sh->page_no = 0;
+    }
+
+    sqlite3_mutex_enter(zvfs_mutex());
+    zvfs_stats.pages_written++;
+    zvfs_stats.pages_raw += (clen == 0);
+    zvfs_stats.page_bytes += sh->page_size;
+    zvfs_stats.stored_bytes += len;
+    zvfs_stats.compress_time += t;
+    sqlite3_mutex_leave(zvfs_mutex());
+    return SQLITE_OK;
+}
+
+static int zvfs_io_read(sqlite3_file *f, void *buf, int amt, sqlite3_int64 ofst)
+{
+    struct zvfs_file *p = (struct zvfs_file *)f;
+    struct zvfs_shared *sh = p->sh;
+    rt_uint8_t *out = buf;
+    int rc = SQLITE_OK;
+
+    sqlite3_mutex_enter(sh->mutex);
+    while (rc == SQLITE_OK && amt > 0 && sh->page_size && ofst < (sqlite3_int64)sh->npages * sh->page_size)
+    {
+        rt_uint32_t pgno = (rt_uint32_t)(ofst / sh->page_size);
+        int off = (int)(ofst % sh->page_size);
+        int n = (int)sh->page_size - off < amt ? (int)sh->page_size - off : amt;
+
+        if (n == (int)sh->page_size)
+        {
+            rc = zvfs_get_page(p, pgno, out);
+        }
+        else
+        {
+            rc = zvfs_get_page(p, pgno, sh->page);
+            sh->page_no = rc == SQLITE_OK ? pgno + 1 : 0;
+            memcpy(out, sh->page + off, n);
+        }
+        out += n;
+        ofst += n;
+        amt -= n;
+    }
+    sqlite3_mutex_leave(sh->mutex);
+
+    if (rc == SQLITE_OK && amt > 0)
+    {
+        memset(out, 0, amt);
+        rc = SQLITE_IOERR_SHORT_READ;
+    }
+    return rc;
+}
+
+static int zvfs_io_write(sqlite3_file *f, const void *buf, int amt, sqlite3_int64 ofst)
+{
+    struct zvfs_file *p = (struct zvfs_file *)f;
+    struct zvfs_shared *sh = p->sh;
+    const rt_uint8_t *in = buf;
+    int rc = SQLITE_OK;
+
+    sqlite3_mutex_enter(sh->mutex);
+    if (sh->page_size == 0)
+    {
+        rc = zvfs_create(p, amt, ofst);
+    }
+    while (rc == SQLITE_OK && amt > 0)
+    {
+        rt_uint32_t pgno = (rt_uint32_t)(ofst / sh->page_size);
+        int off = (int)(ofst % sh->page_size);
+        int n = (int)sh->page_size - off < amt ? (int)sh->page_size - off : amt;
+
+        if (ofst / sh->page_size >= sh->max_pages)
+        {
+            rc = SQLITE_FULL;
+            break;
+        }
+        if (n == (int)sh->page_size)
+        {
+            rc = zvfs_put_page(p, pgno, in);
+        }
+        else
+        {
+            rc = zvfs_get_page(p, pgno, sh->page);
+            if (rc == SQLITE_OK)
+            {
+                memcpy(sh->page + off, in, n);
+                sh->page_no = pgno + 1;
+                rc = zvfs_put_page(p, pgno, sh->page);
+            }
+            if (rc != SQLITE_OK)
+            {
+                sh->page_no = 0;
+            }
+        }
+        in += n;
+        ofst += n;
+        amt -= n;
+    }
+    sqlite3_mutex_leave(sh->mutex);
+    return rc;
+}
+
+static int zvfs_io_truncate(sqlite3_file *f, sqlite3_int64 size)
+{
+    struct zvfs_file *p = (struct zvfs_file *)f;
+    struct zvfs_shared *sh = p->sh;
+    rt_uint32_t npages;
+    int rc = SQLITE_OK;
+
+    sqlite3_mutex_enter(sh->mutex);
+    if (sh->page_size)
+    {
+        npages = (rt_uint32_t)((size + sh->page_size - 1) / sh->page_size);
+        while (rc == SQLITE_OK && sh->npages > npages)
+        {
+            rc = zvfs_release(sh, sh->npages - 1);
+            if (rc == SQLITE_OK)
+            {
+                sh->npages--;
+            }
+        }
+        if (sh->page_no > sh->npages)
+        {
+            sh->page_no = 0;
+        }
+    }
+    sqlite3_mutex_leave(sh->mutex);
+    return rc;
+}
+
+static int zvfs_io_sync(sqlite3_file *f, int flags)
+{
+    struct zvfs_file *p = (struct zvfs_file *)f;
+    int rc = SQLITE_OK;
+
+    sqlite3_mutex_enter(p->sh->mutex);
+    if (p->sh->changed)
+    {
+        rc = zvfs_commit(p, flags);
+    }
+    sqlite3_mutex_leave(p->sh->mutex);
+    return rc;
+}
+
+static int zvfs_io_file_size(sqlite3_file *f, sqlite3_int64 *size)
+{
+    struct zvfs_file *p = (struct zvfs_file *)f;
+
+    sqlite3_mutex_enter(p->sh->mutex);
+    *size = (sqlite3_int64)p->sh->npages * p->sh->page_size;
+    sqlite3_mutex_leave(p->sh->mutex);
+    return SQLITE_OK;
+}
+
+static int zvfs_io_lock(sqlite3_file *f, int lock)
+{
+    struct zvfs_file *p = (struct zvfs_file *)f;
+    return p->real->pMethods->xLock(p->real, lock);
+}
+
+/*
+ * With synchronous=OFF SQLite never calls xSync(), so the map of a finished
+ * transaction is written, unsynced, when its lock is dropped.
+ */
+static int zvfs_io_unlock(sqlite3_file *f, int lock)
+{
+    struct zvfs_file *p = (struct zvfs_file *)f;
+    int rc = SQLITE_OK, rc2;
+
+    if (lock <= SQLITE_LOCK_SHARED)
+    {
+        sqlite3_mutex_enter(p->sh->mutex);
+        if (p->sh->changed)
+        {
+            rc = zvfs_commit(p, 0);
+        }
+        sqlite3_mutex_leave(p->sh->mutex);
+    }
+    rc2 = p->real->pMethods->xUnlock(p->real, lock);
+    return rc != SQLITE_OK ? rc : rc2;
+}
+
+static int zvfs_io_check_reserved(sqlite3_file *f, int *out)
+{
+    struct zvfs_file *p = (struct zvfs_file *)f;
+    return p->real->pMethods->xCheckReservedLock(p->real, out);
+}
+
+static int zvfs_io_file_control(sqlite3_file *f, int op, void *arg)
+{
+    struct zvfs_file *p = (struct zvfs_file *)f;
+
+    switch (op)
+    {
+    /* physical sizes have no relation to the logical ones */
+    case SQLITE_FCNTL_SIZE_HINT:
+    case SQLITE_FCNTL_CHUNK_SIZE:
+    case SQLITE_FCNTL_RTTHREAD_PREALLOCATE:
+        return SQLITE_OK;
+
+    case SQLITE_FCNTL_VFSNAME:
+        *(char **)arg = sqlite3_mprintf("%s", DB_COMPRESS_VFS_NAME);
+        return SQLITE_OK;
+
+    default:
+        return p->real->pMethods->xFileControl(p->real, op, arg);
+    }
+}
+
+static int zvfs_io_sector_size(sqlite3_file *f)
+{
+    struct zvfs_file *p = (struct zvfs_file *)f;
+    return p->real->pMethods->xSectorSize(p->real);
+}
+
+static int zvfs_io_device_characteristics(sqlite3_file *f)
+{
+    struct zvfs_file *p = (struct zvfs_file *)f;
+    return p->real->pMethods->xDeviceCharacteristics(p->real);
+}
+
+static void zvfs_unref(struct zvfs_shared *sh)
+{
+    struct zvfs_shared **pp;
+
+    sqlite3_mutex_enter(zvfs_mutex());
+    if (--sh->refs == 0)
+    {
+        for (pp = &zvfs_list; *pp; pp = &(*pp)->next)
+        {
+            if (*pp == sh)
+            {
+                *pp = sh->next;
+                break;
+            }
+        }
+        zvfs_free_shared(sh);
+    }
+    sqlite3_mutex_leave(zvfs_mutex());
+}
+
+static int zvfs_io_close(sqlite3_file *f)
+{
+    struct zvfs_file *p = (struct zvfs_file *)f;
+    int rc = SQLITE_OK, rc2;
+
+    sqlite3_mutex_enter(p->sh->mutex);
+    if (p->sh->changed)
+    {
+        rc = zvfs_commit(p, 0);
+    }
+    sqlite3_mutex_leave(p->sh->mutex);
+
+    rc2 = p->real->pMethods->xClose(p->real);
+    zvfs_unref(p->sh);
+    return rc != SQLITE_OK ? rc : rc2;
+}
+
+/*
+ * Find or make the shared state of a database file; the first handle loads
+ * it. Returns SQLITE_NOTADB when the file is a plain database.
+ */
+static int zvfs_attach(struct zvfs_file *p, const char *name)
+{
+    struct zvfs_shared *sh;
+    int rc = SQLITE_OK;
+
+    sqlite3_mutex_enter(zvfs_mutex());
+    for (sh = zvfs_list; sh; sh = sh->next)
+    {
+        if (strcmp(sh->path, name) == 0)
+        {
+            sh->refs++;
+            p->sh = sh;
+            sqlite3_mutex_leave(zvfs_mutex());
+            return SQLITE_OK;
+        }
+    }
+
+    sh = sqlite3_malloc(sizeof(*sh) + strlen(name) + 1);
+    if (sh == RT_NULL)
+    {
+        sqlite3_mutex_leave(zvfs_mutex());
+        return SQLITE_NOMEM;
+    }
+    memset(sh, 0, sizeof(*sh));
+    sh->path = (char *)(sh + 1);
+    strcpy(sh->path, name);
+    sh->refs = 1;
+    sh->active = -1;
+    sh->mutex = sqlite3_mutex_alloc(SQLITE_MUTEX_FAST);
+    p->sh = sh;
+
+    rc = sh->mutex ? zvfs_load(p) : SQLITE_NOMEM;
+    if (rc == SQLITE_OK)
+    {
+        sh->next = zvfs_list;
+        zvfs_list = sh;
+    }
+    else
+    {
+        zvfs_free_shared(sh);
+        p->sh = RT_NULL;
+    }
+    sqlite3_mutex_leave(zvfs_mutex());
+    return rc;
+}
+
+static int zvfs_vfs_open(sqlite3_vfs *vfs, const char *name, sqlite3_file *f, int flags, int *out_flags)
+{
+    sqlite3_vfs *root = (sqlite3_vfs *)vfs->pAppData;
+    struct zvfs_file *p = (struct zvfs_file *)f;
+    int rc;
+
+    /* journals and temporary files are opened straight on the rt-thread VFS */
+    if (!(flags & SQLITE_OPEN_MAIN_DB) || name == RT_NULL)
+    {
+        return root->xOpen(root, name, f, flags, out_flags);
+    }
+
+    memset(p, 0, sizeof(struct zvfs_file));
+    p->real = (sqlite3_file *)((char *)p + ZVFS_FILE_SIZE);
+    memset(p->real, 0, root->szOsFile);
+    rc = root->xOpen(root, name, p->real, flags, out_flags);
+    if (rc != SQLITE_OK || p->real->pMethods == RT_NULL)
+    {
+        return rc;
+    }
+
+    rc = zvfs_attach(p, name);
+    if (rc == SQLITE_NOTADB)
+    {
+        /* a database created without compression stays as it is */
+        p->real->pMethods->xClose(p->real);
+        memset(f, 0, vfs->szOsFile);
+        return root->xOpen(root, name, f, flags, out_flags);
+    }
+    if (rc != SQLITE_OK)
+    {
+        p->real->pMethods->xClose(p->real);
+        return rc;
+    }
+    p->base.pMethods = &zvfs_io_methods;
+    return SQLITE_OK;
+}
+
+static int zvfs_vfs_delete(sqlite3_vfs *vfs, const char *name, int sync_dir)
+{
+    sqlite3_vfs *root = (sqlite3_vfs *)vfs->pAppData;
+    return root->xDelete(root, name, sync_dir);
+}
+
+static int zvfs_vfs_access(sqlite3_vfs *vfs, const char *name, int flags, int *out)
+{
+    sqlite3_vfs *root = (sqlite3_vfs *)vfs->pAppData;
+    return root->xAccess(root, name, flags, out);
+}
+
+static int zvfs_vfs_fullpathname(sqlite3_vfs *vfs, const char *name, int n, char *out)
+{
+    sqlite3_vfs *root = (sqlite3_vfs *)vfs->pAppData;
+    return root->xFullPathname(root, name, n, out);
+}
+
+static int zvfs_vfs_randomness(sqlite3_vfs *vfs, int n, char *out)
+{
+    sqlite3_vfs *root = (sqlite3_vfs *)vfs->pAppData;
+    return root->xRandomness(root, n, out);
+}
+
+static int zvfs_vfs_sleep(sqlite3_vfs *vfs, int us)
+{
+    sqlite3_vfs *root = (sqlite3_vfs *)vfs->pAppData;
+    return root->xSleep(root, us);
+}
+
+static int zvfs_vfs_current_time(sqlite3_vfs *vfs, double *now)
+{
+    sqlite3_vfs *root = (sqlite3_vfs *)vfs->pAppData;
+    return root->xCurrentTime(root, now);
+}
+
+int db_compress_register(int make_default)
+{
+    sqlite3_vfs *root;
+
+    if (zvfs_vfs.zName)
+    {
+        return sqlite3_vfs_register(&zvfs_vfs, make_default);
+    }
+
+    root = sqlite3_vfs_find("rt-thread");
+    if (root == RT_NULL)
+    {
+        LOG_E("the rt-thread VFS is not registered");
+        return SQLITE_ERROR;
+    }
+
+    zvfs_io_methods.iVersion = 1;
+    zvfs_io_methods.xClose = zvfs_io_close;
+    zvfs_io_methods.xRead = zvfs_io_read;
+    zvfs_io_methods.xWrite = zvfs_io_write;
+    zvfs_io_methods.xTruncate = zvfs_io_truncate;
+    zvfs_io_methods.xSync = zvfs_io_sync;
+    zvfs_io_methods.xFileSize = zvfs_io_file_size;
+    zvfs_io_methods.xLock = zvfs_io_lock;
+    zvfs_io_methods.xUnlock = zvfs_io_unlock;
+    zvfs_io_methods.xCheckReservedLock = zvfs_io_check_reserved;
+    zvfs_io_methods.xFileControl = zvfs_io_file_control;
+    zvfs_io_methods.xSectorSize = zvfs_io_sector_size;
+    zvfs_io_methods.xDeviceCharacteristics = zvfs_io_device_characteristics;
+
+    zvfs_vfs.iVersion = 1;
+    zvfs_vfs.szOsFile = ZVFS_FILE_SIZE + root->szOsFile;
+    zvfs_vfs.mxPathname = root->mxPathname;
+    zvfs_vfs.zName = DB_COMPRESS_VFS_NAME;
+    zvfs_vfs.pAppData = root;
+    zvfs_vfs.xOpen = zvfs_vfs_open;
+    zvfs_vfs.xDelete = zvfs_vfs_delete;
+    zvfs_vfs.xAccess = zvfs_vfs_access;
+    zvfs_vfs.xFullPathname = zvfs_vfs_fullpathname;
+    zvfs_vfs.xRandomness = zvfs_vfs_randomness;
+    zvfs_vfs.xSleep = zvfs_vfs_sleep;
+    zvfs_vfs.xCurrentTime = zvfs_vfs_current_time;
+
+    return sqlite3_vfs_register(&zvfs_vfs, make_default);
+}
+
+void db_compress_stats(struct db_compress_stats *stats, int reset)
+{
+    sqlite3_mutex_enter(zvfs_mutex());
+    *stats = zvfs_stats;
+    if (reset)
+    {
+        memset(&zvfs_stats, 0, sizeof(zvfs_stats));
+    }
+    sqlite3_mutex_leave(zvfs_mutex());
+}
+
+#ifdef RT_USING_FINSH
+static void sqlzip(int argc, char **argv)
+{
+    struct db_compress_stats st;
+    char line[160];
+
+    db_compress_stats(&st, argc >= 2 && rt_strcmp(argv[1], "reset") == 0);
+
+    /* rt_kprintf() has no 64-bit or floating point conversions, sqlite3_snprintf() does */
+    sqlite3_snprintf(sizeof(line), line, "written %u pages (%u uncompressed), %lld -> %lld bytes, ratio %.2f",
+                     st.pages_written, st.pages_raw, st.page_bytes, st.stored_bytes,
+                     st.stored_bytes ? (double)st.page_bytes / st.stored_bytes : 0.0);
+    rt_kprintf("%s\n", line);
+    sqlite3_snprintf(sizeof(line), line, "read %u pages, %u commits, %lld page map bytes",
+                     st.pages_read, st.commits, st.map_bytes);
+    rt_kprintf("%s\n", line);
+    sqlite3_snprintf(sizeof(line), line, "per page: compress %lld %s, decompress %lld %s",
+                     st.pages_written ? st.compress_time / st.pages_written : 0, RTTHREAD_IO_CLOCK_UNIT,
+                     st.pages_read ? st.decompress_time / st.pages_read : 0, RTTHREAD_IO_CLOCK_UNIT);
+    rt_kprintf("%s\n", line);
+}
+MSH_CMD_EXPORT(sqlzip, sqlite page compression statistics: sqlzip [reset]);
+#endif
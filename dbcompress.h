@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2026-10-19     RT-Thread    first version
+ */
+
+#ifndef __DBCOMPRESS_H__
+#define __DBCOMPRESS_H__
+
+#include <sqlite3.h>
+
+#define DB_COMPRESS_VFS_NAME "compress"
+
+/*
+ * counters of the page compression VFS since start or the last reset;
+ * times are in units of PKG_SQLITE_IO_CLOCK (see rtthread_vfs.h)
+ */
+struct db_compress_stats
+{
+    unsigned int pages_written;     /* pages stored */
+    unsigned int pages_raw;         /* of which stored uncompressed, no block saved */
+    unsigned int pages_read;        /* pages loaded from flash */
+    unsigned int commits;           /* page map commits */
+    sqlite3_int64 page_bytes;       /* uncompressed bytes of the pages stored */
+    sqlite3_int64 stored_bytes;     /* bytes written for them */
+    sqlite3_int64 map_bytes;        /* page map bytes written by commits */
+    sqlite3_int64 compress_time;    /* spent compressing pages_written pages */
+    sqlite3_int64 decompress_time;  /* spent decompressing pages_read pages */
+};
+
+/**
+ * This function will register the "compress" VFS, which stores every page
+ * of the main database files compressed on top of the rt-thread VFS.
+ * Journals and temporary files are passed through uncompressed, and database
+ * files created by another VFS are opened as they are.
+ *
+ * @param make_default non-zero to make it the default VFS.
+ * @return SQLITE_OK on success.
+ */
+int db_compress_register(int make_default);
+
+/**
+ * This function will get the counters of the compression VFS.
+ *
+ * @param stats the counters.
+ * @param reset non-zero to clear the counters after reading them.
+ */
+void db_compress_stats(struct db_compress_stats *stats, int reset);
+
+#endif
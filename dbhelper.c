@@ -13,6 +13,22 @@
 #include <rtthread.h>
 #include <ctype.h>
 #include "dbhelper.h"
+#include "dbbulk.h"
+#ifdef PKG_SQLITE_COMPRESS
+#include "dbcompress.h"
+#endif
+#ifdef PKG_SQLITE_BLOCKDEV
+#include "dbblock.h"
+#endif
+#ifdef PKG_SQLITE_LOGFS
+#include "dblog.h"
+#endif
+#ifdef PKG_SQLITE_MEMPOOL
+#include "dbmem.h"
+#endif
+#ifdef PKG_SQLITE_PCACHE
+#include "dbpcache.h"
+#endif
 
 #define DBG_ENABLE
 #define DBG_SECTION_NAME "app.dbhelper"
@@ -26,13 +42,513 @@
 #define DEFAULT_DB_NAME "/rt.db"
 
 static rt_mutex_t db_mutex_lock = RT_NULL;
+static rt_thread_t db_connect_owner = RT_NULL;  /* thread between db_connect() and db_disconnect() */
+static int db_connect_nest;
 static char db_name[PKG_SQLITE_DB_NAME_MAX_LEN + 1] = DEFAULT_DB_NAME;
+static rt_uint32_t db_name_gen;     /* bumped whenever db_name changes */
+static rt_uint32_t db_profile_gen;  /* bumped whenever the profile of a database changes */
+
+/* connections dbhelper keeps open, 0 to open one for every operation */
+#ifndef PKG_SQLITE_POOL_SIZE
+#define PKG_SQLITE_POOL_SIZE 0
+#endif
+
+/* milliseconds a pooled connection retries a database locked by another one */
+#ifndef PKG_SQLITE_BUSY_TIMEOUT
+#define PKG_SQLITE_BUSY_TIMEOUT 3000
+#endif
+
+/*
+ * Keep one connection open for good with PKG_SQLITE_EXCLUSIVE_PRAGMAS, which
+ * hold the database file locked from its first transaction on. The file is
+ * then never unlocked and its change counter never read again, so the page
+ * cache stays valid from one transaction to the next. No other connection,
+ * of dbhelper or not, can open the database meanwhile.
+ */
+#ifdef PKG_SQLITE_EXCLUSIVE
+#if PKG_SQLITE_POOL_SIZE > 1
+#error "the exclusive connection locks out every other one, set PKG_SQLITE_POOL_SIZE to 0 or 1"
+#endif
+#define DB_CONN_SLOTS 1
+#define DB_CONN_KEEP 1
+#elif PKG_SQLITE_POOL_SIZE > 0
+#define DB_CONN_SLOTS PKG_SQLITE_POOL_SIZE
+#define DB_CONN_KEEP 1
+#else
+#define DB_CONN_SLOTS 1
+#define DB_CONN_KEEP 0
+#endif
+
+/*
+ * Open the connections on one page cache shared by all of them. The writer
+ * holds the tables it changes until it commits, and a query blocked on such
+ * a table gets SQLITE_LOCKED, which the busy timeout does not retry, so
+ * db_stmt_step() retries it for as long. With PKG_SQLITE_READ_UNCOMMITTED
+ * the connections read uncommitted instead and are not blocked, but may see
+ * rows of the write in progress.
+ */
+#ifdef PKG_SQLITE_SHARED_CACHE
+#define DB_OPEN_CACHE SQLITE_OPEN_SHAREDCACHE
+#else
+#define DB_OPEN_CACHE 0
+#endif
+
+/* without a pool every operation runs under db_mutex_lock, with one only writes do */
+#define DB_SERIALIZED(write) ((write) || PKG_SQLITE_POOL_SIZE == 0)
+
+/*
+ * Every connection of dbhelper is checked out to one thread at a time, which
+ * is all SQLite asks of a connection opened with SQLITE_OPEN_NOMUTEX or in a
+ * SQLITE_THREADSAFE=2 build, so they are opened without connection mutexes.
+ * A thread that nests operations, e.g. from a query callback, gets back the
+ * connection it already holds.
+ */
+struct db_conn
+{
+    sqlite3 *db;
+    rt_thread_t owner;              /* thread the connection is checked out to */
+    int nest;                       /* operations of the owner running on it */
+    rt_uint32_t gen;                /* db_name_gen the connection was opened at */
+    rt_uint32_t profile_gen;        /* db_profile_gen the connection was opened at */
+};
+
+static struct db_conn db_conn[DB_CONN_SLOTS];
+static rt_mutex_t db_pool_lock = RT_NULL;     /* guards db_conn[] and db_name */
+static rt_sem_t db_pool_sem = RT_NULL;        /* counts the connections not checked out */
+
+/* databases remembered as looked for a bulk load backup point at since boot */
+#ifndef PKG_SQLITE_RECOVER_PATHS
+#define PKG_SQLITE_RECOVER_PATHS 4
+#endif
+
+static char db_recovered[PKG_SQLITE_RECOVER_PATHS][PKG_SQLITE_DB_NAME_MAX_LEN + 1];  /* guarded by db_pool_lock */
+static int db_recovered_next;       /* slot the next database is remembered in */
+
+/* define PKG_SQLITE_PROFILE, e.g. "durable", to open the databases without a profile of their own with it */
+
+/* databases that can be given a profile of their own */
+#ifndef PKG_SQLITE_PROFILE_BINDS
+#define PKG_SQLITE_PROFILE_BINDS 4
+#endif
+
+/*
+ * A profile is a set of PRAGMAs run on every connection dbhelper opens to a
+ * database, after which the connection keeps them until it is closed.
+ */
+struct db_profile
+{
+    const char *name;
+    const char *pragmas;
+};
+
+static const struct db_profile db_profiles[] =
+{
+    {"durable", PKG_SQLITE_PROFILE_DURABLE},
+    {"fast-log", PKG_SQLITE_PROFILE_FAST_LOG},
+    {"read-mostly", PKG_SQLITE_PROFILE_READ_MOSTLY},
+    {"bulk-load", PKG_SQLITE_PROFILE_BULK_LOAD},
+};
+
+static struct
+{
+    char name[PKG_SQLITE_DB_NAME_MAX_LEN + 1];
+    const struct db_profile *profile;
+} db_profile_bind[PKG_SQLITE_PROFILE_BINDS];    /* guarded by db_pool_lock */
+static const struct db_profile *db_profile_default;
+
+/* bytes of the static heap given to SQLite (memsys5), 0 to use the system heap */
+#ifndef PKG_SQLITE_HEAP_SIZE
+#define PKG_SQLITE_HEAP_SIZE 0
+#endif
+
+/* smallest block of the static heap, every allocation is rounded to a power of two of it */
+#ifndef PKG_SQLITE_HEAP_MIN_ALLOC
+#define PKG_SQLITE_HEAP_MIN_ALLOC 32
+#endif
+
+/* bytes of the static buffer of the default page cache, 0 to disable it */
+#ifndef PKG_SQLITE_PAGECACHE_SIZE
+#define PKG_SQLITE_PAGECACHE_SIZE 0
+#endif
+
+/* largest page size held by a page cache buffer slot */
+#ifndef PKG_SQLITE_PAGECACHE_PAGE
+#define PKG_SQLITE_PAGECACHE_PAGE 4096
+#endif
+
+/* lookaside slots of each connection, 0 to keep the SQLite default */
+#ifndef PKG_SQLITE_LOOKASIDE_COUNT
+#define PKG_SQLITE_LOOKASIDE_COUNT 0
+#endif
+
+#ifndef PKG_SQLITE_LOOKASIDE_SLOT
+#define PKG_SQLITE_LOOKASIDE_SLOT 64
+#endif
+
+#if PKG_SQLITE_HEAP_SIZE > 0 && defined(PKG_SQLITE_MEMPOOL)
+#error "PKG_SQLITE_HEAP_SIZE and PKG_SQLITE_MEMPOOL both replace the sqlite allocator"
+#endif
+#if PKG_SQLITE_PAGECACHE_SIZE > 0 && defined(PKG_SQLITE_PCACHE)
+#error "the PKG_SQLITE_PAGECACHE_SIZE buffer is only used by the default page cache"
+#endif
+
+#ifndef rt_section
+#define rt_section(x) SECTION(x)
+#endif
+
+#if PKG_SQLITE_HEAP_SIZE > 0
+#ifdef PKG_SQLITE_HEAP_SECTION
+static rt_uint64_t db_heap[PKG_SQLITE_HEAP_SIZE / 8] rt_section(PKG_SQLITE_HEAP_SECTION);
+#else
+static rt_uint64_t db_heap[PKG_SQLITE_HEAP_SIZE / 8];
+#endif
+#endif
+
+#if PKG_SQLITE_PAGECACHE_SIZE > 0
+#ifdef PKG_SQLITE_PAGECACHE_SECTION
+static rt_uint64_t db_pagecache[PKG_SQLITE_PAGECACHE_SIZE / 8] rt_section(PKG_SQLITE_PAGECACHE_SECTION);
+#else
+static rt_uint64_t db_pagecache[PKG_SQLITE_PAGECACHE_SIZE / 8];
+#endif
+static int db_pagecache_slots;
+#endif
+
+#if PKG_SQLITE_LOOKASIDE_COUNT > 0
+/* one buffer for each connection slot, a slot holds one open connection at a time */
+#ifdef PKG_SQLITE_LOOKASIDE_SECTION
+static rt_uint64_t db_lookaside[DB_CONN_SLOTS][RT_ALIGN(PKG_SQLITE_LOOKASIDE_SLOT, 8) * PKG_SQLITE_LOOKASIDE_COUNT / 8]
+rt_section(PKG_SQLITE_LOOKASIDE_SECTION);
+#else
+static rt_uint64_t db_lookaside[DB_CONN_SLOTS][RT_ALIGN(PKG_SQLITE_LOOKASIDE_SLOT, 8) * PKG_SQLITE_LOOKASIDE_COUNT / 8];
+#endif
+static struct
+{
+    int peak;                       /* most slots in use by one connection */
+    int miss_size;                  /* allocations too large for a slot */
+    int miss_full;                  /* allocations made with every slot in use */
+} db_lookaside_stats;
+#endif
+
+/* hand SQLite the static memory, before it is initialized */
+static void db_static_memory(void)
+{
+#if PKG_SQLITE_PAGECACHE_SIZE > 0
+    int hdr = 0, slot;
+#endif
+
+#if PKG_SQLITE_HEAP_SIZE > 0
+    if (sqlite3_config(SQLITE_CONFIG_HEAP, db_heap, (int)sizeof(db_heap), PKG_SQLITE_HEAP_MIN_ALLOC) != SQLITE_OK)
+    {
+        LOG_E("give sqlite the static heap failed!\n");
+    }
+#endif
+#if PKG_SQLITE_PAGECACHE_SIZE > 0
+    sqlite3_config(SQLITE_CONFIG_PCACHE_HDRSZ, &hdr);
+    slot = RT_ALIGN(PKG_SQLITE_PAGECACHE_PAGE + hdr, 8);
+    if (sqlite3_config(SQLITE_CONFIG_PAGECACHE, db_pagecache, slot, (int)sizeof(db_pagecache) / slot) == SQLITE_OK)
+    {
+        db_pagecache_slots = (int)sizeof(db_pagecache) / slot;
+    }
+    else
+    {
+        LOG_E("give sqlite the static page cache failed!\n");
+    }
+#endif
+#if PKG_SQLITE_LOOKASIDE_COUNT > 0
+    sqlite3_config(SQLITE_CONFIG_LOOKASIDE, RT_ALIGN(PKG_SQLITE_LOOKASIDE_SLOT, 8), PKG_SQLITE_LOOKASIDE_COUNT);
+#endif
+}
+
+static const struct db_profile *db_profile_find(const char *profile)
+{
+    int i;
+
+    for (i = 0; profile != RT_NULL && i < sizeof(db_profiles) / sizeof(db_profiles[0]); i++)
+    {
+        if (rt_strcmp(profile, db_profiles[i].name) == 0)
+        {
+            return &db_profiles[i];
+        }
+    }
+    return RT_NULL;
+}
+
+/* PRAGMAs of the profile of a database, with db_pool_lock held */
+static const char *db_profile_of(const char *name)
+{
+    int i;
+
+    for (i = 0; i < PKG_SQLITE_PROFILE_BINDS; i++)
+    {
+        if (db_profile_bind[i].profile != RT_NULL && rt_strcmp(db_profile_bind[i].name, name) == 0)
+        {
+            return db_profile_bind[i].profile->pragmas;
+        }
+    }
+    return db_profile_default != RT_NULL ? db_profile_default->pragmas : RT_NULL;
+}
+
+static int db_conn_open(struct db_conn *c, const char *name, const char *pragmas, int recover)
+{
+    int rc = sqlite3_open_v2(name, &c->db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_NOMUTEX | DB_OPEN_CACHE,
+                             RT_NULL);
+
+    if (rc != SQLITE_OK)
+    {
+        sqlite3_close(c->db);
+        c->db = RT_NULL;
+        return rc;
+    }
+    /* the first connection to a database undoes a bulk load a power loss interrupted, before anything reads it */
+    if (recover && db_bulk_recover(c->db) != SQLITE_OK)
+    {
+        LOG_E("recover %s from the bulk load backup point failed!\n", name);
+    }
+#if PKG_SQLITE_LOOKASIDE_COUNT > 0
+    if (sqlite3_db_config(c->db, SQLITE_DBCONFIG_LOOKASIDE, db_lookaside[c - db_conn],
+                          RT_ALIGN(PKG_SQLITE_LOOKASIDE_SLOT, 8), PKG_SQLITE_LOOKASIDE_COUNT) != SQLITE_OK)
+    {
+        LOG_W("the static lookaside buffer is not used");
+    }
+#endif
+#if PKG_SQLITE_POOL_SIZE > 0
+    sqlite3_busy_timeout(c->db, PKG_SQLITE_BUSY_TIMEOUT);
+#endif
+#if defined(PKG_SQLITE_SHARED_CACHE) && defined(PKG_SQLITE_READ_UNCOMMITTED)
+    sqlite3_exec(c->db, "PRAGMA read_uncommitted=1;", 0, 0, RT_NULL);
+#endif
+    if (pragmas != RT_NULL && sqlite3_exec(c->db, pragmas, 0, 0, RT_NULL) != SQLITE_OK)
+    {
+        LOG_E("set the profile PRAGMAs failed: %s", sqlite3_errmsg(c->db));
+    }
+#ifdef PKG_SQLITE_EXCLUSIVE
+    if (sqlite3_exec(c->db, PKG_SQLITE_EXCLUSIVE_PRAGMAS, 0, 0, RT_NULL) != SQLITE_OK)
+    {
+        LOG_E("set the exclusive PRAGMAs failed: %s", sqlite3_errmsg(c->db));
+    }
+#endif
+    return SQLITE_OK;
+}
+
+/*
+ * Remember a database as looked for a bulk load backup point at, returns
+ * the slot it is remembered in, or -1 if it already was. With more
+ * databases than slots the one remembered longest is forgotten, and looked
+ * at again before its next connection. Called with db_pool_lock held.
+ */
+static int db_recover_slot(const char *name)
+{
+    int i;
+
+    for (i = 0; i < PKG_SQLITE_RECOVER_PATHS; i++)
+    {
+        if (rt_strcmp(db_recovered[i], name) == 0)
+        {
+            return -1;
+        }
+    }
+    i = db_recovered_next;
+    rt_strncpy(db_recovered[i], name, sizeof(db_recovered[i]));
+    db_recovered_next = (i + 1) % PKG_SQLITE_RECOVER_PATHS;
+    return i;
+}
+
+/* fold the lookaside usage of a connection into the totals, and restart its counters */
+static void db_conn_account(sqlite3 *db)
+{
+#if PKG_SQLITE_LOOKASIDE_COUNT > 0
+    int cur, peak = 0, miss_size = 0, miss_full = 0;
+
+    sqlite3_db_status(db, SQLITE_DBSTATUS_LOOKASIDE_USED, &cur, &peak, 1);
+    sqlite3_db_status(db, SQLITE_DBSTATUS_LOOKASIDE_MISS_SIZE, &cur, &miss_size, 1);
+    sqlite3_db_status(db, SQLITE_DBSTATUS_LOOKASIDE_MISS_FULL, &cur, &miss_full, 1);
+    rt_mutex_take(db_pool_lock, RT_WAITING_FOREVER);
+    if (peak > db_lookaside_stats.peak)
+    {
+        db_lookaside_stats.peak = peak;
+    }
+    db_lookaside_stats.miss_size += miss_size;
+    db_lookaside_stats.miss_full += miss_full;
+    rt_mutex_release(db_pool_lock);
+#endif
+}
+
+/* check a connection out to the calling thread, opening it if needed */
+static int db_open(sqlite3 **db, int write)
+{
+    char name[PKG_SQLITE_DB_NAME_MAX_LEN + 1];
+    rt_thread_t self = rt_thread_self();
+    struct db_conn *c = RT_NULL;
+    const char *pragmas;
+    rt_uint32_t gen, profile_gen;
+    int i, recover, rc = SQLITE_OK;
+
+    rt_mutex_take(db_pool_lock, RT_WAITING_FOREVER);
+    for (i = 0; i < DB_CONN_SLOTS && c == RT_NULL; i++)
+    {
+        if (db_conn[i].owner == self)
+        {
+            c = &db_conn[i];
+        }
+    }
+    rt_mutex_release(db_pool_lock);
+    if (c != RT_NULL)
+    {
+        /*
+         * a write nested in a query must not wait for db_mutex_lock while it
+         * holds a connection, the writer holding the lock may be waiting for
+         * that connection
+         */
+        if (DB_SERIALIZED(write) && rt_mutex_take(db_mutex_lock, RT_WAITING_NO) != RT_EOK)
+        {
+            return SQLITE_BUSY;
+        }
+        c->nest++;
+        *db = c->db;
+        return SQLITE_OK;
+    }
+
+    if (DB_SERIALIZED(write))
+    {
+        rt_mutex_take(db_mutex_lock, RT_WAITING_FOREVER);
+    }
+    rt_sem_take(db_pool_sem, RT_WAITING_FOREVER);
+    rt_mutex_take(db_pool_lock, RT_WAITING_FOREVER);
+    for (i = 0; c == RT_NULL; i++)
+    {
+        if (db_conn[i].owner == RT_NULL)
+        {
+            c = &db_conn[i];
+        }
+    }
+    c->owner = self;
+    c->nest = 1;
+    rt_strncpy(name, db_name, sizeof(name));
+    pragmas = db_profile_of(name);
+    gen = db_name_gen;
+    profile_gen = db_profile_gen;
+    recover = db_recover_slot(name);
+    /* the other connections to a database wait until its first one has undone an interrupted bulk load */
+    if (recover < 0)
+    {
+        rt_mutex_release(db_pool_lock);
+    }
+
+    /* the database was renamed or given another profile since the connection was opened */
+    if (c->db != RT_NULL && (c->gen != gen || c->profile_gen != profile_gen || recover >= 0))
+    {
+        db_conn_account(c->db);
+        sqlite3_close(c->db);
+        c->db = RT_NULL;
+    }
+    if (c->db == RT_NULL)
+    {
+        rc = db_conn_open(c, name, pragmas, recover >= 0);
+        c->gen = gen;
+        c->profile_gen = profile_gen;
+    }
+    if (recover >= 0)
+    {
+        /* look again on the next connection if this one could not be opened */
+        if (rc != SQLITE_OK)
+        {
+            db_recovered[recover][0] = '\0';
+        }
+        rt_mutex_release(db_pool_lock);
+    }
+    if (rc != SQLITE_OK)
+    {
+        rt_mutex_take(db_pool_lock, RT_WAITING_FOREVER);
+        c->owner = RT_NULL;
+        rt_mutex_release(db_pool_lock);
+        rt_sem_release(db_pool_sem);
+        if (DB_SERIALIZED(write))
+        {
+            rt_mutex_release(db_mutex_lock);
+        }
+        return rc;
+    }
+    *db = c->db;
+    return SQLITE_OK;
+}
+
+/* give back a connection checked out by db_open() */
+static void db_close(sqlite3 *db, int write)
+{
+    struct db_conn *c = RT_NULL;
+    rt_uint32_t gen, profile_gen;
+    int i;
+
+    for (i = 0; i < DB_CONN_SLOTS; i++)
+    {
+        if (db_conn[i].db == db && db_conn[i].owner == rt_thread_self())
+        {
+            c = &db_conn[i];
+        }
+    }
+    RT_ASSERT(c != RT_NULL);
+    if (--c->nest == 0)
+    {
+        db_conn_account(db);
+        rt_mutex_take(db_pool_lock, RT_WAITING_FOREVER);
+        gen = db_name_gen;
+        profile_gen = db_profile_gen;
+        rt_mutex_release(db_pool_lock);
+        if (!DB_CONN_KEEP || c->gen != gen || c->profile_gen != profile_gen)
+        {
+            sqlite3_close(db);
+            c->db = RT_NULL;
+        }
+        rt_mutex_take(db_pool_lock, RT_WAITING_FOREVER);
+        c->owner = RT_NULL;
+        rt_mutex_release(db_pool_lock);
+        rt_sem_release(db_pool_sem);
+    }
+    if (DB_SERIALIZED(write))
+    {
+        rt_mutex_release(db_mutex_lock);
+    }
+}
+
+/* point dbhelper at another database, open connections are reopened on it when next checked out */
+static void db_name_update(const char *name, int len)
+{
+    rt_mutex_take(db_pool_lock, RT_WAITING_FOREVER);
+    rt_strncpy(db_name, name, len);
+    db_name[len] = '\0';
+    db_name_gen++;
+    rt_mutex_release(db_pool_lock);
+}
 
 /**
  * This function will initialize SQLite3 create a mutex as a lock.
  */
 int db_helper_init(void)
 {
+    /* the memory, the allocator and the page cache can only be set before SQLite is initialized */
+    if (db_mutex_lock == RT_NULL)
+    {
+        db_static_memory();
+#ifdef PKG_SQLITE_PROFILE
+        db_profile_default = db_profile_find(PKG_SQLITE_PROFILE);
+        if (db_profile_default == RT_NULL)
+        {
+            LOG_E("unknown sqlite profile %s!\n", PKG_SQLITE_PROFILE);
+        }
+#endif
+    }
+#ifdef PKG_SQLITE_MEMPOOL
+    if (db_mutex_lock == RT_NULL && db_mem_register() != SQLITE_OK)
+    {
+        LOG_E("register the pool allocator failed!\n");
+    }
+#endif
+#ifdef PKG_SQLITE_PCACHE
+    if (db_mutex_lock == RT_NULL && db_pcache_register(RT_NULL, 0) != SQLITE_OK)
+    {
+        LOG_E("register the pool page cache failed!\n");
+    }
+#endif
     sqlite3_initialize();
     if (db_mutex_lock == RT_NULL)
     {
@@ -43,6 +559,37 @@ int db_helper_init(void)
         LOG_E("rt_mutex_create dbmtx failed!\n");
         return -RT_ERROR;
     }
+    if (db_pool_lock == RT_NULL)
+    {
+        db_pool_lock = rt_mutex_create("dbpool", RT_IPC_FLAG_FIFO);
+    }
+    if (db_pool_sem == RT_NULL)
+    {
+        db_pool_sem = rt_sem_create("dbpool", DB_CONN_SLOTS, RT_IPC_FLAG_FIFO);
+    }
+    if (db_pool_lock == RT_NULL || db_pool_sem == RT_NULL)
+    {
+        LOG_E("create the connection pool lock failed!\n");
+        return -RT_ERROR;
+    }
+#ifdef PKG_SQLITE_COMPRESS
+    if (db_compress_register(1) != SQLITE_OK)
+    {
+        LOG_E("register the compress VFS failed!\n");
+    }
+#endif
+#if defined(PKG_SQLITE_BLOCKDEV) && defined(PKG_SQLITE_BLOCKDEV_NAME)
+    if (db_block_register(PKG_SQLITE_BLOCKDEV_NAME, 1) != SQLITE_OK)
+    {
+        LOG_E("mount %s for sqlite failed!\n", PKG_SQLITE_BLOCKDEV_NAME);
+    }
+#endif
+#ifdef PKG_SQLITE_LOGFS
+    if (db_log_register(1) != SQLITE_OK)
+    {
+        LOG_E("register the logfs VFS failed!\n");
+    }
+#endif
     return RT_EOK;
 }
 INIT_APP_EXPORT(db_helper_init);
@@ -113,6 +660,94 @@ static int db_bind_by_var(sqlite3_stmt *stmt, const char *fmt, va_list args)
     return ret;
 }
 
+#ifdef PKG_SQLITE_SHARED_CACHE
+static void db_unlock_notify_cb(void **args, int n)
+{
+    int i;
+
+    for (i = 0; i < n; i++)
+    {
+        rt_sem_release((rt_sem_t)args[i]);
+    }
+}
+
+/*
+ * Wait until the connection holding the shared cache table a statement of
+ * db ran into ends its transaction, for PKG_SQLITE_BUSY_TIMEOUT from start
+ * at most. Returns 0 when the statement should give up with rc instead,
+ * which is also the case when waiting would deadlock.
+ */
+static int db_locked_retry(sqlite3 *db, int rc, rt_tick_t start)
+{
+    struct rt_semaphore sem;
+    rt_tick_t limit = rt_tick_from_millisecond(PKG_SQLITE_BUSY_TIMEOUT);
+    rt_tick_t waited = rt_tick_get() - start;
+    rt_err_t err = -RT_ETIMEOUT;
+
+    if ((rc & 0xff) != SQLITE_LOCKED || waited >= limit)
+    {
+        return 0;
+    }
+    rt_sem_init(&sem, "sqlntf", 0, RT_IPC_FLAG_FIFO);
+    rc = sqlite3_unlock_notify(db, db_unlock_notify_cb, &sem);
+    if (rc == SQLITE_OK)
+    {
+        err = rt_sem_take(&sem, (rt_int32_t)(limit - waited));
+        if (err != RT_EOK)
+        {
+            /* withdraw the callback before its semaphore goes away */
+            sqlite3_unlock_notify(db, RT_NULL, RT_NULL);
+        }
+    }
+    rt_sem_detach(&sem);
+    return err == RT_EOK;
+}
+#endif
+
+/* prepare a statement, waiting like db_stmt_step() when the schema is locked */
+static int db_prepare(sqlite3 *db, const char *sql, sqlite3_stmt **stmt)
+{
+#ifdef PKG_SQLITE_SHARED_CACHE
+    rt_tick_t start = rt_tick_get();
+    int rc;
+
+    while ((rc = sqlite3_prepare(db, sql, -1, stmt, NULL)) != SQLITE_OK && db_locked_retry(db, rc, start))
+    {
+    }
+    return rc;
+#else
+    return sqlite3_prepare(db, sql, -1, stmt, NULL);
+#endif
+}
+
+/**
+ * This function will step a statement like sqlite3_step(), retrying a table
+ * locked by another connection on the shared cache.
+ *
+ * @param stmt the SQL statement.
+ * @return SQLITE_ROW, SQLITE_DONE or the error.
+ */
+int db_stmt_step(sqlite3_stmt *stmt)
+{
+#ifdef PKG_SQLITE_SHARED_CACHE
+    rt_tick_t start = rt_tick_get();
+    int rc;
+
+    while ((rc = sqlite3_step(stmt)) != SQLITE_ROW && rc != SQLITE_DONE)
+    {
+        /* a statement from sqlite3_prepare() only tells the error on reset */
+        rc = sqlite3_reset(stmt);
+        if (!db_locked_retry(sqlite3_db_handle(stmt), rc, start))
+        {
+            break;
+        }
+    }
+    return rc;
+#else
+    return sqlite3_step(stmt);
+#endif
+}
+
 /**
  * This function will be used for the SELECT operating.The additional arguments
  * following format are formatted and inserted in the resulting string replacing
@@ -136,16 +771,14 @@ int db_query_by_varpara(const char *sql, int (*create)(sqlite3_stmt *stmt, void
     {
         return SQLITE_ERROR;
     }
-    rt_mutex_take(db_mutex_lock, RT_WAITING_FOREVER);
-    int rc = sqlite3_open(db_name, &db);
+    int rc = db_open(&db, 0);
     if (rc != SQLITE_OK)
     {
         LOG_E("open database failed,rc=%d", rc);
-        rt_mutex_release(db_mutex_lock);
         return rc;
     }
 
-    rc = sqlite3_prepare(db, sql, -1, &stmt, NULL);
+    rc = db_prepare(db, sql, &stmt);
     if (rc != SQLITE_OK)
     {
         LOG_E("database prepare fail,rc=%d", rc);
@@ -171,15 +804,14 @@ int db_query_by_varpara(const char *sql, int (*create)(sqlite3_stmt *stmt, void
     }
     else
     {
-        rc = (sqlite3_step(stmt), 0);
+        rc = (db_stmt_step(stmt), 0);
     }
     sqlite3_finalize(stmt);
     goto __db_exec_ok;
 __db_exec_fail:
     LOG_E("db operator failed,rc=%d", rc);
 __db_exec_ok:
-    sqlite3_close(db);
-    rt_mutex_release(db_mutex_lock);
+    db_close(db, 0);
     return rc;
 }
 
@@ -207,12 +839,10 @@ int db_nonquery_operator(const char *sqlstr, int (*bind)(sqlite3_stmt *stmt, int
     {
         return SQLITE_ERROR;
     }
-    rt_mutex_take(db_mutex_lock, RT_WAITING_FOREVER);
-    int rc = sqlite3_open(db_name, &db);
+    int rc = db_open(&db, 1);
     if (rc != SQLITE_OK)
     {
         LOG_E("open database failed,rc=%d", rc);
-        rt_mutex_release(db_mutex_lock);
         return rc;
     }
     rc = sqlite3_exec(db, "begin transaction", 0, 0, NULL);
@@ -248,7 +878,7 @@ int db_nonquery_operator(const char *sqlstr, int (*bind)(sqlite3_stmt *stmt, int
                 break;
             }
         } while (1);
-        rc = sqlite3_prepare(db, sql, -1, &stmt, NULL);
+        rc = db_prepare(db, sql, &stmt);
         if (rc != SQLITE_OK)
         {
             LOG_E("prepare error,rc=%d", rc);
@@ -260,7 +890,7 @@ int db_nonquery_operator(const char *sqlstr, int (*bind)(sqlite3_stmt *stmt, int
         }
         else
         {
-            rc = sqlite3_step(stmt);
+            rc = db_stmt_step(stmt);
         }
         sqlite3_finalize(stmt);
         if ((rc != SQLITE_OK) && (rc != SQLITE_DONE))
@@ -287,8 +917,7 @@ __db_begin_fail:
     LOG_E("db operator failed,rc=%d", rc);
 
 __db_exec_ok:
-    sqlite3_close(db);
-    rt_mutex_release(db_mutex_lock);
+    db_close(db, 1);
     return rc;
 }
 
@@ -310,16 +939,14 @@ int db_nonquery_by_varpara(const char *sql, const char *fmt, ...)
     {
         return SQLITE_ERROR;
     }
-    rt_mutex_take(db_mutex_lock, RT_WAITING_FOREVER);
-    int rc = sqlite3_open(db_name, &db);
+    int rc = db_open(&db, 1);
     if (rc != SQLITE_OK)
     {
         LOG_E("open database failed,rc=%d\n", rc);
-        rt_mutex_release(db_mutex_lock);
         return rc;
     }
     LOG_D("sql:%s", sql);
-    rc = sqlite3_prepare(db, sql, -1, &stmt, NULL);
+    rc = db_prepare(db, sql, &stmt);
     if (rc != SQLITE_OK)
     {
         LOG_E("prepare error,rc=%d", rc);
@@ -336,7 +963,7 @@ int db_nonquery_by_varpara(const char *sql, const char *fmt, ...)
             goto __db_exec_fail;
         }
     }
-    rc = sqlite3_step(stmt);
+    rc = db_stmt_step(stmt);
     sqlite3_finalize(stmt);
     if ((rc != SQLITE_OK) && (rc != SQLITE_DONE))
     {
@@ -350,8 +977,7 @@ __db_exec_fail:
     LOG_E("db operator failed,rc=%d", rc);
 
 __db_exec_ok:
-    sqlite3_close(db);
-    rt_mutex_release(db_mutex_lock);
+    db_close(db, 1);
     return rc;
 }
 
@@ -369,12 +995,10 @@ int db_nonquery_transaction(int (*exec_sqls)(sqlite3 *db, void *arg), void *arg)
 {
     sqlite3 *db = NULL;
 
-    rt_mutex_take(db_mutex_lock, RT_WAITING_FOREVER);
-    int rc = sqlite3_open(db_name, &db);
+    int rc = db_open(&db, 1);
     if (rc != SQLITE_OK)
     {
         LOG_E("open database failed,rc=%d", rc);
-        rt_mutex_release(db_mutex_lock);
         return rc;
     }
     rc = sqlite3_exec(db, "begin transaction", 0, 0, NULL);
@@ -415,15 +1039,14 @@ __db_begin_fail:
     LOG_E("db operator failed,rc=%d", rc);
 
 __db_exec_ok:
-    sqlite3_close(db);
-    rt_mutex_release(db_mutex_lock);
+    db_close(db, 1);
     return rc;
 }
 
 static int db_get_count(sqlite3_stmt *stmt, void *arg)
 {
     int ret, *count = arg;
-    ret = sqlite3_step(stmt);
+    ret = db_stmt_step(stmt);
     if (ret != SQLITE_ROW)
     {
         return SQLITE_EMPTY;
@@ -555,23 +1178,33 @@ int db_connect(char *name)
         rt_mutex_release(db_mutex_lock);
         return -RT_ERROR;
     }
-    rt_strncpy(db_name, name, len);
-    db_name[len] = '\0';
+    db_connect_owner = rt_thread_self();
+    db_connect_nest++;
+    db_name_update(name, len);
     return RT_EOK;
 }
 /**
- * This function will disconnect DB
+ * This function will disconnect DB, from the thread that called db_connect().
  *
  * @param name the DB filename.
  * @return RT_EOK:success
- *         -RT_ERROR:the input name is too long
+ *         -RT_ERROR:the calling thread did not db_connect()
  */
 int db_disconnect(char *name)
 {
-    int32_t len = 0;
+    /* the lock taken by db_connect() can only be given back by its thread */
+    if (db_connect_owner != rt_thread_self())
+    {
+        LOG_E("db_disconnect() without db_connect() in this thread");
+        RT_ASSERT(db_connect_owner == rt_thread_self());
+        return -RT_ERROR;
+    }
+    if (--db_connect_nest == 0)
+    {
+        db_connect_owner = RT_NULL;
+    }
+    db_name_update(DEFAULT_DB_NAME, strlen(DEFAULT_DB_NAME));
     rt_mutex_release(db_mutex_lock);
-    rt_strncpy(db_name, DEFAULT_DB_NAME, strlen(DEFAULT_DB_NAME));
-    db_name[len] = '\0';
     return RT_EOK;
 }
 
@@ -593,8 +1226,7 @@ int db_set_name(char *name)
         rt_mutex_release(db_mutex_lock);
         return -RT_ERROR;
     }
-    rt_strncpy(db_name, name, len);
-    db_name[len] = '\0';
+    db_name_update(name, len);
     rt_mutex_release(db_mutex_lock);
     return RT_EOK;
 }
@@ -613,3 +1245,166 @@ char *db_get_name(void)
     name[len] = '\0';
     return name;
 }
+
+/**
+ * This function will check a connection to the current database out to the
+ * calling thread. The connection is used by this thread only until it is
+ * given back, so it runs without SQLite connection mutexes. A thread that
+ * already holds one gets the same connection back.
+ *
+ * @param write non-zero if the connection will write, writers take turns
+ *        under the dbhelper lock like the db_nonquery_xxx() functions.
+ * @return the connection, RT_NULL on failure.
+ */
+sqlite3 *db_connection_take(int write)
+{
+    sqlite3 *db = RT_NULL;
+
+    if (db_open(&db, write) != SQLITE_OK)
+    {
+        return RT_NULL;
+    }
+    return db;
+}
+
+/**
+ * This function will give back a connection checked out with
+ * db_connection_take(), from the thread that took it.
+ *
+ * @param db the connection.
+ * @param write the value passed to db_connection_take().
+ */
+void db_connection_release(sqlite3 *db, int write)
+{
+    db_close(db, write);
+}
+
+/**
+ * This function will select the PRAGMA profile the connections to a
+ * database are opened with.
+ *
+ * @param name the DB filename, RT_NULL for the databases without a profile
+ *        of their own.
+ * @param profile the profile name, RT_NULL for none.
+ * @return RT_EOK:success
+ *         -RT_EINVAL:unknown profile or the name is too long
+ *         -RT_EFULL:no room for another database
+ */
+int db_set_profile(const char *name, const char *profile)
+{
+    const struct db_profile *p = db_profile_find(profile);
+    int i, slot = -1;
+
+    if ((profile != RT_NULL && p == RT_NULL) || (name != RT_NULL && rt_strlen(name) > PKG_SQLITE_DB_NAME_MAX_LEN))
+    {
+        LOG_E("set the profile %s of %s failed.", profile ? profile : "(none)", name ? name : "(default)");
+        return -RT_EINVAL;
+    }
+    rt_mutex_take(db_pool_lock, RT_WAITING_FOREVER);
+    if (name == RT_NULL)
+    {
+        db_profile_default = p;
+    }
+    else
+    {
+        for (i = 0; i < PKG_SQLITE_PROFILE_BINDS; i++)
+        {
+            if (db_profile_bind[i].profile != RT_NULL && rt_strcmp(db_profile_bind[i].name, name) == 0)
+            {
+                slot = i;
+                break;
+            }
+            if (db_profile_bind[i].profile == RT_NULL && slot < 0)
+            {
+                slot = i;
+            }
+        }
+        if (slot < 0 && p != RT_NULL)
+        {
+            rt_mutex_release(db_pool_lock);
+            return -RT_EFULL;
+        }
+        if (slot >= 0)
+        {
+            rt_strncpy(db_profile_bind[slot].name, name, sizeof(db_profile_bind[slot].name));
+            db_profile_bind[slot].profile = p;
+        }
+    }
+    /* reopen the connections kept open with the new PRAGMAs, the database itself is the same */
+    db_profile_gen++;
+    rt_mutex_release(db_pool_lock);
+    return RT_EOK;
+}
+
+/**
+ * This function will get the PRAGMAs of a profile.
+ *
+ * @param profile the profile name.
+ * @return the PRAGMA statements, RT_NULL if there is no such profile.
+ */
+const char *db_profile_pragmas(const char *profile)
+{
+    const struct db_profile *p = db_profile_find(profile);
+
+    return p != RT_NULL ? p->pragmas : RT_NULL;
+}
+
+/**
+ * This function will print how much of the memory given to SQLite has been
+ * used at most, to tune PKG_SQLITE_HEAP_SIZE, PKG_SQLITE_PAGECACHE_SIZE and
+ * the lookaside slots.
+ *
+ * @param reset non-zero to restart the peaks from the current usage.
+ */
+void db_memory_report(int reset)
+{
+    sqlite3_int64 cur, hw;
+    char line[128];
+
+    /* rt_kprintf() has no 64-bit conversions, sqlite3_snprintf() does */
+    sqlite3_status64(SQLITE_STATUS_MEMORY_USED, &cur, &hw, reset);
+#if PKG_SQLITE_HEAP_SIZE > 0
+    sqlite3_snprintf(sizeof(line), line, "heap: %lld bytes used, peak %lld of %d", cur, hw,
+                     PKG_SQLITE_HEAP_SIZE);
+#else
+    sqlite3_snprintf(sizeof(line), line, "heap: %lld bytes used, peak %lld, system heap", cur, hw);
+#endif
+    rt_kprintf("%s\n", line);
+    sqlite3_status64(SQLITE_STATUS_MALLOC_COUNT, &cur, &hw, reset);
+    sqlite3_snprintf(sizeof(line), line, "      %lld allocations, peak %lld", cur, hw);
+    rt_kprintf("%s\n", line);
+    sqlite3_status64(SQLITE_STATUS_MALLOC_SIZE, &cur, &hw, reset);
+    sqlite3_snprintf(sizeof(line), line, "      largest request %lld bytes", hw);
+    rt_kprintf("%s\n", line);
+#if PKG_SQLITE_PAGECACHE_SIZE > 0
+    sqlite3_status64(SQLITE_STATUS_PAGECACHE_USED, &cur, &hw, reset);
+    sqlite3_snprintf(sizeof(line), line, "page cache: %lld slots used, peak %lld of %d", cur, hw,
+                     db_pagecache_slots);
+    rt_kprintf("%s\n", line);
+    sqlite3_status64(SQLITE_STATUS_PAGECACHE_OVERFLOW, &cur, &hw, reset);
+    sqlite3_snprintf(sizeof(line), line, "      %lld bytes overflowed to the heap, peak %lld", cur, hw);
+    rt_kprintf("%s\n", line);
+    sqlite3_status64(SQLITE_STATUS_PAGECACHE_SIZE, &cur, &hw, reset);
+    sqlite3_snprintf(sizeof(line), line, "      largest page %lld bytes", hw);
+    rt_kprintf("%s\n", line);
+#endif
+#if PKG_SQLITE_LOOKASIDE_COUNT > 0
+    rt_kprintf("lookaside: peak %d of %d slots, %d misses too large, %d misses full\n",
+               db_lookaside_stats.peak, PKG_SQLITE_LOOKASIDE_COUNT,
+               db_lookaside_stats.miss_size, db_lookaside_stats.miss_full);
+    if (reset)
+    {
+        rt_mutex_take(db_pool_lock, RT_WAITING_FOREVER);
+        memset(&db_lookaside_stats, 0, sizeof(db_lookaside_stats));
+        rt_mutex_release(db_pool_lock);
+    }
+#endif
+}
+
+#ifdef RT_USING_FINSH
+static void sqlpeak(int argc, char **argv)
+{
+    db_memory_report(argc >= 2 && rt_strcmp(argv[1], "reset") == 0);
+}
+MSH_CMD_EXPORT(sqlpeak, sqlite memory peak usage: sqlpeak [reset]);
+#endif
@@ -16,6 +16,35 @@
 
 #define DB_SQL_MAX_LEN PKG_SQLITE_SQL_MAX_LEN
 
+/* PRAGMAs of the connection dbhelper keeps open with PKG_SQLITE_EXCLUSIVE */
+#ifndef PKG_SQLITE_EXCLUSIVE_PRAGMAS
+#define PKG_SQLITE_EXCLUSIVE_PRAGMAS "PRAGMA locking_mode=EXCLUSIVE; PRAGMA journal_mode=PERSIST;" \
+                                     "PRAGMA journal_size_limit=65536; PRAGMA temp_store=MEMORY;"
+#endif
+
+/*
+ * PRAGMAs of the connection profiles of db_set_profile(). page_size only
+ * takes effect before the first table of a database is created, and the
+ * port maps no files, so mmap_size stays 0.
+ */
+#ifndef PKG_SQLITE_PROFILE_DURABLE
+#define PKG_SQLITE_PROFILE_DURABLE "PRAGMA page_size=4096; PRAGMA cache_size=-256; PRAGMA synchronous=FULL;" \
+                                   "PRAGMA journal_mode=DELETE; PRAGMA temp_store=FILE; PRAGMA mmap_size=0;"
+#endif
+#ifndef PKG_SQLITE_PROFILE_FAST_LOG
+#define PKG_SQLITE_PROFILE_FAST_LOG "PRAGMA page_size=4096; PRAGMA cache_size=-128; PRAGMA synchronous=NORMAL;" \
+                                    "PRAGMA journal_mode=PERSIST; PRAGMA journal_size_limit=65536;" \
+                                    "PRAGMA temp_store=MEMORY; PRAGMA mmap_size=0;"
+#endif
+#ifndef PKG_SQLITE_PROFILE_READ_MOSTLY
+#define PKG_SQLITE_PROFILE_READ_MOSTLY "PRAGMA page_size=4096; PRAGMA cache_size=-1024; PRAGMA synchronous=NORMAL;" \
+                                       "PRAGMA journal_mode=DELETE; PRAGMA temp_store=MEMORY; PRAGMA mmap_size=0;"
+#endif
+#ifndef PKG_SQLITE_PROFILE_BULK_LOAD
+#define PKG_SQLITE_PROFILE_BULK_LOAD "PRAGMA page_size=4096; PRAGMA cache_size=-2048; PRAGMA synchronous=OFF;" \
+                                     "PRAGMA journal_mode=MEMORY; PRAGMA temp_store=FILE; PRAGMA mmap_size=0;"
+#endif
+
 int db_helper_init(void);
 int db_create_database(const char *sqlstr);
 /**
@@ -74,6 +103,18 @@ int db_query_by_varpara(const char *sql, int (*create)(sqlite3_stmt *stmt, void
  */
 int db_query_count_result(const char *sql);
 
+/**
+ * This function will step a statement like sqlite3_step(). With
+ * PKG_SQLITE_SHARED_CACHE it waits for up to PKG_SQLITE_BUSY_TIMEOUT ms
+ * for another connection to unlock a table the statement needs, which the
+ * busy timeout does not do, and then gives up with SQLITE_LOCKED; callbacks
+ * should step with it.
+ *
+ * @param stmt the SQL statement.
+ * @return SQLITE_ROW, SQLITE_DONE or the error.
+ */
+int db_stmt_step(sqlite3_stmt *stmt);
+
 /**
  * This function will get the blob from the "index" colum.
  *
@@ -130,11 +171,11 @@ int db_table_is_exist(const char *tbl_name);
 int db_connect(char *name);
 
 /**
- * This function will disconnect DB
+ * This function will disconnect DB, from the thread that called db_connect().
  *
  * @param name the DB filename.
  * @return RT_EOK:success
- *         -RT_ERROR:the input name is too long
+ *         -RT_ERROR:the calling thread did not db_connect()
  */
 int db_disconnect(char *name);
 
@@ -145,4 +186,58 @@ int db_disconnect(char *name);
  *
  */
 char *db_get_name(void);
+
+/**
+ * This function will check a connection to the current database out to the
+ * calling thread. The connection is used by this thread only until it is
+ * given back, so it runs without SQLite connection mutexes. A thread that
+ * already holds one gets the same connection back.
+ *
+ * @param write non-zero if the connection will write, writers take turns
+ *        under the dbhelper lock like the db_nonquery_xxx() functions.
+ * @return the connection, RT_NULL on failure.
+ */
+sqlite3 *db_connection_take(int write);
+
+/**
+ * This function will give back a connection checked out with
+ * db_connection_take(), from the thread that took it.
+ *
+ * @param db the connection.
+ * @param write the value passed to db_connection_take().
+ */
+void db_connection_release(sqlite3 *db, int write);
+
+/**
+ * This function will select the PRAGMA profile the connections to a
+ * database are opened with. Connections dbhelper keeps open are reopened
+ * with it when next checked out.
+ *
+ * @param name the DB filename, RT_NULL for the databases without a profile
+ *        of their own, which start with PKG_SQLITE_PROFILE.
+ * @param profile "durable", "fast-log", "read-mostly" or "bulk-load".
+ *        RT_NULL drops the profile of the database, or with a RT_NULL name
+ *        opens the other databases with the SQLite defaults.
+ * @return RT_EOK:success
+ *         -RT_EINVAL:unknown profile or the name is too long
+ *         -RT_EFULL:PKG_SQLITE_PROFILE_BINDS databases have a profile already
+ */
+int db_set_profile(const char *name, const char *profile);
+
+/**
+ * This function will get the PRAGMAs of a profile.
+ *
+ * @param profile the profile name.
+ * @return the PRAGMA statements, RT_NULL if there is no such profile.
+ */
+const char *db_profile_pragmas(const char *profile);
+
+/**
+ * This function will print how much of the memory given to SQLite has been
+ * used at most, to tune PKG_SQLITE_HEAP_SIZE, PKG_SQLITE_PAGECACHE_SIZE and
+ * the lookaside slots.
+ *
+ * @param reset non-zero to restart the peaks from the current usage.
+ */
+void db_memory_report(int reset);
 #endif
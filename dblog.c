@@ -0,0 +1,1580 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2026-10-19     RT-Thread    first version
+ */
+
+#include <rtthread.h>
+#include <string.h>
+#include "sqlite3.h"
+#include "rtthread_vfs.h"
+#include "dblog.h"
+
+#define DBG_ENABLE
+#define DBG_SECTION_NAME "app.dblog"
+#define DBG_LEVEL DBG_INFO
+#define DBG_COLOR
+#include <rtdbg.h>
+
+/* bytes of one log segment, raised for large pages to hold at least 8 of them */
+#ifndef PKG_SQLITE_LOGFS_SEGMENT
+#define PKG_SQLITE_LOGFS_SEGMENT 65536
+#endif
+
+/* log space in percent of the live pages above which the cleaner runs */
+#ifndef PKG_SQLITE_LOGFS_SPACE
+#define PKG_SQLITE_LOGFS_SPACE 300
+#endif
+
+#ifndef PKG_SQLITE_LOGFS_GC_PRIORITY
+#define PKG_SQLITE_LOGFS_GC_PRIORITY (RT_THREAD_PRIORITY_MAX - 2)
+#endif
+
+#ifndef PKG_SQLITE_LOGFS_GC_STACK
+#define PKG_SQLITE_LOGFS_GC_STACK 2048
+#endif
+
+/*
+ * A VFS over the rt-thread one that never overwrites a page of a main
+ * database file. The file is a set of fixed size segments, each starting
+ * with a header carrying a sequence number; the log is the used segments in
+ * sequence order, and records are only ever appended to its head:
+ *
+ *     page record     header (txn, pgno, page checksum) + page
+ *     commit record   header (txn, database pages, page records in txn)
+ *
+ * A page table in RAM maps each page to its last committed record. xSync()
+ * appends one commit record and syncs once, which makes the transaction
+ * durable: opening replays the log, applies the pages of a transaction only
+ * when its commit record follows them, and drops a transaction that lost
+ * the race with a crash. The pages of the last commit are read back and
+ * checked, and the commit is dropped when one of them is torn. Record
+ * headers include the sequence number of their segment, which tells them
+ * from the leftovers of a previous use of that segment.
+ *
+ * With synchronous=OFF SQLite never calls xSync(). The transaction is then
+ * committed without a sync when its write lock is dropped, but only once
+ * SQLITE_FCNTL_SYNC has told that SQLite is committing it; a transaction
+ * given up without that, e.g. after an I/O error, is discarded instead.
+ * Commits that were never synced may be lost or torn by a power loss.
+ *
+ * A transaction is atomic on its own, so the rollback journals of these
+ * databases never have to reach flash and are kept in RAM.
+ *
+ * The cleaner reclaims the oldest segment by appending its live pages to
+ * the head under a cleaner commit record, which commits only those copies.
+ * Always cleaning the oldest one first keeps every commit record needed by
+ * a live page in the log. It runs in a background thread once the log
+ * outgrows PKG_SQLITE_LOGFS_SPACE percent of the live pages, and in the
+ * writer itself past twice that, when the thread cannot keep up.
+ *
+ * The thread copies one page at a time and lets writers in between. A
+ * SQLite commit in the middle of such a run gives it up: replay drops
+ * whatever is pending at a SQLite commit, so the copies made so far are
+ * left behind uncommitted and the run starts over.
+ */
+#define LVFS_SEG_MAGIC          0x534c5452      /* "RTLS" */
+#define LVFS_REC_MAGIC          0x524c5452      /* "RTLR" */
+#define LVFS_SEG_HEADER         32
+#define LVFS_PAGE               1
+#define LVFS_COMMIT             2
+#define LVFS_GC_COMMIT          3
+#define LVFS_MAX_PAGE_SIZE      32768
+
+struct lvfs_seg_header
+{
+    rt_uint32_t magic;
+    rt_uint32_t seq;
+    rt_uint32_t page_size;
+    rt_uint32_t seg_size;
+    rt_uint32_t sum;
+};
+
+struct lvfs_rec
+{
+    rt_uint32_t magic;
+    rt_uint32_t type;
+    rt_uint32_t txn;
+    rt_uint32_t arg;                /* page: page number, commit: database pages */
+    rt_uint32_t data;               /* page: page checksum, commits: page records */
+    rt_uint32_t sum;                /* of the above and the segment sequence */
+};
+
+struct lvfs_seg
+{
+    rt_uint32_t seq;
+    rt_uint32_t live;               /* committed pages stored in it */
+    int used;                       /* part of the log */
+};
+
+/* a page record of a transaction being replayed or cleaned */
+struct lvfs_pend
+{
+    rt_uint32_t txn;
+    rt_uint32_t pgno;
+    rt_uint32_t pos;
+    rt_uint32_t sum;
+};
+
+/* state of one database file, shared by all of its handles */
+struct lvfs_shared
+{
+    struct lvfs_shared *next;
+    int refs;
+    char *path;
+    sqlite3_mutex *mutex;
+    sqlite3_file *data;             /* log I/O, also used by the cleaner */
+    int gc;                         /* wants cleaning, under lvfs_mutex */
+
+    rt_uint32_t page_size;          /* 0 until the file is created */
+    rt_uint32_t seg_size;
+    rt_uint32_t rec_size;           /* page record with its page */
+    struct lvfs_seg *segs;
+    rt_uint32_t nsegs;
+    rt_uint32_t head;               /* segment appended to */
+    rt_uint32_t head_off;
+    rt_uint32_t next_seq;
+    rt_uint32_t next_txn;
+
+    rt_uint32_t *map;               /* per page: file offset of the committed page, 0 for none */
+    rt_uint32_t *cur;               /* the same including the open transaction */
+    rt_uint32_t cap;                /* entries of map[] and cur[] */
+    rt_uint32_t npages;             /* committed database pages */
+    rt_uint32_t cur_npages;
+    rt_uint32_t live;               /* committed pages in the log */
+
+    rt_uint32_t txn;                /* open transaction, 0 for none */
+    int txn_done;                   /* SQLite is committing it, see SQLITE_FCNTL_SYNC */
+    rt_uint32_t txn_seq;            /* segment it started in */
+    rt_uint32_t txn_records;
+    rt_uint32_t *dirty;             /* pages changed by the open transaction */
+    rt_uint32_t ndirty;
+    rt_uint32_t max_dirty;
+
+    rt_uint8_t *rec;                /* one page record */
+    rt_uint8_t *page;               /* one page, for partial I/O */
+    rt_uint32_t page_no;            /* page held in page[] plus one, 0 for none */
+
+    rt_uint32_t gc_txn;             /* cleaner run in progress, 0 for none */
+    rt_uint32_t gc_tail;            /* segment it reclaims */
+    rt_uint32_t gc_off;             /* next record of that segment */
+    struct lvfs_pend *gc_moved;     /* copies made so far */
+    rt_uint32_t gc_nmoved;
+    rt_uint32_t gc_max_moved;
+};
+
+struct lvfs_file
+{
+    sqlite3_file base;
+    struct lvfs_shared *sh;
+    sqlite3_file *real;             /* for locking */
+    int lock;                       /* SQLITE_LOCK_xxx held by this handle */
+};
+
+#define LVFS_FILE_SIZE  RT_ALIGN(sizeof(struct lvfs_file), 8)
+
+static sqlite3_vfs lvfs_vfs;
+static sqlite3_io_methods lvfs_io_methods;
+static sqlite3_mutex *lvfs_mutex;
+static struct lvfs_shared *lvfs_list;
+static struct db_log_stats lvfs_stats;
+static rt_sem_t lvfs_gc_sem;
+
+static rt_uint32_t lvfs_sum(const void *buf, int len, rt_uint32_t seed)
+{
+    const rt_uint8_t *p = buf;
+    rt_uint32_t h = 2166136261U ^ seed;
+
+    while (len-- > 0)
+    {
+        h = (h ^ *p++) * 16777619U;
+    }
+    return h;
+}
+
+/* checksum of a whole page, by words as it runs on every page written */
+static rt_uint32_t lvfs_page_sum(const rt_uint8_t *page, rt_uint32_t size)
+{
+    rt_uint32_t a = 1, b = 0, w, i;
+
+    for (i = 0; i < size; i += sizeof(w))
+    {
+        memcpy(&w, page + i, sizeof(w));
+        a += w;
+        b += a;
+    }
+    return a ^ (b << 16 | b >> 16);
+}
+
+static int lvfs_read(struct lvfs_shared *sh, void *buf, int amt, rt_uint32_t pos)
+{
+    return sh->data->pMethods->xRead(sh->data, buf, amt, pos);
+}
+
+static int lvfs_write(struct lvfs_shared *sh, const void *buf, int amt, rt_uint32_t pos)
+{
+    return sh->data->pMethods->xWrite(sh->data, buf, amt, pos);
+}
+
+/* read the record at pos of segment seg, 0 if there is no valid one */
+static int lvfs_read_rec(struct lvfs_shared *sh, rt_uint32_t seg, rt_uint32_t off, struct lvfs_rec *rec)
+{
+    int rc;
+
+    if (off + sizeof(*rec) > sh->seg_size)
+    {
+        return 0;
+    }
+    rc = lvfs_read(sh, rec, sizeof(*rec), seg * sh->seg_size + off);
+    return rc == SQLITE_OK && rec->magic == LVFS_REC_MAGIC
+           && rec->sum == lvfs_sum(rec, sizeof(*rec) - sizeof(rec->sum), sh->segs[seg].seq)
+           && (rec->type == LVFS_COMMIT || rec->type == LVFS_GC_COMMIT
+               || (rec->type == LVFS_PAGE && off + sh->rec_size <= sh->seg_size));
+}
+
+static int lvfs_grow_map(struct lvfs_shared *sh, rt_uint32_t pages)
+{
+    rt_uint32_t more, *map, *cur;
+
+    if (pages <= sh->cap)
+    {
+        return SQLITE_OK;
+    }
+    more = pages + 64;
+    map = sqlite3_realloc(sh->map, more * sizeof(rt_uint32_t));
+    if (map == RT_NULL)
+    {
+        return SQLITE_NOMEM;
+    }
+    sh->map = map;
+    cur = sqlite3_realloc(sh->cur, more * sizeof(rt_uint32_t));
+    if (cur == RT_NULL)
+    {
+        return SQLITE_NOMEM;
+    }
+    sh->cur = cur;
+    memset(map + sh->cap, 0, (more - sh->cap) * sizeof(rt_uint32_t));
+    memset(cur + sh->cap, 0, (more - sh->cap) * sizeof(rt_uint32_t));
+    sh->cap = more;
+    return SQLITE_OK;
+}
+
+static int lvfs_grow_segs(struct lvfs_shared *sh, rt_uint32_t nsegs)
+{
+    struct lvfs_seg *segs;
+
+    segs = sqlite3_realloc(sh->segs, nsegs * sizeof(struct lvfs_seg));
+    if (segs == RT_NULL)
+    {
+        return SQLITE_NOMEM;
+    }
+    memset(segs + sh->nsegs, 0, (nsegs - sh->nsegs) * sizeof(struct lvfs_seg));
+    sh->segs = segs;
+    sh->nsegs = nsegs;
+    return SQLITE_OK;
+}
+
+/* sizes and buffers once the page size is known */
+static int lvfs_setup(struct lvfs_shared *sh, rt_uint32_t page_size, rt_uint32_t seg_size)
+{
+    sh->page_size = page_size;
+    sh->rec_size = sizeof(struct lvfs_rec) + page_size;
+    sh->seg_size = seg_size;
+    if (sh->seg_size == 0)
+    {
+        sh->seg_size = PKG_SQLITE_LOGFS_SEGMENT;
+        while (sh->seg_size < LVFS_SEG_HEADER + 8 * sh->rec_size)
+        {
+            sh->seg_size <<= 1;
+        }
+    }
+    sh->rec = sqlite3_malloc(sh->rec_size);
+    sh->page = sqlite3_malloc(page_size);
+    if (sh->rec == RT_NULL || sh->page == RT_NULL)
+    {
+        sh->page_size = 0;
+        return SQLITE_NOMEM;
+    }
+    return SQLITE_OK;
+}
+
+/* start a new head segment, reusing a reclaimed one before growing the file */
+static int lvfs_new_segment(struct lvfs_shared *sh)
+{
+    struct lvfs_seg_header hdr;
+    rt_uint32_t i;
+    int rc;
+
+    for (i = 0; i < sh->nsegs && sh->segs[i].used; i++)
+        ;
+    if (i == sh->nsegs && (rc = lvfs_grow_segs(sh, sh->nsegs + 1)) != SQLITE_OK)
+    {
+        return rc;
+    }
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = LVFS_SEG_MAGIC;
+    hdr.seq = sh->next_seq;
+    hdr.page_size = sh->page_size;
+    hdr.seg_size = sh->seg_size;
+    hdr.sum = lvfs_sum(&hdr, sizeof(hdr) - sizeof(hdr.sum), 0);
+    rc = lvfs_write(sh, &hdr, sizeof(hdr), i * sh->seg_size);
+    if (rc != SQLITE_OK)
+    {
+        return rc;
+    }
+
+    sh->segs[i].seq = sh->next_seq++;
+    sh->segs[i].live = 0;
+    sh->segs[i].used = 1;
+    sh->head = i;
+    sh->head_off = LVFS_SEG_HEADER;
+
+    sqlite3_mutex_enter(lvfs_mutex);
+    lvfs_stats.log_bytes += sizeof(hdr);
+    sqlite3_mutex_leave(lvfs_mutex);
+    return SQLITE_OK;
+}
+
+/* append a record to the head; for a page record, returns the file offset of the page */
+static int lvfs_append(struct lvfs_shared *sh, struct lvfs_rec *rec, const rt_uint8_t *page, rt_uint32_t *pos)
+{
+    rt_uint32_t size = page ? sh->rec_size : sizeof(*rec);
+    int rc;
+
+    if (sh->head_off + size > sh->seg_size)
+    {
+        rc = lvfs_new_segment(sh);
+        if (rc != SQLITE_OK)
+        {
+            return rc;
+        }
+    }
+
+    rec->magic = LVFS_REC_MAGIC;
+    if (page)
+    {
+        rec->data = lvfs_page_sum(page, sh->page_size);
+        memcpy(sh->rec + sizeof(*rec), page, sh->page_size);
+    }
+    rec->sum = lvfs_sum(rec, sizeof(*rec) - sizeof(rec->sum), sh->segs[sh->head].seq);
+    memcpy(sh->rec, rec, sizeof(*rec));
+
+    rc = lvfs_write(sh, sh->rec, size, sh->head * sh->seg_size + sh->head_off);
+    if (rc != SQLITE_OK)
+    {
+        return rc;
+    }
+    if (pos)
+    {
+        *pos = sh->head * sh->seg_size + sh->head_off + sizeof(*rec);
+    }
+    sh->head_off += size;
+
+    sqlite3_mutex_enter(lvfs_mutex);
+    lvfs_stats.log_bytes += size;
+    sqlite3_mutex_leave(lvfs_mutex);
+    return SQLITE_OK;
+}
+
+static int lvfs_pend_push(struct lvfs_pend **list, rt_uint32_t *n, rt_uint32_t *max,
+                          rt_uint32_t txn, rt_uint32_t pgno, rt_uint32_t pos, rt_uint32_t sum)
+{
+    if (*n == *max)
+    {
+        rt_uint32_t more = *max ? *max * 2 : 32;
+        struct lvfs_pend *p = sqlite3_realloc(*list, more * sizeof(struct lvfs_pend));
+        if (p == RT_NULL)
+        {
+            return SQLITE_NOMEM;
+        }
+        *list = p;
+        *max = more;
+    }
+    (*list)[*n].txn = txn;
+    (*list)[*n].pgno = pgno;
+    (*list)[*n].pos = pos;
+    (*list)[*n].sum = sum;
+    (*n)++;
+    return SQLITE_OK;
+}
+
+/* change cur[pgno] in the open transaction */
+static int lvfs_set(struct lvfs_shared *sh, rt_uint32_t pgno, rt_uint32_t pos)
+{
+    if (sh->cur[pgno] == sh->map[pgno])
+    {
+        if (sh->ndirty == sh->max_dirty)
+        {
+            rt_uint32_t more = sh->max_dirty ? sh->max_dirty * 2 : 32;
+            rt_uint32_t *dirty = sqlite3_realloc(sh->dirty, more * sizeof(rt_uint32_t));
+            if (dirty == RT_NULL)
+            {
+                return SQLITE_NOMEM;
+            }
+            sh->dirty = dirty;
+            sh->max_dirty = more;
+        }
+        sh->dirty[sh->ndirty++] = pgno;
+    }
+    sh->cur[pgno] = pos;
+    return SQLITE_OK;
+}
+
+static void lvfs_begin(struct lvfs_shared *sh)
+{
+    if (sh->txn == 0)
+    {
+        sh->txn = sh->next_txn++;
+        sh->txn_seq = sh->segs[sh->head].seq;
+        sh->txn_records = 0;
+        sh->txn_done = 0;
+        sh->ndirty = 0;
+    }
+}
+
+static int lvfs_put_page(struct lvfs_shared *sh, rt_uint32_t pgno, const rt_uint8_t *data)
+{
+    struct lvfs_rec rec;
+    rt_uint32_t pos;
+    int rc;
+
+    rc = lvfs_grow_map(sh, pgno + 1);
+    if (rc != SQLITE_OK)
+    {
+        return rc;
+    }
+    lvfs_begin(sh);
+
+    rec.type = LVFS_PAGE;
+    rec.txn = sh->txn;
+    rec.arg = pgno;
+    rc = lvfs_append(sh, &rec, data, &pos);
+    if (rc == SQLITE_OK)
+    {
+        rc = lvfs_set(sh, pgno, pos);
+    }
+    if (rc != SQLITE_OK)
+    {
+        return rc;
+    }
+
+    sh->txn_records++;
+    if (pgno >= sh->cur_npages)
+    {
+        sh->cur_npages = pgno + 1;
+    }
+    if (sh->page_no == pgno + 1 && data != sh->page)
+    {
+        sh->page_no = 0;
+    }
+    return SQLITE_OK;
+}
+
+/* whether the log takes more than percent of the space of the live pages */
+static int lvfs_gc_needed(struct lvfs_shared *sh, int percent)
+{
+    rt_uint32_t i, used = 0, per_seg;
+
+    for (i = 0; i < sh->nsegs; i++)
+    {
+        used += sh->segs[i].used;
+    }
+    per_seg = (sh->seg_size - LVFS_SEG_HEADER) / sh->rec_size;
+    return used > 2 && (sqlite3_int64)(used - 1) * per_seg * 100 > (sqlite3_int64)sh->live * percent;
+}
+
+/* move a committed page from one file offset to another */
+static void lvfs_move(struct lvfs_shared *sh, rt_uint32_t pgno, rt_uint32_t pos)
+{
+    if (sh->map[pgno])
+    {
+        sh->segs[sh->map[pgno] / sh->seg_size].live--;
+        sh->live--;
+    }
+    if (pos)
+    {
+        sh->segs[pos / sh->seg_size].live++;
+        sh->live++;
+    }
+    sh->map[pgno] = pos;
+}
+
+/*
+ * Commit the open transaction with one commit record, see the top of the
+ * file. With sync_flags 0 the record is appended without syncing, as
+ * SQLite does with synchronous=OFF.
+ */
+static int lvfs_commit(struct lvfs_shared *sh, int sync_flags)
+{
+    struct lvfs_rec rec;
+    rt_uint32_t i;
+    int rc;
+
+    rec.type = LVFS_COMMIT;
+    rec.txn = sh->txn;
+    rec.arg = sh->cur_npages;
+    rec.data = sh->txn_records;
+    rc = lvfs_append(sh, &rec, RT_NULL, RT_NULL);
+    if (rc == SQLITE_OK)
+    {
+        /* replay drops the copies of a cleaner run before this record */
+        sh->gc_txn = 0;
+    }
+    if (rc == SQLITE_OK && sync_flags)
+    {
+        rc = sh->data->pMethods->xSync(sh->data, sync_flags);
+    }
+    if (rc != SQLITE_OK)
+    {
+        return rc;
+    }
+
+    for (i = 0; i < sh->ndirty; i++)
+    {
+        lvfs_move(sh, sh->dirty[i], sh->cur[sh->dirty[i]]);
+    }
+    sh->npages = sh->cur_npages;
+    sh->txn = 0;
+    sh->ndirty = 0;
+    return SQLITE_OK;
+}
+
+/*
+ * Give up the open transaction. Its page records stay in the log without a
+ * commit record, which replay drops.
+ */
+static void lvfs_discard(struct lvfs_shared *sh)
+{
+    rt_uint32_t i;
+
+    for (i = 0; i < sh->ndirty; i++)
+    {
+        sh->cur[sh->dirty[i]] = sh->map[sh->dirty[i]];
+    }
+    sh->cur_npages = sh->npages;
+    sh->page_no = 0;
+    sh->txn = 0;
+    sh->ndirty = 0;
+}
+
+/* called by the writer when it drops its write lock, with sh->mutex held */
+static int lvfs_end(struct lvfs_shared *sh)
+{
+    int rc = SQLITE_OK;
+
+    if (sh->txn && sh->txn_done)
+    {
+        rc = lvfs_commit(sh, 0);
+        if (rc == SQLITE_OK)
+        {
+            sqlite3_mutex_enter(lvfs_mutex);
+            lvfs_stats.commits++;
+            sqlite3_mutex_leave(lvfs_mutex);
+        }
+    }
+    if (sh->txn)
+    {
+        lvfs_discard(sh);
+    }
+    return rc;
+}
+
+/*
+ * Reclaim the oldest segment: append its live pages to the head and commit
+ * them durably with a cleaner commit record before the segment may be
+ * reused. A cleaner commit applies only its own pages, so it may come in
+ * the middle of a SQLite transaction; that transaction's segments are left
+ * alone, as its commit record will need them.
+ *
+ * At most max_pages pages are copied per call, the run goes on in the next
+ * call. Returns SQLITE_OK once it made progress, SQLITE_DONE when there is
+ * no segment to reclaim.
+ */
+static int lvfs_clean_step(struct lvfs_shared *sh, rt_uint32_t max_pages)
+{
+    struct lvfs_rec rec;
+    rt_uint32_t i, tail = sh->nsegs, copied = 0;
+    int rc = SQLITE_OK;
+
+    if (sh->gc_txn == 0)
+    {
+        for (i = 0; i < sh->nsegs; i++)
+        {
+            if (sh->segs[i].used && i != sh->head && (sh->txn == 0 || sh->segs[i].seq < sh->txn_seq)
+                && (tail == sh->nsegs || sh->segs[i].seq < sh->segs[tail].seq))
+            {
+                tail = i;
+            }
+        }
+        if (tail == sh->nsegs)
+        {
+            return SQLITE_DONE;
+        }
+        sh->gc_txn = sh->next_txn++;
+        sh->gc_tail = tail;
+        sh->gc_off = LVFS_SEG_HEADER;
+        sh->gc_nmoved = 0;
+    }
+    tail = sh->gc_tail;
+
+    sh->page_no = 0;
+    while (rc == SQLITE_OK && copied < max_pages && sh->gc_nmoved < sh->segs[tail].live
+           && lvfs_read_rec(sh, tail, sh->gc_off, &rec))
+    {
+        rt_uint32_t pos = tail * sh->seg_size + sh->gc_off + sizeof(rec);
+
+        if (rec.type != LVFS_PAGE)
+        {
+            sh->gc_off += sizeof(rec);
+            continue;
+        }
+        if (rec.arg < sh->npages && sh->map[rec.arg] == pos)
+        {
+            rc = lvfs_read(sh, sh->page, sh->page_size, pos);
+            if (rc == SQLITE_OK)
+            {
+                rec.txn = sh->gc_txn;
+                rc = lvfs_append(sh, &rec, sh->page, &pos);
+            }
+            if (rc == SQLITE_OK)
+            {
+                rc = lvfs_pend_push(&sh->gc_moved, &sh->gc_nmoved, &sh->gc_max_moved, sh->gc_txn, rec.arg, pos, 0);
+            }
+            copied++;
+        }
+        sh->gc_off += sh->rec_size;
+    }
+
+    if (rc == SQLITE_OK && sh->gc_nmoved != sh->segs[tail].live)
+    {
+        if (copied == max_pages)
+        {
+            return SQLITE_OK;
+        }
+        rc = SQLITE_CORRUPT;
+    }
+    if (rc == SQLITE_OK)
+    {
+        rec.type = LVFS_GC_COMMIT;
+        rec.txn = sh->gc_txn;
+        rec.arg = sh->npages;
+        rec.data = sh->gc_nmoved;
+        rc = lvfs_append(sh, &rec, RT_NULL, RT_NULL);
+        if (rc == SQLITE_OK)
+        {
+            rc = sh->data->pMethods->xSync(sh->data, SQLITE_SYNC_NORMAL);
+        }
+    }
+
+    /* on failure the copies are left behind without a commit, nothing refers to them */
+    sh->gc_txn = 0;
+    if (rc != SQLITE_OK)
+    {
+        return rc;
+    }
+    for (i = 0; i < sh->gc_nmoved; i++)
+    {
+        struct lvfs_pend *m = &sh->gc_moved[i];
+
+        if (sh->cur[m->pgno] == sh->map[m->pgno])
+        {
+            sh->cur[m->pgno] = m->pos;
+        }
+        lvfs_move(sh, m->pgno, m->pos);
+    }
+    sh->segs[tail].used = 0;
+
+    sqlite3_mutex_enter(lvfs_mutex);
+    lvfs_stats.gc_runs++;
+    lvfs_stats.gc_pages += sh->gc_nmoved;
+    sqlite3_mutex_leave(lvfs_mutex);
+    return SQLITE_OK;
+}
+
+/* reclaim a segment in one go, finishing a run the thread started */
+static int lvfs_clean(struct lvfs_shared *sh)
+{
+    return lvfs_clean_step(sh, (rt_uint32_t)-1);
+}
+
+/* called with sh->mutex held */
+static void lvfs_gc_wakeup(struct lvfs_shared *sh)
+{
+    sqlite3_mutex_enter(lvfs_mutex);
+    sh->gc = 1;
+    sqlite3_mutex_leave(lvfs_mutex);
+    rt_sem_release(lvfs_gc_sem);
+}
+
+/*
+ * Create a new log on its first write. SQLite writes page 1 first, so the
+ * size of that write is the page size.
+ */
+static int lvfs_create(struct lvfs_shared *sh, int amt, sqlite3_int64 ofst)
+{
+    rt_uint32_t page_size = 4096;
+    int rc;
+
+    if (ofst == 0 && amt >= 512 && amt <= LVFS_MAX_PAGE_SIZE && (amt & (amt - 1)) == 0)
+    {
+        page_size = amt;
+    }
+    rc = lvfs_setup(sh, page_size, 0);
+    if (rc != SQLITE_OK)
+    {
+        return rc;
+    }
+    sh->next_seq = 1;
+    sh->next_txn = 1;
+    return lvfs_new_segment(sh);
+}
+
+/*
+ * Replay the log of an existing file into the page table. Each commit is
+ * applied with an undo list, so the last one can be undone when one of its
+ * pages does not match its checksum. Returns SQLITE_NOTADB for a file in
+ * another format.
+ */
+static int lvfs_load(struct lvfs_shared *sh)
+{
+    static const char plain[] = "SQLite format 3";
+    struct lvfs_seg_header hdr;
+    struct lvfs_pend *pend = RT_NULL, *last = RT_NULL, *undo = RT_NULL;
+    rt_uint32_t npend = 0, max_pend = 0, nlast = 0, max_last = 0, nundo = 0, max_undo = 0, undo_npages = 0;
+    rt_uint32_t *order = RT_NULL, nused = 0, last_commit = 0, i, j, n;
+    int torn = 0;
+    sqlite3_int64 size;
+    int rc;
+
+    rc = sh->data->pMethods->xFileSize(sh->data, &size);
+    if (rc != SQLITE_OK || size == 0)
+    {
+        return rc;
+    }
+
+    rc = lvfs_read(sh, &hdr, sizeof(hdr), 0);
+    if (rc == SQLITE_OK && memcmp(&hdr, plain, sizeof(plain)) == 0)
+    {
+        return SQLITE_NOTADB;
+    }
+    if (rc != SQLITE_OK || hdr.magic != LVFS_SEG_MAGIC || hdr.sum != lvfs_sum(&hdr, sizeof(hdr) - sizeof(hdr.sum), 0)
+        || hdr.page_size < 512 || hdr.page_size > LVFS_MAX_PAGE_SIZE || hdr.seg_size < LVFS_SEG_HEADER + hdr.page_size)
+    {
+        return rc == SQLITE_IOERR_SHORT_READ || rc == SQLITE_OK ? SQLITE_CORRUPT : rc;
+    }
+    rc = lvfs_setup(sh, hdr.page_size, hdr.seg_size);
+    if (rc == SQLITE_OK)
+    {
+        rc = lvfs_grow_segs(sh, (rt_uint32_t)((size + sh->seg_size - 1) / sh->seg_size));
+    }
+    order = rc == SQLITE_OK ? sqlite3_malloc(sh->nsegs * sizeof(rt_uint32_t)) : RT_NULL;
+    if (order == RT_NULL)
+    {
+        return SQLITE_NOMEM;
+    }
+    sh->next_seq = 1;
+    sh->next_txn = 1;
+
+    /* the log is every segment with a valid header, oldest first */
+    for (i = 0; i < sh->nsegs; i++)
+    {
+        if (lvfs_read(sh, &hdr, sizeof(hdr), i * sh->seg_size) != SQLITE_OK || hdr.magic != LVFS_SEG_MAGIC
+            || hdr.sum != lvfs_sum(&hdr, sizeof(hdr) - sizeof(hdr.sum), 0))
+        {
+            continue;
+        }
+        sh->segs[i].seq = hdr.seq;
+        sh->segs[i].used = 1;
+        if (hdr.seq >= sh->next_seq)
+        {
+            sh->next_seq = hdr.seq + 1;
+        }
+        for (j = nused; j > 0 && sh->segs[order[j - 1]].seq > hdr.seq; j--)
+        {
+            order[j] = order[j - 1];
+        }
+        order[j] = i;
+        nused++;
+    }
+
+    for (i = 0; rc == SQLITE_OK && i < nused; i++)
+    {
+        rt_uint32_t seg = order[i], off = LVFS_SEG_HEADER;
+        struct lvfs_rec rec;
+
+        while (rc == SQLITE_OK && lvfs_read_rec(sh, seg, off, &rec))
+        {
+            if (rec.txn >= sh->next_txn)
+            {
+                sh->next_txn = rec.txn + 1;
+            }
+            if (rec.type == LVFS_PAGE)
+            {
+                rc = lvfs_pend_push(&pend, &npend, &max_pend, rec.txn, rec.arg,
+                                    seg * sh->seg_size + off + sizeof(rec), rec.data);
+                off += sh->rec_size;
+                continue;
+            }
+
+            /*
+             * Take the pages of the committed transaction out of pend[]. Only
+             * cleaner copies come in the middle of a SQLite transaction, so
+             * what is left at a SQLite commit never committed and is dropped.
+             */
+            nlast = 0;
+            for (j = 0, n = 0; rc == SQLITE_OK && j < npend; j++)
+            {
+                if (pend[j].txn == rec.txn)
+                {
+                    rc = lvfs_pend_push(&last, &nlast, &max_last, pend[j].txn, pend[j].pgno, pend[j].pos, pend[j].sum);
+                }
+                else
+                {
+                    pend[n++] = pend[j];
+                }
+            }
+            npend = rec.type == LVFS_COMMIT ? 0 : n;
+
+            /* every commit is applied, the last one is checked below */
+            nundo = 0;
+            undo_npages = sh->npages;
+            if (rc == SQLITE_OK)
+            {
+                rc = lvfs_grow_map(sh, rec.arg);
+            }
+            for (j = 0; rc == SQLITE_OK && j < nlast; j++)
+            {
+                rc = lvfs_grow_map(sh, last[j].pgno + 1);
+                if (rc == SQLITE_OK)
+                {
+                    rc = lvfs_pend_push(&undo, &nundo, &max_undo, 0, last[j].pgno, sh->map[last[j].pgno], 0);
+                    sh->map[last[j].pgno] = last[j].pos;
+                }
+            }
+            for (j = rec.arg; rc == SQLITE_OK && j < sh->npages; j++)
+            {
+                rc = lvfs_pend_push(&undo, &nundo, &max_undo, 0, j, sh->map[j], 0);
+                sh->map[j] = 0;
+            }
+            sh->npages = rec.arg;
+            last_commit = seg * sh->seg_size + off;
+            torn = rec.data != nlast;
+            off += sizeof(rec);
+        }
+
+        if (i == nused - 1)
+        {
+            sh->head = seg;
+            sh->head_off = off;
+        }
+    }
+
+    /*
+     * last[] holds the pages of the last commit, undo[] how to take it back.
+     * Earlier commits may miss page records reclaimed by the cleaner after
+     * copying them, but a reclaim always ends with a commit of its own, so
+     * the last commit has all of its records unless it is torn.
+     */
+    for (i = 0; rc == SQLITE_OK && last_commit && !torn && i < nlast; i++)
+    {
+        rc = lvfs_read(sh, sh->page, sh->page_size, last[i].pos);
+        torn = rc == SQLITE_IOERR_SHORT_READ || (rc == SQLITE_OK && lvfs_page_sum(sh->page, sh->page_size) != last[i].sum);
+        rc = rc == SQLITE_IOERR_SHORT_READ ? SQLITE_OK : rc;
+    }
+    if (rc == SQLITE_OK && last_commit && torn)
+    {
+        struct lvfs_rec zero;
+
+        LOG_E("%s: the last commit is torn, rolled back", sh->path);
+        for (j = nundo; j > 0; j--)
+        {
+            sh->map[undo[j - 1].pgno] = undo[j - 1].pos;
+        }
+        sh->npages = undo_npages;
+        memset(&zero, 0, sizeof(zero));
+        rc = lvfs_write(sh, &zero, sizeof(zero), last_commit);
+        if (rc == SQLITE_OK)
+        {
+            rc = sh->data->pMethods->xSync(sh->data, SQLITE_SYNC_NORMAL);
+        }
+        /* replay stops at the cleared record, so append from there */
+        if (last_commit / sh->seg_size == sh->head)
+        {
+            sh->head_off = last_commit % sh->seg_size;
+        }
+    }
+
+    for (i = 0; rc == SQLITE_OK && i < sh->npages; i++)
+    {
+        if (sh->map[i])
+        {
+            sh->segs[sh->map[i] / sh->seg_size].live++;
+            sh->live++;
+        }
+    }
+    if (rc == SQLITE_OK && sh->cap)
+    {
+        memcpy(sh->cur, sh->map, sh->cap * sizeof(rt_uint32_t));
+    }
+    if (rc == SQLITE_OK)
+    {
+        sh->cur_npages = sh->npages;
+        if (nused == 0)
+        {
+            rc = lvfs_new_segment(sh);
+        }
+    }
+
+    sqlite3_free(order);
+    sqlite3_free(pend);
+    sqlite3_free(last);
+    sqlite3_free(undo);
+    return rc;
+}
+
+/* load page pgno into buf, zeros for a page never written */
+static int lvfs_get_page(struct lvfs_shared *sh, rt_uint32_t pgno, rt_uint8_t *buf)
+{
+    int rc;
+
+    if (sh->page_no == pgno + 1)
+    {
+        if (buf != sh->page)
+        {
+            memcpy(buf, sh->page, sh->page_size);
+        }
+        return SQLITE_OK;
+    }
+    if (pgno >= sh->cur_npages || sh->cur[pgno] == 0)
+    {
+        memset(buf, 0, sh->page_size);
+        return SQLITE_OK;
+    }
+    rc = lvfs_read(sh, buf, sh->page_size, sh->cur[pgno]);
+    return rc == SQLITE_IOERR_SHORT_READ ? SQLITE_CORRUPT : rc;
+}
+
+static int lvfs_io_read(sqlite3_file *f, void *buf, int amt, sqlite3_int64 ofst)
+{
+    struct lvfs_file *p = (struct lvfs_file *)f;
+    struct lvfs_shared *sh = p->sh;
+    rt_uint8_t *out = buf;
+    int rc = SQLITE_OK;
+
+    sqlite3_mutex_enter(sh->mutex);
+    while (rc == SQLITE_OK && amt > 0 && sh->page_size && ofst < (sqlite3_int64)sh->cur_npages * sh->page_size)
+    {
+        rt_uint32_t pgno = (rt_uint32_t)(ofst / sh->page_size);
+        int off = (int)(ofst % sh->page_size);
+        int n = (int)sh->page_size - off < amt ? (int)sh->page_size - off : amt;
+
+        if (n == (int)sh->page_size)
+        {
+            rc = lvfs_get_page(sh, pgno, out);
+        }
+        else
+        {
+            rc = lvfs_get_page(sh, pgno, sh->page);
+            sh->page_no = rc == SQLITE_OK ? pgno + 1 : 0;
+            memcpy(out, sh->page + off, n);
+        }
+        out += n;
+        ofst += n;
+        amt -= n;
+    }
+    sqlite3_mutex_leave(sh->mutex);
+
+    if (rc == SQLITE_OK && amt > 0)
+    {
+        memset(out, 0, amt);
+        rc = SQLITE_IOERR_SHORT_READ;
+    }
+    return rc;
+}
+
+static int lvfs_io_write(sqlite3_file *f, const void *buf, int amt, sqlite3_int64 ofst)
+{
+    struct lvfs_file *p = (struct lvfs_file *)f;
+    struct lvfs_shared *sh = p->sh;
+    const rt_uint8_t *in = buf;
+    rt_uint32_t pages = 0;
+    int rc = SQLITE_OK;
+
+    sqlite3_mutex_enter(sh->mutex);
+    if (sh->page_size == 0)
+    {
+        rc = lvfs_create(sh, amt, ofst);
+    }
+    else if (lvfs_gc_needed(sh, 2 * PKG_SQLITE_LOGFS_SPACE))
+    {
+        /* the cleaner thread fell behind, help it before the log grows further */
+        rc = lvfs_clean(sh);
+        rc = rc == SQLITE_DONE ? SQLITE_OK : rc;
+    }
+    while (rc == SQLITE_OK && amt > 0)
+    {
+        rt_uint32_t pgno = (rt_uint32_t)(ofst / sh->page_size);
+        int off = (int)(ofst % sh->page_size);
+        int n = (int)sh->page_size - off < amt ? (int)sh->page_size - off : amt;
+
+        if (n == (int)sh->page_size)
+        {
+            rc = lvfs_put_page(sh, pgno, in);
+        }
+        else
+        {
+            rc = lvfs_get_page(sh, pgno, sh->page);
+            if (rc == SQLITE_OK)
+            {
+                memcpy(sh->page + off, in, n);
+                sh->page_no = pgno + 1;
+                rc = lvfs_put_page(sh, pgno, sh->page);
+            }
+            if (rc != SQLITE_OK)
+            {
+                sh->page_no = 0;
+            }
+        }
+        pages++;
+        in += n;
+        ofst += n;
+        amt -= n;
+    }
+    sqlite3_mutex_leave(sh->mutex);
+
+    sqlite3_mutex_enter(lvfs_mutex);
+    lvfs_stats.pages_written += pages;
+    lvfs_stats.page_bytes += (sqlite3_int64)pages * sh->page_size;
+    sqlite3_mutex_leave(lvfs_mutex);
+    return rc;
+}
+
+static int lvfs_io_truncate(sqlite3_file *f, sqlite3_int64 size)
+{
+    struct lvfs_file *p = (struct lvfs_file *)f;
+    struct lvfs_shared *sh = p->sh;
+    rt_uint32_t npages;
+    int rc = SQLITE_OK;
+
+    sqlite3_mutex_enter(sh->mutex);
+    npages = sh->page_size ? (rt_uint32_t)((size + sh->page_size - 1) / sh->page_size) : 0;
+    if (npages < sh->cur_npages)
+    {
+        lvfs_begin(sh);
+        for (; rc == SQLITE_OK && sh->cur_npages > npages; sh->cur_npages--)
+        {
+            rc = lvfs_set(sh, sh->cur_npages - 1, 0);
+        }
+        if (sh->page_no > sh->cur_npages)
+        {
+            sh->page_no = 0;
+        }
+    }
+    sqlite3_mutex_leave(sh->mutex);
+    return rc;
+}
+
+static int lvfs_io_sync(sqlite3_file *f, int flags)
+{
+    struct lvfs_file *p = (struct lvfs_file *)f;
+    int rc = SQLITE_OK;
+
+    sqlite3_mutex_enter(p->sh->mutex);
+    if (p->sh->txn)
+    {
+        rc = lvfs_commit(p->sh, flags);
+        if (rc == SQLITE_OK)
+        {
+            sqlite3_mutex_enter(lvfs_mutex);
+            lvfs_stats.commits++;
+            sqlite3_mutex_leave(lvfs_mutex);
+        }
+        /* without the cleaner thread, clean a segment after the commit instead */
+        if (rc == SQLITE_OK && lvfs_gc_needed(p->sh, PKG_SQLITE_LOGFS_SPACE))
+        {
+            if (lvfs_gc_sem)
+            {
+                lvfs_gc_wakeup(p->sh);
+            }
+            else
+            {
+                rc = lvfs_clean(p->sh);
+                rc = rc == SQLITE_DONE ? SQLITE_OK : rc;
+            }
+        }
+    }
+    sqlite3_mutex_leave(p->sh->mutex);
+    return rc;
+}
+
+static int lvfs_io_file_size(sqlite3_file *f, sqlite3_int64 *size)
+{
+    struct lvfs_file *p = (struct lvfs_file *)f;
+
+    sqlite3_mutex_enter(p->sh->mutex);
+    *size = (sqlite3_int64)p->sh->cur_npages * p->sh->page_size;
+    sqlite3_mutex_leave(p->sh->mutex);
+    return SQLITE_OK;
+}
+
+static int lvfs_io_lock(sqlite3_file *f, int lock)
+{
+    struct lvfs_file *p = (struct lvfs_file *)f;
+    int rc;
+
+    rc = p->real->pMethods->xLock(p->real, lock);
+    if (rc == SQLITE_OK)
+    {
+        p->lock = lock;
+    }
+    return rc;
+}
+
+/*
+ * The writer dropping its write lock ends the open transaction: it is
+ * committed, unsynced, if SQLite was committing it with synchronous=OFF,
+ * and discarded otherwise, see the top of the file.
+ */
+static int lvfs_io_unlock(sqlite3_file *f, int lock)
+{
+    struct lvfs_file *p = (struct lvfs_file *)f;
+    int rc = SQLITE_OK, rc2;
+
+    if (p->lock > SQLITE_LOCK_SHARED && lock <= SQLITE_LOCK_SHARED)
+    {
+        sqlite3_mutex_enter(p->sh->mutex);
+        rc = lvfs_end(p->sh);
+        sqlite3_mutex_leave(p->sh->mutex);
+    }
+    rc2 = p->real->pMethods->xUnlock(p->real, lock);
+    if (rc2 == SQLITE_OK && lock < p->lock)
+    {
+        p->lock = lock;
+    }
+    return rc != SQLITE_OK ? rc : rc2;
+}
+
+static int lvfs_io_check_reserved(sqlite3_file *f, int *out)
+{
+    struct lvfs_file *p = (struct lvfs_file *)f;
+    return p->real->pMethods->xCheckReservedLock(p->real, out);
+}
+
+static int lvfs_io_file_control(sqlite3_file *f, int op, void *arg)
+{
+    struct lvfs_file *p = (struct lvfs_file *)f;
+
+    switch (op)
+    {
+    /* physical sizes have no relation to the logical ones */
+    case SQLITE_FCNTL_SIZE_HINT:
+    case SQLITE_FCNTL_CHUNK_SIZE:
+    case SQLITE_FCNTL_RTTHREAD_PREALLOCATE:
+        return SQLITE_OK;
+
+    case SQLITE_FCNTL_VFSNAME:
+        *(char **)arg = sqlite3_mprintf("%s", DB_LOG_VFS_NAME);
+        return SQLITE_OK;
+
+    /* sent at every commit, before xSync() when synchronous is not OFF */
+    case SQLITE_FCNTL_SYNC:
+        sqlite3_mutex_enter(p->sh->mutex);
+        p->sh->txn_done = p->sh->txn != 0;
+        sqlite3_mutex_leave(p->sh->mutex);
+        return SQLITE_OK;
+
+    default:
+        return p->real->pMethods->xFileControl(p->real, op, arg);
+    }
+}
+
+static int lvfs_io_sector_size(sqlite3_file *f)
+{
+    struct lvfs_file *p = (struct lvfs_file *)f;
+    return p->real->pMethods->xSectorSize(p->real);
+}
+
+/*
+ * Every transaction commits atomically and no page write disturbs another,
+ * so SQLite may skip the journal of single page transactions.
+ */
+static int lvfs_io_device_characteristics(sqlite3_file *f)
+{
+    return SQLITE_IOCAP_ATOMIC | SQLITE_IOCAP_SAFE_APPEND | SQLITE_IOCAP_SEQUENTIAL
+           | SQLITE_IOCAP_POWERSAFE_OVERWRITE;
+}
+
+static void lvfs_free_shared(struct lvfs_shared *sh)
+{
+    if (sh->data)
+    {
+        if (sh->data->pMethods)
+        {
+            sh->data->pMethods->xClose(sh->data);
+        }
+        sqlite3_free(sh->data);
+    }
+    sqlite3_free(sh->segs);
+    sqlite3_free(sh->map);
+    sqlite3_free(sh->cur);
+    sqlite3_free(sh->dirty);
+    sqlite3_free(sh->rec);
+    sqlite3_free(sh->page);
+    sqlite3_free(sh->gc_moved);
+    if (sh->mutex)
+    {
+        sqlite3_mutex_free(sh->mutex);
+    }
+    sqlite3_free(sh);
+}
+
+static void lvfs_unref(struct lvfs_shared *sh)
+{
+    struct lvfs_shared **pp;
+
+    sqlite3_mutex_enter(lvfs_mutex);
+    if (--sh->refs == 0)
+    {
+        for (pp = &lvfs_list; *pp; pp = &(*pp)->next)
+        {
+            if (*pp == sh)
+            {
+                *pp = sh->next;
+                break;
+            }
+        }
+        lvfs_free_shared(sh);
+    }
+    sqlite3_mutex_leave(lvfs_mutex);
+}
+
+static int lvfs_io_close(sqlite3_file *f)
+{
+    struct lvfs_file *p = (struct lvfs_file *)f;
+    int rc;
+
+    if (p->lock > SQLITE_LOCK_SHARED)
+    {
+        sqlite3_mutex_enter(p->sh->mutex);
+        lvfs_end(p->sh);
+        sqlite3_mutex_leave(p->sh->mutex);
+    }
+    rc = p->real->pMethods->xClose(p->real);
+    lvfs_unref(p->sh);
+    return rc;
+}
+
+/* take a reference on the next database waiting for the cleaner */
+static struct lvfs_shared *lvfs_gc_next(void)
+{
+    struct lvfs_shared *sh;
+
+    sqlite3_mutex_enter(lvfs_mutex);
+    for (sh = lvfs_list; sh && !sh->gc; sh = sh->next)
+        ;
+    if (sh)
+    {
+        sh->gc = 0;
+        sh->refs++;
+    }
+    sqlite3_mutex_leave(lvfs_mutex);
+    return sh;
+}
+
+/* the cleaner, one page copy at a time so that writers get in between */
+static void lvfs_gc_entry(void *param)
+{
+    struct lvfs_shared *sh;
+
+    while (rt_sem_take(lvfs_gc_sem, RT_WAITING_FOREVER) == RT_EOK)
+    {
+        while ((sh = lvfs_gc_next()) != RT_NULL)
+        {
+            sqlite3_mutex_enter(sh->mutex);
+            while ((sh->gc_txn || lvfs_gc_needed(sh, PKG_SQLITE_LOGFS_SPACE)) && lvfs_clean_step(sh, 1) == SQLITE_OK)
+            {
+                sqlite3_mutex_leave(sh->mutex);
+                sqlite3_mutex_enter(sh->mutex);
+            }
+            sqlite3_mutex_leave(sh->mutex);
+            lvfs_unref(sh);
+        }
+    }
+}
+
+/*
+ * Find or make the shared state of a database file; the first handle opens
+ * the log and replays it. Returns SQLITE_NOTADB when the file is a plain
+ * database.
+ */
+static int lvfs_attach(sqlite3_vfs *root, struct lvfs_file *p, const char *name, int flags)
+{
+    struct lvfs_shared *sh;
+    int rc;
+
+    sqlite3_mutex_enter(lvfs_mutex);
+    for (sh = lvfs_list; sh; sh = sh->next)
+    {
+        if (strcmp(sh->path, name) == 0)
+        {
+            sh->refs++;
+            p->sh = sh;
+            sqlite3_mutex_leave(lvfs_mutex);
+            return SQLITE_OK;
+        }
+    }
+
+    sh = sqlite3_malloc(sizeof(*sh) + strlen(name) + 2);
+    if (sh == RT_NULL)
+    {
+        sqlite3_mutex_leave(lvfs_mutex);
+        return SQLITE_NOMEM;
+    }
+    memset(sh, 0, sizeof(*sh));
+    sh->path = (char *)(sh + 1);
+    strcpy(sh->path, name);
+    sh->path[strlen(name) + 1] = '\0';
+    sh->refs = 1;
+    sh->mutex = sqlite3_mutex_alloc(SQLITE_MUTEX_FAST);
+    sh->data = sqlite3_malloc(root->szOsFile);
+
+    rc = sh->mutex && sh->data ? SQLITE_OK : SQLITE_NOMEM;
+    if (rc == SQLITE_OK)
+    {
+        memset(sh->data, 0, root->szOsFile);
+        rc = root->xOpen(root, sh->path, sh->data, flags & ~SQLITE_OPEN_EXCLUSIVE, RT_NULL);
+    }
+    if (rc == SQLITE_OK)
+    {
+        rc = lvfs_load(sh);
+    }
+    if (rc == SQLITE_OK)
+    {
+        sh->next = lvfs_list;
+        lvfs_list = sh;
+        p->sh = sh;
+    }
+    else
+    {
+        lvfs_free_shared(sh);
+    }
+    sqlite3_mutex_leave(lvfs_mutex);
+    return rc;
+}
+
+/* whether a journal belongs to a database kept in a log */
+static int lvfs_is_log_journal(const char *name)
+{
+    struct lvfs_shared *sh;
+    size_t len = strlen(name);
+    int found = 0;
+
+    if (len <= 8 || strcmp(name + len - 8, "-journal") != 0)
+    {
+        return 0;
+    }
+    sqlite3_mutex_enter(lvfs_mutex);
+    for (sh = lvfs_list; sh && !found; sh = sh->next)
+    {
+        found = strlen(sh->path) == len - 8 && strncmp(sh->path, name, len - 8) == 0;
+    }
+    sqlite3_mutex_leave(lvfs_mutex);
+    return found;
+}
+
+static int lvfs_vfs_open(sqlite3_vfs *vfs, const char *name, sqlite3_file *f, int flags, int *out_flags)
+{
+    sqlite3_vfs *root = (sqlite3_vfs *)vfs->pAppData;
+    struct lvfs_file *p = (struct lvfs_file *)f;
+    int rc;
+
+    /* the journal of a log database only has to last as long as its transaction */
+    if ((flags & SQLITE_OPEN_MAIN_JOURNAL) && name && lvfs_is_log_journal(name))
+    {
+        flags = (flags & ~SQLITE_OPEN_MAIN_JOURNAL) | SQLITE_OPEN_TEMP_JOURNAL | SQLITE_OPEN_DELETEONCLOSE;
+        return root->xOpen(root, RT_NULL, f, flags, out_flags);
+    }
+    if (!(flags & SQLITE_OPEN_MAIN_DB) || name == RT_NULL)
+    {
+        return root->xOpen(root, name, f, flags, out_flags);
+    }
+
+    memset(p, 0, sizeof(struct lvfs_file));
+    p->real = (sqlite3_file *)((char *)p + LVFS_FILE_SIZE);
+    memset(p->real, 0, root->szOsFile);
+    rc = root->xOpen(root, name, p->real, flags, out_flags);
+    if (rc != SQLITE_OK || p->real->pMethods == RT_NULL)
+    {
+        return rc;
+    }
+
+    rc = lvfs_attach(root, p, name, flags);
+    if (rc == SQLITE_NOTADB)
+    {
+        /* a database created by another VFS stays as it is */
+        p->real->pMethods->xClose(p->real);
+        memset(f, 0, vfs->szOsFile);
+        return root->xOpen(root, name, f, flags, out_flags);
+    }
+    if (rc != SQLITE_OK)
+    {
+        p->real->pMethods->xClose(p->real);
+        return rc;
+    }
+    p->base.pMethods = &lvfs_io_methods;
+    return SQLITE_OK;
+}
+
+/* a journal kept in RAM has nothing on flash to look up or delete */
+static int lvfs_vfs_delete(sqlite3_vfs *vfs, const char *name, int sync_dir)
+{
+    sqlite3_vfs *root = (sqlite3_vfs *)vfs->pAppData;
+
+    if (lvfs_is_log_journal(name))
+    {
+        return SQLITE_OK;
+    }
+    return root->xDelete(root, name, sync_dir);
+}
+
+static int lvfs_vfs_access(sqlite3_vfs *vfs, const char *name, int flags, int *out)
+{
+    sqlite3_vfs *root = (sqlite3_vfs *)vfs->pAppData;
+
+    if (lvfs_is_log_journal(name))
+    {
+        *out = 0;
+        return SQLITE_OK;
+    }
+    return root->xAccess(root, name, flags, out);
+}
+
+static int lvfs_vfs_fullpathname(sqlite3_vfs *vfs, const char *name, int n, char *out)
+{
+    sqlite3_vfs *root = (sqlite3_vfs *)vfs->pAppData;
+    return root->xFullPathname(root, name, n, out);
+}
+
+static int lvfs_vfs_randomness(sqlite3_vfs *vfs, int n, char *out)
+{
+    sqlite3_vfs *root = (sqlite3_vfs *)vfs->pAppData;
+    return root->xRandomness(root, n, out);
+}
+
+static int lvfs_vfs_sleep(sqlite3_vfs *vfs, int us)
+{
+    sqlite3_vfs *root = (sqlite3_vfs *)vfs->pAppData;
+    return root->xSleep(root, us);
+}
+
+static int lvfs_vfs_current_time(sqlite3_vfs *vfs, double *now)
+{
+    sqlite3_vfs *root = (sqlite3_vfs *)vfs->pAppData;
+    return root->xCurrentTime(root, now);
+}
+
+int db_log_register(int make_default)
+{
+    sqlite3_vfs *root;
+    rt_thread_t tid;
+
+    if (lvfs_vfs.zName)
+    {
+        return sqlite3_vfs_register(&lvfs_vfs, make_default);
+    }
+
+    root = sqlite3_vfs_find("rt-thread");
+    if (root == RT_NULL)
+    {
+        LOG_E("the rt-thread VFS is not registered");
+        return SQLITE_ERROR;
+    }
+    lvfs_mutex = sqlite3_mutex_alloc(SQLITE_MUTEX_FAST);
+    if (lvfs_mutex == RT_NULL)
+    {
+        return SQLITE_NOMEM;
+    }
+
+    /* without the thread the cleaner runs at the end of each commit instead */
+    lvfs_gc_sem = rt_sem_create("sqlgc", 0, RT_IPC_FLAG_FIFO);
+    tid = lvfs_gc_sem ? rt_thread_create("sqlgc", lvfs_gc_entry, RT_NULL, PKG_SQLITE_LOGFS_GC_STACK,
+                                         PKG_SQLITE_LOGFS_GC_PRIORITY, 10) : RT_NULL;
+    if (tid == RT_NULL || rt_thread_startup(tid) != RT_EOK)
+    {
+        LOG_E("create the log cleaner thread failed");
+        if (lvfs_gc_sem)
+        {
+            rt_sem_delete(lvfs_gc_sem);
+            lvfs_gc_sem = RT_NULL;
+        }
+    }
+
+    lvfs_io_methods.iVersion = 1;
+    lvfs_io_methods.xClose = lvfs_io_close;
+    lvfs_io_methods.xRead = lvfs_io_read;
+    lvfs_io_methods.xWrite = lvfs_io_write;
+    lvfs_io_methods.xTruncate = lvfs_io_truncate;
+    lvfs_io_methods.xSync = lvfs_io_sync;
+    lvfs_io_methods.xFileSize = lvfs_io_file_size;
+    lvfs_io_methods.xLock = lvfs_io_lock;
+    lvfs_io_methods.xUnlock = lvfs_io_unlock;
+    lvfs_io_methods.xCheckReservedLock = lvfs_io_check_reserved;
+    lvfs_io_methods.xFileControl = lvfs_io_file_control;
+    lvfs_io_methods.xSectorSize = lvfs_io_sector_size;
+    lvfs_io_methods.xDeviceCharacteristics = lvfs_io_device_characteristics;
+
+    lvfs_vfs.iVersion = 1;
+    lvfs_vfs.szOsFile = LVFS_FILE_SIZE + root->szOsFile;
+    lvfs_vfs.mxPathname = root->mxPathname;
+    lvfs_vfs.zName = DB_LOG_VFS_NAME;
+    lvfs_vfs.pAppData = root;
+    lvfs_vfs.xOpen = lvfs_vfs_open;
+    lvfs_vfs.xDelete = lvfs_vfs_delete;
+    lvfs_vfs.xAccess = lvfs_vfs_access;
+    lvfs_vfs.xFullPathname = lvfs_vfs_fullpathname;
+    lvfs_vfs.xRandomness = lvfs_vfs_randomness;
+    lvfs_vfs.xSleep = lvfs_vfs_sleep;
+    lvfs_vfs.xCurrentTime = lvfs_vfs_current_time;
+
+    return sqlite3_vfs_register(&lvfs_vfs, make_default);
+}
+
+void db_log_stats(struct db_log_stats *stats, int reset)
+{
+    if (lvfs_mutex == RT_NULL)
+    {
+        memset(stats, 0, sizeof(*stats));
+        return;
+    }
+    sqlite3_mutex_enter(lvfs_mutex);
+    *stats = lvfs_stats;
+    if (reset)
+    {
+        memset(&lvfs_stats, 0, sizeof(lvfs_stats));
+    }
+    sqlite3_mutex_leave(lvfs_mutex);
+}
+
+#ifdef RT_USING_FINSH
+static void sqllog(int argc, char **argv)
+{
+    struct db_log_stats st;
+    char line[160];
+
+    db_log_stats(&st, argc >= 2 && rt_strcmp(argv[1], "reset") == 0);
+
+    /* rt_kprintf() has no 64-bit or floating point conversions, sqlite3_snprintf() does */
+    sqlite3_snprintf(sizeof(line), line, "%u commits, %u pages (%lld bytes) written, %lld bytes logged",
+                     st.commits, st.pages_written, st.page_bytes, st.log_bytes);
+    rt_kprintf("%s\n", line);
+    sqlite3_snprintf(sizeof(line), line, "cleaner: %u segments, %u pages copied, write amplification %.2f",
+                     st.gc_runs, st.gc_pages, st.page_bytes ? (double)st.log_bytes / st.page_bytes : 0.0);
+    rt_kprintf("%s\n", line);
+}
+MSH_CMD_EXPORT(sqllog, sqlite log-structured VFS statistics: sqllog [reset]);
+#endif
@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2026-10-19     RT-Thread    first version
+ */
+
+#ifndef __DBLOG_H__
+#define __DBLOG_H__
+
+#include <sqlite3.h>
+
+#define DB_LOG_VFS_NAME "logfs"
+
+/* counters of the log-structured VFS since start or the last reset */
+struct db_log_stats
+{
+    unsigned int commits;           /* commit records appended by SQLite transactions */
+    unsigned int pages_written;     /* pages written by SQLite */
+    unsigned int gc_runs;           /* segments reclaimed by the cleaner */
+    unsigned int gc_pages;          /* live pages the cleaner copied forward */
+    sqlite3_int64 log_bytes;        /* every byte appended to the logs */
+    sqlite3_int64 page_bytes;       /* bytes of the pages_written pages */
+};
+
+/**
+ * This function will register the "logfs" VFS, which appends every page of
+ * the main database files to a log on top of the rt-thread VFS and commits
+ * a transaction with a single commit record. The rollback journals of those
+ * databases are kept in RAM, other files are passed through, and database
+ * files created by another VFS are opened as they are.
+ *
+ * @param make_default non-zero to make it the default VFS.
+ * @return SQLITE_OK on success.
+ */
+int db_log_register(int make_default);
+
+/**
+ * This function will get the counters of the log-structured VFS. The write
+ * amplification is log_bytes / page_bytes.
+ *
+ * @param stats the counters.
+ * @param reset non-zero to clear the counters after reading them.
+ */
+void db_log_stats(struct db_log_stats *stats, int reset);
+
+#endif
@@ -0,0 +1,321 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2026-10-19     RT-Thread    first version
+ */
+
+#include <rtthread.h>
+#include <string.h>
+#include "sqlite3.h"
+#include "dbmem.h"
+
+#define DBG_ENABLE
+#define DBG_SECTION_NAME "app.dbmem"
+#define DBG_LEVEL DBG_INFO
+#define DBG_COLOR
+#include <rtdbg.h>
+
+/* bytes of each size class pool */
+#ifndef PKG_SQLITE_MEMPOOL_CLASS_SIZE
+#define PKG_SQLITE_MEMPOOL_CLASS_SIZE 8192
+#endif
+
+/*
+ * An sqlite3_mem_methods over DB_MEM_CLASSES rt_mp pools laid out one
+ * after another in a static region. Allocating walks at most
+ * DB_MEM_CLASSES pools and freeing finds the pool by address, both with
+ * interrupts masked only inside rt_mp and around the counters, so SQLite
+ * never takes the heap lock for the parser and VDBE objects that make up
+ * most of its allocations. Blocks larger than the largest class, and those
+ * of classes that ran dry, come from the heap with a size header.
+ *
+ * SQLite wants 8-byte aligned memory, but rt_mp hands out the address right
+ * after its pointer sized block header. Each block therefore gets the slack
+ * to round up to 8 bytes, and freeing recovers the block from the index of
+ * the slot the address falls in.
+ */
+#define DBM_ALIGN               8
+#define DBM_ROUND(n)            RT_ALIGN((n), DBM_ALIGN)
+#define DBM_CLASS_MAX           (DB_MEM_CLASS_MIN << (DB_MEM_CLASSES - 1))
+#define DBM_SLACK               ((DBM_ALIGN - sizeof(rt_uint8_t *) % DBM_ALIGN) % DBM_ALIGN)
+#define DBM_CLASS_SPAN          DBM_ROUND(PKG_SQLITE_MEMPOOL_CLASS_SIZE)
+
+#ifndef rt_section
+#define rt_section(x)           SECTION(x)
+#endif
+
+#ifdef PKG_SQLITE_MEMPOOL_SECTION
+#define DBM_SECTION             rt_section(PKG_SQLITE_MEMPOOL_SECTION)
+#else
+#define DBM_SECTION
+#endif
+
+/* the heap header keeps the size and the 8-byte alignment */
+union dbm_header
+{
+    rt_size_t size;
+    rt_uint64_t align;
+};
+
+struct dbm_class
+{
+    struct rt_mempool pool;
+    rt_uint8_t *start;
+    rt_uint8_t *end;
+    rt_size_t stride;               /* distance between two blocks of the pool */
+};
+
+static rt_uint64_t dbm_region[(DB_MEM_CLASSES * DBM_CLASS_SPAN) / sizeof(rt_uint64_t)] DBM_SECTION;
+static struct dbm_class dbm_class[DB_MEM_CLASSES];
+static struct db_mem_stats dbm_stats;
+
+static int dbm_class_of_size(int n)
+{
+    int i = 0;
+
+    while ((DB_MEM_CLASS_MIN << i) < n)
+    {
+        i++;
+    }
+    return i;
+}
+
+static int dbm_class_of_ptr(const rt_uint8_t *p)
+{
+    int i;
+
+    if (p < (rt_uint8_t *)dbm_region || p >= (rt_uint8_t *)dbm_region + sizeof(dbm_region))
+    {
+        return -1;
+    }
+    for (i = 0; i < DB_MEM_CLASSES; i++)
+    {
+        if (p >= dbm_class[i].start && p < dbm_class[i].end)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void *dbm_malloc(int n)
+{
+    struct dbm_class *c;
+    union dbm_header *h;
+    rt_uint8_t *block;
+    rt_base_t level;
+    int i;
+
+    if (n <= 0)
+    {
+        return RT_NULL;
+    }
+    for (i = n <= DBM_CLASS_MAX ? dbm_class_of_size(n) : DB_MEM_CLASSES; i < DB_MEM_CLASSES; i++)
+    {
+        c = &dbm_class[i];
+        block = dbm_stats.cls[i].blocks ? rt_mp_alloc(&c->pool, RT_WAITING_NO) : RT_NULL;
+        level = rt_hw_interrupt_disable();
+        if (block)
+        {
+            dbm_stats.cls[i].allocs++;
+            if (++dbm_stats.cls[i].used > dbm_stats.cls[i].peak)
+            {
+                dbm_stats.cls[i].peak = dbm_stats.cls[i].used;
+            }
+        }
+        else
+        {
+            dbm_stats.cls[i].full++;
+        }
+        rt_hw_interrupt_enable(level);
+        if (block)
+        {
+            return (void *)DBM_ROUND((rt_ubase_t)block);
+        }
+    }
+
+    h = rt_malloc_align(sizeof(*h) + n, DBM_ALIGN);
+    if (h == RT_NULL)
+    {
+        return RT_NULL;
+    }
+    h->size = n;
+    level = rt_hw_interrupt_disable();
+    dbm_stats.heap_allocs++;
+    dbm_stats.heap_used += n;
+    if (dbm_stats.heap_used > dbm_stats.heap_peak)
+    {
+        dbm_stats.heap_peak = dbm_stats.heap_used;
+    }
+    rt_hw_interrupt_enable(level);
+    return h + 1;
+}
+
+static void dbm_free(void *p)
+{
+    struct dbm_class *c;
+    union dbm_header *h;
+    rt_size_t index;
+    rt_base_t level;
+    int i;
+
+    i = dbm_class_of_ptr(p);
+    if (i >= 0)
+    {
+        c = &dbm_class[i];
+        index = ((rt_uint8_t *)p - c->start - sizeof(rt_uint8_t *)) / c->stride;
+        rt_mp_free(c->start + index * c->stride + sizeof(rt_uint8_t *));
+        level = rt_hw_interrupt_disable();
+        dbm_stats.cls[i].used--;
+        rt_hw_interrupt_enable(level);
+    }
+    else
+    {
+        h = (union dbm_header *)p - 1;
+        level = rt_hw_interrupt_disable();
+        dbm_stats.heap_used -= h->size;
+        rt_hw_interrupt_enable(level);
+        rt_free_align(h);
+    }
+}
+
+static int dbm_size(void *p)
+{
+    int i = dbm_class_of_ptr(p);
+
+    if (i >= 0)
+    {
+        return DB_MEM_CLASS_MIN << i;
+    }
+    return ((union dbm_header *)p - 1)->size;
+}
+
+static void *dbm_realloc(void *p, int n)
+{
+    void *q;
+    int old = dbm_size(p);
+
+    /* a pool block is kept while it fits, a heap block while it stays above the classes */
+    if (n <= old && (dbm_class_of_ptr(p) >= 0 || n > DBM_CLASS_MAX))
+    {
+        return p;
+    }
+    q = dbm_malloc(n);
+    if (q)
+    {
+        memcpy(q, p, n < old ? n : old);
+        dbm_free(p);
+    }
+    return q;
+}
+
+static int dbm_roundup(int n)
+{
+    if (n <= DBM_CLASS_MAX)
+    {
+        return DB_MEM_CLASS_MIN << dbm_class_of_size(n);
+    }
+    return DBM_ROUND(n);
+}
+
+static int dbm_init(void *arg)
+{
+    rt_uint8_t *start = (rt_uint8_t *)dbm_region;
+    char name[RT_NAME_MAX];
+    int i, size;
+
+    memset(&dbm_stats, 0, sizeof(dbm_stats));
+    for (i = 0; i < DB_MEM_CLASSES; i++)
+    {
+        size = DB_MEM_CLASS_MIN << i;
+        dbm_stats.cls[i].size = size;
+        dbm_class[i].start = start;
+        dbm_class[i].end = start + DBM_CLASS_SPAN;
+        rt_snprintf(name, sizeof(name), "sqm%d", size);
+        if (rt_mp_init(&dbm_class[i].pool, name, start, DBM_CLASS_SPAN, size + DBM_SLACK) == RT_EOK)
+        {
+            dbm_class[i].stride = dbm_class[i].pool.block_size + sizeof(rt_uint8_t *);
+            dbm_stats.cls[i].blocks = dbm_class[i].pool.block_total;
+        }
+        else
+        {
+            LOG_E("init the %d bytes pool failed", size);
+        }
+        start += DBM_CLASS_SPAN;
+    }
+    return SQLITE_OK;
+}
+
+static void dbm_shutdown(void *arg)
+{
+    int i;
+
+    for (i = 0; i < DB_MEM_CLASSES; i++)
+    {
+        if (dbm_stats.cls[i].blocks)
+        {
+            rt_mp_detach(&dbm_class[i].pool);
+            dbm_stats.cls[i].blocks = 0;
+        }
+    }
+}
+
+int db_mem_register(void)
+{
+    static const sqlite3_mem_methods methods =
+    {
+        dbm_malloc,
+        dbm_free,
+        dbm_realloc,
+        dbm_size,
+        dbm_roundup,
+        dbm_init,
+        dbm_shutdown,
+        RT_NULL
+    };
+
+    return sqlite3_config(SQLITE_CONFIG_MALLOC, &methods);
+}
+
+void db_mem_stats(struct db_mem_stats *stats, int reset)
+{
+    rt_base_t level;
+    int i;
+
+    level = rt_hw_interrupt_disable();
+    *stats = dbm_stats;
+    if (reset)
+    {
+        for (i = 0; i < DB_MEM_CLASSES; i++)
+        {
+            dbm_stats.cls[i].allocs = 0;
+            dbm_stats.cls[i].full = 0;
+            dbm_stats.cls[i].peak = dbm_stats.cls[i].used;
+        }
+        dbm_stats.heap_allocs = 0;
+        dbm_stats.heap_peak = dbm_stats.heap_used;
+    }
+    rt_hw_interrupt_enable(level);
+}
+
+#ifdef RT_USING_FINSH
+static void sqlmem(int argc, char **argv)
+{
+    struct db_mem_stats st;
+    int i;
+
+    db_mem_stats(&st, argc >= 2 && rt_strcmp(argv[1], "reset") == 0);
+    rt_kprintf("class  blocks    used    peak      allocs    full\n");
+    for (i = 0; i < DB_MEM_CLASSES; i++)
+    {
+        rt_kprintf("%5u %7u %7u %7u %11u %7u\n", st.cls[i].size, st.cls[i].blocks, st.cls[i].used,
+                   st.cls[i].peak, st.cls[i].allocs, st.cls[i].full);
+    }
+    rt_kprintf("heap: %u allocations, %u bytes used, peak %u\n", st.heap_allocs, st.heap_used, st.heap_peak);
+}
+MSH_CMD_EXPORT(sqlmem, sqlite pool allocator statistics: sqlmem [reset]);
+#endif
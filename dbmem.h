@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2026-10-19     RT-Thread    first version
+ */
+
+#ifndef __DBMEM_H__
+#define __DBMEM_H__
+
+#include <sqlite3.h>
+
+/* size classes of the pool allocator: 16, 32, 64 ... 1024 bytes */
+#define DB_MEM_CLASSES      7
+#define DB_MEM_CLASS_MIN    16
+
+/* counters of one size class */
+struct db_mem_class_stats
+{
+    unsigned int size;              /* bytes of a block */
+    unsigned int blocks;            /* blocks of the class */
+    unsigned int used;              /* blocks in use now */
+    unsigned int peak;              /* most blocks ever in use */
+    unsigned int allocs;            /* allocations served by the class */
+    unsigned int full;              /* allocations passed on because the class was empty */
+};
+
+/* counters of the pool allocator since start or the last reset */
+struct db_mem_stats
+{
+    struct db_mem_class_stats cls[DB_MEM_CLASSES];
+    unsigned int heap_allocs;       /* allocations taken from the heap */
+    unsigned int heap_used;         /* heap bytes in use now */
+    unsigned int heap_peak;         /* most heap bytes ever in use */
+};
+
+/**
+ * This function will make SQLite allocate its memory from segregated
+ * rt_mp pools, one per size class, each of PKG_SQLITE_MEMPOOL_CLASS_SIZE
+ * bytes. A request is served by the smallest class that fits and has a free
+ * block, and from the heap when it is larger than the largest class or
+ * every class that fits is empty. It must be called before
+ * sqlite3_initialize(), db_helper_init() does so when PKG_SQLITE_MEMPOOL
+ * is defined.
+ *
+ * @return SQLITE_OK on success, SQLITE_MISUSE once SQLite is initialized.
+ */
+int db_mem_register(void);
+
+/**
+ * This function will get the counters of the pool allocator.
+ *
+ * @param stats the counters.
+ * @param reset non-zero to clear the allocation counters and lower the
+ *        peaks to the current usage after reading them.
+ */
+void db_mem_stats(struct db_mem_stats *stats, int reset);
+
+#endif
@@ -0,0 +1,579 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2026-10-19     RT-Thread    first version
+ */
+
+#include <rtthread.h>
+#include <string.h>
+#include "sqlite3.h"
+#include "dbpcache.h"
+
+#define DBG_ENABLE
+#define DBG_SECTION_NAME "app.dbpcache"
+#define DBG_LEVEL DBG_INFO
+#define DBG_COLOR
+#include <rtdbg.h>
+
+/* bytes of the pool placed by db_helper_init(), 0 to keep pages on the heap */
+#ifndef PKG_SQLITE_PCACHE_SIZE
+#define PKG_SQLITE_PCACHE_SIZE 65536
+#endif
+
+/* largest page size held by a pool slot, larger pages come from the heap */
+#ifndef PKG_SQLITE_PCACHE_PAGE_SIZE
+#define PKG_SQLITE_PCACHE_PAGE_SIZE 4096
+#endif
+
+/* bytes SQLite keeps with each page, about 120 on 32-bit and 220 on 64-bit targets */
+#ifndef PKG_SQLITE_PCACHE_EXTRA
+#define PKG_SQLITE_PCACHE_EXTRA 256
+#endif
+
+/*
+ * An sqlite3_pcache_methods2 over one rt_mp pool. Every slot holds one page
+ * of up to PKG_SQLITE_PCACHE_PAGE_SIZE bytes, its extra bytes and the header
+ * below, so allocating and freeing a page is O(1) and never fragments the
+ * heap, and a slot given up by any cache fits any other:
+ *
+ *     | page (pBuf) | extra (pExtra) | struct mpc_page |
+ *
+ * Unpinned pages sit on the LRU list of their cache and, when they live in
+ * the pool, on the LRU list of the pool. A cache at its page limit recycles
+ * its own oldest page; a cache that finds the pool empty recycles the oldest
+ * page of the pool, whichever cache holds it. Only when neither is possible
+ * and SQLite insists (createFlag 2) does a page come from the heap, and so
+ * do all pages of a cache whose page size does not fit a slot.
+ */
+#define MPC_ALIGN               8
+#define MPC_ROUND(n)            RT_ALIGN((n), MPC_ALIGN)
+#define MPC_HASH_MIN            16
+
+#ifndef rt_section
+#define rt_section(x)           SECTION(x)
+#endif
+
+struct mpc_cache;
+
+struct mpc_page
+{
+    sqlite3_pcache_page base;       /* must be first, SQLite hands it back */
+    struct mpc_cache *cache;
+    struct mpc_page *hash_next;
+    rt_list_t cache_lru;            /* in cache->lru while unpinned */
+    rt_list_t pool_lru;             /* in mpc.lru while unpinned, pool pages only */
+    void *block;                    /* from rt_mp_alloc() or sqlite3_malloc() */
+    unsigned int key;
+    rt_uint8_t pooled;
+    rt_uint8_t pinned;
+};
+
+struct mpc_cache
+{
+    int page_size;
+    int extra_size;
+    int purgeable;
+    int pooled;                     /* pages fit a pool slot */
+    unsigned int max_pages;         /* PRAGMA cache_size */
+    unsigned int pages;
+    unsigned int unpinned;
+    unsigned int max_key;
+    unsigned int hash_size;
+    struct mpc_page **hash;
+    rt_list_t lru;                  /* unpinned pages, most recently used first */
+};
+
+static struct
+{
+    sqlite3_mutex *mutex;
+    void *region;
+    rt_size_t region_size;
+    struct rt_mempool pool;
+    rt_list_t lru;                  /* unpinned pool pages of all caches */
+    unsigned int limit;             /* pages of one cache, 0 for no limit */
+    struct db_pcache_stats stats;
+} mpc;
+
+#if PKG_SQLITE_PCACHE_SIZE > 0
+#ifdef PKG_SQLITE_PCACHE_ADDR
+#define MPC_REGION              ((void *)(PKG_SQLITE_PCACHE_ADDR))
+#else
+#ifdef PKG_SQLITE_PCACHE_SECTION
+#define MPC_SECTION             rt_section(PKG_SQLITE_PCACHE_SECTION)
+#else
+#define MPC_SECTION
+#endif
+static rt_uint8_t mpc_region[PKG_SQLITE_PCACHE_SIZE] MPC_SECTION;
+#define MPC_REGION              ((void *)mpc_region)
+#endif
+#else
+#define MPC_REGION              RT_NULL
+#endif
+
+static rt_size_t mpc_need(int page_size, int extra_size)
+{
+    /* the slack aligns pBuf when the block is only pointer aligned */
+    return MPC_ALIGN + MPC_ROUND(page_size) + MPC_ROUND(extra_size) + sizeof(struct mpc_page);
+}
+
+static unsigned int mpc_max(struct mpc_cache *cache)
+{
+    if (mpc.limit && mpc.limit < cache->max_pages)
+    {
+        return mpc.limit;
+    }
+    return cache->max_pages;
+}
+
+static struct mpc_page *mpc_hash_find(struct mpc_cache *cache, unsigned int key)
+{
+    struct mpc_page *page = RT_NULL;
+
+    if (cache->hash_size)
+    {
+        page = cache->hash[key % cache->hash_size];
+        while (page && page->key != key)
+        {
+            page = page->hash_next;
+        }
+    }
+    return page;
+}
+
+static void mpc_hash_insert(struct mpc_cache *cache, struct mpc_page *page)
+{
+    unsigned int i, h, size;
+    struct mpc_page **hash, *p, *next;
+
+    if (cache->pages >= cache->hash_size)
+    {
+        /* a failed resize only makes the chains longer */
+        size = cache->hash_size ? cache->hash_size * 2 : MPC_HASH_MIN;
+        hash = sqlite3_malloc64(size * sizeof(*hash));
+        if (hash)
+        {
+            memset(hash, 0, size * sizeof(*hash));
+            for (i = 0; i < cache->hash_size; i++)
+            {
+                for (p = cache->hash[i]; p; p = next)
+                {
+                    next = p->hash_next;
+                    h = p->key % size;
+                    p->hash_next = hash[h];
+                    hash[h] = p;
+                }
+            }
+            sqlite3_free(cache->hash);
+            cache->hash = hash;
+            cache->hash_size = size;
+        }
+    }
+    h = page->key % cache->hash_size;
+    page->hash_next = cache->hash[h];
+    cache->hash[h] = page;
+}
+
+static void mpc_hash_remove(struct mpc_cache *cache, struct mpc_page *page)
+{
+    struct mpc_page **pp = &cache->hash[page->key % cache->hash_size];
+
+    while (*pp != page)
+    {
+        pp = &(*pp)->hash_next;
+    }
+    *pp = page->hash_next;
+}
+
+static void mpc_pin(struct mpc_page *page)
+{
+    if (!page->pinned)
+    {
+        rt_list_remove(&page->cache_lru);
+        rt_list_remove(&page->pool_lru);
+        page->cache->unpinned--;
+        page->pinned = 1;
+    }
+}
+
+/* take a page out of its cache and return its memory block */
+static void *mpc_take(struct mpc_page *page)
+{
+    struct mpc_cache *cache = page->cache;
+
+    mpc_pin(page);
+    mpc_hash_remove(cache, page);
+    cache->pages--;
+    return page->block;
+}
+
+static void mpc_free_block(void *block, int pooled)
+{
+    if (pooled)
+    {
+        rt_mp_free(block);
+        mpc.stats.pool_used--;
+    }
+    else
+    {
+        sqlite3_free(block);
+    }
+}
+
+static void mpc_discard(struct mpc_page *page)
+{
+    int pooled = page->pooled;
+
+    mpc_free_block(mpc_take(page), pooled);
+}
+
+static void mpc_discard_oldest(struct mpc_cache *cache)
+{
+    mpc_discard(rt_list_entry(cache->lru.prev, struct mpc_page, cache_lru));
+}
+
+static void mpc_truncate_locked(struct mpc_cache *cache, unsigned int limit)
+{
+    unsigned int i;
+    struct mpc_page *page, *next;
+
+    if (cache->pages == 0 || limit > cache->max_key)
+    {
+        return;
+    }
+    for (i = 0; i < cache->hash_size; i++)
+    {
+        for (page = cache->hash[i]; page; page = next)
+        {
+            next = page->hash_next;
+            if (page->key >= limit)
+            {
+                mpc_discard(page);
+            }
+        }
+    }
+    cache->max_key = limit ? limit - 1 : 0;
+}
+
+static int mpc_init(void *arg)
+{
+    mpc.mutex = sqlite3_mutex_alloc(SQLITE_MUTEX_FAST);
+    rt_list_init(&mpc.lru);
+    memset(&mpc.stats, 0, sizeof(mpc.stats));
+    mpc.stats.slot_size = RT_ALIGN(mpc_need(PKG_SQLITE_PCACHE_PAGE_SIZE, PKG_SQLITE_PCACHE_EXTRA), RT_ALIGN_SIZE);
+    if (mpc.region && rt_mp_init(&mpc.pool, "sqlpc", mpc.region, mpc.region_size,
+                                 mpc.stats.slot_size) == RT_EOK)
+    {
+        mpc.stats.pool_pages = mpc.pool.block_total;
+    }
+    if (mpc.stats.pool_pages == 0)
+    {
+        LOG_W("no page pool, sqlite pages come from the heap");
+    }
+    return SQLITE_OK;
+}
+
+static void mpc_shutdown(void *arg)
+{
+    if (mpc.stats.pool_pages)
+    {
+        rt_mp_detach(&mpc.pool);
+        mpc.stats.pool_pages = 0;
+    }
+    sqlite3_mutex_free(mpc.mutex);
+    mpc.mutex = RT_NULL;
+}
+
+static sqlite3_pcache *mpc_create(int page_size, int extra_size, int purgeable)
+{
+    struct mpc_cache *cache;
+
+    cache = sqlite3_malloc(sizeof(*cache));
+    if (cache == RT_NULL)
+    {
+        return RT_NULL;
+    }
+    memset(cache, 0, sizeof(*cache));
+    cache->page_size = page_size;
+    cache->extra_size = extra_size;
+    cache->purgeable = purgeable;
+    cache->pooled = mpc.stats.pool_pages && mpc_need(page_size, extra_size) <= mpc.stats.slot_size;
+    rt_list_init(&cache->lru);
+    return (sqlite3_pcache *)cache;
+}
+
+static void mpc_cachesize(sqlite3_pcache *p, int max_pages)
+{
+    struct mpc_cache *cache = (struct mpc_cache *)p;
+
+    sqlite3_mutex_enter(mpc.mutex);
+    cache->max_pages = max_pages > 0 ? max_pages : 0;
+    while (cache->purgeable && cache->unpinned && cache->pages > mpc_max(cache))
+    {
+        mpc_discard_oldest(cache);
+    }
+    sqlite3_mutex_leave(mpc.mutex);
+}
+
+static int mpc_pagecount(sqlite3_pcache *p)
+{
+    return ((struct mpc_cache *)p)->pages;
+}
+
+static sqlite3_pcache_page *mpc_fetch(sqlite3_pcache *p, unsigned int key, int create)
+{
+    struct mpc_cache *cache = (struct mpc_cache *)p;
+    struct mpc_page *page, *victim;
+    unsigned int max, pinned;
+    void *block = RT_NULL;
+    int pooled = 0;
+
+    sqlite3_mutex_enter(mpc.mutex);
+    page = mpc_hash_find(cache, key);
+    if (page)
+    {
+        mpc.stats.hits++;
+        mpc_pin(page);
+        goto __exit;
+    }
+    if (create == 0)
+    {
+        goto __exit;
+    }
+
+    /* an easy request fails near the budget, so SQLite spills a dirty page and asks again */
+    max = mpc_max(cache);
+    pinned = cache->pages - cache->unpinned;
+    if (create == 1 && cache->purgeable &&
+            (pinned >= max - max / 10 ||
+             (cache->pooled && cache->unpinned == 0 && rt_list_isempty(&mpc.lru) &&
+              mpc.stats.pool_used >= mpc.stats.pool_pages)))
+    {
+        goto __exit;
+    }
+
+    if (cache->purgeable && cache->unpinned && cache->pages >= max)
+    {
+        victim = rt_list_entry(cache->lru.prev, struct mpc_page, cache_lru);
+        pooled = victim->pooled;
+        block = mpc_take(victim);
+        mpc.stats.evictions++;
+    }
+    else if (cache->pooled)
+    {
+        if (mpc.stats.pool_used < mpc.stats.pool_pages)
+        {
+            block = rt_mp_alloc(&mpc.pool, RT_WAITING_NO);
+        }
+        if (block)
+        {
+            pooled = 1;
+            if (++mpc.stats.pool_used > mpc.stats.pool_peak)
+            {
+                mpc.stats.pool_peak = mpc.stats.pool_used;
+            }
+        }
+        else if (!rt_list_isempty(&mpc.lru))
+        {
+            victim = rt_list_entry(mpc.lru.prev, struct mpc_page, pool_lru);
+            pooled = 1;
+            block = mpc_take(victim);
+            mpc.stats.evictions++;
+        }
+    }
+    if (block == RT_NULL && (create == 2 || !cache->pooled))
+    {
+        block = sqlite3_malloc64(mpc_need(cache->page_size, cache->extra_size));
+        if (block == RT_NULL)
+        {
+            goto __exit;
+        }
+        mpc.stats.heap_pages++;
+    }
+    if (block == RT_NULL)
+    {
+        goto __exit;
+    }
+
+    page = (struct mpc_page *)((rt_uint8_t *)MPC_ROUND((rt_ubase_t)block) +
+                               MPC_ROUND(cache->page_size) + MPC_ROUND(cache->extra_size));
+    page->base.pBuf = (rt_uint8_t *)MPC_ROUND((rt_ubase_t)block);
+    page->base.pExtra = (rt_uint8_t *)page->base.pBuf + MPC_ROUND(cache->page_size);
+    page->cache = cache;
+    page->block = block;
+    page->key = key;
+    page->pooled = pooled;
+    page->pinned = 1;
+    rt_list_init(&page->cache_lru);
+    rt_list_init(&page->pool_lru);
+    /* SQLite tells a fresh page by the first pointer of its extra bytes */
+    *(void **)page->base.pExtra = RT_NULL;
+    mpc_hash_insert(cache, page);
+    cache->pages++;
+    if (key > cache->max_key)
+    {
+        cache->max_key = key;
+    }
+    mpc.stats.misses++;
+
+__exit:
+    sqlite3_mutex_leave(mpc.mutex);
+    return page ? &page->base : RT_NULL;
+}
+
+static void mpc_unpin(sqlite3_pcache *p, sqlite3_pcache_page *pg, int discard)
+{
+    struct mpc_cache *cache = (struct mpc_cache *)p;
+    struct mpc_page *page = (struct mpc_page *)pg;
+
+    sqlite3_mutex_enter(mpc.mutex);
+    /* a heap page is given back as soon as the pool has room again */
+    if (discard || cache->pages > mpc_max(cache) ||
+            (!page->pooled && cache->pooled && mpc.stats.pool_used < mpc.stats.pool_pages))
+    {
+        mpc_discard(page);
+    }
+    else
+    {
+        page->pinned = 0;
+        cache->unpinned++;
+        rt_list_insert_after(&cache->lru, &page->cache_lru);
+        if (page->pooled)
+        {
+            rt_list_insert_after(&mpc.lru, &page->pool_lru);
+        }
+    }
+    sqlite3_mutex_leave(mpc.mutex);
+}
+
+static void mpc_rekey(sqlite3_pcache *p, sqlite3_pcache_page *pg, unsigned int old_key, unsigned int new_key)
+{
+    struct mpc_cache *cache = (struct mpc_cache *)p;
+    struct mpc_page *page = (struct mpc_page *)pg;
+
+    sqlite3_mutex_enter(mpc.mutex);
+    mpc_hash_remove(cache, page);
+    page->key = new_key;
+    mpc_hash_insert(cache, page);
+    if (new_key > cache->max_key)
+    {
+        cache->max_key = new_key;
+    }
+    sqlite3_mutex_leave(mpc.mutex);
+}
+
+static void mpc_truncate(sqlite3_pcache *p, unsigned int limit)
+{
+    sqlite3_mutex_enter(mpc.mutex);
+    mpc_truncate_locked((struct mpc_cache *)p, limit);
+    sqlite3_mutex_leave(mpc.mutex);
+}
+
+static void mpc_destroy(sqlite3_pcache *p)
+{
+    struct mpc_cache *cache = (struct mpc_cache *)p;
+
+    sqlite3_mutex_enter(mpc.mutex);
+    mpc_truncate_locked(cache, 0);
+    sqlite3_mutex_leave(mpc.mutex);
+    sqlite3_free(cache->hash);
+    sqlite3_free(cache);
+}
+
+static void mpc_shrink(sqlite3_pcache *p)
+{
+    struct mpc_cache *cache = (struct mpc_cache *)p;
+
+    sqlite3_mutex_enter(mpc.mutex);
+    while (cache->unpinned)
+    {
+        mpc_discard_oldest(cache);
+    }
+    sqlite3_mutex_leave(mpc.mutex);
+}
+
+int db_pcache_register(void *region, rt_size_t size)
+{
+    static const sqlite3_pcache_methods2 methods =
+    {
+        1,                          /* iVersion */
+        RT_NULL,                    /* pArg */
+        mpc_init,
+        mpc_shutdown,
+        mpc_create,
+        mpc_cachesize,
+        mpc_pagecount,
+        mpc_fetch,
+        mpc_unpin,
+        mpc_rekey,
+        mpc_truncate,
+        mpc_destroy,
+        mpc_shrink
+    };
+    int rc;
+
+    if (region == RT_NULL)
+    {
+        region = MPC_REGION;
+        size = PKG_SQLITE_PCACHE_SIZE;
+    }
+    rc = sqlite3_config(SQLITE_CONFIG_PCACHE2, &methods);
+    if (rc == SQLITE_OK)
+    {
+        mpc.region = region;
+        mpc.region_size = size;
+    }
+    return rc;
+}
+
+int db_pcache_limit(int pages)
+{
+    int old;
+
+    sqlite3_mutex_enter(mpc.mutex);
+    old = mpc.limit;
+    if (pages >= 0)
+    {
+        mpc.limit = pages;
+    }
+    sqlite3_mutex_leave(mpc.mutex);
+    return old;
+}
+
+void db_pcache_stats(struct db_pcache_stats *stats, int reset)
+{
+    sqlite3_mutex_enter(mpc.mutex);
+    *stats = mpc.stats;
+    if (reset)
+    {
+        mpc.stats.hits = 0;
+        mpc.stats.misses = 0;
+        mpc.stats.evictions = 0;
+        mpc.stats.heap_pages = 0;
+        mpc.stats.pool_peak = mpc.stats.pool_used;
+    }
+    sqlite3_mutex_leave(mpc.mutex);
+}
+
+#ifdef RT_USING_FINSH
+static void sqlpc(int argc, char **argv)
+{
+    struct db_pcache_stats st;
+    unsigned int total;
+    char line[160];
+
+    db_pcache_stats(&st, argc >= 2 && rt_strcmp(argv[1], "reset") == 0);
+    total = st.hits + st.misses;
+
+    /* rt_kprintf() has no floating point conversions, sqlite3_snprintf() does */
+    sqlite3_snprintf(sizeof(line), line, "%u hits, %u misses, hit rate %.1f%%, %u evictions, %u heap pages",
+                     st.hits, st.misses, total ? 100.0 * st.hits / total : 0.0, st.evictions, st.heap_pages);
+    rt_kprintf("%s\n", line);
+    rt_kprintf("pool: %u/%u slots of %u bytes used, peak %u\n",
+               st.pool_used, st.pool_pages, st.slot_size, st.pool_peak);
+}
+MSH_CMD_EXPORT(sqlpc, sqlite pool page cache statistics: sqlpc [reset]);
+#endif
@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2026-10-19     RT-Thread    first version
+ */
+
+#ifndef __DBPCACHE_H__
+#define __DBPCACHE_H__
+
+#include <rtthread.h>
+#include <sqlite3.h>
+
+/* counters of the pool page cache since start or the last reset */
+struct db_pcache_stats
+{
+    unsigned int hits;              /* fetches of a page already cached */
+    unsigned int misses;            /* fetches that had to create the page */
+    unsigned int evictions;         /* unpinned pages recycled to make room */
+    unsigned int heap_pages;        /* pages taken from the heap, pool full or page too large */
+    unsigned int pool_pages;        /* page slots of the pool */
+    unsigned int pool_used;         /* slots in use now */
+    unsigned int pool_peak;         /* most slots ever in use */
+    unsigned int slot_size;         /* bytes of one slot */
+};
+
+/**
+ * This function will make SQLite keep its page caches in a fixed-size
+ * rt_mp memory pool. Every slot of the pool holds one page of up to
+ * PKG_SQLITE_PCACHE_PAGE_SIZE bytes, so a page given up by one connection
+ * can be recycled by any other. It must be called before sqlite3_initialize(),
+ * db_helper_init() does so when PKG_SQLITE_PCACHE is defined.
+ *
+ * @param region the memory of the pool, e.g. an SRAM/DTCM or SDRAM area,
+ *        RT_NULL for the PKG_SQLITE_PCACHE_SIZE bytes set in menuconfig.
+ * @param size the bytes of region.
+ * @return SQLITE_OK on success, SQLITE_MISUSE once SQLite is initialized.
+ */
+int db_pcache_register(void *region, rt_size_t size);
+
+/**
+ * This function will set the most pages one database connection may keep,
+ * on top of its PRAGMA cache_size. The pool itself is the budget of all of
+ * them together.
+ *
+ * @param pages the page limit of one cache, 0 for no limit, negative to
+ *        only query.
+ * @return the previous limit.
+ */
+int db_pcache_limit(int pages);
+
+/**
+ * This function will get the counters of the pool page cache. The hit
+ * rates of one connection are read with sqlite3_db_status().
+ *
+ * @param stats the counters.
+ * @param reset non-zero to clear the counters after reading them.
+ */
+void db_pcache_stats(struct db_pcache_stats *stats, int reset);
+
+#endif
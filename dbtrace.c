@@ -0,0 +1,436 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2026-10-19     RT-Thread    first version
+ */
+
+#include <rtthread.h>
+#include <string.h>
+#include <stdlib.h>
+#include <dfs_posix.h>
+#include "sqlite3.h"
+#include "dbtrace.h"
+
+#define DBG_ENABLE
+#define DBG_SECTION_NAME "app.dbtrace"
+#define DBG_LEVEL DBG_INFO
+#define DBG_COLOR
+#include <rtdbg.h>
+
+#ifndef PKG_SQLITE_TRACE_RECORDS
+#define PKG_SQLITE_TRACE_RECORDS 512
+#endif
+
+#define TRACE_VFS_NAME "trace"
+
+/*
+ * A pass-through VFS over the default one that appends every call to a
+ * ring buffer of PKG_SQLITE_TRACE_RECORDS records. When the ring is full
+ * the oldest records are overwritten and counted as dropped.
+ */
+struct trace_file
+{
+    sqlite3_file base;
+    sqlite3_file *real;
+    rt_uint16_t id;
+};
+
+static struct
+{
+    struct sqltrace_record *ring;
+    rt_uint32_t head;               /* records written since start */
+    rt_uint32_t next_temp;          /* next id handed to a temporary file */
+    int recording;
+    char names[SQLTRACE_NAMES][SQLTRACE_NAME_LEN];
+    rt_uint32_t nnames;
+} trace;
+
+static sqlite3_vfs trace_vfs;
+static sqlite3_io_methods trace_io_methods;
+
+static sqlite3_mutex *trace_mutex(void)
+{
+    return sqlite3_mutex_alloc(SQLITE_MUTEX_STATIC_APP1);
+}
+
+static void trace_add(rt_uint16_t id, int op, rt_uint32_t arg, int result, sqlite3_int64 offset)
+{
+    struct sqltrace_record *rec;
+
+    if (!trace.recording)
+    {
+        return;
+    }
+    sqlite3_mutex_enter(trace_mutex());
+    rec = &trace.ring[trace.head % PKG_SQLITE_TRACE_RECORDS];
+    rec->time = rt_tick_get();
+    rec->file = id;
+    rec->op = op;
+    rec->reserved = 0;
+    rec->arg = arg;
+    rec->result = result;
+    rec->offset = offset;
+    trace.head++;
+    sqlite3_mutex_leave(trace_mutex());
+}
+
+/*
+ * Give a file its trace id: named files keep the same id for every handle
+ * opened on them, temporary files get a fresh one above the name table.
+ */
+static rt_uint16_t trace_file_id(const char *name)
+{
+    rt_uint32_t i;
+    rt_uint16_t id;
+
+    sqlite3_mutex_enter(trace_mutex());
+    if (name == RT_NULL)
+    {
+        id = SQLTRACE_NAMES + trace.next_temp++;
+        sqlite3_mutex_leave(trace_mutex());
+        return id;
+    }
+    for (i = 0; i < trace.nnames; i++)
+    {
+        if (strncmp(trace.names[i], name, SQLTRACE_NAME_LEN - 1) == 0)
+        {
+            break;
+        }
+    }
+    if (i == trace.nnames && trace.nnames < SQLTRACE_NAMES)
+    {
+        strncpy(trace.names[i], name, SQLTRACE_NAME_LEN - 1);
+        trace.nnames++;
+    }
+    id = (i < SQLTRACE_NAMES) ? i : SQLTRACE_NAMES + trace.next_temp++;
+    sqlite3_mutex_leave(trace_mutex());
+    return id;
+}
+
+static int trace_io_close(sqlite3_file *f)
+{
+    struct trace_file *p = (struct trace_file *)f;
+    int rc = p->real->pMethods->xClose(p->real);
+    trace_add(p->id, SQLTRACE_CLOSE, 0, rc, 0);
+    sqlite3_free(p->real);
+    return rc;
+}
+
+static int trace_io_read(sqlite3_file *f, void *buf, int amt, sqlite3_int64 ofst)
+{
+    struct trace_file *p = (struct trace_file *)f;
+    int rc = p->real->pMethods->xRead(p->real, buf, amt, ofst);
+    trace_add(p->id, SQLTRACE_READ, amt, rc, ofst);
+    return rc;
+}
+
+static int trace_io_write(sqlite3_file *f, const void *buf, int amt, sqlite3_int64 ofst)
+{
+    struct trace_file *p = (struct trace_file *)f;
+    int rc = p->real->pMethods->xWrite(p->real, buf, amt, ofst);
+    trace_add(p->id, SQLTRACE_WRITE, amt, rc, ofst);
+    return rc;
+}
+
+static int trace_io_truncate(sqlite3_file *f, sqlite3_int64 size)
+{
+    struct trace_file *p = (struct trace_file *)f;
+    int rc = p->real->pMethods->xTruncate(p->real, size);
+    trace_add(p->id, SQLTRACE_TRUNCATE, 0, rc, size);
+    return rc;
+}
+
+static int trace_io_sync(sqlite3_file *f, int flags)
+{
+    struct trace_file *p = (struct trace_file *)f;
+    int rc = p->real->pMethods->xSync(p->real, flags);
+    trace_add(p->id, SQLTRACE_SYNC, flags, rc, 0);
+    return rc;
+}
+
+static int trace_io_file_size(sqlite3_file *f, sqlite3_int64 *size)
+{
+    struct trace_file *p = (struct trace_file *)f;
+    int rc = p->real->pMethods->xFileSize(p->real, size);
+    trace_add(p->id, SQLTRACE_FILESIZE, 0, rc, rc == SQLITE_OK ? *size : 0);
+    return rc;
+}
+
+static int trace_io_lock(sqlite3_file *f, int lock)
+{
+    struct trace_file *p = (struct trace_file *)f;
+    int rc = p->real->pMethods->xLock(p->real, lock);
+    trace_add(p->id, SQLTRACE_LOCK, lock, rc, 0);
+    return rc;
+}
+
+static int trace_io_unlock(sqlite3_file *f, int lock)
+{
+    struct trace_file *p = (struct trace_file *)f;
+    int rc = p->real->pMethods->xUnlock(p->real, lock);
+    trace_add(p->id, SQLTRACE_UNLOCK, lock, rc, 0);
+    return rc;
+}
+
+static int trace_io_check_reserved(sqlite3_file *f, int *out)
+{
+    struct trace_file *p = (struct trace_file *)f;
+    return p->real->pMethods->xCheckReservedLock(p->real, out);
+}
+
+static int trace_io_file_control(sqlite3_file *f, int op, void *arg)
+{
+    struct trace_file *p = (struct trace_file *)f;
+    return p->real->pMethods->xFileControl(p->real, op, arg);
+}
+
+static int trace_io_sector_size(sqlite3_file *f)
+{
+    struct trace_file *p = (struct trace_file *)f;
+    return p->real->pMethods->xSectorSize(p->real);
+}
+
+static int trace_io_device_characteristics(sqlite3_file *f)
+{
+    struct trace_file *p = (struct trace_file *)f;
+    return p->real->pMethods->xDeviceCharacteristics(p->real);
+}
+
+static int trace_vfs_open(sqlite3_vfs *vfs, const char *name, sqlite3_file *f, int flags, int *out_flags)
+{
+    sqlite3_vfs *root = (sqlite3_vfs *)vfs->pAppData;
+    struct trace_file *p = (struct trace_file *)f;
+    int rc;
+
+    memset(p, 0, sizeof(struct trace_file));
+    p->real = sqlite3_malloc(root->szOsFile);
+    if (p->real == RT_NULL)
+    {
+        return SQLITE_NOMEM;
+    }
+    memset(p->real, 0, root->szOsFile);
+
+    p->id = trace_file_id(name);
+    rc = root->xOpen(root, name, p->real, flags, out_flags);
+    trace_add(p->id, SQLTRACE_OPEN, flags, rc, 0);
+    if (rc != SQLITE_OK || p->real->pMethods == RT_NULL)
+    {
+        sqlite3_free(p->real);
+        p->real = RT_NULL;
+        return rc;
+    }
+    p->base.pMethods = &trace_io_methods;
+    return SQLITE_OK;
+}
+
+static int trace_vfs_delete(sqlite3_vfs *vfs, const char *name, int sync_dir)
+{
+    sqlite3_vfs *root = (sqlite3_vfs *)vfs->pAppData;
+    int rc = root->xDelete(root, name, sync_dir);
+    trace_add(trace_file_id(name), SQLTRACE_DELETE, sync_dir, rc, 0);
+    return rc;
+}
+
+static int trace_vfs_access(sqlite3_vfs *vfs, const char *name, int flags, int *out)
+{
+    sqlite3_vfs *root = (sqlite3_vfs *)vfs->pAppData;
+    int rc = root->xAccess(root, name, flags, out);
+    trace_add(trace_file_id(name), SQLTRACE_ACCESS, flags, *out, 0);
+    return rc;
+}
+
+static int trace_vfs_fullpathname(sqlite3_vfs *vfs, const char *name, int n, char *out)
+{
+    sqlite3_vfs *root = (sqlite3_vfs *)vfs->pAppData;
+    return root->xFullPathname(root, name, n, out);
+}
+
+static int trace_vfs_randomness(sqlite3_vfs *vfs, int n, char *out)
+{
+    sqlite3_vfs *root = (sqlite3_vfs *)vfs->pAppData;
+    return root->xRandomness(root, n, out);
+}
+
+static int trace_vfs_sleep(sqlite3_vfs *vfs, int us)
+{
+    sqlite3_vfs *root = (sqlite3_vfs *)vfs->pAppData;
+    return root->xSleep(root, us);
+}
+
+static int trace_vfs_current_time(sqlite3_vfs *vfs, double *now)
+{
+    sqlite3_vfs *root = (sqlite3_vfs *)vfs->pAppData;
+    return root->xCurrentTime(root, now);
+}
+
+static int trace_vfs_register(void)
+{
+    /* wrap whatever VFS is the default now, rt-thread, logfs, zip... */
+    sqlite3_vfs *root = sqlite3_vfs_find(RT_NULL);
+
+    if (root == RT_NULL)
+    {
+        return SQLITE_ERROR;
+    }
+    if (root == &trace_vfs)
+    {
+        return SQLITE_OK;
+    }
+    if (trace_vfs.zName)
+    {
+        trace_vfs.mxPathname = root->mxPathname;
+        trace_vfs.pAppData = root;
+        return sqlite3_vfs_register(&trace_vfs, 1);
+    }
+
+    trace_io_methods.iVersion = 1;
+    trace_io_methods.xClose = trace_io_close;
+    trace_io_methods.xRead = trace_io_read;
+    trace_io_methods.xWrite = trace_io_write;
+    trace_io_methods.xTruncate = trace_io_truncate;
+    trace_io_methods.xSync = trace_io_sync;
+    trace_io_methods.xFileSize = trace_io_file_size;
+    trace_io_methods.xLock = trace_io_lock;
+    trace_io_methods.xUnlock = trace_io_unlock;
+    trace_io_methods.xCheckReservedLock = trace_io_check_reserved;
+    trace_io_methods.xFileControl = trace_io_file_control;
+    trace_io_methods.xSectorSize = trace_io_sector_size;
+    trace_io_methods.xDeviceCharacteristics = trace_io_device_characteristics;
+
+    trace_vfs.iVersion = 1;
+    trace_vfs.szOsFile = sizeof(struct trace_file);
+    trace_vfs.mxPathname = root->mxPathname;
+    trace_vfs.zName = TRACE_VFS_NAME;
+    trace_vfs.pAppData = root;
+    trace_vfs.xOpen = trace_vfs_open;
+    trace_vfs.xDelete = trace_vfs_delete;
+    trace_vfs.xAccess = trace_vfs_access;
+    trace_vfs.xFullPathname = trace_vfs_fullpathname;
+    trace_vfs.xRandomness = trace_vfs_randomness;
+    trace_vfs.xSleep = trace_vfs_sleep;
+    trace_vfs.xCurrentTime = trace_vfs_current_time;
+
+    return sqlite3_vfs_register(&trace_vfs, 1);
+}
+
+int db_trace_start(void)
+{
+    if (trace.ring == RT_NULL)
+    {
+        trace.ring = rt_malloc(PKG_SQLITE_TRACE_RECORDS * sizeof(struct sqltrace_record));
+        if (trace.ring == RT_NULL)
+        {
+            LOG_E("no memory for %d trace records", PKG_SQLITE_TRACE_RECORDS);
+            return -1;
+        }
+    }
+
+    sqlite3_mutex_enter(trace_mutex());
+    trace.head = 0;
+    trace.next_temp = 0;
+    trace.nnames = 0;
+    sqlite3_mutex_leave(trace_mutex());
+
+    if (trace_vfs_register() != SQLITE_OK)
+    {
+        LOG_E("register the trace VFS failed");
+        return -1;
+    }
+    trace.recording = 1;
+    return 0;
+}
+
+void db_trace_stop(void)
+{
+    trace.recording = 0;
+    /* hand the default back to the VFS the trace one wraps */
+    if (sqlite3_vfs_find(RT_NULL) == &trace_vfs)
+    {
+        sqlite3_vfs_register((sqlite3_vfs *)trace_vfs.pAppData, 1);
+    }
+}
+
+int db_trace_dump(const char *path)
+{
+    struct sqltrace_header hdr;
+    rt_uint32_t first, i;
+    int fd, ok = 1;
+
+    if (trace.ring == RT_NULL)
+    {
+        return -1;
+    }
+    fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0);
+    if (fd < 0)
+    {
+        LOG_E("open %s failed", path);
+        return -1;
+    }
+
+    sqlite3_mutex_enter(trace_mutex());
+    first = trace.head > PKG_SQLITE_TRACE_RECORDS ? trace.head - PKG_SQLITE_TRACE_RECORDS : 0;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = SQLTRACE_MAGIC;
+    hdr.tick_hz = RT_TICK_PER_SECOND;
+    hdr.names = trace.nnames;
+    hdr.records = trace.head - first;
+    hdr.dropped = first;
+
+    ok = write(fd, &hdr, sizeof(hdr)) == sizeof(hdr);
+    for (i = 0; ok && i < trace.nnames; i++)
+    {
+        ok = write(fd, trace.names[i], SQLTRACE_NAME_LEN) == SQLTRACE_NAME_LEN;
+    }
+    for (i = first; ok && i < trace.head; i++)
+    {
+        ok = write(fd, &trace.ring[i % PKG_SQLITE_TRACE_RECORDS], sizeof(struct sqltrace_record))
+             == sizeof(struct sqltrace_record);
+    }
+    sqlite3_mutex_leave(trace_mutex());
+
+    close(fd);
+    if (!ok)
+    {
+        LOG_E("write %s failed", path);
+        return -1;
+    }
+    return (int)hdr.records;
+}
+
+#ifdef RT_USING_FINSH
+static void sqltrace(int argc, char **argv)
+{
+    if (argc >= 2 && rt_strcmp(argv[1], "start") == 0)
+    {
+        if (db_trace_start() == 0)
+        {
+            rt_kprintf("tracing connections opened from now on, %d records ring\n", PKG_SQLITE_TRACE_RECORDS);
+        }
+    }
+    else if (argc >= 2 && rt_strcmp(argv[1], "stop") == 0)
+    {
+        db_trace_stop();
+        rt_kprintf("stopped, %d record(s), %d dropped\n",
+                   trace.head > PKG_SQLITE_TRACE_RECORDS ? PKG_SQLITE_TRACE_RECORDS : trace.head,
+                   trace.head > PKG_SQLITE_TRACE_RECORDS ? trace.head - PKG_SQLITE_TRACE_RECORDS : 0);
+    }
+    else if (argc >= 3 && rt_strcmp(argv[1], "dump") == 0)
+    {
+        int n = db_trace_dump(argv[2]);
+        if (n >= 0)
+        {
+            rt_kprintf("%d record(s) written to %s\n", n, argv[2]);
+        }
+    }
+    else
+    {
+        rt_kprintf("usage: sqltrace start|stop|dump FILE\n"
+                   "record the VFS calls of new connections, replay FILE with tools/sqltrace_replay\n");
+    }
+}
+MSH_CMD_EXPORT(sqltrace, record sqlite VFS calls);
+#endif
@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2026-10-19     RT-Thread    first version
+ */
+
+#ifndef __DBTRACE_H__
+#define __DBTRACE_H__
+
+#include <stdint.h>
+
+/*
+ * Trace file layout, shared with the host replay tool (tools/sqltrace_replay.c).
+ * All fields are little-endian:
+ *
+ *     struct sqltrace_header
+ *     char name[SQLTRACE_NAME_LEN] * header.names    paths of named files, by file id
+ *     struct sqltrace_record * header.records        oldest first
+ *
+ * File ids below header.names refer to a named file; higher ids are
+ * temporary files, which have no name.
+ */
+#define SQLTRACE_MAGIC          0x31435254  /* "TRC1" */
+#define SQLTRACE_NAME_LEN       64
+#define SQLTRACE_NAMES          16
+
+enum sqltrace_op
+{
+    SQLTRACE_OPEN = 1,          /* arg: SQLITE_OPEN_xxx flags */
+    SQLTRACE_CLOSE,
+    SQLTRACE_READ,              /* arg: bytes, offset */
+    SQLTRACE_WRITE,             /* arg: bytes, offset */
+    SQLTRACE_TRUNCATE,          /* offset: new size */
+    SQLTRACE_SYNC,              /* arg: SQLITE_SYNC_xxx flags */
+    SQLTRACE_FILESIZE,          /* offset: size returned */
+    SQLTRACE_LOCK,              /* arg: lock level */
+    SQLTRACE_UNLOCK,            /* arg: lock level */
+    SQLTRACE_DELETE,            /* arg: sync directory flag */
+    SQLTRACE_ACCESS,            /* arg: SQLITE_ACCESS_xxx, result: answer */
+};
+
+struct sqltrace_header
+{
+    uint32_t magic;
+    uint32_t tick_hz;           /* unit of sqltrace_record.time per second */
+    uint32_t names;             /* entries in the name table */
+    uint32_t records;           /* records following the name table */
+    uint32_t dropped;           /* records lost to ring buffer wrap */
+    uint32_t reserved;
+};
+
+struct sqltrace_record
+{
+    uint32_t time;              /* timestamp of the call */
+    uint16_t file;              /* file id */
+    uint8_t op;                 /* enum sqltrace_op */
+    uint8_t reserved;
+    uint32_t arg;
+    int32_t result;             /* SQLite result code of the call */
+    int64_t offset;
+};
+
+/**
+ * This function will start recording the calls of every connection opened
+ * from now on, by making the tracing VFS the default one. Earlier records
+ * are discarded.
+ *
+ * @return 0 on success, or -1 when out of memory.
+ */
+int db_trace_start(void);
+
+/**
+ * This function will stop recording and make the rt-thread VFS the default
+ * again. The records are kept until the next start.
+ */
+void db_trace_stop(void);
+
+/**
+ * This function will write the recorded calls to a trace file.
+ *
+ * @param path the trace file to create.
+ * @return the number of records written, or -1 on error.
+ */
+int db_trace_dump(const char *path);
+
+#endif
@@ -0,0 +1,427 @@
+/*
+** Asynchronous writes.
+**
+** xWrite on a flash file only queues the write and returns; one background
+** thread, "sqlaio", issues the queued writes of all files in the order they
+** were made. The data is copied into the queue while the copied bytes stay
+** within PKG_SQLITE_ASYNC_IO_SIZE. A write that does not fit, or whose copy
+** cannot be allocated, is queued with the caller's buffer instead and the
+** caller waits until it is written, so the order is kept and the memory of
+** the queue stays bounded.
+**
+** xSync is the durability barrier: it waits until every write queued on the
+** handle is done, returns the error of any that failed, and only then calls
+** fsync(). xTruncate, xClose and preallocation wait in the same way first.
+** Reads are patched with queued data that overlaps them, so every handle on
+** the file sees a write as soon as xWrite returns. A handle with writes in
+** flight shares its descriptor, and the file position with it, with the
+** thread, so its reads take the I/O lock the thread holds around each write.
+*/
+#if PKG_SQLITE_ASYNC_IO_SIZE > 0
+
+#if !SQLITE_THREADSAFE
+    #error "the async I/O thread needs SQLITE_THREADSAFE."
+#endif
+
+typedef struct rtthread_aio
+{
+    struct rtthread_aio *pNext;
+    RTTHREAD_SQLITE_FILE_T *file;   /* handle the write was made on */
+    void *pKey;                     /* inode of the file, the handle for private files */
+    sqlite3_int64 iOff;             /* file offset of pData[0] */
+    int nData;                      /* bytes to write */
+    const char *pData;              /* the copy following this header, or the caller's buffer */
+} RTTHREAD_AIO_T;
+
+static struct
+{
+    sqlite3_mutex *mutex;           /* protects everything below and nAioPending/rcAio of handles */
+    sqlite3_mutex *io;              /* held by the thread around each write */
+    rt_sem_t work;                  /* one count per queued write, 0 when there is no thread */
+    rt_sem_t done;                  /* released once per waiter after each write */
+    RTTHREAD_AIO_T *pHead;          /* oldest write, the one being written */
+    RTTHREAD_AIO_T *pTail;
+    int nWait;                      /* threads blocked on done */
+    sqlite3_int64 nLimit;           /* bytes that may be copied into the queue */
+    struct rtthread_aio_stats stats;
+} _rtthread_aio_g = { 0, 0, 0, 0, 0, 0, 0, PKG_SQLITE_ASYNC_IO_SIZE };
+
+static int _rtthread_io_pread(RTTHREAD_SQLITE_FILE_T *file, void *pbuf, int cnt, sqlite3_int64 offset);
+static int _rtthread_io_pwrite(RTTHREAD_SQLITE_FILE_T *file, const void *pbuf, int cnt, sqlite3_int64 offset);
+
+#define RTTHREAD_AIO_KEY(file)  ((file)->pInode ? (void*)(file)->pInode : (void*)(file))
+
+static void _rtthread_aio_entry(void *param)
+{
+    RTTHREAD_AIO_T *p;
+    RTTHREAD_SQLITE_FILE_T *file;
+    int bCopy;
+    int nWait;
+    int rc;
+
+    while (rt_sem_take(_rtthread_aio_g.work, RT_WAITING_FOREVER) == RT_EOK)
+    {
+        sqlite3_mutex_enter(_rtthread_aio_g.io);
+
+        sqlite3_mutex_enter(_rtthread_aio_g.mutex);
+        p = _rtthread_aio_g.pHead;
+        sqlite3_mutex_leave(_rtthread_aio_g.mutex);
+
+        rc = _rtthread_io_pwrite(p->file, p->pData, p->nData, p->iOff);
+
+        sqlite3_mutex_enter(_rtthread_aio_g.mutex);
+        _rtthread_aio_g.pHead = p->pNext;
+        if (_rtthread_aio_g.pHead == 0)
+        {
+            _rtthread_aio_g.pTail = 0;
+        }
+
+        /* a borrowed entry lives on the stack of a waiting writer, it must
+        ** not be touched once nAioPending has been decremented */
+        file = p->file;
+        bCopy = (p->pData == (const char*)&p[1]);
+        if (bCopy)
+        {
+            _rtthread_aio_g.stats.queued -= p->nData;
+        }
+        if (rc != SQLITE_OK)
+        {
+            _rtthread_aio_g.stats.errors++;
+            if (file->rcAio == SQLITE_OK)
+            {
+                file->rcAio = rc;
+            }
+        }
+        file->nAioPending--;
+
+        nWait = _rtthread_aio_g.nWait;
+        _rtthread_aio_g.nWait = 0;
+        sqlite3_mutex_leave(_rtthread_aio_g.mutex);
+
+        sqlite3_mutex_leave(_rtthread_aio_g.io);
+
+        while (nWait-- > 0)
+        {
+            rt_sem_release(_rtthread_aio_g.done);
+        }
+
+        if (bCopy)
+        {
+            sqlite3_free(p);
+        }
+    }
+}
+
+/*
+** Start the writer thread. Without it every write is made synchronously.
+*/
+static void _rtthread_aio_init(void)
+{
+    rt_thread_t tid;
+
+    _rtthread_aio_g.mutex = sqlite3_mutex_alloc(SQLITE_MUTEX_FAST);
+    _rtthread_aio_g.io = sqlite3_mutex_alloc(SQLITE_MUTEX_FAST);
+    _rtthread_aio_g.done = rt_sem_create("sqlaiod", 0, RT_IPC_FLAG_FIFO);
+    _rtthread_aio_g.work = rt_sem_create("sqlaio", 0, RT_IPC_FLAG_FIFO);
+
+    tid = RT_NULL;
+    if (_rtthread_aio_g.mutex && _rtthread_aio_g.io && _rtthread_aio_g.done && _rtthread_aio_g.work)
+    {
+        tid = rt_thread_create("sqlaio", _rtthread_aio_entry, RT_NULL, PKG_SQLITE_ASYNC_IO_STACK,
+                               PKG_SQLITE_ASYNC_IO_PRIORITY, 10);
+    }
+
+    if (tid == RT_NULL || rt_thread_startup(tid) != RT_EOK)
+    {
+        sqlite3_log(SQLITE_NOMEM, "os_rtthread.c: cannot start the async I/O thread");
+        if (_rtthread_aio_g.work)
+        {
+            rt_sem_delete(_rtthread_aio_g.work);
+            _rtthread_aio_g.work = RT_NULL;
+        }
+    }
+}
+
+/*
+** Wait until every write queued on the handle is done. Returns the first
+** error of those writes, and clears it. A barrier is counted in the stats.
+*/
+static int _rtthread_aio_wait(RTTHREAD_SQLITE_FILE_T *file, int bBarrier)
+{
+    int rc;
+
+    if (_rtthread_aio_g.work == RT_NULL)
+    {
+        return SQLITE_OK;
+    }
+
+    sqlite3_mutex_enter(_rtthread_aio_g.mutex);
+
+    if (bBarrier && file->nAioPending > 0)
+    {
+        _rtthread_aio_g.stats.barriers++;
+    }
+
+    while (file->nAioPending > 0)
+    {
+        _rtthread_aio_g.nWait++;
+        sqlite3_mutex_leave(_rtthread_aio_g.mutex);
+        rt_sem_take(_rtthread_aio_g.done, RT_WAITING_FOREVER);
+        sqlite3_mutex_enter(_rtthread_aio_g.mutex);
+    }
+
+    rc = file->rcAio;
+    file->rcAio = SQLITE_OK;
+
+    sqlite3_mutex_leave(_rtthread_aio_g.mutex);
+
+    return rc;
+}
+
+static int _rtthread_aio_drain(RTTHREAD_SQLITE_FILE_T *file)
+{
+    return _rtthread_aio_wait(file, 1);
+}
+
+/*
+** Queue a write, see above. The error of an earlier background write on
+** the handle is returned here if no barrier has reported it yet.
+*/
+static int _rtthread_aio_write(RTTHREAD_SQLITE_FILE_T *file, const void *pbuf, int cnt, sqlite3_int64 offset)
+{
+    RTTHREAD_AIO_T borrowed;
+    RTTHREAD_AIO_T *p = 0;
+    int bCopy = 0;
+    int rc;
+
+    if (_rtthread_aio_g.work == RT_NULL)
+    {
+        return _rtthread_io_pwrite(file, pbuf, cnt, offset);
+    }
+
+    sqlite3_mutex_enter(_rtthread_aio_g.mutex);
+
+    rc = file->rcAio;
+    file->rcAio = SQLITE_OK;
+
+    if (rc == SQLITE_OK && _rtthread_aio_g.stats.queued + cnt <= _rtthread_aio_g.nLimit)
+    {
+        /* reserve the room before copying outside the mutex */
+        _rtthread_aio_g.stats.queued += cnt;
+        bCopy = 1;
+    }
+
+    sqlite3_mutex_leave(_rtthread_aio_g.mutex);
+
+    if (rc != SQLITE_OK)
+    {
+        return rc;
+    }
+
+    if (bCopy)
+    {
+        p = (RTTHREAD_AIO_T*)sqlite3_malloc(sizeof(RTTHREAD_AIO_T) + cnt);
+
+        if (p)
+        {
+            memcpy(&p[1], pbuf, cnt);
+            p->pData = (const char*)&p[1];
+        }
+    }
+
+    if (p == 0)
+    {
+        p = &borrowed;
+        p->pData = (const char*)pbuf;
+    }
+
+    p->pNext = 0;
+    p->file = file;
+    p->pKey = RTTHREAD_AIO_KEY(file);
+    p->iOff = offset;
+    p->nData = cnt;
+
+    sqlite3_mutex_enter(_rtthread_aio_g.mutex);
+
+    if (p == &borrowed)
+    {
+        if (bCopy)
+        {
+            _rtthread_aio_g.stats.queued -= cnt;
+        }
+        _rtthread_aio_g.stats.borrowed++;
+    }
+    else
+    {
+        _rtthread_aio_g.stats.copied++;
+        if (_rtthread_aio_g.stats.queued > _rtthread_aio_g.stats.queued_peak)
+        {
+            _rtthread_aio_g.stats.queued_peak = _rtthread_aio_g.stats.queued;
+        }
+    }
+
+    if (_rtthread_aio_g.pTail)
+    {
+        _rtthread_aio_g.pTail->pNext = p;
+    }
+    else
+    {
+        _rtthread_aio_g.pHead = p;
+    }
+    _rtthread_aio_g.pTail = p;
+    file->nAioPending++;
+
+    sqlite3_mutex_leave(_rtthread_aio_g.mutex);
+
+    rt_sem_release(_rtthread_aio_g.work);
+
+    if (p == &borrowed)
+    {
+        /* the thread reads the caller's buffer, it must stay until written */
+        rc = _rtthread_aio_wait(file, 0);
+    }
+
+    return rc;
+}
+
+/*
+** Read through the queue. When neither the handle has writes in flight nor
+** another handle on the file has a queued write overlapping the range, the
+** file is read directly. Otherwise the read runs under the I/O lock, so no
+** queued write completes meanwhile, and every overlapping queued write is
+** then copied over the result, oldest first. A queued write past the end
+** of the file extends the result, with zeros in any gap.
+*/
+static int _rtthread_aio_read(RTTHREAD_SQLITE_FILE_T *file, void *pbuf, int cnt, sqlite3_int64 offset)
+{
+    void *pKey = RTTHREAD_AIO_KEY(file);
+    sqlite3_int64 iEnd = offset + cnt;
+    RTTHREAD_AIO_T *p;
+    int bBusy;
+    int got;
+
+    if (_rtthread_aio_g.work == RT_NULL)
+    {
+        return _rtthread_io_pread(file, pbuf, cnt, offset);
+    }
+
+    sqlite3_mutex_enter(_rtthread_aio_g.mutex);
+    bBusy = (file->nAioPending > 0);
+    for (p = _rtthread_aio_g.pHead; p && !bBusy; p = p->pNext)
+    {
+        bBusy = (p->pKey == pKey && p->iOff < iEnd && p->iOff + p->nData > offset);
+    }
+    sqlite3_mutex_leave(_rtthread_aio_g.mutex);
+
+    if (!bBusy)
+    {
+        return _rtthread_io_pread(file, pbuf, cnt, offset);
+    }
+
+    sqlite3_mutex_enter(_rtthread_aio_g.io);
+
+    got = _rtthread_io_pread(file, pbuf, cnt, offset);
+
+    if (got >= 0)
+    {
+        sqlite3_mutex_enter(_rtthread_aio_g.mutex);
+        for (p = _rtthread_aio_g.pHead; p; p = p->pNext)
+        {
+            sqlite3_int64 iLo;
+            sqlite3_int64 iHi;
+
+            if (p->pKey != pKey || p->iOff >= iEnd || p->iOff + p->nData <= offset)
+            {
+                continue;
+            }
+
+            iLo = (p->iOff > offset) ? p->iOff : offset;
+            iHi = (p->iOff + p->nData < iEnd) ? p->iOff + p->nData : iEnd;
+
+            if (iLo - offset > got)
+            {
+                memset((char*)pbuf + got, 0, (int)(iLo - offset) - got);
+            }
+            memcpy((char*)pbuf + (iLo - offset), p->pData + (iLo - p->iOff), (int)(iHi - iLo));
+
+            if (iHi - offset > got)
+            {
+                got = (int)(iHi - offset);
+            }
+            _rtthread_aio_g.stats.read_hits++;
+        }
+        sqlite3_mutex_leave(_rtthread_aio_g.mutex);
+    }
+
+    sqlite3_mutex_leave(_rtthread_aio_g.io);
+
+    return got;
+}
+
+/*
+** Raise *psize to the end of the last queued write on the file.
+*/
+static void _rtthread_aio_size(RTTHREAD_SQLITE_FILE_T *file, sqlite3_int64 *psize)
+{
+    void *pKey = RTTHREAD_AIO_KEY(file);
+    RTTHREAD_AIO_T *p;
+
+    if (_rtthread_aio_g.work == RT_NULL)
+    {
+        return;
+    }
+
+    sqlite3_mutex_enter(_rtthread_aio_g.mutex);
+    for (p = _rtthread_aio_g.pHead; p; p = p->pNext)
+    {
+        if (p->pKey == pKey && p->iOff + p->nData > *psize)
+        {
+            *psize = p->iOff + p->nData;
+        }
+    }
+    sqlite3_mutex_leave(_rtthread_aio_g.mutex);
+}
+
+sqlite3_int64 rtthread_vfs_aio_limit(sqlite3_int64 limit)
+{
+    sqlite3_int64 prior;
+
+    sqlite3_mutex_enter(_rtthread_aio_g.mutex);
+
+    prior = _rtthread_aio_g.nLimit;
+
+    if (limit >= 0)
+    {
+        _rtthread_aio_g.nLimit = limit;
+    }
+
+    sqlite3_mutex_leave(_rtthread_aio_g.mutex);
+
+    return prior;
+}
+
+void rtthread_vfs_aio_stats(struct rtthread_aio_stats *stats, int reset)
+{
+    if (_rtthread_aio_g.mutex == 0)
+    {
+        memset(stats, 0, sizeof(*stats));
+        return;
+    }
+
+    sqlite3_mutex_enter(_rtthread_aio_g.mutex);
+
+    *stats = _rtthread_aio_g.stats;
+
+    if (reset)
+    {
+        sqlite3_int64 queued = _rtthread_aio_g.stats.queued;
+
+        memset(&_rtthread_aio_g.stats, 0, sizeof(_rtthread_aio_g.stats));
+        _rtthread_aio_g.stats.queued = queued;
+        _rtthread_aio_g.stats.queued_peak = queued;
+    }
+
+    sqlite3_mutex_leave(_rtthread_aio_g.mutex);
+}
+
+#endif  /* PKG_SQLITE_ASYNC_IO_SIZE > 0 */
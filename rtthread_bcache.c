@@ -0,0 +1,661 @@
+/*
+** Block cache.
+**
+** A fixed pool of PKG_SQLITE_BLOCK_CACHE_SIZE bytes, split into blocks of
+** PKG_SQLITE_BLOCK_CACHE_BLOCK bytes, caches file content for every handle
+** of the process below the per-connection page caches, so that pages read
+** by one connection, or by an earlier connection to the same file, are not
+** read from the card again. A block is keyed by the inode entry of its file
+** and its block number; files private to one handle are keyed by the handle.
+** Blocks are replaced least recently used first.
+**
+** What a file does with the cache depends on its type, see
+** rtthread_vfs_bcache_policy(). A write-through file updates the blocks
+** it has cached and writes to the file at once. A write-back file keeps
+** written blocks dirty in the cache; they are written by the handle that
+** dirtied them at xSync, xTruncate, xClose and preallocation, or when that
+** handle evicts one of them. A dirty block of another handle is never
+** evicted; when every block is dirty or the cache is disabled for a file,
+** I/O goes straight to the file.
+**
+** Misses and write-backs are done under the cache mutex, so a block is
+** never read twice or replaced while in flight. Blocks of a file are
+** dropped when its inode entry is freed, when it is deleted or truncated,
+** and by rtthread_vfs_meta_invalidate().
+*/
+#if PKG_SQLITE_BLOCK_CACHE_SIZE > 0
+
+#define RTTHREAD_BCACHE_BLOCKS      (PKG_SQLITE_BLOCK_CACHE_SIZE / PKG_SQLITE_BLOCK_CACHE_BLOCK)
+
+typedef struct rtthread_bcache
+{
+    struct rtthread_bcache *pHash;  /* next block in the same hash bucket */
+    struct rtthread_bcache *pPrev;  /* LRU list, most recently used first */
+    struct rtthread_bcache *pNext;
+    void *pKey;                     /* inode entry or private handle, 0 when free */
+    RTTHREAD_SQLITE_FILE_T *pDirty; /* handle that has to write the block, 0 when clean */
+    sqlite3_int64 iBlock;           /* block number in the file */
+    int nData;                      /* valid bytes, less than a block only at the end of the file */
+} RTTHREAD_BCACHE_T;
+
+static struct
+{
+    sqlite3_mutex *mutex;
+    RTTHREAD_BCACHE_T *pLru;        /* most recently used, free blocks are at the tail */
+    RTTHREAD_BCACHE_T *pLruTail;
+    RTTHREAD_BCACHE_T *apHash[RTTHREAD_BCACHE_BLOCKS];
+    RTTHREAD_BCACHE_T aBlock[RTTHREAD_BCACHE_BLOCKS];
+    int aPolicy[RTTHREAD_IO_TYPES];
+    struct rtthread_bcache_stats stats[RTTHREAD_IO_TYPES];  /* totals of all handles by file type */
+} _rtthread_bcache_g;
+
+static char _rtthread_bcache_data[RTTHREAD_BCACHE_BLOCKS][PKG_SQLITE_BLOCK_CACHE_BLOCK];
+
+static int _rtthread_io_read_at(RTTHREAD_SQLITE_FILE_T *file, void *pbuf, int cnt, sqlite3_int64 offset);
+static int _rtthread_io_write_at(RTTHREAD_SQLITE_FILE_T *file, const void *pbuf, int cnt, sqlite3_int64 offset);
+
+#define RTTHREAD_BCACHE_KEY(file)   ((file)->pInode ? (void*)(file)->pInode : (void*)(file))
+#define RTTHREAD_BCACHE_DATA(p)     (_rtthread_bcache_data[(p) - _rtthread_bcache_g.aBlock])
+
+/* count an event on the handle and in the totals of its type */
+#define RTTHREAD_BCACHE_STAT(file, field) \
+    do { (file)->bc.field++; _rtthread_bcache_g.stats[(file)->eCacheType].field++; } while (0)
+
+static int _rtthread_bcache_hash(void *pKey, sqlite3_int64 iBlock)
+{
+    return (int)((((size_t)pKey >> 4) ^ (size_t)(iBlock * 31)) % RTTHREAD_BCACHE_BLOCKS);
+}
+
+static void _rtthread_bcache_init(void)
+{
+    int i;
+
+    _rtthread_bcache_g.mutex = sqlite3_mutex_alloc(SQLITE_MUTEX_FAST);
+    _rtthread_bcache_g.aPolicy[RTTHREAD_IO_DB] = RTTHREAD_BCACHE_THROUGH;
+    _rtthread_bcache_g.aPolicy[RTTHREAD_IO_JOURNAL] = RTTHREAD_BCACHE_OFF;
+    _rtthread_bcache_g.aPolicy[RTTHREAD_IO_TEMP] = RTTHREAD_BCACHE_BACK;
+
+    for (i = 0; i < RTTHREAD_BCACHE_BLOCKS; i++)
+    {
+        RTTHREAD_BCACHE_T *p = &_rtthread_bcache_g.aBlock[i];
+
+        p->pPrev = (i > 0) ? &p[-1] : 0;
+        p->pNext = (i < RTTHREAD_BCACHE_BLOCKS - 1) ? &p[1] : 0;
+    }
+
+    _rtthread_bcache_g.pLru = &_rtthread_bcache_g.aBlock[0];
+    _rtthread_bcache_g.pLruTail = &_rtthread_bcache_g.aBlock[RTTHREAD_BCACHE_BLOCKS - 1];
+}
+
+/*
+** Choose the policy of a handle being opened.
+*/
+static void _rtthread_bcache_attach(RTTHREAD_SQLITE_FILE_T *file)
+{
+    memset(&file->bc, 0, sizeof(file->bc));
+    file->eCacheType = _rtthread_io_type(file->flags);
+    file->eCache = _rtthread_bcache_g.aPolicy[file->eCacheType];
+}
+
+static void _rtthread_bcache_lru_unlink(RTTHREAD_BCACHE_T *p)
+{
+    if (p->pPrev) p->pPrev->pNext = p->pNext; else _rtthread_bcache_g.pLru = p->pNext;
+    if (p->pNext) p->pNext->pPrev = p->pPrev; else _rtthread_bcache_g.pLruTail = p->pPrev;
+}
+
+/*
+** Move a block to the head of the LRU list, or to the tail once freed.
+*/
+static void _rtthread_bcache_touch(RTTHREAD_BCACHE_T *p, int bTail)
+{
+    _rtthread_bcache_lru_unlink(p);
+
+    if (bTail)
+    {
+        p->pNext = 0;
+        p->pPrev = _rtthread_bcache_g.pLruTail;
+        if (p->pPrev) p->pPrev->pNext = p; else _rtthread_bcache_g.pLru = p;
+        _rtthread_bcache_g.pLruTail = p;
+    }
+    else
+    {
+        p->pPrev = 0;
+        p->pNext = _rtthread_bcache_g.pLru;
+        if (p->pNext) p->pNext->pPrev = p; else _rtthread_bcache_g.pLruTail = p;
+        _rtthread_bcache_g.pLru = p;
+    }
+}
+
+static RTTHREAD_BCACHE_T *_rtthread_bcache_find(void *pKey, sqlite3_int64 iBlock)
+{
+    RTTHREAD_BCACHE_T *p;
+
+    for (p = _rtthread_bcache_g.apHash[_rtthread_bcache_hash(pKey, iBlock)]; p; p = p->pHash)
+    {
+        if (p->pKey == pKey && p->iBlock == iBlock)
+        {
+            return p;
+        }
+    }
+
+    return 0;
+}
+
+/*
+** Take a block out of its hash bucket and put it at the LRU tail as free.
+*/
+static void _rtthread_bcache_free(RTTHREAD_BCACHE_T *p)
+{
+    RTTHREAD_BCACHE_T **pp;
+
+    if (p->pKey == 0)
+    {
+        return;
+    }
+
+    for (pp = &_rtthread_bcache_g.apHash[_rtthread_bcache_hash(p->pKey, p->iBlock)]; *pp; pp = &(*pp)->pHash)
+    {
+        if (*pp == p)
+        {
+            *pp = p->pHash;
+            break;
+        }
+    }
+
+    p->pKey = 0;
+    p->pDirty = 0;
+    p->pHash = 0;
+    _rtthread_bcache_touch(p, 1);
+}
+
+/*
+** Write a dirty block back through the handle that dirtied it.
+*/
+static int _rtthread_bcache_write_back(RTTHREAD_BCACHE_T *p)
+{
+    RTTHREAD_SQLITE_FILE_T *file = p->pDirty;
+    int rc = SQLITE_OK;
+
+    if (file && p->nData > 0)
+    {
+        rc = _rtthread_io_write_at(file, RTTHREAD_BCACHE_DATA(p), p->nData,
+                                   p->iBlock * PKG_SQLITE_BLOCK_CACHE_BLOCK);
+        RTTHREAD_BCACHE_STAT(file, writebacks);
+    }
+
+    if (rc == SQLITE_OK)
+    {
+        p->pDirty = 0;
+    }
+
+    return rc;
+}
+
+/*
+** Get a block to hold (pKey, iBlock): a free one, else the least recently
+** used clean one, else a dirty one of the handle asking, written back
+** first. Returns 0 if every block is dirty for other handles.
+*/
+static RTTHREAD_BCACHE_T *_rtthread_bcache_alloc(RTTHREAD_SQLITE_FILE_T *file, void *pKey, sqlite3_int64 iBlock)
+{
+    RTTHREAD_BCACHE_T *p;
+    int iHash;
+
+    for (p = _rtthread_bcache_g.pLruTail; p; p = p->pPrev)
+    {
+        if (p->pDirty == 0)
+        {
+            break;
+        }
+    }
+
+    if (p == 0)
+    {
+        for (p = _rtthread_bcache_g.pLruTail; p; p = p->pPrev)
+        {
+            if (p->pDirty == file && _rtthread_bcache_write_back(p) == SQLITE_OK)
+            {
+                break;
+            }
+        }
+    }
+
+    if (p == 0)
+    {
+        return 0;
+    }
+
+    if (p->pKey)
+    {
+        RTTHREAD_BCACHE_STAT(file, evictions);
+        _rtthread_bcache_free(p);
+    }
+
+    iHash = _rtthread_bcache_hash(pKey, iBlock);
+    p->pKey = pKey;
+    p->iBlock = iBlock;
+    p->nData = 0;
+    p->pDirty = 0;
+    p->pHash = _rtthread_bcache_g.apHash[iHash];
+    _rtthread_bcache_g.apHash[iHash] = p;
+    _rtthread_bcache_touch(p, 0);
+
+    return p;
+}
+
+/*
+** Read block iBlock of the file into a newly allocated cache block. Bytes
+** past the end of the file are zero. Returns 0 on error or when no block
+** can be had, with *pRc set on error.
+*/
+static RTTHREAD_BCACHE_T *_rtthread_bcache_load(RTTHREAD_SQLITE_FILE_T *file, sqlite3_int64 iBlock, int *pRc)
+{
+    RTTHREAD_BCACHE_T *p;
+    int n;
+
+    p = _rtthread_bcache_alloc(file, RTTHREAD_BCACHE_KEY(file), iBlock);
+
+    if (p == 0)
+    {
+        return 0;
+    }
+
+    n = _rtthread_io_read_at(file, RTTHREAD_BCACHE_DATA(p), PKG_SQLITE_BLOCK_CACHE_BLOCK,
+                             iBlock * PKG_SQLITE_BLOCK_CACHE_BLOCK);
+    RTTHREAD_BCACHE_STAT(file, misses);
+
+    if (n < 0)
+    {
+        _rtthread_bcache_free(p);
+        *pRc = SQLITE_IOERR_READ;
+        return 0;
+    }
+
+    memset(RTTHREAD_BCACHE_DATA(p) + n, 0, PKG_SQLITE_BLOCK_CACHE_BLOCK - n);
+    p->nData = n;
+
+    return p;
+}
+
+/*
+** Read through the cache, with the result of _rtthread_io_pread(). A clean
+** block that ends short of the range is read again, as the file may have
+** grown since; a dirty one is the end of the file.
+*/
+static int _rtthread_bcache_read(RTTHREAD_SQLITE_FILE_T *file, void *pbuf, int cnt, sqlite3_int64 offset)
+{
+    void *pKey = RTTHREAD_BCACHE_KEY(file);
+    sqlite3_int64 iEnd = offset + cnt;
+    sqlite3_int64 iOff = offset;
+    int rc = SQLITE_OK;
+
+    sqlite3_mutex_enter(_rtthread_bcache_g.mutex);
+
+    while (iOff < iEnd)
+    {
+        sqlite3_int64 iBlock = iOff / PKG_SQLITE_BLOCK_CACHE_BLOCK;
+        int iIn = (int)(iOff - iBlock * PKG_SQLITE_BLOCK_CACHE_BLOCK);
+        int n = PKG_SQLITE_BLOCK_CACHE_BLOCK - iIn;
+        RTTHREAD_BCACHE_T *p;
+
+        if (n > iEnd - iOff)
+        {
+            n = (int)(iEnd - iOff);
+        }
+
+        p = _rtthread_bcache_find(pKey, iBlock);
+
+        if (p && p->pDirty == 0 && p->nData < iIn + n)
+        {
+            _rtthread_bcache_free(p);
+            p = 0;
+        }
+
+        if (p)
+        {
+            RTTHREAD_BCACHE_STAT(file, hits);
+            _rtthread_bcache_touch(p, 0);
+        }
+        else
+        {
+            p = _rtthread_bcache_load(file, iBlock, &rc);
+        }
+
+        if (p == 0)
+        {
+            int got;
+
+            if (rc != SQLITE_OK)
+            {
+                break;
+            }
+
+            /* no room, read this part directly */
+            got = _rtthread_io_read_at(file, (char*)pbuf + (iOff - offset), n, iOff);
+            if (got < 0)
+            {
+                rc = SQLITE_IOERR_READ;
+                break;
+            }
+
+            iOff += got;
+            if (got < n)
+            {
+                break;
+            }
+            continue;
+        }
+
+        if (p->nData < iIn + n)
+        {
+            /* end of file inside this block */
+            if (p->nData > iIn)
+            {
+                memcpy((char*)pbuf + (iOff - offset), RTTHREAD_BCACHE_DATA(p) + iIn, p->nData - iIn);
+                iOff += p->nData - iIn;
+            }
+            break;
+        }
+
+        memcpy((char*)pbuf + (iOff - offset), RTTHREAD_BCACHE_DATA(p) + iIn, n);
+        iOff += n;
+    }
+
+    sqlite3_mutex_leave(_rtthread_bcache_g.mutex);
+
+    return (rc != SQLITE_OK) ? -1 : (int)(iOff - offset);
+}
+
+/*
+** Copy a write into the cached blocks. A write-through file updates only
+** the blocks already cached, then writes the file. A write-back file loads
+** the blocks it does not fully overwrite and leaves them dirty; a part
+** that finds no room goes to the file.
+*/
+static int _rtthread_bcache_write(RTTHREAD_SQLITE_FILE_T *file, const void *pbuf, int cnt, sqlite3_int64 offset)
+{
+    void *pKey = RTTHREAD_BCACHE_KEY(file);
+    sqlite3_int64 iEnd = offset + cnt;
+    sqlite3_int64 iOff = offset;
+    int bBack = (file->eCache == RTTHREAD_BCACHE_BACK);
+    int rc = SQLITE_OK;
+
+    sqlite3_mutex_enter(_rtthread_bcache_g.mutex);
+
+    while (iOff < iEnd && rc == SQLITE_OK)
+    {
+        sqlite3_int64 iBlock = iOff / PKG_SQLITE_BLOCK_CACHE_BLOCK;
+        int iIn = (int)(iOff - iBlock * PKG_SQLITE_BLOCK_CACHE_BLOCK);
+        int n = PKG_SQLITE_BLOCK_CACHE_BLOCK - iIn;
+        const char *pData = (const char*)pbuf + (iOff - offset);
+        RTTHREAD_BCACHE_T *p;
+
+        if (n > iEnd - iOff)
+        {
+            n = (int)(iEnd - iOff);
+        }
+
+        p = _rtthread_bcache_find(pKey, iBlock);
+
+        if (p == 0 && bBack)
+        {
+            if (n == PKG_SQLITE_BLOCK_CACHE_BLOCK)
+            {
+                p = _rtthread_bcache_alloc(file, pKey, iBlock);
+            }
+            else
+            {
+                p = _rtthread_bcache_load(file, iBlock, &rc);
+            }
+        }
+
+        if (p)
+        {
+            if (p->nData < iIn)
+            {
+                memset(RTTHREAD_BCACHE_DATA(p) + p->nData, 0, iIn - p->nData);
+            }
+            memcpy(RTTHREAD_BCACHE_DATA(p) + iIn, pData, n);
+            if (p->nData < iIn + n)
+            {
+                p->nData = iIn + n;
+            }
+            _rtthread_bcache_touch(p, 0);
+
+            if (bBack)
+            {
+                /* the latest writer owns the block, and writes it back */
+                p->pDirty = file;
+            }
+        }
+
+        if (rc == SQLITE_OK && (p == 0 || !bBack))
+        {
+            rc = _rtthread_io_write_at(file, pData, n, iOff);
+
+            if (rc != SQLITE_OK && p)
+            {
+                _rtthread_bcache_free(p);
+            }
+        }
+
+        iOff += n;
+    }
+
+    sqlite3_mutex_leave(_rtthread_bcache_g.mutex);
+
+    return rc;
+}
+
+/*
+** Write back every block dirtied through the handle.
+*/
+static int _rtthread_bcache_flush(RTTHREAD_SQLITE_FILE_T *file)
+{
+    int rc = SQLITE_OK;
+    int i;
+
+    if (file->eCache != RTTHREAD_BCACHE_BACK)
+    {
+        return SQLITE_OK;
+    }
+
+    sqlite3_mutex_enter(_rtthread_bcache_g.mutex);
+
+    for (i = 0; i < RTTHREAD_BCACHE_BLOCKS && rc == SQLITE_OK; i++)
+    {
+        if (_rtthread_bcache_g.aBlock[i].pDirty == file)
+        {
+            rc = _rtthread_bcache_write_back(&_rtthread_bcache_g.aBlock[i]);
+        }
+    }
+
+    sqlite3_mutex_leave(_rtthread_bcache_g.mutex);
+
+    return rc;
+}
+
+/*
+** Drop the cached content of a file from offset iSize on, dirty or not.
+*/
+static void _rtthread_bcache_drop(void *pKey, sqlite3_int64 iSize)
+{
+    int i;
+
+    if (_rtthread_bcache_g.pLru == 0)
+    {
+        return;
+    }
+
+    sqlite3_mutex_enter(_rtthread_bcache_g.mutex);
+
+    for (i = 0; i < RTTHREAD_BCACHE_BLOCKS; i++)
+    {
+        RTTHREAD_BCACHE_T *p = &_rtthread_bcache_g.aBlock[i];
+        sqlite3_int64 iStart = p->iBlock * PKG_SQLITE_BLOCK_CACHE_BLOCK;
+
+        if (p->pKey != pKey || iStart + p->nData <= iSize)
+        {
+            continue;
+        }
+
+        if (iStart >= iSize)
+        {
+            _rtthread_bcache_free(p);
+        }
+        else
+        {
+            p->nData = (int)(iSize - iStart);
+        }
+    }
+
+    sqlite3_mutex_leave(_rtthread_bcache_g.mutex);
+}
+
+static void _rtthread_bcache_forget(void *pKey)
+{
+    _rtthread_bcache_drop(pKey, 0);
+}
+
+/*
+** Closing a handle writes back its dirty blocks. The blocks of a private
+** file go with it, those of a named file stay for the next handle.
+*/
+static int _rtthread_bcache_detach(RTTHREAD_SQLITE_FILE_T *file)
+{
+    int rc;
+
+    if (file->pInode == 0)
+    {
+        _rtthread_bcache_forget(file);
+        return SQLITE_OK;
+    }
+
+    rc = _rtthread_bcache_flush(file);
+
+    if (rc != SQLITE_OK)
+    {
+        int i;
+
+        /* nobody is left to write them */
+        sqlite3_mutex_enter(_rtthread_bcache_g.mutex);
+        for (i = 0; i < RTTHREAD_BCACHE_BLOCKS; i++)
+        {
+            if (_rtthread_bcache_g.aBlock[i].pDirty == file)
+            {
+                _rtthread_bcache_free(&_rtthread_bcache_g.aBlock[i]);
+            }
+        }
+        sqlite3_mutex_leave(_rtthread_bcache_g.mutex);
+    }
+
+    return rc;
+}
+
+/*
+** Raise *psize to the end of the last dirty block of the file.
+*/
+static void _rtthread_bcache_size(RTTHREAD_SQLITE_FILE_T *file, sqlite3_int64 *psize)
+{
+    void *pKey = RTTHREAD_BCACHE_KEY(file);
+    int i;
+
+    sqlite3_mutex_enter(_rtthread_bcache_g.mutex);
+
+    for (i = 0; i < RTTHREAD_BCACHE_BLOCKS; i++)
+    {
+        RTTHREAD_BCACHE_T *p = &_rtthread_bcache_g.aBlock[i];
+
+        if (p->pKey == pKey && p->pDirty && p->iBlock * PKG_SQLITE_BLOCK_CACHE_BLOCK + p->nData > *psize)
+        {
+            *psize = p->iBlock * PKG_SQLITE_BLOCK_CACHE_BLOCK + p->nData;
+        }
+    }
+
+    sqlite3_mutex_leave(_rtthread_bcache_g.mutex);
+}
+
+int rtthread_vfs_bcache_policy(int type, int policy)
+{
+    int old;
+
+    if (type < 0 || type >= RTTHREAD_IO_TYPES)
+    {
+        return -1;
+    }
+
+    sqlite3_mutex_enter(_rtthread_bcache_g.mutex);
+
+    old = _rtthread_bcache_g.aPolicy[type];
+
+    if (policy >= RTTHREAD_BCACHE_OFF && policy <= RTTHREAD_BCACHE_BACK)
+    {
+        _rtthread_bcache_g.aPolicy[type] = policy;
+    }
+
+    sqlite3_mutex_leave(_rtthread_bcache_g.mutex);
+
+    return old;
+}
+
+void rtthread_vfs_bcache_stats(int type, struct rtthread_bcache_stats *stats, int reset)
+{
+    memset(stats, 0, sizeof(*stats));
+
+    if (type < 0 || type >= RTTHREAD_IO_TYPES)
+    {
+        return;
+    }
+
+    sqlite3_mutex_enter(_rtthread_bcache_g.mutex);
+
+    *stats = _rtthread_bcache_g.stats[type];
+
+    if (reset)
+    {
+        memset(&_rtthread_bcache_g.stats[type], 0, sizeof(_rtthread_bcache_g.stats[type]));
+    }
+
+    sqlite3_mutex_leave(_rtthread_bcache_g.mutex);
+}
+
+#if defined(RT_USING_FINSH)
+static void sqlbc(int argc, char **argv)
+{
+    static const char *azType[RTTHREAD_IO_TYPES] = { "db", "journal", "temp" };
+    static const char *azPolicy[] = { "off", "through", "back" };
+    struct rtthread_bcache_stats st;
+    int reset = (argc >= 2 && rt_strcmp(argv[1], "reset") == 0);
+    int nUsed = 0;
+    int nDirty = 0;
+    int i;
+
+    sqlite3_mutex_enter(_rtthread_bcache_g.mutex);
+    for (i = 0; i < RTTHREAD_BCACHE_BLOCKS; i++)
+    {
+        nUsed += (_rtthread_bcache_g.aBlock[i].pKey != 0);
+        nDirty += (_rtthread_bcache_g.aBlock[i].pDirty != 0);
+    }
+    sqlite3_mutex_leave(_rtthread_bcache_g.mutex);
+
+    rt_kprintf("blocks %d x %d bytes, %d used, %d dirty\n",
+               RTTHREAD_BCACHE_BLOCKS, PKG_SQLITE_BLOCK_CACHE_BLOCK, nUsed, nDirty);
+    rt_kprintf("%-8s %-8s %10s %10s %6s %10s %10s\n",
+               "type", "policy", "hits", "misses", "hit%", "writeback", "evictions");
+    for (i = 0; i < RTTHREAD_IO_TYPES; i++)
+    {
+        rtthread_vfs_bcache_stats(i, &st, reset);
+        rt_kprintf("%-8s %-8s %10u %10u %6u %10u %10u\n",
+                   azType[i], azPolicy[_rtthread_bcache_g.aPolicy[i]], st.hits, st.misses,
+                   (st.hits + st.misses) ? (unsigned int)((st.hits * 100ULL) / (st.hits + st.misses)) : 0,
+                   st.writebacks, st.evictions);
+    }
+}
+MSH_CMD_EXPORT(sqlbc, sqlite VFS block cache statistics: sqlbc [reset]);
+#endif
+
+#else
+
+#define _rtthread_bcache_attach(file)
+
+#endif  /* PKG_SQLITE_BLOCK_CACHE_SIZE > 0 */
@@ -1,44 +1,223 @@
-static int _rtthread_io_read(sqlite3_file *file_id, void *pbuf, int cnt, sqlite3_int64 offset)
+/*
+** Read up to cnt bytes at offset. Returns the number of bytes read, which is
+** less than cnt only at end of file, or -1 on error.
+*/
+static int _rtthread_io_pread(RTTHREAD_SQLITE_FILE_T *file, void *pbuf, int cnt, sqlite3_int64 offset)
 {
-    RTTHREAD_SQLITE_FILE_T *file = (RTTHREAD_SQLITE_FILE_T*)file_id;
     sqlite3_int64 new_offset;
     int r_cnt;
-
-    assert(file_id);
-    assert(offset >= 0);
-    assert(cnt > 0);
+    int got = 0;
 
     new_offset = lseek(file->fd, offset, SEEK_SET);
+    RTTHREAD_IO_STAT(file, seeks, 1);
 
     if (new_offset != offset)
     {
-        return SQLITE_IOERR_READ;
+        return -1;
     }
 
-    do {
-        r_cnt = read(file->fd, pbuf, cnt);
-
-        if (r_cnt == cnt)
-        {
-            break;
-        }
+    while (got < cnt)
+    {
+        RTTHREAD_IO_CLOCK(t);
+        r_cnt = read(file->fd, (char*)pbuf + got, cnt - got);
+        RTTHREAD_IO_ELAPSED(file, read_time, t);
+        RTTHREAD_IO_STAT(file, reads, 1);
 
         if (r_cnt < 0)
         {
             if (errno != EINTR)
             {
-                return SQLITE_IOERR_READ;
+                return -1;
             }
 
-            r_cnt = 1;
             continue;
         }
-        else if (r_cnt > 0)
+        else if (r_cnt == 0)
+        {
+            break;
+        }
+
+        got += r_cnt;
+        RTTHREAD_IO_STAT(file, read_bytes, r_cnt);
+    }
+
+    return got;
+}
+
+/*
+** Read through the queue of pending writes when there is one.
+*/
+static int _rtthread_io_read_at(RTTHREAD_SQLITE_FILE_T *file, void *pbuf, int cnt, sqlite3_int64 offset)
+{
+#if PKG_SQLITE_ASYNC_IO_SIZE > 0
+    return _rtthread_aio_read(file, pbuf, cnt, offset);
+#else
+    return _rtthread_io_pread(file, pbuf, cnt, offset);
+#endif
+}
+
+/*
+** Read through the block cache when the file uses it.
+*/
+static int _rtthread_io_read_cached(RTTHREAD_SQLITE_FILE_T *file, void *pbuf, int cnt, sqlite3_int64 offset)
+{
+#if PKG_SQLITE_BLOCK_CACHE_SIZE > 0
+    if (file->eCache != RTTHREAD_BCACHE_OFF)
+    {
+        return _rtthread_bcache_read(file, pbuf, cnt, offset);
+    }
+#endif
+
+    return _rtthread_io_read_at(file, pbuf, cnt, offset);
+}
+
+#if PKG_SQLITE_READAHEAD_SIZE > 0
+
+/* sequential reads needed before the window is filled */
+#define RTTHREAD_READAHEAD_TRIGGER  2
+
+/*
+** Empty the read-ahead window. Whatever was prefetched but never handed out
+** is accounted as waste.
+*/
+static void _rtthread_ra_drop(RTTHREAD_READAHEAD_T *ra)
+{
+    if (ra->nBuf > ra->nServed)
+    {
+        ra->stats.waste_bytes += ra->nBuf - ra->nServed;
+    }
+
+    ra->nBuf = 0;
+    ra->nServed = 0;
+}
+
+/*
+** Drop the window if [offset, offset + cnt) overlaps it, so that a write or
+** a truncate can never leave stale data behind.
+*/
+static void _rtthread_ra_invalidate(RTTHREAD_SQLITE_FILE_T *file, sqlite3_int64 offset, sqlite3_int64 cnt)
+{
+    RTTHREAD_READAHEAD_T *ra = &file->ra;
+
+    if (ra->nBuf > 0 && offset < ra->iOff + ra->nBuf && offset + cnt > ra->iOff)
+    {
+        _rtthread_ra_drop(ra);
+    }
+}
+
+/*
+** Read through the read-ahead window. A request fully inside the window is a
+** plain memcpy. Otherwise the request is a miss: random access resets the
+** window, while the RTTHREAD_READAHEAD_TRIGGER-th consecutive sequential
+** read fills it with one large read starting at the requested offset. The
+** window starts at two requests and doubles on each fill that was entirely
+** consumed, up to PKG_SQLITE_READAHEAD_SIZE.
+*/
+static int _rtthread_ra_read(RTTHREAD_SQLITE_FILE_T *file, void *pbuf, int cnt, sqlite3_int64 offset)
+{
+    RTTHREAD_READAHEAD_T *ra = &file->ra;
+    int consumed;
+    int n;
+
+    if (ra->nBuf > 0 && offset >= ra->iOff && offset + cnt <= ra->iOff + ra->nBuf)
+    {
+        memcpy(pbuf, ra->pBuf + (offset - ra->iOff), cnt);
+        ra->nServed += cnt;
+        ra->iNext = offset + cnt;
+        ra->stats.hits++;
+        return cnt;
+    }
+
+    consumed = (ra->nBuf > 0 && ra->nServed >= ra->nBuf);
+    _rtthread_ra_drop(ra);
+
+    if (offset == ra->iNext)
+    {
+        ra->nSeq++;
+    }
+    else
+    {
+        ra->nSeq = 0;
+        ra->nWindow = 0;
+    }
+
+    ra->iNext = offset + cnt;
+
+    if (ra->nSeq < RTTHREAD_READAHEAD_TRIGGER || cnt * 2 > PKG_SQLITE_READAHEAD_SIZE)
+    {
+        return _rtthread_io_read_cached(file, pbuf, cnt, offset);
+    }
+
+    if (ra->nWindow == 0)
+    {
+        ra->nWindow = cnt * 2;
+    }
+    else if (consumed && ra->nWindow * 2 <= PKG_SQLITE_READAHEAD_SIZE)
+    {
+        ra->nWindow *= 2;
+    }
+
+    if (ra->nWindow < cnt * 2)
+    {
+        ra->nWindow = cnt * 2;
+    }
+
+    if (ra->pBuf == 0)
+    {
+        ra->pBuf = sqlite3_malloc(PKG_SQLITE_READAHEAD_SIZE);
+
+        if (ra->pBuf == 0)
         {
-            cnt -= r_cnt;
-            pbuf = (void*)(r_cnt + (char*)pbuf);
+            return _rtthread_io_read_cached(file, pbuf, cnt, offset);
         }
-    } while (r_cnt > 0);
+    }
+
+    n = _rtthread_io_read_cached(file, ra->pBuf, ra->nWindow, offset);
+
+    if (n < 0)
+    {
+        return n;
+    }
+
+    ra->stats.fills++;
+    ra->stats.prefetch_bytes += n;
+
+    if (n <= cnt)
+    {
+        /* end of file inside the request, nothing left to keep */
+        memcpy(pbuf, ra->pBuf, n);
+        return n;
+    }
+
+    memcpy(pbuf, ra->pBuf, cnt);
+    ra->iOff = offset;
+    ra->nBuf = n;
+    ra->nServed = cnt;
+
+    return cnt;
+}
+
+#endif  /* PKG_SQLITE_READAHEAD_SIZE > 0 */
+
+static int _rtthread_io_read(sqlite3_file *file_id, void *pbuf, int cnt, sqlite3_int64 offset)
+{
+    RTTHREAD_SQLITE_FILE_T *file = (RTTHREAD_SQLITE_FILE_T*)file_id;
+    int r_cnt;
+
+    assert(file_id);
+    assert(offset >= 0);
+    assert(cnt > 0);
+
+#if PKG_SQLITE_READAHEAD_SIZE > 0
+    r_cnt = _rtthread_ra_read(file, pbuf, cnt, offset);
+#else
+    r_cnt = _rtthread_io_read_cached(file, pbuf, cnt, offset);
+#endif
+
+    if (r_cnt < 0)
+    {
+        return SQLITE_IOERR_READ;
+    }
 
     if (r_cnt != cnt)
     {
@@ -49,16 +228,17 @@ static int _rtthread_io_read(sqlite3_file *file_id, void *pbuf, int cnt, sqlite3
     return SQLITE_OK;
 }
 
-static int _rtthread_io_write(sqlite3_file* file_id, const void *pbuf, int cnt, sqlite3_int64 offset)
+/*
+** Write cnt bytes at offset. Returns SQLITE_OK, SQLITE_IOERR_WRITE or
+** SQLITE_FULL when the filesystem takes no more.
+*/
+static int _rtthread_io_pwrite(RTTHREAD_SQLITE_FILE_T *file, const void *pbuf, int cnt, sqlite3_int64 offset)
 {
-    RTTHREAD_SQLITE_FILE_T *file = (RTTHREAD_SQLITE_FILE_T*)file_id;
     sqlite3_int64 new_offset;
     int w_cnt;
 
-    assert(file_id);
-    assert(cnt > 0);
-
     new_offset = lseek(file->fd, offset, SEEK_SET);
+    RTTHREAD_IO_STAT(file, seeks, 1);
 
     if (new_offset != offset)
     {
@@ -66,7 +246,11 @@ static int _rtthread_io_write(sqlite3_file* file_id, const void *pbuf, int cnt,
     }
 
     do {
+        RTTHREAD_IO_CLOCK(t);
         w_cnt = write(file->fd, pbuf, cnt);
+        RTTHREAD_IO_ELAPSED(file, write_time, t);
+        RTTHREAD_IO_STAT(file, writes, 1);
+        RTTHREAD_IO_STAT(file, write_bytes, w_cnt > 0 ? w_cnt : 0);
 
         if (w_cnt == cnt)
         {
@@ -98,19 +282,159 @@ static int _rtthread_io_write(sqlite3_file* file_id, const void *pbuf, int cnt,
     return SQLITE_OK;
 }
 
+/*
+** Write through the queue of pending writes when there is one.
+*/
+static int _rtthread_io_write_at(RTTHREAD_SQLITE_FILE_T *file, const void *pbuf, int cnt, sqlite3_int64 offset)
+{
+#if PKG_SQLITE_ASYNC_IO_SIZE > 0
+    return _rtthread_aio_write(file, pbuf, cnt, offset);
+#else
+    return _rtthread_io_pwrite(file, pbuf, cnt, offset);
+#endif
+}
+
+/*
+** Write through the block cache when the file uses it.
+*/
+static int _rtthread_io_write_cached(RTTHREAD_SQLITE_FILE_T *file, const void *pbuf, int cnt, sqlite3_int64 offset)
+{
+#if PKG_SQLITE_BLOCK_CACHE_SIZE > 0
+    if (file->eCache != RTTHREAD_BCACHE_OFF)
+    {
+        return _rtthread_bcache_write(file, pbuf, cnt, offset);
+    }
+#endif
+
+    return _rtthread_io_write_at(file, pbuf, cnt, offset);
+}
+
+static int _rtthread_io_write(sqlite3_file* file_id, const void *pbuf, int cnt, sqlite3_int64 offset)
+{
+    RTTHREAD_SQLITE_FILE_T *file = (RTTHREAD_SQLITE_FILE_T*)file_id;
+    sqlite3_int64 end_offset = offset + cnt;
+    int rc;
+
+    assert(file_id);
+    assert(cnt > 0);
+
+#if PKG_SQLITE_READAHEAD_SIZE > 0
+    _rtthread_ra_invalidate(file, offset, cnt);
+#endif
+
+    rc = _rtthread_io_write_cached(file, pbuf, cnt, offset);
+
+    if (rc != SQLITE_OK)
+    {
+        return rc;
+    }
+
+    if (end_offset > file->iAlloc)
+    {
+        file->iAlloc = end_offset;
+    }
+
+    _rtthread_inode_set_size(file->pInode, end_offset, 1);
+
+    /* a reused journal is live again once written */
+    if (file->pInode && file->pInode->bZeroed)
+    {
+        _rtthread_vfs_enter_mutex();
+        file->pInode->bZeroed = 0;
+        _rtthread_vfs_leave_mutex();
+    }
+
+    return SQLITE_OK;
+}
+
 static int _rtthread_io_truncate(sqlite3_file* file_id, sqlite3_int64 size)
 {
+#ifdef PKG_SQLITE_VFS_USING_FTRUNCATE
+    RTTHREAD_SQLITE_FILE_T *file = (RTTHREAD_SQLITE_FILE_T*)file_id;
+#if PKG_SQLITE_ASYNC_IO_SIZE > 0 || PKG_SQLITE_BLOCK_CACHE_SIZE > 0
+    int rc;
+#endif
+
+    /* keep the file a whole number of chunks, as the size hint grows it,
+    ** the way unixTruncate() does */
+    if (file->szChunk > 0)
+    {
+        size = ((size + file->szChunk - 1) / file->szChunk) * file->szChunk;
+    }
+
+#if PKG_SQLITE_READAHEAD_SIZE > 0
+    _rtthread_ra_invalidate(file, size, (sqlite3_int64)1 << 62);
+#endif
+
+#if PKG_SQLITE_BLOCK_CACHE_SIZE > 0
+    /* dirty blocks end at the old end of file, which is about to move */
+    rc = _rtthread_bcache_flush(file);
+    if (rc != SQLITE_OK)
+    {
+        return rc;
+    }
+#endif
+
+#if PKG_SQLITE_ASYNC_IO_SIZE > 0
+    rc = _rtthread_aio_drain(file);
+    if (rc != SQLITE_OK)
+    {
+        return rc;
+    }
+#endif
+
+    if (ftruncate(file->fd, size) != 0)
+    {
+        return _RTTHREAD_LOG_ERROR(SQLITE_IOERR_TRUNCATE, "ftruncate", 0);
+    }
+
+#if PKG_SQLITE_BLOCK_CACHE_SIZE > 0
+    _rtthread_bcache_drop(RTTHREAD_BCACHE_KEY(file), size);
+#endif
+
+    file->iAlloc = size;
+    _rtthread_inode_set_size(file->pInode, size, 0);
+
+    return SQLITE_OK;
+#else
     return SQLITE_IOERR_TRUNCATE;
+#endif
 }
 
 static int _rtthread_io_sync(sqlite3_file* file_id, int flags)
 {
     RTTHREAD_SQLITE_FILE_T *file = (RTTHREAD_SQLITE_FILE_T*)file_id;
+    int rc;
 
     assert((flags & 0x0F) == SQLITE_SYNC_NORMAL
         || (flags & 0x0F) == SQLITE_SYNC_FULL);
 
-    fsync(file->fd);
+#if PKG_SQLITE_BLOCK_CACHE_SIZE > 0
+    rc = _rtthread_bcache_flush(file);
+    if (rc != SQLITE_OK)
+    {
+        return rc;
+    }
+#endif
+
+#if PKG_SQLITE_ASYNC_IO_SIZE > 0
+    /* the queued writes must be on the media before they are synced */
+    rc = _rtthread_aio_drain(file);
+    if (rc != SQLITE_OK)
+    {
+        return rc;
+    }
+#endif
+
+    RTTHREAD_IO_CLOCK(t);
+    rc = fsync(file->fd);
+    RTTHREAD_IO_ELAPSED(file, sync_time, t);
+    RTTHREAD_IO_STAT(file, syncs, 1);
+
+    if (rc != 0)
+    {
+        return _RTTHREAD_LOG_ERROR(SQLITE_IOERR_FSYNC, "fsync", file->zPath);
+    }
 
     return SQLITE_OK;
 }
@@ -123,6 +447,28 @@ static int _rtthread_io_file_size(sqlite3_file* file_id, sqlite3_int64 *psize)
 
     assert(file_id);
 
+#if PKG_SQLITE_META_CACHE_SIZE > 0
+    if (file->pInode)
+    {
+        _rtthread_vfs_enter_mutex();
+        *psize = file->pInode->iSize;
+        if (*psize >= 0)
+        {
+            _rtthread_meta_stats.size_hits++;
+        }
+        else
+        {
+            _rtthread_meta_stats.size_misses++;
+        }
+        _rtthread_vfs_leave_mutex();
+
+        if (*psize >= 0)
+        {
+            goto size_done;
+        }
+    }
+#endif
+
     rc = fstat(file->fd, &buf);
 
     if (rc != 0)
@@ -131,6 +477,17 @@ static int _rtthread_io_file_size(sqlite3_file* file_id, sqlite3_int64 *psize)
     }
 
     *psize = buf.st_size;
+#if PKG_SQLITE_BLOCK_CACHE_SIZE > 0
+    _rtthread_bcache_size(file, psize);
+#endif
+#if PKG_SQLITE_ASYNC_IO_SIZE > 0
+    _rtthread_aio_size(file, psize);
+#endif
+    _rtthread_inode_set_size(file->pInode, *psize, 0);
+
+#if PKG_SQLITE_META_CACHE_SIZE > 0
+size_done:
+#endif
 
     /* When opening a zero-size database, the findInodeInfo() procedure
     ** writes a single byte into that file in order to work around a bug
@@ -145,35 +502,28 @@ static int _rtthread_io_file_size(sqlite3_file* file_id, sqlite3_int64 *psize)
 
 /*
 ** This routine checks if there is a RESERVED lock held on the specified
-** file by this or any other process. If such a lock is held, set *pResOut
+** file by this or any other connection. If such a lock is held, set *pResOut
 ** to a non-zero value otherwise *pResOut is set to zero.  The return value
 ** is set to SQLITE_OK unless an I/O error occurs during lock checking.
 */
 static int _rtthread_io_check_reserved_lock(sqlite3_file *file_id, int *pResOut)
 {
     RTTHREAD_SQLITE_FILE_T *file = (RTTHREAD_SQLITE_FILE_T*)file_id;
-    rt_sem_t psem = &file->sem;
+    RTTHREAD_INODE_T *pInode = file->pInode;
     int reserved = 0;
 
-    /* Check if a thread in this process holds such a lock */
+    /* Check if this connection holds such a lock */
     if (file->eFileLock > SHARED_LOCK)
     {
         reserved = 1;
     }
 
-    /* Otherwise see if some other process holds it. */
-    if (!reserved)
+    /* Otherwise see if some other connection holds it. */
+    if (!reserved && pInode)
     {
-        if (rt_sem_trytake(psem) != RT_EOK)
-        {
-            /* someone else has the lock when we are in NO_LOCK */
-            reserved = (file->eFileLock < SHARED_LOCK);
-        }
-        else
-        {
-            /* we could have it if we want it */
-            rt_sem_release(psem);
-        }
+        _rtthread_vfs_enter_mutex();
+        reserved = (pInode->eFileLock > SHARED_LOCK);
+        _rtthread_vfs_leave_mutex();
     }
 
     *pResOut = reserved;
@@ -201,10 +551,12 @@ static int _rtthread_io_check_reserved_lock(sqlite3_file *file_id, int *pResOut)
 **    RESERVED -> (PENDING) -> EXCLUSIVE
 **    PENDING -> EXCLUSIVE
 **
-** Semaphore locks only really support EXCLUSIVE locks.  We track intermediate
-** lock states in the sqlite3_file structure, but all locks SHARED or
-** above are really EXCLUSIVE locks and exclude all other processes from
-** access the file.
+** The lock state of a file is kept in its RTTHREAD_INODE_T, shared by all
+** handles on that file.  Any number of handles may hold SHARED at once;
+** RESERVED and PENDING are single-holder and coexist with readers, and
+** EXCLUSIVE is granted only once the requester is the last SHARED holder.
+** A writer that fails to get EXCLUSIVE is left at PENDING, which keeps new
+** readers out so that it can make progress on a later retry.
 **
 ** This routine will only increase a lock.  Use the sqlite3OsUnlock()
 ** routine to lower a locking level.
@@ -212,29 +564,82 @@ static int _rtthread_io_check_reserved_lock(sqlite3_file *file_id, int *pResOut)
 static int _rtthread_io_lock(sqlite3_file *file_id, int eFileLock)
 {
     RTTHREAD_SQLITE_FILE_T *file = (RTTHREAD_SQLITE_FILE_T*)file_id;
-    rt_sem_t psem = &file->sem;
+    RTTHREAD_INODE_T *pInode = file->pInode;
     int rc = SQLITE_OK;
 
-    /* if we already have a lock, it is exclusive.
-    ** Just adjust level and punt on outta here. */
-    if (file->eFileLock > NO_LOCK)
+    /* If there is already a lock of this type or more restrictive on the
+    ** file, do nothing. */
+    if (file->eFileLock >= eFileLock)
+    {
+        return SQLITE_OK;
+    }
+
+    assert(file->eFileLock != NO_LOCK || eFileLock == SHARED_LOCK);
+    assert(eFileLock != PENDING_LOCK);
+    assert(eFileLock != RESERVED_LOCK || file->eFileLock == SHARED_LOCK);
+
+#if PKG_SQLITE_READAHEAD_SIZE > 0
+    /* another connection may have written the file since this handle last
+    ** held a lock, so nothing prefetched before may be served any more */
+    if (file->eFileLock == NO_LOCK)
+    {
+        _rtthread_ra_drop(&file->ra);
+    }
+#endif
+
+    /* files private to one connection need no bookkeeping */
+    if (pInode == 0)
     {
         file->eFileLock = eFileLock;
-        rc = SQLITE_OK;
-        goto sem_end_lock;
+        return SQLITE_OK;
+    }
+
+    _rtthread_vfs_enter_mutex();
+
+    /* If some other handle holds a lock stronger than SHARED, or is on its
+    ** way to EXCLUSIVE, nobody else may go past SHARED and no new reader
+    ** may come in. */
+    if (file->eFileLock != pInode->eFileLock
+        && (pInode->eFileLock >= PENDING_LOCK || eFileLock > SHARED_LOCK))
+    {
+        rc = SQLITE_BUSY;
+        goto inode_end_lock;
     }
 
-    /* lock semaphore now but bail out when already locked. */
-    if (rt_sem_trytake(psem) != RT_EOK)
+    if (eFileLock == SHARED_LOCK)
     {
+        /* join the readers already present, or become the first one */
+        pInode->nShared++;
+        if (pInode->eFileLock < SHARED_LOCK)
+        {
+            pInode->eFileLock = SHARED_LOCK;
+        }
+        file->eFileLock = SHARED_LOCK;
+        goto inode_end_lock;
+    }
+
+    if (eFileLock == EXCLUSIVE_LOCK && pInode->nShared > 1)
+    {
+        /* Readers are still active.  Hold PENDING so that no more arrive
+        ** and let the pager retry through its busy handler. */
+        file->eFileLock = PENDING_LOCK;
+        pInode->eFileLock = PENDING_LOCK;
         rc = SQLITE_BUSY;
-        goto sem_end_lock;
+        goto inode_end_lock;
     }
 
-    /* got it, set the type and return ok */
     file->eFileLock = eFileLock;
+    pInode->eFileLock = eFileLock;
+
+    /* see _rtthread_journal_zero() */
+    if (eFileLock == RESERVED_LOCK)
+    {
+        pInode->bNoSync = (file->eSync == 0);
+    }
 
-sem_end_lock:
+inode_end_lock:
+    _rtthread_vfs_leave_mutex();
+    RTTHREAD_IO_STAT(file, lock_waits, rc == SQLITE_BUSY);
     return rc;
 }
 
@@ -248,27 +653,41 @@ sem_end_lock:
 static int _rtthread_io_unlock(sqlite3_file *file_id, int eFileLock)
 {
     RTTHREAD_SQLITE_FILE_T *file = (RTTHREAD_SQLITE_FILE_T*)file_id;
-    rt_sem_t psem = &file->sem;
+    RTTHREAD_INODE_T *pInode = file->pInode;
 
     assert(eFileLock <= SHARED_LOCK);
 
     /* no-op if possible */
-    if (file->eFileLock == eFileLock)
+    if (file->eFileLock <= eFileLock)
     {
         return SQLITE_OK;
     }
 
-    /* shared can just be set because we always have an exclusive */
-    if (eFileLock == SHARED_LOCK)
+    if (pInode)
     {
-        file->eFileLock = SHARED_LOCK;
-        return SQLITE_OK;
-    }
+        _rtthread_vfs_enter_mutex();
 
-    /* no, really unlock. */
-    rt_sem_release(psem);
+        /* a writer steps back to being an ordinary reader */
+        if (file->eFileLock > SHARED_LOCK)
+        {
+            assert(pInode->eFileLock == file->eFileLock);
+            pInode->eFileLock = SHARED_LOCK;
+        }
 
-    file->eFileLock = NO_LOCK;
+        /* the last reader out leaves the file unlocked */
+        if (eFileLock == NO_LOCK)
+        {
+            pInode->nShared--;
+            if (pInode->nShared == 0)
+            {
+                pInode->eFileLock = NO_LOCK;
+            }
+        }
+
+        _rtthread_vfs_leave_mutex();
+    }
+
+    file->eFileLock = eFileLock;
     return SQLITE_OK;
 }
 
@@ -279,63 +698,175 @@ static int _rtthread_io_close(sqlite3_file *file_id)
 
     if (file->fd >= 0)
     {
+#if PKG_SQLITE_BLOCK_CACHE_SIZE > 0
+        rc = _rtthread_bcache_detach(file);
+#endif
+#if PKG_SQLITE_ASYNC_IO_SIZE > 0
+        {
+            int rcAio = _rtthread_aio_drain(file);
+            if (rc == SQLITE_OK)
+            {
+                rc = rcAio;
+            }
+        }
+#endif
         _rtthread_io_unlock(file_id, NO_LOCK);
-        rt_sem_detach(&file->sem);
-        rc = close(file->fd);
+
+        if (_rtthread_journal_park(file))
+        {
+            file->pInode = 0;
+        }
+        else if (close(file->fd) != 0)
+        {
+            rc = SQLITE_IOERR_CLOSE;
+        }
         file->fd = -1;
     }
 
+    if (file->pInode)
+    {
+        if (file->flags & SQLITE_OPEN_MAIN_DB)
+        {
+            _rtthread_journal_discard(file->pInode);
+        }
+        _rtthread_inode_release(file->pInode);
+        file->pInode = 0;
+    }
+
+#if PKG_SQLITE_READAHEAD_SIZE > 0
+    sqlite3_free(file->ra.pBuf);
+    file->ra.pBuf = 0;
+#endif
+
+    _rtthread_io_stats_detach(file);
+
     return rc;
 }
 
-static int _rtthread_fcntl_size_hint(sqlite3_file *file_id, i64 nByte)
+/*
+** Grow the file from nCur to nSize bytes. The native DFS extend is tried
+** first; otherwise the new region is zero-filled with writes of up to
+** RTTHREAD_PREALLOC_BUF bytes, aligned on filesystem blocks so that each
+** write allocates whole clusters instead of one cluster per small write.
+*/
+#define RTTHREAD_PREALLOC_BUF       8192
+
+static int _rtthread_io_extend(RTTHREAD_SQLITE_FILE_T *file, i64 nCur, i64 nSize)
 {
-    RTTHREAD_SQLITE_FILE_T *file = (RTTHREAD_SQLITE_FILE_T*)file_id;
+    char *zero;
+    int nBuf;
+    int rc = SQLITE_OK;
 
-    if (file->szChunk > 0)
+#ifdef PKG_SQLITE_VFS_USING_FTRUNCATE
+    if (ftruncate(file->fd, nSize) == 0)
     {
-        i64 nSize;                    /* Required file size */
-        struct stat buf;              /* Used to hold return values of fstat() */
+        file->iAlloc = nSize;
+        _rtthread_inode_set_size(file->pInode, nSize, 1);
+        return SQLITE_OK;
+    }
+#endif
+
+    if (file->szBlock == 0)
+    {
+        struct statfs sfs;
+
+        file->szBlock = 512;
 
-        if (fstat(file->fd, &buf))
+        if (file->zPath && statfs(file->zPath, &sfs) == 0 && sfs.f_bsize >= 512 && sfs.f_bsize <= 65536)
         {
-            return SQLITE_IOERR_FSTAT;
+            file->szBlock = (int)sfs.f_bsize;
         }
+    }
 
-        nSize = ((nByte + file->szChunk - 1) / file->szChunk) * file->szChunk;
+    nBuf = ((RTTHREAD_PREALLOC_BUF + file->szBlock - 1) / file->szBlock) * file->szBlock;
 
-        if (nSize > (i64)buf.st_size)
-        {
-            /* If the OS does not have posix_fallocate(), fake it. Write a
-            ** single byte to the last byte in each block that falls entirely
-            ** within the extended region. Then, if required, a single byte
-            ** at offset (nSize-1), to set the size of the file correctly.
-            ** This is a similar technique to that used by glibc on systems
-            ** that do not have a real fallocate() call.
-            */
-            int nBlk = 512;  /* File-system block size */
-            int nWrite = 0;             /* Number of bytes written by seekAndWrite */
-            i64 iWrite;                 /* Next offset to write to */
-
-            iWrite = (buf.st_size / nBlk) * nBlk + nBlk - 1;
-            assert(iWrite >= buf.st_size);
-            assert(((iWrite + 1) % nBlk) == 0);
-
-            for (/*no-op*/; iWrite < nSize + nBlk - 1; iWrite += nBlk)
-            {
-                if (iWrite >= nSize)
-                {
-                    iWrite = nSize - 1;
-                }
+    if (nBuf > nSize - nCur)
+    {
+        nBuf = (int)(nSize - nCur);
+    }
 
-                nWrite = _rtthread_io_write(file_id, "", 1, iWrite);
+    zero = sqlite3_malloc(nBuf);
 
-                if (nWrite != 1)
-                {
-                    return SQLITE_IOERR_WRITE;
-                }
-            }
+    if (zero == 0)
+    {
+        return SQLITE_IOERR_NOMEM;
+    }
+
+    memset(zero, 0, nBuf);
+
+    while (nCur < nSize && rc == SQLITE_OK)
+    {
+        /* the first write ends on a block boundary, later ones are aligned */
+        int n = nBuf - (int)(nCur % file->szBlock);
+
+        if (n > nSize - nCur)
+        {
+            n = (int)(nSize - nCur);
         }
+
+        rc = _rtthread_io_write((sqlite3_file*)file, zero, n, nCur);
+        nCur += n;
+    }
+
+    sqlite3_free(zero);
+
+    return rc;
+}
+
+/*
+** Make sure at least nByte bytes are allocated to the file. Space already
+** known to be allocated, by an earlier extend or write, is trusted without
+** asking the filesystem again.
+*/
+static int _rtthread_io_preallocate(RTTHREAD_SQLITE_FILE_T *file, i64 nByte)
+{
+    struct stat buf;
+
+    if (nByte <= file->iAlloc)
+    {
+        return SQLITE_OK;
+    }
+
+#if PKG_SQLITE_BLOCK_CACHE_SIZE > 0
+    if (_rtthread_bcache_flush(file) != SQLITE_OK)
+    {
+        return SQLITE_IOERR_WRITE;
+    }
+#endif
+
+#if PKG_SQLITE_ASYNC_IO_SIZE > 0
+    if (_rtthread_aio_drain(file) != SQLITE_OK)
+    {
+        return SQLITE_IOERR_WRITE;
+    }
+#endif
+
+    if (fstat(file->fd, &buf))
+    {
+        return SQLITE_IOERR_FSTAT;
+    }
+
+    file->iAlloc = buf.st_size;
+
+    if (nByte <= file->iAlloc)
+    {
+        return SQLITE_OK;
+    }
+
+    return _rtthread_io_extend(file, buf.st_size, nByte);
+}
+
+static int _rtthread_fcntl_size_hint(sqlite3_file *file_id, i64 nByte)
+{
+    RTTHREAD_SQLITE_FILE_T *file = (RTTHREAD_SQLITE_FILE_T*)file_id;
+
+    if (file->szChunk > 0)
+    {
+        i64 nSize;                    /* Required file size */
+
+        nSize = ((nByte + file->szChunk - 1) / file->szChunk) * file->szChunk;
+
+        return _rtthread_io_preallocate(file, nSize);
     }
 
     return SQLITE_OK;
@@ -375,7 +906,40 @@ static int _rtthread_io_file_ctrl(sqlite3_file *file_id, int op, void *pArg)
         return SQLITE_OK;
     }
 
+    case SQLITE_FCNTL_PRAGMA: {
+        /* note PRAGMA synchronous for _rtthread_journal_zero(), SQLite
+        ** still runs the pragma itself */
+        char **azArg = (char **)pArg;
+
+        if (azArg[2] && sqlite3_stricmp(azArg[1], "synchronous") == 0)
+        {
+            if (azArg[2][0] >= '0' && azArg[2][0] <= '9')
+            {
+                file->eSync = atoi(azArg[2]);
+            }
+            else
+            {
+                file->eSync = !(sqlite3_stricmp(azArg[2], "off") == 0
+                    || sqlite3_stricmp(azArg[2], "no") == 0
+                    || sqlite3_stricmp(azArg[2], "false") == 0);
+            }
+        }
+        return SQLITE_NOTFOUND;
+    }
+
     case SQLITE_FCNTL_POWERSAFE_OVERWRITE: {
+        if (*(int*)pArg < 0)
+        {
+            *(int*)pArg = (file->iocap & SQLITE_IOCAP_POWERSAFE_OVERWRITE) != 0;
+        }
+        else if (*(int*)pArg == 0)
+        {
+            file->iocap &= ~SQLITE_IOCAP_POWERSAFE_OVERWRITE;
+        }
+        else
+        {
+            file->iocap |= SQLITE_IOCAP_POWERSAFE_OVERWRITE;
+        }
         return SQLITE_OK;
     }
 
@@ -384,6 +948,31 @@ static int _rtthread_io_file_ctrl(sqlite3_file *file_id, int op, void *pArg)
         return SQLITE_OK;
     }
 
+    case SQLITE_FCNTL_RTTHREAD_PREALLOCATE: {
+        return _rtthread_io_preallocate(file, *(i64 *)pArg);
+    }
+
+#if PKG_SQLITE_READAHEAD_SIZE > 0
+    case SQLITE_FCNTL_RTTHREAD_READAHEAD: {
+        *(struct rtthread_readahead_stats *)pArg = file->ra.stats;
+        return SQLITE_OK;
+    }
+#endif
+
+#if PKG_SQLITE_BLOCK_CACHE_SIZE > 0
+    case SQLITE_FCNTL_RTTHREAD_BLOCK_CACHE: {
+        *(struct rtthread_bcache_stats *)pArg = file->bc;
+        return SQLITE_OK;
+    }
+#endif
+
+#ifdef PKG_SQLITE_IO_STATS
+    case SQLITE_FCNTL_RTTHREAD_IO_STATS: {
+        *(struct rtthread_io_stats *)pArg = file->io;
+        return SQLITE_OK;
+    }
+#endif
+
     case SQLITE_FCNTL_TEMPFILENAME: {
         char *zTFile = sqlite3_malloc(file->pvfs->mxPathname );
 
@@ -401,12 +990,16 @@ static int _rtthread_io_file_ctrl(sqlite3_file *file_id, int op, void *pArg)
 
 static int _rtthread_io_sector_size(sqlite3_file *file_id)
 {
-    return SQLITE_DEFAULT_SECTOR_SIZE;
+    RTTHREAD_SQLITE_FILE_T *file = (RTTHREAD_SQLITE_FILE_T*)file_id;
+
+    return file->szSector;
 }
 
 static int _rtthread_io_device_characteristics(sqlite3_file *file_id)
 {
-    return 0;
+    RTTHREAD_SQLITE_FILE_T *file = (RTTHREAD_SQLITE_FILE_T*)file_id;
+
+    return file->iocap;
 }
 
 /*
@@ -0,0 +1,170 @@
+/*
+** Per-file I/O statistics.
+**
+** Every file handle counts the system calls it issues: read()/write()
+** calls and bytes, lseek() calls, fsync() calls, lock requests refused
+** with SQLITE_BUSY, and the time spent in read(), write() and fsync().
+** Counters of open handles live in the handle; when a handle is closed
+** they are folded into the totals of its file type, so the totals of a
+** type are the closed totals plus the handles still open on the list.
+**
+** Times are measured with PKG_SQLITE_IO_CLOCK(), see rtthread_vfs.h.
+*/
+
+/*
+** Start the cycle counter if it is used and needs starting.  It is left
+** alone unless something that reads it is built: the I/O statistics, the
+** compression VFS or the mutex profiler.
+*/
+static void _rtthread_io_clock_init(void)
+{
+#if defined(RTTHREAD_DWT_CYCCNT) \
+    && (defined(PKG_SQLITE_IO_STATS) || defined(PKG_SQLITE_COMPRESS) || defined(PKG_SQLITE_MUTEX_PROFILE))
+    RTTHREAD_DEM_CR |= (1UL << 24);         /* TRCENA */
+    RTTHREAD_DWT_CTRL |= 1UL;               /* CYCCNTENA */
+#endif
+}
+
+#if defined(PKG_SQLITE_IO_STATS) || PKG_SQLITE_BLOCK_CACHE_SIZE > 0
+static int _rtthread_io_type(int flags)
+{
+    switch (flags & 0xFFFFFF00)
+    {
+    case SQLITE_OPEN_MAIN_DB:
+        return RTTHREAD_IO_DB;
+
+    case SQLITE_OPEN_MAIN_JOURNAL:
+    case SQLITE_OPEN_MASTER_JOURNAL:
+    case SQLITE_OPEN_WAL:
+        return RTTHREAD_IO_JOURNAL;
+
+    default:
+        return RTTHREAD_IO_TEMP;
+    }
+}
+#endif
+
+#ifdef PKG_SQLITE_IO_STATS
+
+static RTTHREAD_SQLITE_FILE_T *_rtthread_io_open_list = 0;
+static struct rtthread_io_stats _rtthread_io_closed[RTTHREAD_IO_TYPES];
+
+static void _rtthread_io_stats_add(struct rtthread_io_stats *pTo, const struct rtthread_io_stats *pFrom)
+{
+    pTo->reads += pFrom->reads;
+    pTo->writes += pFrom->writes;
+    pTo->read_bytes += pFrom->read_bytes;
+    pTo->write_bytes += pFrom->write_bytes;
+    pTo->seeks += pFrom->seeks;
+    pTo->syncs += pFrom->syncs;
+    pTo->lock_waits += pFrom->lock_waits;
+    pTo->read_time += pFrom->read_time;
+    pTo->write_time += pFrom->write_time;
+    pTo->sync_time += pFrom->sync_time;
+}
+
+/*
+** Put a newly opened handle on the list of open handles.
+*/
+static void _rtthread_io_stats_attach(RTTHREAD_SQLITE_FILE_T *file)
+{
+    memset(&file->io, 0, sizeof(file->io));
+
+    _rtthread_vfs_enter_mutex();
+    file->pIoNext = _rtthread_io_open_list;
+    _rtthread_io_open_list = file;
+    _rtthread_vfs_leave_mutex();
+}
+
+/*
+** Take a closing handle off the open list and fold its counters into the
+** totals of its file type.
+*/
+static void _rtthread_io_stats_detach(RTTHREAD_SQLITE_FILE_T *file)
+{
+    RTTHREAD_SQLITE_FILE_T **pp;
+
+    _rtthread_vfs_enter_mutex();
+    for (pp = &_rtthread_io_open_list; *pp; pp = &(*pp)->pIoNext)
+    {
+        if (*pp == file)
+        {
+            *pp = file->pIoNext;
+            _rtthread_io_stats_add(&_rtthread_io_closed[_rtthread_io_type(file->flags)], &file->io);
+            break;
+        }
+    }
+    _rtthread_vfs_leave_mutex();
+}
+
+#define RTTHREAD_IO_STAT(file, field, n)        ((file)->io.field += (n))
+#define RTTHREAD_IO_CLOCK(t)                    rt_uint32_t t = PKG_SQLITE_IO_CLOCK()
+#define RTTHREAD_IO_ELAPSED(file, field, t)     ((file)->io.field += (rt_uint32_t)(PKG_SQLITE_IO_CLOCK() - (t)))
+
+#else
+
+#define _rtthread_io_stats_attach(file)
+#define _rtthread_io_stats_detach(file)
+#define RTTHREAD_IO_STAT(file, field, n)
+#define RTTHREAD_IO_CLOCK(t)
+#define RTTHREAD_IO_ELAPSED(file, field, t)
+
+#endif /* PKG_SQLITE_IO_STATS */
+
+void rtthread_vfs_io_stats(int type, struct rtthread_io_stats *stats, int reset)
+{
+    memset(stats, 0, sizeof(*stats));
+
+#ifdef PKG_SQLITE_IO_STATS
+    if (type >= 0 && type < RTTHREAD_IO_TYPES)
+    {
+        RTTHREAD_SQLITE_FILE_T *file;
+
+        _rtthread_vfs_enter_mutex();
+        _rtthread_io_stats_add(stats, &_rtthread_io_closed[type]);
+        if (reset)
+        {
+            memset(&_rtthread_io_closed[type], 0, sizeof(_rtthread_io_closed[type]));
+        }
+
+        for (file = _rtthread_io_open_list; file; file = file->pIoNext)
+        {
+            if (_rtthread_io_type(file->flags) == type)
+            {
+                _rtthread_io_stats_add(stats, &file->io);
+                if (reset)
+                {
+                    memset(&file->io, 0, sizeof(file->io));
+                }
+            }
+        }
+        _rtthread_vfs_leave_mutex();
+    }
+#endif
+}
+
+#if defined(PKG_SQLITE_IO_STATS) && defined(RT_USING_FINSH)
+static void sqlio(int argc, char **argv)
+{
+    static const char *azType[RTTHREAD_IO_TYPES] = { "db", "journal", "temp" };
+    struct rtthread_io_stats st;
+    char zLine[160];
+    int reset = (argc >= 2 && rt_strcmp(argv[1], "reset") == 0);
+    int i;
+
+    /* rt_kprintf() has no 64-bit conversions, sqlite3_snprintf() does */
+    rt_kprintf("%-8s %8s %10s %8s %10s %7s %6s %5s %12s %12s %12s\n",
+               "type", "reads", "rbytes", "writes", "wbytes", "seeks", "syncs", "busy",
+               "read_" RTTHREAD_IO_CLOCK_UNIT, "write_" RTTHREAD_IO_CLOCK_UNIT, "sync_" RTTHREAD_IO_CLOCK_UNIT);
+    for (i = 0; i < RTTHREAD_IO_TYPES; i++)
+    {
+        rtthread_vfs_io_stats(i, &st, reset);
+        sqlite3_snprintf(sizeof(zLine), zLine, "%-8s %8u %10lld %8u %10lld %7u %6u %5u %12lld %12lld %12lld",
+                         azType[i], st.reads, st.read_bytes, st.writes, st.write_bytes,
+                         st.seeks, st.syncs, st.lock_waits,
+                         (sqlite3_int64)st.read_time, (sqlite3_int64)st.write_time, (sqlite3_int64)st.sync_time);
+        rt_kprintf("%s\n", zLine);
+    }
+}
+MSH_CMD_EXPORT(sqlio, sqlite file io statistics: sqlio [reset]);
+#endif
@@ -0,0 +1,519 @@
+/*
+** RAM-backed temporary files.
+**
+** Temporary databases, temporary journals, statement subjournals and
+** transient indices are private to one connection and never outlive it, so
+** they are kept in memory instead of being created under /sql, /tmp or ".".
+** The content is stored in fixed size chunks allocated from the SQLite heap.
+** All memory temp files share one budget of PKG_SQLITE_TEMP_MEM_SIZE bytes;
+** a write that would exceed it spills that file to a real temporary file
+** and the handle continues with the regular rt-thread io methods.
+*/
+#if PKG_SQLITE_TEMP_MEM_SIZE > 0
+
+#define RTTHREAD_MEMFILE_CHUNK      4096
+
+typedef struct rtthread_memfile
+{
+    char **apChunk;                 /* chunk table, 0 entries are holes */
+    int nChunk;                     /* slots in apChunk */
+    sqlite3_int64 nSize;            /* logical file size */
+    int nAlloc;                     /* chunks allocated, charged to the budget */
+} RTTHREAD_MEMFILE_T;
+
+static struct
+{
+    sqlite3_int64 nLimit;           /* budget shared by all memory temp files */
+    sqlite3_int64 nUsed;            /* bytes currently allocated */
+    struct rtthread_temp_stats stats;
+} _rtthread_memfile_g = { PKG_SQLITE_TEMP_MEM_SIZE };
+
+static const sqlite3_io_methods _rtthread_memfile_method;
+
+/*
+** Charge nByte (which may be negative) to the shared budget. Returns
+** SQLITE_FULL without charging anything if the budget would be exceeded.
+*/
+static int _rtthread_memfile_charge(sqlite3_int64 nByte)
+{
+    int rc = SQLITE_OK;
+
+    _rtthread_vfs_enter_mutex();
+
+    if (nByte > 0 && _rtthread_memfile_g.nUsed + nByte > _rtthread_memfile_g.nLimit)
+    {
+        rc = SQLITE_FULL;
+    }
+    else
+    {
+        _rtthread_memfile_g.nUsed += nByte;
+
+        if (_rtthread_memfile_g.nUsed > _rtthread_memfile_g.stats.mem_peak)
+        {
+            _rtthread_memfile_g.stats.mem_peak = _rtthread_memfile_g.nUsed;
+        }
+    }
+
+    _rtthread_vfs_leave_mutex();
+
+    return rc;
+}
+
+/*
+** Release every chunk at or after chunk index iFirst.
+*/
+static void _rtthread_memfile_release(RTTHREAD_MEMFILE_T *pMem, int iFirst)
+{
+    int i;
+    int nFreed = 0;
+
+    for (i = iFirst; i < pMem->nChunk; i++)
+    {
+        if (pMem->apChunk[i])
+        {
+            sqlite3_free(pMem->apChunk[i]);
+            pMem->apChunk[i] = 0;
+            nFreed++;
+        }
+    }
+
+    pMem->nAlloc -= nFreed;
+    _rtthread_memfile_charge(-(sqlite3_int64)nFreed * RTTHREAD_MEMFILE_CHUNK);
+}
+
+static int _rtthread_memfile_open(sqlite3_vfs *pvfs, RTTHREAD_SQLITE_FILE_T *p, int flags, int *pOutFlags)
+{
+    RTTHREAD_MEMFILE_T *pMem;
+
+    pMem = sqlite3_malloc(sizeof(RTTHREAD_MEMFILE_T));
+
+    if (pMem == 0)
+    {
+        return SQLITE_NOMEM;
+    }
+
+    memset(pMem, 0, sizeof(RTTHREAD_MEMFILE_T));
+
+    if (pOutFlags)
+    {
+        *pOutFlags = flags;
+    }
+
+    p->pMem = pMem;
+    p->fd = -1;
+    p->pMethod = &_rtthread_memfile_method;
+    p->flags = flags;
+    p->eFileLock = NO_LOCK;
+    p->pvfs = pvfs;
+    _rtthread_io_stats_attach(p);
+
+    _rtthread_vfs_enter_mutex();
+    _rtthread_memfile_g.stats.mem_files++;
+    _rtthread_vfs_leave_mutex();
+
+    return SQLITE_OK;
+}
+
+/*
+** Move the content of a memory temp file to a newly created temporary file
+** and switch the handle over to the regular io methods.
+*/
+static int _rtthread_memfile_spill(RTTHREAD_SQLITE_FILE_T *file)
+{
+    RTTHREAD_MEMFILE_T *pMem = file->pMem;
+    char zTmpname[RTTHREAD_MAX_PATHNAME + 2];
+    sqlite3_int64 iOff;
+    int fd;
+    int rc;
+    int i;
+
+    rc = _rtthread_get_temp_name(RTTHREAD_MAX_PATHNAME + 2, zTmpname);
+
+    if (rc != SQLITE_OK)
+    {
+        return rc;
+    }
+
+    fd = _rtthread_fs_open(zTmpname, O_RDWR | O_CREAT | O_EXCL | O_BINARY, 0);
+
+    if (fd < 0)
+    {
+        return _RTTHREAD_LOG_ERROR(SQLITE_IOERR_WRITE, "open", zTmpname);
+    }
+
+    unlink(zTmpname);
+
+    file->fd = fd;
+
+    for (i = 0; i < pMem->nChunk; i++)
+    {
+        int nWrite;
+
+        iOff = (sqlite3_int64)i * RTTHREAD_MEMFILE_CHUNK;
+
+        if (pMem->apChunk[i] == 0 || iOff >= pMem->nSize)
+        {
+            continue;
+        }
+
+        nWrite = RTTHREAD_MEMFILE_CHUNK;
+
+        if (iOff + nWrite > pMem->nSize)
+        {
+            nWrite = (int)(pMem->nSize - iOff);
+        }
+
+        rc = _rtthread_io_write((sqlite3_file*)file, pMem->apChunk[i], nWrite, iOff);
+
+        if (rc != SQLITE_OK)
+        {
+            close(fd);
+            file->fd = -1;
+            return rc;
+        }
+    }
+
+    _rtthread_vfs_enter_mutex();
+    _rtthread_memfile_g.stats.spills++;
+    _rtthread_memfile_g.stats.spill_bytes += pMem->nSize;
+    _rtthread_vfs_leave_mutex();
+
+    _rtthread_memfile_release(pMem, 0);
+    sqlite3_free(pMem->apChunk);
+    sqlite3_free(pMem);
+
+    file->pMem = 0;
+    file->pMethod = &_rtthread_io_method;
+    _rtthread_vfs_geometry(zTmpname, &file->szSector, &file->iocap);
+
+    return SQLITE_OK;
+}
+
+static int _rtthread_memfile_close(sqlite3_file *file_id)
+{
+    RTTHREAD_SQLITE_FILE_T *file = (RTTHREAD_SQLITE_FILE_T*)file_id;
+    RTTHREAD_MEMFILE_T *pMem = file->pMem;
+
+    if (pMem)
+    {
+        _rtthread_memfile_release(pMem, 0);
+        sqlite3_free(pMem->apChunk);
+        sqlite3_free(pMem);
+        file->pMem = 0;
+    }
+
+    _rtthread_io_stats_detach(file);
+
+    return SQLITE_OK;
+}
+
+static int _rtthread_memfile_read(sqlite3_file *file_id, void *pbuf, int cnt, sqlite3_int64 offset)
+{
+    RTTHREAD_SQLITE_FILE_T *file = (RTTHREAD_SQLITE_FILE_T*)file_id;
+    RTTHREAD_MEMFILE_T *pMem = file->pMem;
+    char *zOut = (char*)pbuf;
+    int nAvail;
+    int rc = SQLITE_OK;
+
+    assert(offset >= 0);
+    assert(cnt > 0);
+
+    if (offset + cnt > pMem->nSize)
+    {
+        nAvail = offset < pMem->nSize ? (int)(pMem->nSize - offset) : 0;
+        memset(&zOut[nAvail], 0, cnt - nAvail);
+        cnt = nAvail;
+        rc = SQLITE_IOERR_SHORT_READ;
+    }
+
+    while (cnt > 0)
+    {
+        int iChunk = (int)(offset / RTTHREAD_MEMFILE_CHUNK);
+        int iIn = (int)(offset % RTTHREAD_MEMFILE_CHUNK);
+        int n = RTTHREAD_MEMFILE_CHUNK - iIn;
+
+        if (n > cnt)
+        {
+            n = cnt;
+        }
+
+        if (iChunk < pMem->nChunk && pMem->apChunk[iChunk])
+        {
+            memcpy(zOut, &pMem->apChunk[iChunk][iIn], n);
+        }
+        else
+        {
+            memset(zOut, 0, n);
+        }
+
+        zOut += n;
+        offset += n;
+        cnt -= n;
+    }
+
+    return rc;
+}
+
+static int _rtthread_memfile_write(sqlite3_file *file_id, const void *pbuf, int cnt, sqlite3_int64 offset)
+{
+    RTTHREAD_SQLITE_FILE_T *file = (RTTHREAD_SQLITE_FILE_T*)file_id;
+    RTTHREAD_MEMFILE_T *pMem = file->pMem;
+    const char *zIn = (const char*)pbuf;
+    int iLast = (int)((offset + cnt - 1) / RTTHREAD_MEMFILE_CHUNK);
+    int nNew = 0;
+    int rc;
+    int i;
+
+    assert(cnt > 0);
+
+    /* grow the chunk table and count the chunks this write allocates */
+    if (iLast >= pMem->nChunk)
+    {
+        int nChunk = pMem->nChunk ? pMem->nChunk : 4;
+        char **apNew;
+
+        while (nChunk <= iLast)
+        {
+            nChunk *= 2;
+        }
+
+        apNew = sqlite3_realloc(pMem->apChunk, nChunk * sizeof(char*));
+
+        if (apNew == 0)
+        {
+            return SQLITE_IOERR_NOMEM;
+        }
+
+        memset(&apNew[pMem->nChunk], 0, (nChunk - pMem->nChunk) * sizeof(char*));
+        pMem->apChunk = apNew;
+        pMem->nChunk = nChunk;
+    }
+
+    for (i = (int)(offset / RTTHREAD_MEMFILE_CHUNK); i <= iLast; i++)
+    {
+        if (pMem->apChunk[i] == 0)
+        {
+            nNew++;
+        }
+    }
+
+    if (nNew > 0)
+    {
+        if (_rtthread_memfile_charge((sqlite3_int64)nNew * RTTHREAD_MEMFILE_CHUNK) != SQLITE_OK)
+        {
+            rc = _rtthread_memfile_spill(file);
+
+            if (rc != SQLITE_OK)
+            {
+                return rc;
+            }
+
+            return _rtthread_io_write(file_id, pbuf, cnt, offset);
+        }
+
+        for (i = (int)(offset / RTTHREAD_MEMFILE_CHUNK); i <= iLast; i++)
+        {
+            if (pMem->apChunk[i] == 0)
+            {
+                pMem->apChunk[i] = sqlite3_malloc(RTTHREAD_MEMFILE_CHUNK);
+
+                if (pMem->apChunk[i] == 0)
+                {
+                    /* refund the chunks this write could not get */
+                    _rtthread_memfile_charge(-(sqlite3_int64)nNew * RTTHREAD_MEMFILE_CHUNK);
+                    return SQLITE_IOERR_NOMEM;
+                }
+
+                memset(pMem->apChunk[i], 0, RTTHREAD_MEMFILE_CHUNK);
+                pMem->nAlloc++;
+                nNew--;
+            }
+        }
+    }
+
+    while (cnt > 0)
+    {
+        int iChunk = (int)(offset / RTTHREAD_MEMFILE_CHUNK);
+        int iIn = (int)(offset % RTTHREAD_MEMFILE_CHUNK);
+        int n = RTTHREAD_MEMFILE_CHUNK - iIn;
+
+        if (n > cnt)
+        {
+            n = cnt;
+        }
+
+        memcpy(&pMem->apChunk[iChunk][iIn], zIn, n);
+
+        zIn += n;
+        offset += n;
+        cnt -= n;
+    }
+
+    if (offset > pMem->nSize)
+    {
+        pMem->nSize = offset;
+    }
+
+    return SQLITE_OK;
+}
+
+static int _rtthread_memfile_truncate(sqlite3_file *file_id, sqlite3_int64 size)
+{
+    RTTHREAD_SQLITE_FILE_T *file = (RTTHREAD_SQLITE_FILE_T*)file_id;
+    RTTHREAD_MEMFILE_T *pMem = file->pMem;
+
+    if (size < pMem->nSize)
+    {
+        int iFirst = (int)((size + RTTHREAD_MEMFILE_CHUNK - 1) / RTTHREAD_MEMFILE_CHUNK);
+        int iTail = (int)(size % RTTHREAD_MEMFILE_CHUNK);
+
+        _rtthread_memfile_release(pMem, iFirst);
+
+        /* bytes past the new end of a partial chunk must read back as zero */
+        if (iTail > 0 && iFirst - 1 < pMem->nChunk && pMem->apChunk[iFirst - 1])
+        {
+            memset(&pMem->apChunk[iFirst - 1][iTail], 0, RTTHREAD_MEMFILE_CHUNK - iTail);
+        }
+
+        pMem->nSize = size;
+    }
+
+    return SQLITE_OK;
+}
+
+static int _rtthread_memfile_sync(sqlite3_file *file_id, int flags)
+{
+    return SQLITE_OK;
+}
+
+static int _rtthread_memfile_file_size(sqlite3_file *file_id, sqlite3_int64 *psize)
+{
+    RTTHREAD_SQLITE_FILE_T *file = (RTTHREAD_SQLITE_FILE_T*)file_id;
+
+    *psize = file->pMem->nSize;
+
+    return SQLITE_OK;
+}
+
+/*
+** Memory temp files are private to the connection that opened them, so
+** locks only need to be tracked, never enforced.
+*/
+static int _rtthread_memfile_lock(sqlite3_file *file_id, int eFileLock)
+{
+    RTTHREAD_SQLITE_FILE_T *file = (RTTHREAD_SQLITE_FILE_T*)file_id;
+
+    if (eFileLock > file->eFileLock)
+    {
+        file->eFileLock = eFileLock;
+    }
+
+    return SQLITE_OK;
+}
+
+static int _rtthread_memfile_unlock(sqlite3_file *file_id, int eFileLock)
+{
+    RTTHREAD_SQLITE_FILE_T *file = (RTTHREAD_SQLITE_FILE_T*)file_id;
+
+    if (eFileLock < file->eFileLock)
+    {
+        file->eFileLock = eFileLock;
+    }
+
+    return SQLITE_OK;
+}
+
+static int _rtthread_memfile_check_reserved_lock(sqlite3_file *file_id, int *pResOut)
+{
+    *pResOut = 0;
+
+    return SQLITE_OK;
+}
+
+static int _rtthread_memfile_file_ctrl(sqlite3_file *file_id, int op, void *pArg)
+{
+    RTTHREAD_SQLITE_FILE_T *file = (RTTHREAD_SQLITE_FILE_T*)file_id;
+
+    switch( op )
+    {
+    case SQLITE_FCNTL_LOCKSTATE: {
+        *(int*)pArg = file->eFileLock;
+        return SQLITE_OK;
+    }
+
+    case SQLITE_FCNTL_CHUNK_SIZE:
+    case SQLITE_FCNTL_SIZE_HINT: {
+        return SQLITE_OK;
+    }
+
+    case SQLITE_FCNTL_VFSNAME: {
+        *(char**)pArg = sqlite3_mprintf("%s", file->pvfs->zName);
+        return SQLITE_OK;
+    }
+    }
+
+    return SQLITE_NOTFOUND;
+}
+
+static int _rtthread_memfile_sector_size(sqlite3_file *file_id)
+{
+    return RTTHREAD_MEMFILE_CHUNK;
+}
+
+static int _rtthread_memfile_device_characteristics(sqlite3_file *file_id)
+{
+    return SQLITE_IOCAP_ATOMIC | SQLITE_IOCAP_SAFE_APPEND | SQLITE_IOCAP_SEQUENTIAL
+        | SQLITE_IOCAP_POWERSAFE_OVERWRITE;
+}
+
+static const sqlite3_io_methods _rtthread_memfile_method = {
+    1,
+    _rtthread_memfile_close,
+    _rtthread_memfile_read,
+    _rtthread_memfile_write,
+    _rtthread_memfile_truncate,
+    _rtthread_memfile_sync,
+    _rtthread_memfile_file_size,
+    _rtthread_memfile_lock,
+    _rtthread_memfile_unlock,
+    _rtthread_memfile_check_reserved_lock,
+    _rtthread_memfile_file_ctrl,
+    _rtthread_memfile_sector_size,
+    _rtthread_memfile_device_characteristics
+};
+
+sqlite3_int64 rtthread_vfs_temp_mem_limit(sqlite3_int64 limit)
+{
+    sqlite3_int64 prior;
+
+    _rtthread_vfs_enter_mutex();
+
+    prior = _rtthread_memfile_g.nLimit;
+
+    if (limit >= 0)
+    {
+        _rtthread_memfile_g.nLimit = limit;
+    }
+
+    _rtthread_vfs_leave_mutex();
+
+    return prior;
+}
+
+void rtthread_vfs_temp_stats(struct rtthread_temp_stats *stats, int reset)
+{
+    _rtthread_vfs_enter_mutex();
+
+    _rtthread_memfile_g.stats.mem_used = _rtthread_memfile_g.nUsed;
+    *stats = _rtthread_memfile_g.stats;
+
+    if (reset)
+    {
+        memset(&_rtthread_memfile_g.stats, 0, sizeof(_rtthread_memfile_g.stats));
+        _rtthread_memfile_g.stats.mem_peak = _rtthread_memfile_g.nUsed;
+    }
+
+    _rtthread_vfs_leave_mutex();
+}
+
+#endif  /* PKG_SQLITE_TEMP_MEM_SIZE > 0 */
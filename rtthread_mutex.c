@@ -4,13 +4,175 @@
 * rt-thread mutex
 */
 struct sqlite3_mutex {
-    struct rt_mutex mutex;          /* Mutex controlling the lock */
+    struct rt_mutex mutex;          /* all but an uncontended SQLITE_MUTEX_FAST */
+    volatile rt_int32_t state;      /* FAST: 0 free, 1 held by compare-and-swap, 2 held with mutex */
+    volatile int slow;              /* FAST: has been contended, always take mutex now */
     int id;                         /* Mutex type */
+#ifdef SQLITE_DEBUG
+    rt_thread_t owner;              /* holder of a fast mutex */
+#endif
+#ifdef PKG_SQLITE_MUTEX_PROFILE
+    rt_uint32_t acquired;           /* clock when the outermost enter got the mutex */
+#endif
 };
 
+/*
+** SQLite never enters a FAST mutex recursively, so an uncontended one skips
+** the rt_mutex (scheduler lock, owner and priority inheritance bookkeeping)
+** and is taken with a compare-and-swap on its state word, retried a few
+** times on SMP where the holder may be about to leave. The first enter that
+** still finds it taken switches the mutex for good to its rt_mutex, so that
+** from then on a waiter lends its priority to the holder, as the VFS and
+** cache mutexes held across I/O need. That waiter sleeps out the holder
+** that got in by compare-and-swap, the only hold without inheritance.
+** The static mutexes are always rt_mutex; set PKG_SQLITE_FAST_MUTEX to 0 to
+** keep rt_mutex for all.
+*/
+#if PKG_SQLITE_FAST_MUTEX
+#define _RTTHREAD_MTX_FAST(p)   ((p)->id == SQLITE_MUTEX_FAST)
+#else
+#define _RTTHREAD_MTX_FAST(p)   0
+#endif
+
+#ifdef RT_USING_SMP
+#define _RTTHREAD_MTX_SPIN      64
+#else
+#define _RTTHREAD_MTX_SPIN      1       /* the holder cannot run while we spin */
+#endif
+
+#if defined(__GCC_HAVE_SYNC_COMPARE_AND_SWAP_4)
+static rt_int32_t _rtthread_atomic_cas(volatile rt_int32_t *v, rt_int32_t expect, rt_int32_t value)
+{
+    __atomic_compare_exchange_n(v, &expect, value, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+    return expect;
+}
+
+static rt_int32_t _rtthread_atomic_xchg(volatile rt_int32_t *v, rt_int32_t value)
+{
+    return __atomic_exchange_n(v, value, __ATOMIC_ACQ_REL);
+}
+#else
+/* no native compare-and-swap (e.g. Cortex-M0): a few instructions with interrupts masked */
+static rt_int32_t _rtthread_atomic_cas(volatile rt_int32_t *v, rt_int32_t expect, rt_int32_t value)
+{
+    rt_base_t level = rt_hw_interrupt_disable();
+    rt_int32_t old = *v;
+
+    if (old == expect)
+    {
+        *v = value;
+    }
+    rt_hw_interrupt_enable(level);
+    return old;
+}
+
+static rt_int32_t _rtthread_atomic_xchg(volatile rt_int32_t *v, rt_int32_t value)
+{
+    rt_base_t level = rt_hw_interrupt_disable();
+    rt_int32_t old = *v;
+
+    *v = value;
+    rt_hw_interrupt_enable(level);
+    return old;
+}
+#endif
+
 SQLITE_PRIVATE void sqlite3MemoryBarrier(void)
 {
+#if defined(__GNUC__) || defined(__clang__)
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+#elif defined(__CC_ARM)
+    __dmb(0xf);
+#elif defined(__ICCARM__)
+    __asm volatile ("dmb" ::: "memory");
+#else
+    /* taking the interrupt lock orders memory on every port, SMP ones included */
+    rt_base_t level = rt_hw_interrupt_disable();
+    rt_hw_interrupt_enable(level);
+#endif
+}
+
+#ifdef PKG_SQLITE_MUTEX_PROFILE
+#include "rtthread_vfs.h"
+
+/*
+** Contention profile, one row per mutex id (FAST and RECURSIVE share a row
+** among all the mutexes of that type). Waits and holds are measured with
+** PKG_SQLITE_IO_CLOCK(), see rtthread_vfs.h. A contended acquisition is one
+** that found the mutex taken and had to wait; a try refused with
+** SQLITE_BUSY counts as contended but not as an acquisition. The rows are
+** shared by all mutexes of a type, so they are updated with interrupts
+** masked.
+*/
+struct _rtthread_mtx_prof
+{
+    rt_uint32_t acquisitions;       /* successful enters and tries */
+    rt_uint32_t contended;          /* enters that waited, refused tries */
+    rt_uint64_t wait_time;          /* total time spent waiting in enter */
+    rt_uint32_t hold_max;           /* longest time from enter to leave */
+};
+
+static struct _rtthread_mtx_prof _rtthread_mtx_prof[SQLITE_MUTEX_STATIC_VFS3 + 1];
+
+static void _rtthread_mtx_prof_acquired(sqlite3_mutex *p, int contended, rt_uint32_t wait)
+{
+    struct _rtthread_mtx_prof *prof = &_rtthread_mtx_prof[p->id];
+    rt_base_t level;
+
+    /* time the hold from the outermost enter of a recursive mutex only */
+    if (_RTTHREAD_MTX_FAST(p) || p->mutex.hold == 1)
+    {
+        p->acquired = PKG_SQLITE_IO_CLOCK();
+    }
+    level = rt_hw_interrupt_disable();
+    prof->acquisitions++;
+    if (contended)
+    {
+        prof->contended++;
+        prof->wait_time += wait;
+    }
+    rt_hw_interrupt_enable(level);
+}
+
+static void _rtthread_mtx_prof_busy(sqlite3_mutex *p)
+{
+    rt_base_t level = rt_hw_interrupt_disable();
+
+    _rtthread_mtx_prof[p->id].contended++;
+    rt_hw_interrupt_enable(level);
+}
+
+static void _rtthread_mtx_prof_release(sqlite3_mutex *p)
+{
+    struct _rtthread_mtx_prof *prof = &_rtthread_mtx_prof[p->id];
+    rt_uint32_t hold;
+    rt_base_t level;
+
+    if (!_RTTHREAD_MTX_FAST(p) && p->mutex.hold != 1)
+    {
+        return;
+    }
+    hold = PKG_SQLITE_IO_CLOCK() - p->acquired;
+    level = rt_hw_interrupt_disable();
+    if (hold > prof->hold_max)
+    {
+        prof->hold_max = hold;
+    }
+    rt_hw_interrupt_enable(level);
+}
+#endif
+
+static rt_err_t _rtthread_mtx_setup(sqlite3_mutex *p, int id)
+{
+    p->id = id;
+    p->state = 0;
+    p->slow = 0;
+    return rt_mutex_init(&p->mutex, "sqlmtx", RT_IPC_FLAG_PRIO);
+}
 
+static rt_err_t _rtthread_mtx_teardown(sqlite3_mutex *p)
+{
+    return rt_mutex_detach(&p->mutex);
 }
 
 /*
@@ -61,7 +223,7 @@ static int _rtthread_mtx_init(void)
 
     for (i = 0; i < sizeof(_static_mutex) / sizeof(_static_mutex[0]); i++)
     {
-        err = rt_mutex_init(&_static_mutex[i].mutex, "sqlmtx", RT_IPC_FLAG_PRIO);
+        err = _rtthread_mtx_setup(&_static_mutex[i], i + 2);
 
         if (err != RT_EOK)
         {
@@ -79,9 +241,8 @@ static int _rtthread_mtx_end(void)
 
     for (i = 0; i < sizeof(_static_mutex) / sizeof(_static_mutex[0]); i++)
     {
-        err = rt_mutex_detach(&_static_mutex[i].mutex);
-        _static_mutex[i].mutex.owner = 0;
-        _static_mutex[i].mutex.hold = 0;
+        err = _rtthread_mtx_teardown(&_static_mutex[i]);
+        memset(&_static_mutex[i].mutex, 0, sizeof(_static_mutex[i].mutex));
 
         if (err != RT_EOK)
         {
@@ -104,8 +265,7 @@ static sqlite3_mutex * _rtthread_mtx_alloc(int id)
 
         if (p != NULL)
         {
-            rt_mutex_init(&p->mutex, "sqlmtx", RT_IPC_FLAG_PRIO);
-            p->id = id;
+            _rtthread_mtx_setup(p, id);
         }
         break;
 
@@ -113,7 +273,6 @@ static sqlite3_mutex * _rtthread_mtx_alloc(int id)
         assert(id - 2 >= 0);
         assert(id - 2 < ArraySize(_static_mutex) );
         p = &_static_mutex[id - 2];
-        p->id = id;
         break;
     }
 
@@ -124,12 +283,11 @@ static void _rtthread_mtx_free(sqlite3_mutex * p)
 {
     assert(p != 0);
 
-    rt_mutex_detach(&p->mutex);
-
     switch (p->id)
     {
     case SQLITE_MUTEX_FAST:
     case SQLITE_MUTEX_RECURSIVE:
+        _rtthread_mtx_teardown(p);
         sqlite3_free(p);
         break;
 
@@ -140,20 +298,100 @@ static void _rtthread_mtx_free(sqlite3_mutex * p)
 
 static void _rtthread_mtx_enter(sqlite3_mutex *p)
 {
+    int i;
+#ifdef PKG_SQLITE_MUTEX_PROFILE
+    rt_uint32_t start = 0;
+    int waited = 0;
+#endif
+
     assert(p != 0);
 
+    if (_RTTHREAD_MTX_FAST(p) && !p->slow)
+    {
+        for (i = 0; i < _RTTHREAD_MTX_SPIN; i++)
+        {
+            if (_rtthread_atomic_cas(&p->state, 0, 1) == 0)
+            {
+#ifdef PKG_SQLITE_MUTEX_PROFILE
+                _rtthread_mtx_prof_acquired(p, i > 0, 0);
+#endif
+#ifdef SQLITE_DEBUG
+                p->owner = rt_thread_self();
+#endif
+                return;
+            }
+        }
+        p->slow = 1;
+    }
+
+#ifdef PKG_SQLITE_MUTEX_PROFILE
+    if (rt_mutex_take(&p->mutex, RT_WAITING_NO) != RT_EOK)
+    {
+        start = PKG_SQLITE_IO_CLOCK();
+        waited = 1;
+        rt_mutex_take(&p->mutex, RT_WAITING_FOREVER);
+    }
+#else
     rt_mutex_take(&p->mutex, RT_WAITING_FOREVER);
+#endif
+    if (_RTTHREAD_MTX_FAST(p))
+    {
+        /* a holder that got in by compare-and-swap before the switch */
+        while (_rtthread_atomic_cas(&p->state, 0, 2) != 0)
+        {
+#ifdef PKG_SQLITE_MUTEX_PROFILE
+            if (!waited)
+            {
+                start = PKG_SQLITE_IO_CLOCK();
+                waited = 1;
+            }
+#endif
+            rt_thread_delay(1);
+        }
+#ifdef SQLITE_DEBUG
+        p->owner = rt_thread_self();
+#endif
+    }
+#ifdef PKG_SQLITE_MUTEX_PROFILE
+    _rtthread_mtx_prof_acquired(p, waited, waited ? PKG_SQLITE_IO_CLOCK() - start : 0);
+#endif
 }
 
 static int _rtthread_mtx_try(sqlite3_mutex *p)
 {
     assert(p != 0);
 
-    if (rt_mutex_take(&p->mutex, RT_WAITING_NO) != RT_EOK)
+    if (_RTTHREAD_MTX_FAST(p) && !p->slow)
     {
+        if (_rtthread_atomic_cas(&p->state, 0, 1) != 0)
+        {
+#ifdef PKG_SQLITE_MUTEX_PROFILE
+            _rtthread_mtx_prof_busy(p);
+#endif
+            return SQLITE_BUSY;
+        }
+    }
+    else if (rt_mutex_take(&p->mutex, RT_WAITING_NO) != RT_EOK)
+    {
+#ifdef PKG_SQLITE_MUTEX_PROFILE
+        _rtthread_mtx_prof_busy(p);
+#endif
         return SQLITE_BUSY;
     }
-
+    else if (_RTTHREAD_MTX_FAST(p) && _rtthread_atomic_cas(&p->state, 0, 2) != 0)
+    {
+        rt_mutex_release(&p->mutex);
+#ifdef PKG_SQLITE_MUTEX_PROFILE
+        _rtthread_mtx_prof_busy(p);
+#endif
+        return SQLITE_BUSY;
+    }
+#ifdef PKG_SQLITE_MUTEX_PROFILE
+    _rtthread_mtx_prof_acquired(p, 0, 0);
+#endif
+#ifdef SQLITE_DEBUG
+    p->owner = rt_thread_self();
+#endif
     return SQLITE_OK;
 }
 
@@ -161,7 +399,21 @@ static void _rtthread_mtx_leave(sqlite3_mutex *p)
 {
     assert(p != 0);
 
-    rt_mutex_release(&p->mutex);
+#ifdef PKG_SQLITE_MUTEX_PROFILE
+    _rtthread_mtx_prof_release(p);
+#endif
+    if (!_RTTHREAD_MTX_FAST(p))
+    {
+        rt_mutex_release(&p->mutex);
+        return;
+    }
+#ifdef SQLITE_DEBUG
+    p->owner = RT_NULL;
+#endif
+    if (_rtthread_atomic_xchg(&p->state, 0) == 2)
+    {
+        rt_mutex_release(&p->mutex);
+    }
 }
 
 #ifdef SQLITE_DEBUG
@@ -179,6 +431,10 @@ static int _rtthread_mtx_held(sqlite3_mutex *p)
 {
     if (p != 0)
     {
+        if (_RTTHREAD_MTX_FAST(p))
+        {
+            return p->state != 0 && p->owner == rt_thread_self();
+        }
         if ((rt_thread_self() == p->mutex.owner) && (p->mutex.hold > 0))
         {
             return 1;
@@ -202,6 +458,44 @@ static int _rtthread_mtx_noheld(sqlite3_mutex *p)
 
 #endif  /* SQLITE_DEBUG */
 
+#if defined(PKG_SQLITE_MUTEX_PROFILE) && defined(RT_USING_FINSH)
+static void sqlmtx(int argc, char **argv)
+{
+    static const char *azName[ArraySize(_rtthread_mtx_prof)] = {
+        "fast", "recursive", "master", "mem", "open", "prng", "lru",
+        "pmem", "app1", "app2", "app3", "vfs1", "vfs2", "vfs3"
+    };
+    struct _rtthread_mtx_prof prof[ArraySize(_rtthread_mtx_prof)];
+    char zLine[128];
+    rt_base_t level;
+    int i;
+
+    level = rt_hw_interrupt_disable();
+    memcpy(prof, _rtthread_mtx_prof, sizeof(prof));
+    if (argc >= 2 && rt_strcmp(argv[1], "reset") == 0)
+    {
+        memset(_rtthread_mtx_prof, 0, sizeof(_rtthread_mtx_prof));
+    }
+    rt_hw_interrupt_enable(level);
+
+    /* rt_kprintf() has no 64-bit conversions, sqlite3_snprintf() does */
+    rt_kprintf("%-10s %10s %10s %14s %12s\n", "mutex", "acquired", "contended",
+               "wait_" RTTHREAD_IO_CLOCK_UNIT, "hold_max_" RTTHREAD_IO_CLOCK_UNIT);
+    for (i = 0; i < ArraySize(prof); i++)
+    {
+        if (prof[i].acquisitions == 0 && prof[i].contended == 0)
+        {
+            continue;
+        }
+        sqlite3_snprintf(sizeof(zLine), zLine, "%-10s %10u %10u %14lld %12u", azName[i],
+                         prof[i].acquisitions, prof[i].contended,
+                         (sqlite3_int64)prof[i].wait_time, prof[i].hold_max);
+        rt_kprintf("%s\n", zLine);
+    }
+}
+MSH_CMD_EXPORT(sqlmtx, sqlite mutex contention profile: sqlmtx [reset]);
+#endif
+
 SQLITE_PRIVATE sqlite3_mutex_methods const *sqlite3DefaultMutex(void)
 {
     static const sqlite3_mutex_methods sMutex = {
@@ -224,5 +518,7 @@ SQLITE_PRIVATE sqlite3_mutex_methods const *sqlite3DefaultMutex(void)
     return &sMutex;
 }
 
+#include "rtthread_threads.c"
+
 #endif  /* SQLITE_MUTEX_RTTHREAD */
 
@@ -0,0 +1,150 @@
+/*
+** Worker threads of the multi-threaded sorter.
+**
+** With SQLITE_MAX_WORKER_THREADS above zero, large sorts (ORDER BY, CREATE
+** INDEX, ...) hand the sorting and merging of their runs to worker threads
+** started through sqlite3ThreadCreate(). Without an implementation for the
+** platform, threads.c falls back to running every task on the calling
+** thread, so this one starts them as RT-Thread threads. It defines
+** SQLITE_THREADS_IMPLEMENTED, so it is included from rtthread_mutex.c, which
+** comes before threads.c in the amalgamation.
+**
+** A worker runs at PKG_SQLITE_WORKER_PRIORITY, by default the priority of
+** the thread that starts the sort, and on SMP is bound to the core
+** PKG_SQLITE_WORKER_CPU, by default any. Both can be changed at run time
+** with rtthread_vfs_worker_config(), so that sorts on a background thread
+** do not preempt control tasks. A worker that cannot be started runs its
+** task on the calling thread, as the fallback does.
+*/
+#if SQLITE_MAX_WORKER_THREADS > 0 && SQLITE_THREADSAFE > 0
+
+#define SQLITE_THREADS_IMPLEMENTED 1
+
+#ifndef PKG_SQLITE_WORKER_STACK_SIZE
+#define PKG_SQLITE_WORKER_STACK_SIZE 8192
+#endif
+
+/* priority of the workers, negative for the priority of the thread sorting */
+#ifndef PKG_SQLITE_WORKER_PRIORITY
+#define PKG_SQLITE_WORKER_PRIORITY -1
+#endif
+
+/* core the workers are bound to on SMP, negative for any */
+#ifndef PKG_SQLITE_WORKER_CPU
+#define PKG_SQLITE_WORKER_CPU -1
+#endif
+
+#ifndef PKG_SQLITE_WORKER_TICK
+#define PKG_SQLITE_WORKER_TICK 10
+#endif
+
+static int _rtthread_worker_priority = PKG_SQLITE_WORKER_PRIORITY;
+static int _rtthread_worker_cpu = PKG_SQLITE_WORKER_CPU;
+
+/* A running thread */
+struct SQLiteThread
+{
+    rt_thread_t tid;                /* RT_NULL when the task ran on the caller */
+    struct rt_semaphore done;       /* released when the task has returned */
+    void *pOut;                     /* Result returned by the thread */
+    void *(*xTask)(void *);         /* The thread routine */
+    void *pIn;                      /* Argument to the thread */
+};
+
+static void _rtthread_worker_entry(void *parameter)
+{
+    SQLiteThread *p = (SQLiteThread *)parameter;
+
+    p->pOut = p->xTask(p->pIn);
+    rt_sem_release(&p->done);
+}
+
+/* Create a new thread */
+SQLITE_PRIVATE int sqlite3ThreadCreate(SQLiteThread **ppThread, void *(*xTask)(void *), void *pIn)
+{
+    SQLiteThread *p;
+    int priority = _rtthread_worker_priority;
+#ifdef RT_USING_SMP
+    int cpu = _rtthread_worker_cpu;
+#endif
+
+    assert(ppThread != 0);
+    assert(xTask != 0);
+    /* This routine is never used in single-threaded mode */
+    assert(sqlite3GlobalConfig.bCoreMutex != 0);
+
+    *ppThread = 0;
+    p = sqlite3Malloc(sizeof(*p));
+    if (p == 0)
+    {
+        return SQLITE_NOMEM_BKPT;
+    }
+    memset(p, 0, sizeof(*p));
+    p->xTask = xTask;
+    p->pIn = pIn;
+
+    if (priority < 0 || priority >= RT_THREAD_PRIORITY_MAX)
+    {
+        priority = rt_thread_self()->current_priority;
+    }
+    /* If the SQLITE_TESTCTRL_FAULT_INSTALL callback is registered to a
+    ** non-zero value, do not create threads */
+    if (sqlite3FaultSim(200) == SQLITE_OK && rt_sem_init(&p->done, "sqlwk", 0, RT_IPC_FLAG_FIFO) == RT_EOK)
+    {
+        p->tid = rt_thread_create("sqlwk", _rtthread_worker_entry, p, PKG_SQLITE_WORKER_STACK_SIZE,
+                                  priority, PKG_SQLITE_WORKER_TICK);
+        if (p->tid == RT_NULL)
+        {
+            rt_sem_detach(&p->done);
+        }
+    }
+    if (p->tid == RT_NULL)
+    {
+        p->pOut = xTask(pIn);
+    }
+    else
+    {
+#ifdef RT_USING_SMP
+        if (cpu >= 0 && cpu < RT_CPUS_NR)
+        {
+            rt_thread_control(p->tid, RT_THREAD_CTRL_BIND_CPU, (void *)(rt_ubase_t)cpu);
+        }
+#endif
+        rt_thread_startup(p->tid);
+    }
+    *ppThread = p;
+    return SQLITE_OK;
+}
+
+/* Get the results of the thread */
+SQLITE_PRIVATE int sqlite3ThreadJoin(SQLiteThread *p, void **ppOut)
+{
+    assert(ppOut != 0);
+    if (NEVER(p == 0))
+    {
+        return SQLITE_NOMEM_BKPT;
+    }
+    if (p->tid != RT_NULL)
+    {
+        /* the worker exits by itself after releasing done, the idle thread reaps it */
+        rt_sem_take(&p->done, RT_WAITING_FOREVER);
+        rt_sem_detach(&p->done);
+    }
+    *ppOut = p->pOut;
+    sqlite3_free(p);
+    return SQLITE_OK;
+}
+
+void rtthread_vfs_worker_config(int priority, int cpu)
+{
+    _rtthread_worker_priority = priority;
+    _rtthread_worker_cpu = cpu;
+}
+
+#else
+
+void rtthread_vfs_worker_config(int priority, int cpu)
+{
+}
+
+#endif  /* SQLITE_MAX_WORKER_THREADS > 0 && SQLITE_THREADSAFE > 0 */
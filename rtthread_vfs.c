@@ -7,6 +7,8 @@
 #define RTTHREAD_MAX_PATHNAME       256
 
 #include <dfs_posix.h>
+#include <dfs_fs.h>
+#include "rtthread_vfs.h"
 
 /*
 ** Define various macros that are missing from some systems.
@@ -140,16 +142,108 @@ static int _rtthread_log_error_at_line(
     return errcode;
 }
 
+#if PKG_SQLITE_READAHEAD_SIZE > 0
+/*
+** Sequential read-ahead window of one file. The buffer is allocated the
+** first time a sequential run is detected and lives until the file is closed.
+*/
 typedef struct
+{
+    char *pBuf;                     /* window buffer, PKG_SQLITE_READAHEAD_SIZE bytes */
+    sqlite3_int64 iOff;             /* file offset of pBuf[0] */
+    int nBuf;                       /* valid bytes in pBuf, 0 when the window is empty */
+    int nServed;                    /* bytes of the window handed out so far */
+    int nWindow;                    /* size of the next fill */
+    int nSeq;                       /* consecutive sequential reads seen */
+    sqlite3_int64 iNext;            /* offset just past the previous read */
+    struct rtthread_readahead_stats stats;
+} RTTHREAD_READAHEAD_T;
+#endif
+
+/*
+** One entry per named file known to this VFS, shared by every handle on
+** that file.  All connections live in the same address space, so the lock
+** state can be kept in memory rather than in OS advisory locks: a count of
+** SHARED holders plus the strongest lock currently granted.
+**
+** The same entry caches what the VFS knows about the file, so that the
+** hot journal probe done by xAccess at the start of every read transaction
+** and xFileSize can be answered without open()/stat()/fstat().  The VFS
+** keeps it exact through its own open, write, truncate and delete paths.
+** Up to PKG_SQLITE_META_CACHE_SIZE entries of files with no open handle
+** are kept, most recently used first.  Entries are kept on a list
+** protected by the VFS mutex.
+*/
+typedef struct rtthread_inode
+{
+    struct rtthread_inode *pNext;
+    int nRef;                       /* handles open on this file */
+    int nShared;                    /* handles holding SHARED_LOCK or above */
+    int eFileLock;                  /* strongest lock held by any handle */
+    int eExists;                    /* 1 exists, 0 does not, -1 unknown */
+    sqlite3_int64 iSize;            /* file size, -1 when unknown */
+    int fdSpare;                    /* closed journal kept open for reuse, or -1 */
+    int flagsSpare;                 /* SQLITE_OPEN_xxx flags fdSpare was opened with */
+    int bZeroed;                    /* journal header zeroed, the journal is not live */
+    int bNoSync;                    /* the writer runs with synchronous=OFF */
+    char zPath[1];                  /* full pathname, the lookup key */
+} RTTHREAD_INODE_T;
+
+typedef struct rtthread_sqlite_file
 {
     sqlite3_io_methods const *pMethod;
     sqlite3_vfs *pvfs;
+    const char *zPath;              /* name given to xOpen, 0 for temp files */
     int fd;
     int eFileLock;
     int szChunk;
-    struct rt_semaphore sem;
+    int szBlock;                    /* filesystem block size, 0 until needed */
+    sqlite3_int64 iAlloc;           /* bytes known to be allocated to the file */
+    int szSector;                   /* sector size reported to the pager */
+    int iocap;                      /* SQLITE_IOCAP_xxx flags of the media */
+    int flags;                      /* SQLITE_OPEN_xxx flags the file was opened with */
+    int eSync;                      /* PRAGMA synchronous of the connection, 0 is OFF */
+    struct rtthread_inode *pInode;  /* shared lock state, 0 for private files */
+#if PKG_SQLITE_READAHEAD_SIZE > 0
+    RTTHREAD_READAHEAD_T ra;
+#endif
+#if PKG_SQLITE_TEMP_MEM_SIZE > 0
+    struct rtthread_memfile *pMem;  /* content of a temp file kept in RAM */
+#endif
+#if PKG_SQLITE_BLOCK_CACHE_SIZE > 0
+    int eCache;                     /* RTTHREAD_BCACHE_xxx policy of this handle */
+    int eCacheType;                 /* RTTHREAD_IO_xxx type the policy was chosen by */
+    struct rtthread_bcache_stats bc;    /* block cache counters of this handle */
+#endif
+#if PKG_SQLITE_ASYNC_IO_SIZE > 0
+    int nAioPending;                /* writes queued on this handle and not yet done */
+    int rcAio;                      /* first error of those writes, until reported */
+#endif
+#ifdef PKG_SQLITE_IO_STATS
+    struct rtthread_io_stats io;    /* system calls issued through this handle */
+    struct rtthread_sqlite_file *pIoNext;   /* next handle on the open list */
+#endif
 } RTTHREAD_SQLITE_FILE_T;
 
+/*
+** Serialize access to state shared by all files of the VFS.
+*/
+static void _rtthread_vfs_enter_mutex(void)
+{
+    sqlite3_mutex_enter(sqlite3_mutex_alloc(SQLITE_MUTEX_STATIC_VFS1));
+}
+
+static void _rtthread_vfs_leave_mutex(void)
+{
+    sqlite3_mutex_leave(sqlite3_mutex_alloc(SQLITE_MUTEX_STATIC_VFS1));
+}
+
+#if PKG_SQLITE_BLOCK_CACHE_SIZE > 0
+static void _rtthread_bcache_forget(void *pKey);
+#else
+#define _rtthread_bcache_forget(pKey)
+#endif
+
 static const char* _rtthread_temp_file_dir(void)
 {
     const char *azDirs[] = {
@@ -221,6 +315,326 @@ static int _rtthread_get_temp_name(int nBuf, char *zBuf)
     return SQLITE_OK;
 }
 
+static RTTHREAD_INODE_T *_rtthread_inode_list = 0;
+static int _rtthread_inode_idle = 0;  /* entries with no open handle */
+static struct rtthread_meta_stats _rtthread_meta_stats;
+
+/*
+** Find the entry for zPath and move it to the front of the list, creating
+** an idle one when bCreate is set.  Returns 0 when there is no entry or
+** memory is short.  The caller must hold the VFS mutex.
+*/
+static RTTHREAD_INODE_T *_rtthread_inode_find(const char *zPath, int bCreate)
+{
+    RTTHREAD_INODE_T **pp, *pInode;
+    int nPath;
+
+    for (pp = &_rtthread_inode_list; (pInode = *pp) != 0; pp = &pInode->pNext)
+    {
+        if (strcmp(pInode->zPath, zPath) == 0)
+        {
+            *pp = pInode->pNext;
+            pInode->pNext = _rtthread_inode_list;
+            _rtthread_inode_list = pInode;
+            return pInode;
+        }
+    }
+
+    if (!bCreate)
+    {
+        return 0;
+    }
+
+    nPath = (int)strlen(zPath);
+    pInode = sqlite3_malloc(sizeof(RTTHREAD_INODE_T) + nPath);
+
+    if (pInode)
+    {
+        memset(pInode, 0, sizeof(RTTHREAD_INODE_T));
+        memcpy(pInode->zPath, zPath, nPath + 1);
+        pInode->eFileLock = NO_LOCK;
+        pInode->eExists = -1;
+        pInode->iSize = -1;
+        pInode->fdSpare = -1;
+        pInode->pNext = _rtthread_inode_list;
+        _rtthread_inode_list = pInode;
+        _rtthread_inode_idle++;
+    }
+
+    return pInode;
+}
+
+/*
+** Free the least recently used idle entries until no more than
+** PKG_SQLITE_META_CACHE_SIZE remain.  The caller must hold the VFS mutex.
+*/
+static void _rtthread_inode_trim(void)
+{
+    RTTHREAD_INODE_T **pp, **ppVictim;
+
+    while (_rtthread_inode_idle > PKG_SQLITE_META_CACHE_SIZE)
+    {
+        ppVictim = 0;
+
+        for (pp = &_rtthread_inode_list; *pp; pp = &(*pp)->pNext)
+        {
+            if ((*pp)->nRef == 0) ppVictim = pp;
+        }
+
+        if (ppVictim)
+        {
+            RTTHREAD_INODE_T *pVictim = *ppVictim;
+
+            *ppVictim = pVictim->pNext;
+            _rtthread_bcache_forget(pVictim);
+            sqlite3_free(pVictim);
+        }
+
+        _rtthread_inode_idle--;
+    }
+}
+
+/*
+** Find or create the inode entry for zPath and take a reference on it.
+** The file has just been opened, so it exists.  Returns 0 when out of
+** memory.
+*/
+static RTTHREAD_INODE_T *_rtthread_inode_acquire(const char *zPath)
+{
+    RTTHREAD_INODE_T *pInode;
+
+    _rtthread_vfs_enter_mutex();
+    pInode = _rtthread_inode_find(zPath, 1);
+
+    if (pInode)
+    {
+        /* The file may have been replaced by other means while no handle
+        ** was open on it, so its size is read again on first use. */
+        if (pInode->nRef++ == 0)
+        {
+            _rtthread_inode_idle--;
+            pInode->iSize = -1;
+        }
+
+        pInode->eExists = 1;
+    }
+    _rtthread_vfs_leave_mutex();
+
+    return pInode;
+}
+
+/*
+** Drop a reference taken by _rtthread_inode_acquire().  The caller must
+** already have released any lock it held through this entry.
+*/
+static void _rtthread_inode_release(RTTHREAD_INODE_T *pInode)
+{
+    _rtthread_vfs_enter_mutex();
+    if (--pInode->nRef == 0)
+    {
+        _rtthread_inode_idle++;
+        _rtthread_inode_trim();
+    }
+    _rtthread_vfs_leave_mutex();
+}
+
+/*
+** Record the size of a file after a write, truncate or extend through one
+** of its handles.  With bGrow set the size only moves forward, and stays
+** unknown if it was.
+*/
+static void _rtthread_inode_set_size(RTTHREAD_INODE_T *pInode, sqlite3_int64 iSize, int bGrow)
+{
+    if (pInode == 0)
+    {
+        return;
+    }
+
+    _rtthread_vfs_enter_mutex();
+    if (!bGrow || (pInode->iSize >= 0 && iSize > pInode->iSize))
+    {
+        pInode->iSize = iSize;
+    }
+    _rtthread_vfs_leave_mutex();
+}
+
+void rtthread_vfs_meta_stats(struct rtthread_meta_stats *stats, int reset)
+{
+    _rtthread_vfs_enter_mutex();
+    *stats = _rtthread_meta_stats;
+    if (reset)
+    {
+        memset(&_rtthread_meta_stats, 0, sizeof(_rtthread_meta_stats));
+    }
+    _rtthread_vfs_leave_mutex();
+}
+
+void rtthread_vfs_meta_invalidate(const char *path)
+{
+    RTTHREAD_INODE_T *pInode;
+
+    _rtthread_vfs_enter_mutex();
+    for (pInode = _rtthread_inode_list; pInode; pInode = pInode->pNext)
+    {
+        if (path == 0 || strcmp(pInode->zPath, path) == 0)
+        {
+            pInode->eExists = -1;
+            pInode->iSize = -1;
+            _rtthread_bcache_forget(pInode);
+        }
+    }
+    _rtthread_vfs_leave_mutex();
+}
+
+#include "rtthread_iostats.c"
+#include "rtthread_bcache.c"
+
+/*
+** Journal reuse.  In the default DELETE journal mode every write
+** transaction creates the -journal file and unlinks it at commit, and
+** the unlink is followed by a directory sync; on FAT these directory
+** updates are the slowest part of a commit.  With reuse enabled, a main
+** journal closed by the pager is parked, still open, in its inode entry,
+** and xDelete invalidates it by zeroing its header, just as
+** journal_mode=PERSIST does, instead of removing it.  The next transaction
+** takes the parked descriptor back without an open().  A parked journal
+** holds a reference on its inode entry and keeps its directory entry
+** until the last handle on the database is closed.
+*/
+#ifdef PKG_SQLITE_JOURNAL_REUSE
+static int _rtthread_journal_reuse = 1;
+#else
+static int _rtthread_journal_reuse = 0;
+#endif
+
+/* bytes cleared to invalidate a journal, as zeroJournalHdr() does */
+#define RTTHREAD_JOURNAL_HDR        28
+
+/* synchronous of a connection that has not set it with a PRAGMA */
+#ifdef SQLITE_DEFAULT_SYNCHRONOUS
+#define RTTHREAD_DEFAULT_SYNC       SQLITE_DEFAULT_SYNCHRONOUS
+#else
+#define RTTHREAD_DEFAULT_SYNC       2
+#endif
+
+int rtthread_vfs_journal_reuse(int enable)
+{
+    int old = _rtthread_journal_reuse;
+
+    if (enable >= 0)
+    {
+        _rtthread_journal_reuse = enable;
+    }
+
+    return old;
+}
+
+/* open flags a parked journal must have been opened with to be reused */
+#define RTTHREAD_JOURNAL_OPEN_FLAGS (SQLITE_OPEN_READONLY | SQLITE_OPEN_READWRITE \
+                                     | SQLITE_OPEN_CREATE | SQLITE_OPEN_EXCLUSIVE)
+
+/*
+** Give the parked descriptor of journal zPath, with the inode reference
+** it holds, to a new handle opening it with flags.  Returns -1 if there is
+** none, or if it was opened with other flags, e.g. read/write where the
+** hot journal check opens it read-only.
+*/
+static int _rtthread_journal_take(const char *zPath, int flags, RTTHREAD_INODE_T **ppInode)
+{
+    RTTHREAD_INODE_T *pInode;
+    int fd = -1;
+
+    _rtthread_vfs_enter_mutex();
+    pInode = _rtthread_inode_find(zPath, 0);
+    if (pInode && pInode->fdSpare >= 0
+        && (pInode->flagsSpare & RTTHREAD_JOURNAL_OPEN_FLAGS) == (flags & RTTHREAD_JOURNAL_OPEN_FLAGS))
+    {
+        fd = pInode->fdSpare;
+        pInode->fdSpare = -1;
+        *ppInode = pInode;
+    }
+    _rtthread_vfs_leave_mutex();
+
+    return fd;
+}
+
+/*
+** Park the descriptor of a read/write main journal being closed.  Returns
+** non-zero if the descriptor and the inode reference now belong to the
+** inode entry.
+*/
+static int _rtthread_journal_park(RTTHREAD_SQLITE_FILE_T *file)
+{
+    int bParked = 0;
+
+    if (!_rtthread_journal_reuse || file->pInode == 0
+        || (file->flags & (SQLITE_OPEN_MAIN_JOURNAL | SQLITE_OPEN_READWRITE))
+            != (SQLITE_OPEN_MAIN_JOURNAL | SQLITE_OPEN_READWRITE))
+    {
+        return 0;
+    }
+
+    _rtthread_vfs_enter_mutex();
+    if (file->pInode->fdSpare < 0)
+    {
+        file->pInode->fdSpare = file->fd;
+        file->pInode->flagsSpare = file->flags;
+        bParked = 1;
+    }
+    _rtthread_vfs_leave_mutex();
+
+    return bParked;
+}
+
+/*
+** Drop the reference held by a parked journal.  The caller must hold the
+** VFS mutex.
+*/
+static void _rtthread_journal_unpark(RTTHREAD_INODE_T *pInode)
+{
+    close(pInode->fdSpare);
+    pInode->fdSpare = -1;
+
+    if (--pInode->nRef == 0)
+    {
+        _rtthread_inode_idle++;
+        _rtthread_inode_trim();
+    }
+}
+
+/*
+** Called when a handle on database pDb is closing.  If it is the last
+** one, close the parked journal of the database and remove it.  A journal
+** that was not invalidated may be hot and is left on disk for recovery.
+*/
+static void _rtthread_journal_discard(RTTHREAD_INODE_T *pDb)
+{
+    char zJournal[RTTHREAD_MAX_PATHNAME + 10];
+    RTTHREAD_INODE_T *pInode = 0;
+
+    sqlite3_snprintf(sizeof(zJournal), zJournal, "%s-journal", pDb->zPath);
+
+    _rtthread_vfs_enter_mutex();
+    if (pDb->nRef == 1)
+    {
+        pInode = _rtthread_inode_find(zJournal, 0);
+    }
+    if (pInode && pInode->fdSpare >= 0)
+    {
+        if (pInode->bZeroed)
+        {
+            _rtthread_bcache_forget(pInode);
+            unlink(zJournal);
+            pInode->eExists = 0;
+            pInode->iSize = -1;
+            pInode->bZeroed = 0;
+        }
+        _rtthread_journal_unpark(pInode);
+    }
+    _rtthread_vfs_leave_mutex();
+}
+
+#include "rtthread_aio.c"
 #include "rtthread_io_methods.c"
 
 /*
@@ -264,6 +678,183 @@ static int _rtthread_fs_open(const char *file_path, int f, mode_t m)
     return fd;
 }
 
+/*
+** Per-mount geometry overrides set by rtthread_vfs_set_geometry(). A file
+** uses the entry with the longest mount path that prefixes its own path.
+*/
+#define RTTHREAD_GEOMETRY_MAX       4
+
+static struct
+{
+    char zMount[64];
+    int szSector;
+    int iocap;
+} _rtthread_geometry[RTTHREAD_GEOMETRY_MAX];
+
+int rtthread_vfs_set_geometry(const char *mount, int sector_size, int iocap)
+{
+    int i;
+    int iFree = -1;
+    int rc = SQLITE_FULL;
+
+    if (mount == 0 || strlen(mount) >= sizeof(_rtthread_geometry[0].zMount))
+    {
+        return SQLITE_MISUSE;
+    }
+
+    _rtthread_vfs_enter_mutex();
+
+    for (i = 0; i < RTTHREAD_GEOMETRY_MAX; i++)
+    {
+        if (_rtthread_geometry[i].zMount[0] == 0)
+        {
+            if (iFree < 0) iFree = i;
+            continue;
+        }
+
+        if (strcmp(_rtthread_geometry[i].zMount, mount) == 0)
+        {
+            iFree = i;
+            break;
+        }
+    }
+
+    if (iFree >= 0)
+    {
+        if (sector_size > 0)
+        {
+            sqlite3_snprintf(sizeof(_rtthread_geometry[0].zMount), _rtthread_geometry[iFree].zMount, "%s", mount);
+            _rtthread_geometry[iFree].szSector = sector_size;
+            _rtthread_geometry[iFree].iocap = iocap;
+        }
+        else
+        {
+            _rtthread_geometry[iFree].zMount[0] = 0;
+        }
+
+        rc = SQLITE_OK;
+    }
+
+    _rtthread_vfs_leave_mutex();
+
+    return rc;
+}
+
+/*
+** Geometry detected from the block device under a DFS mount. The device is
+** asked once per mount, not on every open.
+*/
+#define RTTHREAD_MOUNT_GEOMETRY_MAX 4
+
+static struct
+{
+    struct dfs_filesystem *fs;
+    rt_device_t dev;
+    int szSector;
+    int iocap;
+} _rtthread_mount_geometry[RTTHREAD_MOUNT_GEOMETRY_MAX];
+static int _rtthread_mount_geometry_next;   /* entry replaced when the table is full */
+
+/*
+** Ask the block device under a mount for its geometry. A write damages at
+** most one sector unless the device erases and rewrites blocks larger than
+** a sector, in which case a block is what a power loss can destroy and
+** neighbouring sectors are not safe. Without a block device, e.g. on a RAM
+** filesystem, the sector is 512 bytes and the flags PKG_SQLITE_VFS_IOCAP.
+*/
+static void _rtthread_vfs_detect_geometry(rt_device_t dev, int *pszSector, int *piocap)
+{
+    struct rt_device_blk_geometry geometry;
+
+    *pszSector = 512;
+    *piocap = PKG_SQLITE_VFS_IOCAP;
+    if (dev == 0)
+    {
+        return;
+    }
+
+    memset(&geometry, 0, sizeof(geometry));
+    if (rt_device_control(dev, RT_DEVICE_CTRL_BLK_GETGEOME, &geometry) != RT_EOK
+        || geometry.bytes_per_sector < 512 || geometry.bytes_per_sector > 65536)
+    {
+        return;
+    }
+
+    *pszSector = (int)geometry.bytes_per_sector;
+    *piocap = SQLITE_IOCAP_POWERSAFE_OVERWRITE;
+    if (geometry.block_size > geometry.bytes_per_sector)
+    {
+        *pszSector = geometry.block_size <= 65536 ? (int)geometry.block_size : 65536;
+        *piocap = 0;
+    }
+}
+
+/*
+** Work out the sector size and the IOCAP flags of the media holding
+** file_path: a per-mount override if one matches, else the geometry of the
+** block device under the DFS mount.
+*/
+static void _rtthread_vfs_geometry(const char *file_path, int *pszSector, int *piocap)
+{
+    struct dfs_filesystem *fs;
+    rt_device_t dev;
+    int i;
+    int nBest = -1;
+
+    _rtthread_vfs_enter_mutex();
+
+    for (i = 0; i < RTTHREAD_GEOMETRY_MAX; i++)
+    {
+        int n = (int)strlen(_rtthread_geometry[i].zMount);
+
+        if (n > nBest && n > 0 && strncmp(file_path, _rtthread_geometry[i].zMount, n) == 0)
+        {
+            nBest = n;
+            *pszSector = _rtthread_geometry[i].szSector;
+            *piocap = _rtthread_geometry[i].iocap;
+        }
+    }
+
+    _rtthread_vfs_leave_mutex();
+
+    if (nBest >= 0)
+    {
+        return;
+    }
+
+    fs = dfs_filesystem_lookup(file_path);
+    dev = fs ? fs->dev_id : 0;
+
+    _rtthread_vfs_enter_mutex();
+    for (i = 0; fs && i < RTTHREAD_MOUNT_GEOMETRY_MAX; i++)
+    {
+        if (_rtthread_mount_geometry[i].fs == fs && _rtthread_mount_geometry[i].dev == dev)
+        {
+            *pszSector = _rtthread_mount_geometry[i].szSector;
+            *piocap = _rtthread_mount_geometry[i].iocap;
+            _rtthread_vfs_leave_mutex();
+            return;
+        }
+    }
+    _rtthread_vfs_leave_mutex();
+
+    _rtthread_vfs_detect_geometry(dev, pszSector, piocap);
+
+    if (fs)
+    {
+        _rtthread_vfs_enter_mutex();
+        i = _rtthread_mount_geometry_next;
+        _rtthread_mount_geometry_next = (i + 1) % RTTHREAD_MOUNT_GEOMETRY_MAX;
+        _rtthread_mount_geometry[i].fs = fs;
+        _rtthread_mount_geometry[i].dev = dev;
+        _rtthread_mount_geometry[i].szSector = *pszSector;
+        _rtthread_mount_geometry[i].iocap = *piocap;
+        _rtthread_vfs_leave_mutex();
+    }
+}
+
+#include "rtthread_memfile.c"
+
 static int _rtthread_vfs_open(sqlite3_vfs *pvfs, const char *file_path, sqlite3_file *file_id, int flags, int *pOutFlags)
 {
     RTTHREAD_SQLITE_FILE_T *p;
@@ -318,6 +909,17 @@ static int _rtthread_vfs_open(sqlite3_vfs *pvfs, const char *file_path, sqlite3_
     assert((eType != SQLITE_OPEN_MAIN_DB) || (flags & SQLITE_OPEN_URI) || file_path[strlen(file_path) + 1] == 0);
 
     memset(p, 0, sizeof(RTTHREAD_SQLITE_FILE_T));
+
+#if PKG_SQLITE_TEMP_MEM_SIZE > 0
+    /* connection-private temp files live in RAM until they outgrow the budget */
+    if ((eType == SQLITE_OPEN_TEMP_DB || eType == SQLITE_OPEN_TEMP_JOURNAL
+        || eType == SQLITE_OPEN_SUBJOURNAL || eType == SQLITE_OPEN_TRANSIENT_DB)
+        && (isDelete || !file_path))
+    {
+        return _rtthread_memfile_open(pvfs, p, flags, pOutFlags);
+    }
+#endif
+
     if (!file_path)
     {
         rc = _rtthread_get_temp_name(RTTHREAD_MAX_PATHNAME + 2, zTmpname);
@@ -342,17 +944,27 @@ static int _rtthread_vfs_open(sqlite3_vfs *pvfs, const char *file_path, sqlite3_
     if (isExclusive) openFlags |= (O_EXCL | O_NOFOLLOW);
     openFlags |= (O_LARGEFILE | O_BINARY);
 
-    fd = _rtthread_fs_open(file_path, openFlags, openMode);
+    fd = -1;
 
-    if (fd < 0 && (errno != -EISDIR) && isReadWrite && !isExclusive)
+    if (eType == SQLITE_OPEN_MAIN_JOURNAL)
+    {
+        fd = _rtthread_journal_take(file_path, flags, &p->pInode);
+    }
+
+    if (fd < 0)
     {
-        /* Failed to open the file for read/write access. Try read-only. */
-        flags &= ~(SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE);
-        openFlags &= ~(O_RDWR | O_CREAT);
-        flags |= SQLITE_OPEN_READONLY;
-        openFlags |= O_RDONLY;
-        isReadonly = 1;
         fd = _rtthread_fs_open(file_path, openFlags, openMode);
+
+        if (fd < 0 && (errno != -EISDIR) && isReadWrite && !isExclusive)
+        {
+            /* Failed to open the file for read/write access. Try read-only. */
+            flags &= ~(SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE);
+            openFlags &= ~(O_RDWR | O_CREAT);
+            flags |= SQLITE_OPEN_READONLY;
+            openFlags |= O_RDONLY;
+            isReadonly = 1;
+            fd = _rtthread_fs_open(file_path, openFlags, openMode);
+        }
     }
 
     if (fd < 0)
@@ -370,13 +982,141 @@ static int _rtthread_vfs_open(sqlite3_vfs *pvfs, const char *file_path, sqlite3_
     {
         unlink(file_path);
     }
+    else if (p->pInode == 0)
+    {
+        p->pInode = _rtthread_inode_acquire(file_path);
+        if (p->pInode == 0)
+        {
+            close(fd);
+            return SQLITE_NOMEM;
+        }
+    }
 
     p->fd = fd;
+    p->zPath = (file_path == zTmpname) ? 0 : file_path;
     p->pMethod = &_rtthread_io_method;
+    p->flags = flags;
+    p->eSync = RTTHREAD_DEFAULT_SYNC;
     p->eFileLock = NO_LOCK;
     p->szChunk = 0;
     p->pvfs = pvfs;
-    rt_sem_init(&p->sem, "vfssem", 1, RT_IPC_FLAG_PRIO);
+    _rtthread_vfs_geometry(file_path, &p->szSector, &p->iocap);
+    _rtthread_io_stats_attach(p);
+    _rtthread_bcache_attach(p);
+
+    return rc;
+}
+
+/*
+** Remember that zPath no longer exists.
+*/
+static void _rtthread_vfs_meta_deleted(const char *file_path)
+{
+#if PKG_SQLITE_META_CACHE_SIZE > 0
+    RTTHREAD_INODE_T *pInode;
+
+    _rtthread_vfs_enter_mutex();
+    pInode = _rtthread_inode_find(file_path, 1);
+    if (pInode)
+    {
+        pInode->eExists = 0;
+        pInode->iSize = -1;
+        _rtthread_bcache_forget(pInode);
+    }
+    _rtthread_inode_trim();
+    _rtthread_vfs_leave_mutex();
+#elif PKG_SQLITE_BLOCK_CACHE_SIZE > 0
+    RTTHREAD_INODE_T *pInode;
+
+    _rtthread_vfs_enter_mutex();
+    pInode = _rtthread_inode_find(file_path, 0);
+    if (pInode)
+    {
+        _rtthread_bcache_forget(pInode);
+    }
+    _rtthread_vfs_leave_mutex();
+#endif
+}
+
+/*
+** Invalidate a parked journal in place of deleting it.  Returns -1 when
+** file_path has no parked journal, which then has to be unlinked.
+**
+** Like zeroJournalHdr() in the pager, the zeroed header is synced unless
+** the writer runs with synchronous=OFF.  xDelete is not told that, so it
+** is taken from the database, whose handle recorded the synchronous
+** setting of its connection when it took the write lock.
+*/
+static int _rtthread_journal_zero(const char *file_path)
+{
+    static const char zero[RTTHREAD_JOURNAL_HDR] = { 0 };
+    char zDb[RTTHREAD_MAX_PATHNAME + 1];
+    RTTHREAD_INODE_T *pInode;
+    RTTHREAD_INODE_T *pDb;
+    int nDb = (int)strlen(file_path) - 8;
+    int noSync = 0;
+    int fd = -1;
+    int rc = SQLITE_OK;
+
+    if (nDb > 0 && nDb < (int)sizeof(zDb) && strcmp(file_path + nDb, "-journal") == 0)
+    {
+        memcpy(zDb, file_path, nDb);
+        zDb[nDb] = '\0';
+    }
+    else
+    {
+        zDb[0] = '\0';
+    }
+
+    _rtthread_vfs_enter_mutex();
+    pDb = zDb[0] ? _rtthread_inode_find(zDb, 0) : 0;
+    if (pDb)
+    {
+        noSync = pDb->bNoSync;
+    }
+    pInode = _rtthread_inode_find(file_path, 0);
+    if (pInode && pInode->fdSpare >= 0)
+    {
+        if (_rtthread_journal_reuse)
+        {
+            /* borrow the descriptor so the I/O runs outside the mutex */
+            fd = pInode->fdSpare;
+            pInode->fdSpare = -1;
+        }
+        else
+        {
+            _rtthread_journal_unpark(pInode);
+        }
+    }
+    _rtthread_vfs_leave_mutex();
+
+    if (fd < 0)
+    {
+        return -1;
+    }
+
+    _rtthread_bcache_forget(pInode);
+
+    if (lseek(fd, 0, SEEK_SET) != 0 || write(fd, zero, sizeof(zero)) != sizeof(zero))
+    {
+        rc = _RTTHREAD_LOG_ERROR(SQLITE_IOERR_DELETE, "write", file_path);
+    }
+    else if (!noSync && fsync(fd))
+    {
+        rc = _RTTHREAD_LOG_ERROR(SQLITE_IOERR_DELETE, "fsync", file_path);
+    }
+
+    _rtthread_vfs_enter_mutex();
+    pInode->fdSpare = fd;
+    pInode->bZeroed = (rc == SQLITE_OK);
+#ifdef PKG_SQLITE_IO_STATS
+    /* the parked journal has no handle, charge the journal totals */
+    _rtthread_io_closed[RTTHREAD_IO_JOURNAL].seeks++;
+    _rtthread_io_closed[RTTHREAD_IO_JOURNAL].writes++;
+    _rtthread_io_closed[RTTHREAD_IO_JOURNAL].write_bytes += sizeof(zero);
+    _rtthread_io_closed[RTTHREAD_IO_JOURNAL].syncs += !noSync;
+#endif
+    _rtthread_vfs_leave_mutex();
 
     return rc;
 }
@@ -385,10 +1125,18 @@ int _rtthread_vfs_delete(sqlite3_vfs* pvfs, const char *file_path, int syncDir)
 {
     int rc = SQLITE_OK;
 
+    rc = _rtthread_journal_zero(file_path);
+    if (rc >= 0)
+    {
+        return rc;
+    }
+    rc = SQLITE_OK;
+
     if (unlink(file_path) == (-1))
     {
         if (errno == -ENOENT)
         {
+            _rtthread_vfs_meta_deleted(file_path);
             rc = SQLITE_IOERR_DELETE_NOENT;
         }
         else
@@ -399,6 +1147,8 @@ int _rtthread_vfs_delete(sqlite3_vfs* pvfs, const char *file_path, int syncDir)
         return rc;
     }
 
+    _rtthread_vfs_meta_deleted(file_path);
+
     // sync dir: open dir -> fsync -> close
     if ((syncDir & 1) != 0)
     {
@@ -434,6 +1184,10 @@ int _rtthread_vfs_delete(sqlite3_vfs* pvfs, const char *file_path, int syncDir)
 static int _rtthread_vfs_access(sqlite3_vfs* pvfs, const char *file_path, int flags, int *pResOut)
 {
     int amode = 0;
+    struct stat buf;
+    int bExists;
+    int bStat = 0;
+    RTTHREAD_INODE_T *pInode;
 
 #ifndef F_OK
 # define F_OK 0
@@ -464,21 +1218,118 @@ static int _rtthread_vfs_access(sqlite3_vfs* pvfs, const char *file_path, int fl
         return -1;
     }
 
-    *pResOut = (_Access(file_path, amode) == 0);
+    /* an invalidated journal kept for reuse counts as deleted */
+    if (flags == SQLITE_ACCESS_EXISTS && _rtthread_journal_reuse)
+    {
+        _rtthread_vfs_enter_mutex();
+        pInode = _rtthread_inode_find(file_path, 0);
+        *pResOut = !(pInode && pInode->fdSpare >= 0 && pInode->bZeroed);
+        _rtthread_vfs_leave_mutex();
+
+        if (*pResOut == 0)
+        {
+            return SQLITE_OK;
+        }
+    }
+
+#if PKG_SQLITE_META_CACHE_SIZE > 0
+    /* A file known to be absent fails every check.  One known to exist
+    ** with a known size answers SQLITE_ACCESS_EXISTS, which treats an
+    ** empty file (an invalidated journal) as absent. */
+    _rtthread_vfs_enter_mutex();
+    pInode = _rtthread_inode_find(file_path, 0);
+    if (pInode && (pInode->eExists == 0
+        || (pInode->eExists == 1 && pInode->iSize >= 0 && flags == SQLITE_ACCESS_EXISTS)))
+    {
+        *pResOut = (pInode->eExists == 1 && pInode->iSize > 0);
+        _rtthread_meta_stats.access_hits++;
+        _rtthread_vfs_leave_mutex();
+        return SQLITE_OK;
+    }
+    _rtthread_vfs_leave_mutex();
+#endif
+
+    bExists = (_Access(file_path, amode) == 0);
+    *pResOut = bExists;
 
-    if (flags == SQLITE_ACCESS_EXISTS && *pResOut)
+    if (flags == SQLITE_ACCESS_EXISTS && bExists)
     {
-        struct stat buf;
+        bStat = (0 == stat(file_path, &buf));
 
-        if (0 == stat(file_path, &buf) && (buf.st_size == 0))
+        if (bStat && (buf.st_size == 0))
         {
             *pResOut = 0;
         }
     }
 
+#if PKG_SQLITE_META_CACHE_SIZE > 0
+    _rtthread_vfs_enter_mutex();
+    _rtthread_meta_stats.access_misses++;
+    pInode = _rtthread_inode_find(file_path, 1);
+    if (pInode)
+    {
+        if (!bExists)
+        {
+            pInode->eExists = 0;
+            pInode->iSize = -1;
+        }
+        else if (bStat)
+        {
+            pInode->eExists = 1;
+            pInode->iSize = buf.st_size;
+        }
+    }
+    _rtthread_inode_trim();
+    _rtthread_vfs_leave_mutex();
+#endif
+
     return SQLITE_OK;
 }
 
+/*
+** Drop the empty and "." elements of an absolute path and resolve the ".."
+** ones, so that every spelling of a file gives the same full pathname, which
+** is what SQLite compares to let connections to one database share a cache.
+*/
+static void _rtthread_vfs_normalize_path(char *path)
+{
+    char *out = path;
+    const char *in = path;
+    const char *elem;
+    int n;
+
+    while (*in)
+    {
+        while (*in == '/')
+        {
+            in++;
+        }
+        elem = in;
+        while (*in && *in != '/')
+        {
+            in++;
+        }
+        n = (int)(in - elem);
+        if (n == 0 || (n == 1 && elem[0] == '.'))
+        {
+            continue;
+        }
+        if (n == 2 && elem[0] == '.' && elem[1] == '.')
+        {
+            while (out > path && *--out != '/');
+            continue;
+        }
+        *out++ = '/';
+        memmove(out, elem, n);
+        out += n;
+    }
+    if (out == path)
+    {
+        *out++ = '/';
+    }
+    *out = '\0';
+}
+
 static int _rtthread_vfs_fullpathname(sqlite3_vfs* pvfs, const char *file_path, int nOut, char *zOut)
 {
     assert(pvfs->mxPathname == RTTHREAD_MAX_PATHNAME);
@@ -501,6 +1352,7 @@ static int _rtthread_vfs_fullpathname(sqlite3_vfs* pvfs, const char *file_path,
         nCwd = (int)strlen(zOut);
         sqlite3_snprintf(nOut - nCwd, &zOut[nCwd], "/%s", file_path);
     }
+    _rtthread_vfs_normalize_path(zOut);
 
     return SQLITE_OK;
 }
@@ -640,6 +1492,13 @@ SQLITE_API int sqlite3_os_init(void)
         _rtthread_vfs_next_system_call,     /* xNextSystemCall */
     };
 
+    _rtthread_io_clock_init();
+#if PKG_SQLITE_BLOCK_CACHE_SIZE > 0
+    _rtthread_bcache_init();
+#endif
+#if PKG_SQLITE_ASYNC_IO_SIZE > 0
+    _rtthread_aio_init();
+#endif
     sqlite3_vfs_register(&_rtthread_vfs, 1);
 
     return SQLITE_OK;
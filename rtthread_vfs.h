@@ -0,0 +1,249 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2026-10-19     RT-Thread    first version
+ */
+
+#ifndef __RTTHREAD_VFS_H__
+#define __RTTHREAD_VFS_H__
+
+#include <rtthread.h>
+#include <sqlite3.h>
+
+/*
+ * Free-running 32-bit counter used to time system calls and codec work: the
+ * DWT cycle counter on Cortex-M3/M4/M7, started by sqlite3_os_init() when
+ * PKG_SQLITE_IO_STATS, PKG_SQLITE_COMPRESS or PKG_SQLITE_MUTEX_PROFILE is
+ * defined, OS ticks elsewhere. Define PKG_SQLITE_IO_CLOCK() and
+ * RTTHREAD_IO_CLOCK_UNIT to use another one.
+ */
+#ifndef PKG_SQLITE_IO_CLOCK
+#if defined(ARCH_ARM_CORTEX_M3) || defined(ARCH_ARM_CORTEX_M4) || defined(ARCH_ARM_CORTEX_M7)
+#define RTTHREAD_DWT_CTRL           (*(volatile rt_uint32_t *)0xE0001000)
+#define RTTHREAD_DWT_CYCCNT         (*(volatile rt_uint32_t *)0xE0001004)
+#define RTTHREAD_DEM_CR             (*(volatile rt_uint32_t *)0xE000EDFC)
+#define PKG_SQLITE_IO_CLOCK()       RTTHREAD_DWT_CYCCNT
+#define RTTHREAD_IO_CLOCK_UNIT      "cycles"
+#else
+#define PKG_SQLITE_IO_CLOCK()       ((rt_uint32_t)rt_tick_get())
+#define RTTHREAD_IO_CLOCK_UNIT      "ticks"
+#endif
+#endif
+
+#ifndef RTTHREAD_IO_CLOCK_UNIT
+#define RTTHREAD_IO_CLOCK_UNIT      "clocks"
+#endif
+
+/*
+ * File control opcodes private to the "rt-thread" VFS, used through
+ * sqlite3_file_control(db, "main", op, arg).
+ */
+#define SQLITE_FCNTL_RTTHREAD_READAHEAD     0x52540001  /* struct rtthread_readahead_stats * */
+#define SQLITE_FCNTL_RTTHREAD_PREALLOCATE   0x52540002  /* sqlite3_int64 *, bytes to allocate */
+#define SQLITE_FCNTL_RTTHREAD_IO_STATS      0x52540003  /* struct rtthread_io_stats * */
+#define SQLITE_FCNTL_RTTHREAD_BLOCK_CACHE   0x52540004  /* struct rtthread_bcache_stats * */
+
+/* sequential read-ahead counters of one file */
+struct rtthread_readahead_stats
+{
+    unsigned int fills;             /* large reads issued to fill the window */
+    unsigned int hits;              /* reads served from the window */
+    sqlite3_int64 prefetch_bytes;   /* bytes read into the window */
+    sqlite3_int64 waste_bytes;      /* prefetched bytes dropped before being read */
+};
+
+/*
+ * system call counters of one file, or of all files of one type; times are
+ * in units of PKG_SQLITE_IO_CLOCK (CPU cycles on Cortex-M3/M4/M7, else ticks)
+ */
+struct rtthread_io_stats
+{
+    unsigned int reads;             /* read() calls */
+    unsigned int writes;            /* write() calls */
+    sqlite3_int64 read_bytes;       /* bytes returned by read() */
+    sqlite3_int64 write_bytes;      /* bytes passed to write() */
+    unsigned int seeks;             /* lseek() calls */
+    unsigned int syncs;             /* fsync() calls */
+    unsigned int lock_waits;        /* lock requests refused with SQLITE_BUSY */
+    sqlite3_uint64 read_time;       /* time spent in read() */
+    sqlite3_uint64 write_time;      /* time spent in write() */
+    sqlite3_uint64 sync_time;       /* time spent in fsync() */
+};
+
+/* file types of rtthread_vfs_io_stats() */
+#define RTTHREAD_IO_DB          0   /* main databases */
+#define RTTHREAD_IO_JOURNAL     1   /* rollback, master journals and WAL files */
+#define RTTHREAD_IO_TEMP        2   /* temp databases and journals, subjournals */
+#define RTTHREAD_IO_TYPES       3
+
+/**
+ * This function will override the geometry the VFS reports for files under
+ * a mount point. By default both are derived once per mount from the
+ * geometry of the block device under the DFS mount.
+ *
+ * @param mount the mount path, such as "/" or "/sdcard".
+ * @param sector_size the sector size in bytes, 0 to remove the override.
+ * @param iocap the SQLITE_IOCAP_xxx flags the media guarantees.
+ * @return SQLITE_OK, or SQLITE_FULL when the override table is full.
+ */
+int rtthread_vfs_set_geometry(const char *mount, int sector_size, int iocap);
+
+/* memory temp file counters, see rtthread_vfs_temp_stats() */
+struct rtthread_temp_stats
+{
+    unsigned int mem_files;         /* temp files opened in memory */
+    unsigned int spills;            /* memory temp files moved to flash */
+    sqlite3_int64 spill_bytes;      /* bytes copied to flash by spills */
+    sqlite3_int64 mem_used;         /* bytes currently held by memory temp files */
+    sqlite3_int64 mem_peak;         /* high-water mark of mem_used */
+};
+
+/**
+ * This function will set the memory budget shared by all temporary files
+ * kept in RAM. A write that would exceed it moves that file to flash.
+ *
+ * @param limit the new budget in bytes, or a negative value to only query it.
+ * @return the previous budget.
+ */
+sqlite3_int64 rtthread_vfs_temp_mem_limit(sqlite3_int64 limit);
+
+/**
+ * This function will get the memory temp file counters.
+ *
+ * @param stats the output counters.
+ * @param reset non-zero to clear the counters after reading them.
+ */
+void rtthread_vfs_temp_stats(struct rtthread_temp_stats *stats, int reset);
+
+/**
+ * This function will turn journal reuse on or off. With reuse on, the
+ * rollback journal stays open between transactions and is invalidated by
+ * zeroing its header instead of being deleted; it is removed when the last
+ * connection to the database closes. The default is PKG_SQLITE_JOURNAL_REUSE.
+ *
+ * @param enable 1 to turn reuse on, 0 to turn it off, negative to only query.
+ * @return the previous setting.
+ */
+int rtthread_vfs_journal_reuse(int enable);
+
+/**
+ * This function will get the system call counters of all files of a type,
+ * open or already closed. The counters are only kept when the package is
+ * built with PKG_SQLITE_IO_STATS, otherwise they read as zero.
+ *
+ * @param type RTTHREAD_IO_DB, RTTHREAD_IO_JOURNAL or RTTHREAD_IO_TEMP.
+ * @param stats the output counters.
+ * @param reset non-zero to clear the counters after reading them.
+ */
+void rtthread_vfs_io_stats(int type, struct rtthread_io_stats *stats, int reset);
+
+/* metadata cache counters, see rtthread_vfs_meta_stats() */
+struct rtthread_meta_stats
+{
+    unsigned int access_hits;       /* xAccess answered without open()/stat() */
+    unsigned int access_misses;     /* xAccess that went to the filesystem */
+    unsigned int size_hits;         /* xFileSize answered without fstat() */
+    unsigned int size_misses;       /* xFileSize that called fstat() */
+};
+
+/**
+ * This function will get the metadata cache counters.
+ *
+ * @param stats the output counters.
+ * @param reset non-zero to clear the counters after reading them.
+ */
+void rtthread_vfs_meta_stats(struct rtthread_meta_stats *stats, int reset);
+
+/**
+ * This function will drop cached existence and size information. Call it
+ * after a database or journal file has been changed other than through
+ * SQLite, for example removed from the shell.
+ *
+ * @param path the full path of the file, or RT_NULL to drop every entry.
+ */
+void rtthread_vfs_meta_invalidate(const char *path);
+
+/* async I/O counters, see rtthread_vfs_aio_stats() */
+struct rtthread_aio_stats
+{
+    unsigned int copied;            /* writes queued with a copy of the data */
+    unsigned int borrowed;          /* writes queued with the caller's buffer, the caller waited */
+    unsigned int read_hits;         /* queued writes copied into a read */
+    unsigned int barriers;          /* sync, truncate and close calls that waited for the queue */
+    unsigned int errors;            /* queued writes that failed */
+    sqlite3_int64 queued;           /* bytes currently copied into the queue */
+    sqlite3_int64 queued_peak;      /* high-water mark of queued */
+};
+
+/**
+ * This function will set how many bytes of writes may be copied into the
+ * queue of the async I/O thread. Writes beyond it still go through the
+ * thread, but the writer waits until they are done. The thread only runs
+ * when the package is built with PKG_SQLITE_ASYNC_IO_SIZE > 0.
+ *
+ * @param limit the new budget in bytes, or a negative value to only query it.
+ * @return the previous budget.
+ */
+sqlite3_int64 rtthread_vfs_aio_limit(sqlite3_int64 limit);
+
+/**
+ * This function will get the async I/O counters.
+ *
+ * @param stats the output counters.
+ * @param reset non-zero to clear the counters after reading them.
+ */
+void rtthread_vfs_aio_stats(struct rtthread_aio_stats *stats, int reset);
+
+/* block cache policies of rtthread_vfs_bcache_policy() */
+#define RTTHREAD_BCACHE_OFF         0   /* not cached */
+#define RTTHREAD_BCACHE_THROUGH     1   /* writes update cached blocks and the file */
+#define RTTHREAD_BCACHE_BACK        2   /* writes stay in the cache until sync, truncate or close */
+
+/* block cache counters of one file, or of all files of one type */
+struct rtthread_bcache_stats
+{
+    unsigned int hits;              /* blocks read from the cache */
+    unsigned int misses;            /* blocks read from the file into the cache */
+    unsigned int writebacks;        /* dirty blocks written to the file */
+    unsigned int evictions;         /* blocks replaced to make room */
+};
+
+/**
+ * This function will set how files of a type use the block cache shared by
+ * all files. The policy is taken when a file is opened. The cache is only
+ * present when the package is built with PKG_SQLITE_BLOCK_CACHE_SIZE > 0.
+ *
+ * @param type RTTHREAD_IO_DB, RTTHREAD_IO_JOURNAL or RTTHREAD_IO_TEMP.
+ * @param policy RTTHREAD_BCACHE_OFF, RTTHREAD_BCACHE_THROUGH or
+ *        RTTHREAD_BCACHE_BACK, negative to only query.
+ * @return the previous policy, or -1 if the type is not valid.
+ */
+int rtthread_vfs_bcache_policy(int type, int policy);
+
+/**
+ * This function will get the block cache counters of all files of a type,
+ * open or already closed. The counters of one file are read with
+ * SQLITE_FCNTL_RTTHREAD_BLOCK_CACHE.
+ *
+ * @param type RTTHREAD_IO_DB, RTTHREAD_IO_JOURNAL or RTTHREAD_IO_TEMP.
+ * @param stats the output counters.
+ * @param reset non-zero to clear the counters after reading them.
+ */
+void rtthread_vfs_bcache_stats(int type, struct rtthread_bcache_stats *stats, int reset);
+
+/**
+ * This function will set how the worker threads of the sorter are started
+ * from now on (see PRAGMA threads).
+ *
+ * @param priority the priority of the workers, a negative value for the
+ *        priority of the thread that runs the sort.
+ * @param cpu the core the workers are bound to on SMP, a negative value for
+ *        any core.
+ */
+void rtthread_vfs_worker_config(int priority, int cpu);
+
+#endif
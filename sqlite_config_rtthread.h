@@ -1,5 +1,8 @@
 #ifndef _SQLITE_CONFIG_RTTHREAD_H_
 #define _SQLITE_CONFIG_RTTHREAD_H_
+
+#include <rtconfig.h>
+
 /*
 * SQLite compile macro
 */
@@ -17,13 +20,50 @@
 #define SQLITE_RTTHREAD_NO_WIDE 1
 #endif
 
+/* the logfs VFS commits atomically, let single page transactions skip the journal */
+#if defined(PKG_SQLITE_LOGFS) && !defined(SQLITE_ENABLE_ATOMIC_WRITE)
+#define SQLITE_ENABLE_ATOMIC_WRITE 1
+#endif
+
+/* the static heap dbhelper gives SQLite (PKG_SQLITE_HEAP_SIZE) is managed by memsys5 */
+#if defined(PKG_SQLITE_HEAP_SIZE) && (PKG_SQLITE_HEAP_SIZE > 0) && !defined(SQLITE_ENABLE_MEMSYS5)
+#define SQLITE_ENABLE_MEMSYS5 1
+#endif
+
+/* dbhelper waits for a table locked on the shared cache with sqlite3_unlock_notify() */
+#if defined(PKG_SQLITE_SHARED_CACHE) && !defined(SQLITE_ENABLE_UNLOCK_NOTIFY)
+#define SQLITE_ENABLE_UNLOCK_NOTIFY 1
+#endif
+
 #ifndef SQLITE_TEMP_STORE
 #define SQLITE_TEMP_STORE 1
 #endif
 
+/* multi-thread mode: no connection mutexes, a connection must stay with one thread at a time */
 #ifndef SQLITE_THREADSAFE
+#ifdef PKG_SQLITE_MULTI_THREAD
+#define SQLITE_THREADSAFE 2
+#else
 #define SQLITE_THREADSAFE 1
 #endif
+#endif
+
+/* uncontended FAST sqlite mutexes take an atomic fast path, 0 to map all of them onto rt_mutex */
+#ifndef PKG_SQLITE_FAST_MUTEX
+#define PKG_SQLITE_FAST_MUTEX 1
+#endif
+
+/* worker threads of the sorter (PRAGMA threads), started as RT-Thread threads */
+#ifdef PKG_SQLITE_WORKER_THREADS
+#ifndef SQLITE_MAX_WORKER_THREADS
+#define SQLITE_MAX_WORKER_THREADS PKG_SQLITE_WORKER_THREADS
+#endif
+#ifndef SQLITE_DEFAULT_WORKER_THREADS
+#define SQLITE_DEFAULT_WORKER_THREADS PKG_SQLITE_WORKER_THREADS
+#endif
+#endif
+
+/* define PKG_SQLITE_MUTEX_PROFILE to count acquisitions, contention, waits and holds per mutex (msh sqlmtx) */
 
 #ifndef HAVE_READLINE
 #define HAVE_READLINE 0
@@ -41,4 +81,50 @@
 #define SQLITE_OS_RTTHREAD 1
 #endif
 
+/*
+* rt-thread VFS tuning
+*/
+/* max bytes prefetched per file on sequential reads, 0 to disable read-ahead */
+#ifndef PKG_SQLITE_READAHEAD_SIZE
+#define PKG_SQLITE_READAHEAD_SIZE 16384
+#endif
+
+/* SQLITE_IOCAP_xxx flags assumed for media without a queryable block device */
+#ifndef PKG_SQLITE_VFS_IOCAP
+#define PKG_SQLITE_VFS_IOCAP 0x00001000     /* SQLITE_IOCAP_POWERSAFE_OVERWRITE */
+#endif
+
+/* RAM budget of temp files (sorter, subjournal, temp tables), 0 to keep them on flash */
+#ifndef PKG_SQLITE_TEMP_MEM_SIZE
+#define PKG_SQLITE_TEMP_MEM_SIZE 65536
+#endif
+
+/* closed files whose existence and size stay cached, 0 to disable the metadata cache */
+#ifndef PKG_SQLITE_META_CACHE_SIZE
+#define PKG_SQLITE_META_CACHE_SIZE 8
+#endif
+
+/* bytes of the block cache shared by all files, 0 to disable it */
+#ifndef PKG_SQLITE_BLOCK_CACHE_SIZE
+#define PKG_SQLITE_BLOCK_CACHE_SIZE 0
+#endif
+
+/* block size of the block cache */
+#ifndef PKG_SQLITE_BLOCK_CACHE_BLOCK
+#define PKG_SQLITE_BLOCK_CACHE_BLOCK 4096
+#endif
+
+/* bytes of writes copied into the queue of the async I/O thread, 0 to write synchronously */
+#ifndef PKG_SQLITE_ASYNC_IO_SIZE
+#define PKG_SQLITE_ASYNC_IO_SIZE 0
+#endif
+
+#ifndef PKG_SQLITE_ASYNC_IO_PRIORITY
+#define PKG_SQLITE_ASYNC_IO_PRIORITY (RT_THREAD_PRIORITY_MAX / 2)
+#endif
+
+#ifndef PKG_SQLITE_ASYNC_IO_STACK
+#define PKG_SQLITE_ASYNC_IO_STACK 2048
+#endif
+
 #endif
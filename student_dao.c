@@ -34,7 +34,7 @@ static int student_insert_bind(sqlite3_stmt *stmt, int index, void *arg)
         sqlite3_reset(stmt);                                        //reset the stmt
         sqlite3_bind_text(stmt, 1, s->name, strlen(s->name), NULL); //bind the 1st data,is a string
         sqlite3_bind_int(stmt, 2, s->score);                        //bind the 1st data,is a int
-        rc = sqlite3_step(stmt);                                    //execute the stmt by step
+        rc = db_stmt_step(stmt);                                    //execute the stmt by step
     }
 
     if (rc != SQLITE_DONE)
@@ -63,7 +63,7 @@ static int student_update_bind(sqlite3_stmt *stmt, int index, void *arg)
     sqlite3_bind_text(stmt, 1, s->name, strlen(s->name), NULL);
     sqlite3_bind_int(stmt, 2, s->score);
     sqlite3_bind_int(stmt, 3, s->id);
-    rc = sqlite3_step(stmt);
+    rc = db_stmt_step(stmt);
     if (rc != SQLITE_DONE)
         return rc;
     return SQLITE_OK;
@@ -76,7 +76,7 @@ int student_update(student_t *s)
 static int student_create(sqlite3_stmt *stmt, void *arg)
 {
     student_t *s = arg;
-    int ret = sqlite3_step(stmt);
+    int ret = db_stmt_step(stmt);
     if (ret != SQLITE_ROW)
     {
         return 0;
@@ -124,7 +124,7 @@ static int student_create_queue(sqlite3_stmt *stmt, void *arg)
     rt_list_t *q = arg;
     student_t *s;
     int ret, count = 0;
-    ret = sqlite3_step(stmt);
+    ret = db_stmt_step(stmt);
     if (ret != SQLITE_ROW)
     {
         return 0;
@@ -142,7 +142,7 @@ static int student_create_queue(sqlite3_stmt *stmt, void *arg)
         s->score = db_stmt_get_int(stmt, 2);
         rt_list_insert_before(q, &(s->list));
         count++;
-    } while ((ret = sqlite3_step(stmt)) == SQLITE_ROW);
+    } while ((ret = db_stmt_step(stmt)) == SQLITE_ROW);
     return count;
 __create_student_fail:
     return -1;
@@ -0,0 +1,222 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2026-10-19     RT-Thread    first version
+ */
+
+/*
+ * Host-side test of the blockdev VFS (dbblock.c) against an image file.
+ *
+ * The image is formatted and mounted the way "sqlblk format" and
+ * db_block_register() do on a board, a database is written, rolled back,
+ * reopened and checked, and then the commit latency of the same workload
+ * is compared between a database file in DIR and the image. The host's
+ * own VFS stands in for the rt-thread one that dbblock.c hands its other
+ * files to.
+ *
+ * build: gcc -O2 -Ihost -I.. -o blockdev_host blockdev_host.c ../dbblock.c -lsqlite3
+ * usage: blockdev_host [-n COMMITS] [-s MB] IMAGE [DIR]
+ *     -n COMMITS  single-row commits timed on each VFS (default 200)
+ *     -s MB       size of the image file (default 8)
+ *     DIR         directory of the file system database (default ".")
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sqlite3.h>
+#include "../dbblock.h"
+
+#define TEST_DB_NAME            "/test.db"
+#define BENCH_DB_NAME           "bench.db"
+
+static sqlite3_vfs rtthread_vfs;
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int exec(sqlite3 *db, const char *sql)
+{
+    char *err = NULL;
+    int rc = sqlite3_exec(db, sql, 0, 0, &err);
+
+    if (rc != SQLITE_OK)
+    {
+        fprintf(stderr, "%s: %s\n", sql, err ? err : sqlite3_errstr(rc));
+        sqlite3_free(err);
+    }
+    return rc;
+}
+
+static int query_int(sqlite3 *db, const char *sql, int *out)
+{
+    sqlite3_stmt *stmt;
+    int rc = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
+
+    if (rc == SQLITE_OK)
+    {
+        rc = sqlite3_step(stmt) == SQLITE_ROW ? SQLITE_OK : SQLITE_ERROR;
+        *out = sqlite3_column_int(stmt, 0);
+        sqlite3_finalize(stmt);
+    }
+    return rc;
+}
+
+/*
+ * Commits and a rollback on the image, then a fresh connection must see
+ * exactly the committed rows in a well-formed database.
+ */
+static int check(void)
+{
+    sqlite3 *db;
+    sqlite3_stmt *stmt;
+    const unsigned char *res;
+    int i, rows = 0, ok;
+
+    if (sqlite3_open_v2(TEST_DB_NAME, &db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, DB_BLOCK_VFS_NAME) != SQLITE_OK)
+    {
+        fprintf(stderr, "open %s: %s\n", TEST_DB_NAME, sqlite3_errmsg(db));
+        sqlite3_close(db);
+        return -1;
+    }
+    ok = exec(db, "CREATE TABLE t(id INTEGER PRIMARY KEY, v BLOB);") == SQLITE_OK;
+    for (i = 0; ok && i < 3; i++)
+    {
+        ok = exec(db, "INSERT INTO t(v) SELECT randomblob(200) FROM "
+                      "(WITH RECURSIVE c(n) AS (SELECT 1 UNION ALL SELECT n + 1 FROM c WHERE n < 500) SELECT n FROM c);")
+             == SQLITE_OK;
+    }
+    ok = ok && exec(db, "BEGIN; DELETE FROM t WHERE id % 2 = 0; UPDATE t SET v = zeroblob(300); ROLLBACK;") == SQLITE_OK;
+    sqlite3_close(db);
+
+    ok = ok && sqlite3_open_v2(TEST_DB_NAME, &db, SQLITE_OPEN_READWRITE, DB_BLOCK_VFS_NAME) == SQLITE_OK;
+    ok = ok && query_int(db, "SELECT count(*) FROM t;", &rows) == SQLITE_OK && rows == 1500;
+    ok = ok && sqlite3_prepare_v2(db, "PRAGMA integrity_check;", -1, &stmt, NULL) == SQLITE_OK;
+    if (ok)
+    {
+        res = sqlite3_step(stmt) == SQLITE_ROW ? sqlite3_column_text(stmt, 0) : NULL;
+        ok = res && strcmp((const char *)res, "ok") == 0;
+        sqlite3_finalize(stmt);
+    }
+    sqlite3_close(db);
+
+    ok = ok && sqlite3_vfs_find(DB_BLOCK_VFS_NAME)->xDelete(sqlite3_vfs_find(DB_BLOCK_VFS_NAME), TEST_DB_NAME, 0)
+               == SQLITE_OK;
+    printf("check: %d rows, %s\n", rows, ok ? "ok" : "FAILED");
+    return ok ? 0 : -1;
+}
+
+/* microseconds per single-row update commit on the database "path" */
+static double bench(const char *path, const char *vfs, int commits)
+{
+    sqlite3_vfs *p = sqlite3_vfs_find(vfs);
+    sqlite3 *db;
+    sqlite3_stmt *stmt;
+    double start;
+    int i, rc;
+
+    p->xDelete(p, path, 0);
+    if (sqlite3_open_v2(path, &db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, vfs) != SQLITE_OK
+        || exec(db, "CREATE TABLE kv(id INTEGER PRIMARY KEY, val INT);"
+                    "INSERT INTO kv(val) SELECT 0 FROM "
+                    "(WITH RECURSIVE c(n) AS (SELECT 1 UNION ALL SELECT n + 1 FROM c WHERE n < 1000) SELECT n FROM c);")
+           != SQLITE_OK)
+    {
+        sqlite3_close(db);
+        return -1;
+    }
+
+    sqlite3_prepare_v2(db, "UPDATE kv SET val = val + 1 WHERE id = ?;", -1, &stmt, NULL);
+    start = now();
+    for (i = 0, rc = SQLITE_DONE; rc == SQLITE_DONE && i < commits; i++)
+    {
+        sqlite3_bind_int(stmt, 1, (i * 7919) % 1000 + 1);
+        rc = sqlite3_step(stmt);
+        sqlite3_reset(stmt);
+    }
+    start = now() - start;
+    sqlite3_finalize(stmt);
+    sqlite3_close(db);
+    p->xDelete(p, path, 0);
+    return rc == SQLITE_DONE ? start * 1e6 / commits : -1;
+}
+
+int main(int argc, char **argv)
+{
+    const char *image, *dir = ".";
+    char path[512];
+    int commits = 200, mb = 8, opt;
+    double fs_us, blk_us;
+    FILE *fp;
+
+    while ((opt = getopt(argc, argv, "n:s:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n': commits = atoi(optarg); break;
+        case 's': mb = atoi(optarg); break;
+        default:
+            fprintf(stderr, "usage: %s [-n COMMITS] [-s MB] IMAGE [DIR]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (optind >= argc || argv[optind][0] != '/' || commits <= 0 || mb <= 0)
+    {
+        fprintf(stderr, "usage: %s [-n COMMITS] [-s MB] IMAGE [DIR], IMAGE an absolute path\n", argv[0]);
+        return 2;
+    }
+    image = argv[optind];
+    if (optind + 1 < argc)
+    {
+        dir = argv[optind + 1];
+    }
+
+    fp = fopen(image, "w");
+    if (fp == NULL || ftruncate(fileno(fp), (off_t)mb << 20) != 0)
+    {
+        perror(image);
+        return 1;
+    }
+    fclose(fp);
+
+    /* dbblock.c passes temporary files and the like to "rt-thread" */
+    sqlite3_initialize();
+    rtthread_vfs = *sqlite3_vfs_find(NULL);
+    rtthread_vfs.zName = "rt-thread";
+    rtthread_vfs.pNext = NULL;
+    sqlite3_vfs_register(&rtthread_vfs, 0);
+
+    if (db_block_format(image) != SQLITE_OK || db_block_register(image, 0) != SQLITE_OK)
+    {
+        fprintf(stderr, "format and mount %s failed\n", image);
+        return 1;
+    }
+    if (check() != 0)
+    {
+        return 1;
+    }
+
+    snprintf(path, sizeof(path), "%s/%s", dir, BENCH_DB_NAME);
+    fs_us = bench(path, "rt-thread", commits);
+    blk_us = bench("/" BENCH_DB_NAME, DB_BLOCK_VFS_NAME, commits);
+    if (fs_us < 0 || blk_us < 0)
+    {
+        fprintf(stderr, "benchmark failed\n");
+        return 1;
+    }
+    printf("%d single-row commits\n", commits);
+    printf("file system  %10.1f us/commit\n", fs_us);
+    printf("blockdev     %10.1f us/commit\n", blk_us);
+    return 0;
+}
@@ -0,0 +1,18 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2026-10-19     RT-Thread    first version
+ */
+
+#ifndef __HOST_DFS_POSIX_H__
+#define __HOST_DFS_POSIX_H__
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#endif
@@ -0,0 +1,21 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2026-10-19     RT-Thread    first version
+ */
+
+#ifndef __HOST_RTDBG_H__
+#define __HOST_RTDBG_H__
+
+#include <stdio.h>
+
+#define LOG_E(fmt, ...) fprintf(stderr, "E/" DBG_SECTION_NAME ": " fmt "\n", ##__VA_ARGS__)
+#define LOG_W(fmt, ...) fprintf(stderr, "W/" DBG_SECTION_NAME ": " fmt "\n", ##__VA_ARGS__)
+#define LOG_I(fmt, ...) fprintf(stderr, "I/" DBG_SECTION_NAME ": " fmt "\n", ##__VA_ARGS__)
+#define LOG_D(fmt, ...)
+
+#endif
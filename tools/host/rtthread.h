@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2026-10-19     RT-Thread    first version
+ */
+
+/*
+ * The few RT-Thread definitions the standalone VFS files use, for building
+ * them on a Linux host. There are no block devices here: rt_device_find()
+ * finds nothing, so dbblock.c only runs against an image file, which is
+ * what a device name starting with '/' selects.
+ */
+#ifndef __HOST_RTTHREAD_H__
+#define __HOST_RTTHREAD_H__
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef int8_t      rt_int8_t;
+typedef int16_t     rt_int16_t;
+typedef int32_t     rt_int32_t;
+typedef uint8_t     rt_uint8_t;
+typedef uint16_t    rt_uint16_t;
+typedef uint32_t    rt_uint32_t;
+typedef uint64_t    rt_uint64_t;
+typedef long        rt_base_t;
+typedef rt_base_t   rt_err_t;
+typedef rt_uint32_t rt_tick_t;
+typedef size_t      rt_size_t;
+typedef long        rt_off_t;
+
+#define RT_NULL                     0
+#define RT_EOK                      0
+#define RT_ERROR                    1
+#define RT_NAME_MAX                 8
+#define RT_TICK_PER_SECOND          1000
+
+#define RT_DEVICE_OFLAG_RDWR        0x003
+#define RT_DEVICE_CTRL_BLK_GETGEOME 0x10
+#define RT_DEVICE_CTRL_BLK_SYNC     0x11
+
+struct rt_device_blk_geometry
+{
+    rt_uint32_t sector_count;
+    rt_uint32_t bytes_per_sector;
+    rt_uint32_t block_size;
+};
+typedef struct rt_device *rt_device_t;
+
+static inline rt_device_t rt_device_find(const char *name)
+{
+    return RT_NULL;
+}
+
+static inline rt_err_t rt_device_open(rt_device_t dev, rt_uint16_t oflag)
+{
+    return -RT_ERROR;
+}
+
+static inline rt_err_t rt_device_close(rt_device_t dev)
+{
+    return -RT_ERROR;
+}
+
+static inline rt_size_t rt_device_read(rt_device_t dev, rt_off_t pos, void *buffer, rt_size_t size)
+{
+    return 0;
+}
+
+static inline rt_size_t rt_device_write(rt_device_t dev, rt_off_t pos, const void *buffer, rt_size_t size)
+{
+    return 0;
+}
+
+static inline rt_err_t rt_device_control(rt_device_t dev, int cmd, void *arg)
+{
+    return -RT_ERROR;
+}
+
+/* milliseconds, RT_TICK_PER_SECOND is 1000 */
+static inline rt_tick_t rt_tick_get(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (rt_tick_t)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+#define rt_malloc       malloc
+#define rt_free         free
+#define rt_kprintf      printf
+#define rt_snprintf     snprintf
+#define rt_strcmp       strcmp
+
+#define MSH_CMD_EXPORT(command, desc)
+
+#endif
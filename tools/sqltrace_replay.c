@@ -0,0 +1,455 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2026-10-19     RT-Thread    first version
+ */
+
+/*
+ * Host-side replay of a VFS trace recorded on a board with "sqltrace".
+ *
+ * The calls are replayed against ordinary files in a scratch directory,
+ * optionally through I/O layer variants, and the system calls issued and
+ * the time spent are reported, so that a change to the VFS can be judged
+ * on a workload from the field without the hardware.
+ *
+ * build: gcc -O2 -o sqltrace_replay sqltrace_replay.c
+ * usage: sqltrace_replay [-d DIR] [-c BYTES] [-r BYTES] [-p BYTES] [-n] [-v] TRACE
+ *     -d DIR    scratch directory for the stand-in files (default ".")
+ *     -c BYTES  coalesce contiguous writes up to BYTES before issuing them
+ *     -r BYTES  read-ahead window for sequential reads
+ *     -p BYTES  preallocate files in chunks of BYTES when writes extend them
+ *     -n        skip fsync()
+ *     -v        print every record
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "../dbtrace.h"
+
+#define MAX_FILES               256
+#define OPEN_DELETEONCLOSE      0x00000008  /* SQLITE_OPEN_DELETEONCLOSE */
+
+struct replay_file
+{
+    int used;                   /* slot holds trace file id */
+    unsigned id;
+    int fd;
+    int refs;
+    int delete_on_close;
+    char path[300];
+    int64_t alloc;              /* bytes preallocated */
+    /* pending coalesced write */
+    char *wbuf;
+    int64_t woff;
+    int wlen;
+    /* read-ahead window */
+    char *rbuf;
+    int64_t roff;
+    int rlen;
+    int64_t rnext;
+    int rseq;
+};
+
+static struct
+{
+    unsigned long reads, writes, syncs, truncates, stats, opens, unlinks;
+    unsigned long ra_hits, coalesced;
+    int64_t read_bytes, write_bytes;
+    double io_time;
+} st;
+
+static struct replay_file files[MAX_FILES];
+static char names[SQLTRACE_NAMES][SQLTRACE_NAME_LEN];
+static const char *dir = ".";
+static int opt_coalesce, opt_readahead, opt_prealloc, opt_nosync, opt_verbose;
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* time one system call into st.io_time */
+#define TIMED(expr) do { double t0_ = now(); expr; st.io_time += now() - t0_; } while (0)
+
+static void file_path(struct replay_file *f, unsigned id, uint32_t nnames)
+{
+    const char *base = "";
+
+    if (id < nnames)
+    {
+        base = strrchr(names[id], '/');
+        base = base ? base + 1 : names[id];
+    }
+    snprintf(f->path, sizeof(f->path), "%s/f%u-%s", dir, id, base);
+}
+
+/* the slot of a trace file id, a free one on first use, NULL when all are taken */
+static struct replay_file *file_slot(unsigned id)
+{
+    struct replay_file *free_slot = NULL;
+    int i;
+
+    for (i = 0; i < MAX_FILES; i++)
+    {
+        if (files[i].used && files[i].id == id)
+        {
+            return &files[i];
+        }
+        if (!files[i].used && free_slot == NULL)
+        {
+            free_slot = &files[i];
+        }
+    }
+    if (free_slot)
+    {
+        free_slot->used = 1;
+        free_slot->id = id;
+        free_slot->path[0] = 0;
+    }
+    return free_slot;
+}
+
+static void flush_write(struct replay_file *f)
+{
+    ssize_t n;
+
+    if (f->wlen == 0)
+    {
+        return;
+    }
+    TIMED(n = pwrite(f->fd, f->wbuf, f->wlen, f->woff));
+    if (n != f->wlen)
+    {
+        perror("pwrite");
+    }
+    st.writes++;
+    st.write_bytes += f->wlen;
+    f->wlen = 0;
+}
+
+static void drop_readahead(struct replay_file *f)
+{
+    f->rlen = 0;
+}
+
+static void do_open(struct replay_file *f, unsigned id, uint32_t nnames, uint32_t flags)
+{
+    if (f->refs++ > 0)
+    {
+        return;
+    }
+    file_path(f, id, nnames);
+    TIMED(f->fd = open(f->path, O_RDWR | O_CREAT, 0644));
+    st.opens++;
+    if (f->fd < 0)
+    {
+        perror(f->path);
+        exit(1);
+    }
+    f->delete_on_close = (flags & OPEN_DELETEONCLOSE) != 0;
+    f->alloc = 0;
+    f->wlen = 0;
+    f->rlen = 0;
+    f->rseq = 0;
+    f->rnext = -1;
+    if (opt_coalesce && f->wbuf == NULL)
+    {
+        f->wbuf = malloc(opt_coalesce);
+    }
+    if (opt_readahead && f->rbuf == NULL)
+    {
+        f->rbuf = malloc(opt_readahead);
+    }
+}
+
+static void do_close(struct replay_file *f)
+{
+    if (f->refs == 0 || --f->refs > 0)
+    {
+        return;
+    }
+    flush_write(f);
+    TIMED(close(f->fd));
+    f->fd = -1;
+    if (f->delete_on_close)
+    {
+        TIMED(unlink(f->path));
+        st.unlinks++;
+    }
+}
+
+static void do_read(struct replay_file *f, int amt, int64_t off)
+{
+    char buf[65536];
+    ssize_t n;
+
+    flush_write(f);
+    if (f->rlen && off >= f->roff && off + amt <= f->roff + f->rlen)
+    {
+        st.ra_hits++;
+        f->rnext = off + amt;
+        return;
+    }
+
+    f->rseq = (off == f->rnext) ? f->rseq + 1 : 0;
+    f->rnext = off + amt;
+    if (opt_readahead && f->rseq >= 1 && amt < opt_readahead)
+    {
+        TIMED(n = pread(f->fd, f->rbuf, opt_readahead, off));
+        f->roff = off;
+        f->rlen = n > 0 ? (int)n : 0;
+    }
+    else
+    {
+        if (amt > (int)sizeof(buf))
+        {
+            amt = sizeof(buf);
+        }
+        TIMED(n = pread(f->fd, buf, amt, off));
+    }
+    st.reads++;
+    st.read_bytes += n > 0 ? n : 0;
+}
+
+static void do_write(struct replay_file *f, int amt, int64_t off)
+{
+    static char data[65536];
+    ssize_t n;
+
+    if (f->rlen && off < f->roff + f->rlen && off + amt > f->roff)
+    {
+        drop_readahead(f);
+    }
+
+    if (opt_prealloc && off + amt > f->alloc)
+    {
+        int64_t want = (off + amt + opt_prealloc - 1) / opt_prealloc * opt_prealloc;
+        struct stat sb;
+
+        flush_write(f);
+        TIMED(fstat(f->fd, &sb));
+        st.stats++;
+        if (sb.st_size < want)
+        {
+            TIMED(ftruncate(f->fd, want));
+            st.truncates++;
+        }
+        f->alloc = want;
+    }
+
+    if (opt_coalesce && amt <= opt_coalesce)
+    {
+        if (f->wlen && (off != f->woff + f->wlen || f->wlen + amt > opt_coalesce))
+        {
+            flush_write(f);
+        }
+        if (f->wlen == 0)
+        {
+            f->woff = off;
+        }
+        else
+        {
+            st.coalesced++;
+        }
+        memset(f->wbuf + f->wlen, 0, amt);
+        f->wlen += amt;
+        return;
+    }
+
+    flush_write(f);
+    if (amt > (int)sizeof(data))
+    {
+        amt = sizeof(data);
+    }
+    TIMED(n = pwrite(f->fd, data, amt, off));
+    if (n != amt)
+    {
+        perror("pwrite");
+    }
+    st.writes++;
+    st.write_bytes += amt;
+}
+
+static const char *op_name(int op)
+{
+    static const char *names_[] = { "?", "open", "close", "read", "write", "truncate", "sync",
+                                    "filesize", "lock", "unlock", "delete", "access" };
+    return op >= 0 && op <= SQLTRACE_ACCESS ? names_[op] : "?";
+}
+
+int main(int argc, char **argv)
+{
+    struct sqltrace_header hdr;
+    struct sqltrace_record rec;
+    uint32_t i, n, first = 0, last = 0;
+    double t0;
+    FILE *in;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "d:c:r:p:nv")) != -1)
+    {
+        switch (opt)
+        {
+        case 'd': dir = optarg; break;
+        case 'c': opt_coalesce = atoi(optarg); break;
+        case 'r': opt_readahead = atoi(optarg); break;
+        case 'p': opt_prealloc = atoi(optarg); break;
+        case 'n': opt_nosync = 1; break;
+        case 'v': opt_verbose = 1; break;
+        default:
+            fprintf(stderr, "usage: %s [-d DIR] [-c BYTES] [-r BYTES] [-p BYTES] [-n] [-v] TRACE\n", argv[0]);
+            return 2;
+        }
+    }
+    if (optind >= argc || (in = fopen(argv[optind], "rb")) == NULL)
+    {
+        fprintf(stderr, "no trace file\n");
+        return 2;
+    }
+    if (fread(&hdr, sizeof(hdr), 1, in) != 1 || hdr.magic != SQLTRACE_MAGIC || hdr.names > SQLTRACE_NAMES)
+    {
+        fprintf(stderr, "%s: not a trace file\n", argv[optind]);
+        return 1;
+    }
+    if (hdr.names && fread(names, SQLTRACE_NAME_LEN, hdr.names, in) != hdr.names)
+    {
+        fprintf(stderr, "%s: truncated name table\n", argv[optind]);
+        return 1;
+    }
+    if (hdr.dropped)
+    {
+        fprintf(stderr, "warning: %u records were dropped on the board, files opened before "
+                "the first record are opened on first use\n", hdr.dropped);
+    }
+
+    for (i = 0; i < MAX_FILES; i++)
+    {
+        files[i].fd = -1;
+    }
+
+    t0 = now();
+    for (n = 0; n < hdr.records && fread(&rec, sizeof(rec), 1, in) == 1; n++)
+    {
+        struct replay_file *f = file_slot(rec.file);
+
+        if (f == NULL)
+        {
+            fprintf(stderr, "record %u: more than %d files in use, raise MAX_FILES\n", n, MAX_FILES);
+            return 1;
+        }
+        if (n == 0)
+        {
+            first = rec.time;
+        }
+        last = rec.time;
+        if (opt_verbose)
+        {
+            printf("%10u %-8s file %-3u arg %-8u offset %-10lld rc %d\n", rec.time, op_name(rec.op),
+                   rec.file, rec.arg, (long long)rec.offset, rec.result);
+        }
+        if (rec.op != SQLTRACE_OPEN && rec.op != SQLTRACE_DELETE && rec.op != SQLTRACE_ACCESS && f->refs == 0)
+        {
+            /* opened before the ring wrapped */
+            do_open(f, rec.file, hdr.names, 0);
+        }
+
+        switch (rec.op)
+        {
+        case SQLTRACE_OPEN:
+            if (rec.result == 0)
+            {
+                do_open(f, rec.file, hdr.names, rec.arg);
+            }
+            break;
+        case SQLTRACE_CLOSE:
+            do_close(f);
+            if (f->refs == 0 && rec.file >= hdr.names)
+            {
+                /* temporary file ids are never used again */
+                f->used = 0;
+            }
+            break;
+        case SQLTRACE_READ:
+            do_read(f, (int)rec.arg, rec.offset);
+            break;
+        case SQLTRACE_WRITE:
+            do_write(f, (int)rec.arg, rec.offset);
+            break;
+        case SQLTRACE_TRUNCATE:
+            flush_write(f);
+            drop_readahead(f);
+            TIMED(ftruncate(f->fd, rec.offset));
+            st.truncates++;
+            f->alloc = rec.offset;
+            break;
+        case SQLTRACE_SYNC:
+            flush_write(f);
+            if (!opt_nosync)
+            {
+                TIMED(fsync(f->fd));
+                st.syncs++;
+            }
+            break;
+        case SQLTRACE_FILESIZE:
+        {
+            struct stat sb;
+            flush_write(f);
+            TIMED(fstat(f->fd, &sb));
+            st.stats++;
+            break;
+        }
+        case SQLTRACE_DELETE:
+            if (f->path[0] == 0)
+            {
+                file_path(f, rec.file, hdr.names);
+            }
+            TIMED(unlink(f->path));
+            st.unlinks++;
+            break;
+        case SQLTRACE_ACCESS:
+        {
+            struct stat sb;
+            if (f->path[0] == 0)
+            {
+                file_path(f, rec.file, hdr.names);
+            }
+            TIMED(stat(f->path, &sb));
+            st.stats++;
+            break;
+        }
+        default:
+            break;
+        }
+    }
+    for (i = 0; i < MAX_FILES; i++)
+    {
+        if (files[i].refs)
+        {
+            files[i].refs = 1;
+            do_close(&files[i]);
+        }
+    }
+    fclose(in);
+
+    printf("records    %u, recorded over %.3f s on the board\n", n,
+           hdr.tick_hz ? (double)(uint32_t)(last - first) / hdr.tick_hz : 0.0);
+    printf("reads      %lu, %lld bytes, %lu served by read-ahead\n", st.reads, (long long)st.read_bytes, st.ra_hits);
+    printf("writes     %lu, %lld bytes, %lu merged by coalescing\n", st.writes, (long long)st.write_bytes, st.coalesced);
+    printf("syncs      %lu\n", st.syncs);
+    printf("metadata   %lu open, %lu unlink, %lu stat, %lu truncate\n", st.opens, st.unlinks, st.stats, st.truncates);
+    printf("time       %.3f ms in system calls, %.3f ms total\n", st.io_time * 1000, (now() - t0) * 1000);
+    return 0;
+}